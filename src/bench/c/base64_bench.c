@@ -0,0 +1,52 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+// Benchmarks the base64 encoding loops, after checking them against the
+// generic one (see base64_parity.h). Exits with 1 if any implementation
+// produces different output.
+
+#include "base64_parity.h"
+#include "bench.h"
+
+int main(void)
+{
+    cpu_features_init();
+    base64_init();
+    printf("selected implementation: %s\n", base64_enc_impl->name);
+
+    if (base64_parity()) {
+        return 1;
+    }
+
+    size_t num_impls;
+    const struct base64_enc_impl *impls = base64_enc_impls(&num_impls);
+
+    static const size_t sizes[] = {64, 512, 2048, 65536};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t len = sizes[s];
+        uint8_t *data = malloc(len);
+        char *out = malloc(BASE64_SIZE(len));
+        if (!data || !out) {
+            abort();
+        }
+        bench_fill_random(data, len, 42);
+        for (size_t i = 0; i < num_impls; i++) {
+            const struct base64_enc_impl *impl = &impls[i];
+            if (!cpu_has(impl->required_features)) {
+                continue;
+            }
+            BENCH_RUN(impl->name, "random", len, {
+                size_t n = _encode_with(impl, data, len, out);
+                bench_sink = n + (uint8_t) out[0];
+            });
+        }
+        free(out);
+        free(data);
+    }
+    return 0;
+}
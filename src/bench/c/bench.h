@@ -0,0 +1,65 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+// keeps the compiler from discarding computations whose result is unused
+static volatile uintptr_t bench_sink;
+
+// fills buf with a deterministic pseudo-random sequence (xorshift32)
+static inline void bench_fill_random(uint8_t *buf, size_t len, uint32_t seed)
+{
+    uint32_t x = seed ? seed : 1;
+    for (size_t i = 0; i < len; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = (uint8_t) x;
+    }
+}
+
+static inline void bench_report(const char *impl, const char *input,
+                                size_t input_len, uint64_t iterations,
+                                uint64_t elapsed_ns)
+{
+    double ns_per_op = (double) elapsed_ns / (double) iterations;
+    double mb_per_s = (double) input_len * (double) iterations * 1000.0 /
+                      (double) elapsed_ns;
+    printf("%-10s %-14s %8zu bytes %12.1f ns/op %10.1f MB/s\n", impl, input,
+           input_len, ns_per_op, mb_per_s);
+}
+
+// runs body repeatedly for roughly 200 ms, after a warmup, and reports
+#define BENCH_RUN(impl, input, input_len, body)                                \
+    do {                                                                       \
+        for (int _w = 0; _w < 1000; _w++) {                                    \
+            body;                                                              \
+        }                                                                      \
+        uint64_t _iters = 0;                                                   \
+        uint64_t _start = bench_now_ns();                                      \
+        uint64_t _elapsed;                                                     \
+        do {                                                                   \
+            for (int _i = 0; _i < 100; _i++) {                                 \
+                body;                                                          \
+            }                                                                  \
+            _iters += 100;                                                     \
+        } while ((_elapsed = bench_now_ns() - _start) < 200000000u);           \
+        bench_report(impl, input, input_len, _iters, _elapsed);                \
+    } while (0)
@@ -0,0 +1,224 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+// Compares the gzip+base64 encoding of schema attributes through pooled
+// compressor state with the former per-call deflateInit2, realloc-grown
+// output and separate base64 buffer.
+// Exits with 1 if an encoded schema doesn't decode back to its input.
+
+#include "base64.h"
+#include "bench.h"
+#include "cpu_features.h"
+#include "gzip.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <zlib.h>
+
+#define BASE64_SIZE(n) (((n) + 2) / 3 * 4)
+
+/* the former encoding */
+
+static uint8_t *_old_gzip(const char *json, size_t json_len, size_t *out_size)
+{
+    z_stream strm = {0};
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        return NULL;
+    }
+    size_t deflated_size = json_len < 1024 ? 1024 : json_len;
+    uint8_t *ret = malloc(deflated_size);
+    if (ret == NULL) {
+        deflateEnd(&strm);
+        return NULL;
+    }
+    strm.avail_in = (unsigned) json_len;
+    strm.next_in = (const uint8_t *) json;
+    do {
+        if (strm.total_out >= deflated_size) {
+            deflated_size *= 2;
+            uint8_t *new_ret = realloc(ret, deflated_size);
+            if (new_ret == NULL) {
+                free(ret);
+                deflateEnd(&strm);
+                return NULL;
+            }
+            ret = new_ret;
+        }
+        strm.avail_out = (unsigned) (deflated_size - strm.total_out);
+        strm.next_out = ret + strm.total_out;
+        if (deflate(&strm, Z_FINISH) == Z_STREAM_ERROR) {
+            free(ret);
+            deflateEnd(&strm);
+            return NULL;
+        }
+    } while (strm.avail_out == 0);
+    *out_size = strm.total_out;
+    deflateEnd(&strm);
+    return ret;
+}
+
+static char *_old_encode(const char *json, size_t json_len, size_t *out_len)
+{
+    size_t gzip_size;
+    uint8_t *gzip = _old_gzip(json, json_len, &gzip_size);
+    if (!gzip) {
+        return NULL;
+    }
+    char *base64 = malloc(((4 * gzip_size / 3) + 3) & ~3UL);
+    if (base64) {
+        base64_encode((const char *) gzip, gzip_size, base64, out_len);
+    }
+    free(gzip);
+    return base64;
+}
+
+/* the encoding in output.c, minus the java string */
+
+static size_t _new_encode(const char *json, size_t json_len, char *out,
+                          size_t out_size)
+{
+    uint8_t gzip[3072];
+    if (gzip_bound(json_len) > sizeof gzip) {
+        return 0;
+    }
+    size_t gzip_size = gzip_compress(json, json_len, gzip);
+    if (gzip_size == 0 || BASE64_SIZE(gzip_size) > out_size) {
+        return 0;
+    }
+    size_t base64_len;
+    base64_encode((const char *) gzip, gzip_size, out, &base64_len);
+    return base64_len;
+}
+
+/* verification */
+
+static int _b64_value(char c)
+{
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    }
+    return c == '+' ? 62 : c == '/' ? 63 : -1;
+}
+
+static size_t _b64_decode(const char *in, size_t len, uint8_t *out)
+{
+    size_t o = 0;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (size_t i = 0; i < len && in[i] != '='; i++) {
+        int v = _b64_value(in[i]);
+        if (v < 0) {
+            return 0;
+        }
+        acc = (acc << 6) | (uint32_t) v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[o++] = (uint8_t) (acc >> bits);
+        }
+    }
+    return o;
+}
+
+static bool _decodes_to(const char *b64, size_t b64_len, const char *json,
+                        size_t json_len)
+{
+    uint8_t gzip[8192];
+    char plain[8192];
+    size_t gzip_len = _b64_decode(b64, b64_len, gzip);
+
+    z_stream strm = {0};
+    if (inflateInit2(&strm, 31) != Z_OK) {
+        return false;
+    }
+    strm.next_in = gzip;
+    strm.avail_in = (uInt) gzip_len;
+    strm.next_out = (Bytef *) plain;
+    strm.avail_out = sizeof plain;
+    int res = inflate(&strm, Z_FINISH);
+    size_t plain_len = strm.total_out;
+    inflateEnd(&strm);
+    return res == Z_STREAM_END && plain_len == json_len &&
+           memcmp(plain, json, json_len) == 0;
+}
+
+// something shaped like an API security schema
+static size_t _make_schema(char *out, size_t size, int fields, uint32_t seed)
+{
+    size_t len = 0;
+    out[len++] = '[';
+    out[len++] = '{';
+    uint32_t x = seed;
+    for (int i = 0; i < fields; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        int n = snprintf(out + len, size - len, "%s\"field_%" PRIu32 "\":[%d]",
+                         i ? "," : "", x % 10000, (int) (x % 3) * 8);
+        len += (size_t) n;
+    }
+    out[len++] = '}';
+    out[len++] = ']';
+    return len;
+}
+
+int main(void)
+{
+    cpu_features_init();
+    base64_init();
+
+    static char json[3][4096];
+    size_t json_len[3] = {
+            _make_schema(json[0], sizeof json[0], 8, 1),
+            _make_schema(json[1], sizeof json[1], 50, 2),
+            _make_schema(json[2], sizeof json[2], 120, 3),
+    };
+    const char *names[3] = {"schema-s", "schema-m", "schema-l"};
+
+    char out[8192];
+    int levels[] = {GZIP_DEFAULT_LEVEL, 0, 1, 9};
+    for (size_t l = 0; l < sizeof levels / sizeof levels[0]; l++) {
+        gzip_set_level(levels[l]);
+        for (int i = 0; i < 3; i++) {
+            // twice, so the second one uses a reset pooled state
+            for (int rep = 0; rep < 2; rep++) {
+                size_t len =
+                        _new_encode(json[i], json_len[i], out, sizeof out);
+                if (len == 0 || !_decodes_to(out, len, json[i], json_len[i])) {
+                    fprintf(stderr, "%s (level %d): round-trip failed\n",
+                            names[i], levels[l]);
+                    return 1;
+                }
+            }
+        }
+    }
+    gzip_set_level(GZIP_DEFAULT_LEVEL);
+
+    for (int i = 0; i < 3; i++) {
+        BENCH_RUN("deflateInit", names[i], json_len[i], {
+            size_t len;
+            char *b64 = _old_encode(json[i], json_len[i], &len);
+            bench_sink = (uintptr_t) len;
+            free(b64);
+        });
+        BENCH_RUN(gzip_backend, names[i], json_len[i], {
+            size_t len = _new_encode(json[i], json_len[i], out, sizeof out);
+            bench_sink = (uintptr_t) len;
+        });
+    }
+
+    gzip_shutdown();
+    return 0;
+}
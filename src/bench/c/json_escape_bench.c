@@ -0,0 +1,62 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+// Benchmarks the JSON string escaping implementations and the original
+// byte-by-byte loop, after checking them against it (see
+// json_escape_parity.h). Exits with 1 if any implementation produces
+// different output.
+
+#include "bench.h"
+#include "json_escape_parity.h"
+
+int main(void)
+{
+    static const size_t sizes[] = {15, 64, 256, 4096, 65536};
+
+    cpu_features_init();
+    json_escape_init();
+    printf("selected implementation: %s\n", json_escape_impl->name);
+
+    size_t num_impls;
+    const struct json_escape_impl *impls = json_escape_impls(&num_impls);
+
+    if (json_escape_parity()) {
+        return 1;
+    }
+
+    for (size_t k = 0; k < sizeof(_kinds) / sizeof(_kinds[0]); k++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            size_t len = sizes[s];
+            char *data = _make_input(_kinds[k], len);
+            char *out = malloc(len * 6);
+            if (!out) {
+                abort();
+            }
+
+            BENCH_RUN("legacy", _kinds[k], len, {
+                size_t n = _legacy_size(data, len);
+                _legacy_escape(data, len, out);
+                bench_sink = n + (uint8_t) out[0];
+            });
+            for (size_t i = 0; i < num_impls; i++) {
+                const struct json_escape_impl *impl = &impls[i];
+                if (!cpu_has(impl->required_features)) {
+                    continue;
+                }
+                BENCH_RUN(impl->name, _kinds[k], len, {
+                    size_t n = impl->escaped_size(data, len);
+                    impl->escape(data, len, out);
+                    bench_sink = n + (uint8_t) out[0];
+                });
+            }
+            free(out);
+            free(data);
+        }
+    }
+    return 0;
+}
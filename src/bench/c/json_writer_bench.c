@@ -0,0 +1,413 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+// Compares json_write_object() with the segment list writer it replaced, on
+// ddwaf_object trees shaped like WAF events and like schema attributes.
+// Exits with 1 if the outputs differ or a float doesn't round-trip.
+
+#include "bench.h"
+#include "cpu_features.h"
+#include "json.h"
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+
+/* the former writer: a list of segments of at least 216 bytes */
+
+#define MIN_JSON_SEGMENT_SIZE ((uint32_t) 216)
+
+struct json_segment {
+    uint32_t size, len;
+    struct json_segment *next;
+    char data[];
+};
+
+static struct json_segment *_seg_new(size_t min_size)
+{
+    if (min_size > UINT32_MAX) {
+        return NULL;
+    }
+    uint32_t size = ((uint32_t) min_size) < MIN_JSON_SEGMENT_SIZE
+                            ? MIN_JSON_SEGMENT_SIZE
+                            : (uint32_t) min_size;
+    struct json_segment *seg = malloc(sizeof *seg + size);
+    if (!seg) {
+        return NULL;
+    }
+    seg->size = size;
+    seg->len = 0;
+    seg->next = NULL;
+    return seg;
+}
+
+static struct json_segment *_seg_ensure(struct json_segment *seg,
+                                        size_t data_len)
+{
+    if (seg == NULL || data_len > UINT32_MAX) {
+        return NULL;
+    }
+    if (seg->size - seg->len >= data_len) {
+        return seg;
+    }
+    struct json_segment *new_seg = _seg_new(data_len);
+    if (!new_seg) {
+        return NULL;
+    }
+    seg->next = new_seg;
+    return new_seg;
+}
+
+static struct json_segment *_seg_append(struct json_segment *seg,
+                                        const char *data, size_t data_len)
+{
+    struct json_segment *cur = _seg_ensure(seg, data_len);
+    if (cur == NULL) {
+        return NULL;
+    }
+    memcpy(cur->data + cur->len, data, data_len);
+    cur->len += (uint32_t) data_len;
+    return cur;
+}
+
+static struct json_segment *_seg_encode_str(struct json_segment *seg,
+                                            const char *str, size_t len)
+{
+    size_t enc_len = json_escape_impl->escaped_size(str, len);
+    struct json_segment *cur = _seg_ensure(seg, enc_len);
+    if (!cur) {
+        return NULL;
+    }
+    if (enc_len == len) {
+        memcpy(cur->data + cur->len, str, len);
+    } else {
+        json_escape_impl->escape(str, len, cur->data + cur->len);
+    }
+    cur->len += (uint32_t) enc_len;
+    return cur;
+}
+
+static void _seg_free(struct json_segment *seg)
+{
+    while (seg) {
+        struct json_segment *next = seg->next;
+        free(seg);
+        seg = next;
+    }
+}
+
+static struct json_segment *_seg_convert(const ddwaf_object *obj, int depth,
+                                         struct json_segment *seg)
+{
+    if (depth > MAX_JSON_DEPTH || !obj || !seg) {
+        return NULL;
+    }
+
+    switch (obj->type) {
+    case DDWAF_OBJ_SIGNED: {
+        char str[21];
+        int len = sprintf(str, "%" PRId64, obj->intValue);
+        seg = _seg_append(seg, str, (size_t) len);
+    } break;
+    case DDWAF_OBJ_UNSIGNED: {
+        char str[21];
+        int len = sprintf(str, "%" PRIu64, obj->uintValue);
+        seg = _seg_append(seg, str, (size_t) len);
+    } break;
+    case DDWAF_OBJ_STRING:
+        seg = _seg_append(seg, "\"", 1);
+        seg = _seg_encode_str(seg, obj->stringValue, obj->nbEntries);
+        seg = _seg_append(seg, "\"", 1);
+        break;
+    case DDWAF_OBJ_ARRAY:
+        seg = _seg_append(seg, "[", 1);
+        for (uint64_t i = 0; i < obj->nbEntries; i++) {
+            seg = _seg_convert(&obj->array[i], depth + 1, seg);
+            if (i != obj->nbEntries - 1) {
+                seg = _seg_append(seg, ",", 1);
+            }
+        }
+        seg = _seg_append(seg, "]", 1);
+        break;
+    case DDWAF_OBJ_MAP:
+        seg = _seg_append(seg, "{", 1);
+        for (uint64_t i = 0; i < obj->nbEntries; i++) {
+            const ddwaf_object *o = &obj->array[i];
+            seg = _seg_append(seg, "\"", 1);
+            seg = _seg_encode_str(seg, o->parameterName,
+                                  o->parameterNameLength);
+            seg = _seg_append(seg, "\":", 2);
+            seg = _seg_convert(o, depth + 1, seg);
+            if (i != obj->nbEntries - 1) {
+                seg = _seg_append(seg, ",", 1);
+            }
+        }
+        seg = _seg_append(seg, "}", 1);
+        break;
+    case DDWAF_OBJ_BOOL:
+        seg = obj->boolean ? _seg_append(seg, "true", 4)
+                           : _seg_append(seg, "false", 5);
+        break;
+    default:
+        return NULL;
+    }
+    return seg;
+}
+
+// convert then flatten, as the consumers had to
+static char *_seg_write(const ddwaf_object *obj, size_t *len)
+{
+    struct json_segment *first = _seg_new(0);
+    if (!first || !_seg_convert(obj, 0, first)) {
+        _seg_free(first);
+        return NULL;
+    }
+    size_t total = 0;
+    for (struct json_segment *s = first; s; s = s->next) {
+        total += s->len;
+    }
+    char *out = malloc(total + 1);
+    if (out) {
+        char *o = out;
+        for (struct json_segment *s = first; s; s = s->next) {
+            memcpy(o, s->data, s->len);
+            o += s->len;
+        }
+        *o = '\0';
+        *len = total;
+    }
+    _seg_free(first);
+    return out;
+}
+
+/* ddwaf_object construction, without depending on libddwaf's allocator */
+
+static ddwaf_object *_new_children(ddwaf_object *parent, DDWAF_OBJ_TYPE type,
+                                   size_t n)
+{
+    memset(parent, 0, sizeof *parent);
+    parent->type = type;
+    parent->nbEntries = n;
+    parent->array = calloc(n ? n : 1, sizeof *parent->array);
+    if (!parent->array) {
+        abort();
+    }
+    return parent->array;
+}
+
+static void _set_key(ddwaf_object *o, const char *key)
+{
+    o->parameterName = key;
+    o->parameterNameLength = strlen(key);
+}
+
+static void _set_str(ddwaf_object *o, const char *key, const char *val)
+{
+    _set_key(o, key);
+    o->type = DDWAF_OBJ_STRING;
+    o->stringValue = val;
+    o->nbEntries = strlen(val);
+}
+
+static void _set_uint(ddwaf_object *o, const char *key, uint64_t val)
+{
+    _set_key(o, key);
+    o->type = DDWAF_OBJ_UNSIGNED;
+    o->uintValue = val;
+}
+
+static void _set_int(ddwaf_object *o, const char *key, int64_t val)
+{
+    _set_key(o, key);
+    o->type = DDWAF_OBJ_SIGNED;
+    o->intValue = val;
+}
+
+static void _free_tree(ddwaf_object *o)
+{
+    if (o->type == DDWAF_OBJ_ARRAY || o->type == DDWAF_OBJ_MAP) {
+        for (uint64_t i = 0; i < o->nbEntries; i++) {
+            _free_tree(&o->array[i]);
+        }
+        free(o->array);
+    }
+}
+
+// an "events" array like the one ddwaf_run returns
+static void _make_events(ddwaf_object *root, size_t num_events)
+{
+    ddwaf_object *events = _new_children(root, DDWAF_OBJ_ARRAY, num_events);
+    for (size_t e = 0; e < num_events; e++) {
+        ddwaf_object *ev = _new_children(&events[e], DDWAF_OBJ_MAP, 2);
+
+        ddwaf_object *rule = _new_children(&ev[0], DDWAF_OBJ_MAP, 3);
+        _set_key(&ev[0], "rule");
+        _set_str(&rule[0], "id", "crs-913-110");
+        _set_str(&rule[1], "name", "Found request header associated with "
+                                   "Acunetix security scanner");
+        _set_key(&rule[2], "tags");
+        ddwaf_object *tags = _new_children(&rule[2], DDWAF_OBJ_MAP, 2);
+        _set_key(&rule[2], "tags");
+        _set_str(&tags[0], "type", "security_scanner");
+        _set_str(&tags[1], "category", "attack_attempt");
+
+        ddwaf_object *matches = _new_children(&ev[1], DDWAF_OBJ_ARRAY, 1);
+        _set_key(&ev[1], "rule_matches");
+        ddwaf_object *match = _new_children(&matches[0], DDWAF_OBJ_MAP, 3);
+        _set_str(&match[0], "operator", "phrase_match");
+        _set_str(&match[1], "operator_value", "");
+        ddwaf_object *params = _new_children(&match[2], DDWAF_OBJ_ARRAY, 1);
+        _set_key(&match[2], "parameters");
+        ddwaf_object *param = _new_children(&params[0], DDWAF_OBJ_MAP, 4);
+        _set_str(&param[0], "address", "server.request.headers.no_cookies");
+        ddwaf_object *key_path = _new_children(&param[1], DDWAF_OBJ_ARRAY, 2);
+        _set_key(&param[1], "key_path");
+        _set_str(&key_path[0], "", "user-agent");
+        _set_uint(&key_path[1], "", e);
+        _set_str(&param[2], "value",
+                 "Mozilla/5.0 \"acunetix-wvs-test-for-some-inexistent-file\"\n"
+                 "\tby \\acunetix\\");
+        ddwaf_object *highlight = _new_children(&param[3], DDWAF_OBJ_ARRAY, 1);
+        _set_key(&param[3], "highlight");
+        _set_str(&highlight[0], "", "acunetix-wvs-test-for-some-inexistent-file");
+    }
+}
+
+// a schema attribute: deeply nested small arrays of type tags
+static void _make_schema(ddwaf_object *root)
+{
+    ddwaf_object *top = _new_children(root, DDWAF_OBJ_ARRAY, 1);
+    ddwaf_object *fields = _new_children(&top[0], DDWAF_OBJ_MAP, 12);
+    static const char *names[] = {"id",    "name",    "email", "age",
+                                  "admin", "created", "tags",  "address",
+                                  "phone", "zip",     "score", "history"};
+    for (size_t i = 0; i < 12; i++) {
+        ddwaf_object *type = _new_children(&fields[i], DDWAF_OBJ_ARRAY, 2);
+        _set_key(&fields[i], names[i]);
+        _set_uint(&type[0], "", (uint64_t) (i % 4 + 1));
+        _set_int(&type[1], "", -(int64_t) i * 1234567);
+    }
+}
+
+static int _check_equal(const ddwaf_object *obj, const char *what)
+{
+    size_t legacy_len = 0;
+    char *legacy = _seg_write(obj, &legacy_len);
+    struct json_buf buf;
+    json_buf_init(&buf, NULL, 0);
+    bool ok = json_write_object(&buf, obj);
+    int ret = 0;
+    if (!legacy || !ok || legacy_len != buf.len ||
+        memcmp(legacy, buf.data, buf.len) != 0) {
+        fprintf(stderr, "%s: output mismatch\n", what);
+        ret = 1;
+    }
+    if (ok && json_estimate_size(obj) < buf.len) {
+        fprintf(stderr, "%s: estimate below actual size\n", what);
+        ret = 1;
+    }
+    free(legacy);
+    json_buf_free(&buf);
+    return ret;
+}
+
+static int _check_doubles(void)
+{
+    static const double fixed[] = {0.0,     -0.0,     1.0,      -1.5,
+                                   0.1,     1.0 / 3,  1e15,     1e300,
+                                   5e-324,  1e-7,     123456.789,
+                                   2.2250738585072014e-308,
+                                   1.7976931348623157e308};
+    int ret = 0;
+    uint32_t seed = 42;
+    for (size_t i = 0; i < 100000; i++) {
+        double d;
+        if (i < sizeof(fixed) / sizeof(fixed[0])) {
+            d = fixed[i];
+        } else {
+            uint64_t bits;
+            bench_fill_random((uint8_t *) &bits, sizeof bits, seed++);
+            memcpy(&d, &bits, sizeof d);
+            if (!isfinite(d)) {
+                continue;
+            }
+        }
+        ddwaf_object o = {.type = DDWAF_OBJ_FLOAT, .f64 = d};
+        char storage[64];
+        struct json_buf buf;
+        json_buf_init(&buf, storage, sizeof storage);
+        if (!json_write_object(&buf, &o) || buf.owned ||
+            strtod(buf.data, NULL) != d ||
+            signbit(strtod(buf.data, NULL)) != signbit(d)) {
+            fprintf(stderr, "double %.17g written as %s\n", d, buf.data);
+            ret = 1;
+        }
+        json_buf_free(&buf);
+    }
+    return ret;
+}
+
+int main(void)
+{
+    cpu_features_init();
+    json_escape_init();
+
+    ddwaf_object events_small, events_large, schema;
+    _make_events(&events_small, 1);
+    _make_events(&events_large, 50);
+    _make_schema(&schema);
+
+    int failed = 0;
+    failed |= _check_equal(&events_small, "events (1)");
+    failed |= _check_equal(&events_large, "events (50)");
+    failed |= _check_equal(&schema, "schema");
+    failed |= _check_doubles();
+    if (failed) {
+        return 1;
+    }
+
+    struct {
+        const char *name;
+        const ddwaf_object *obj;
+    } inputs[] = {
+            {"events-1", &events_small},
+            {"events-50", &events_large},
+            {"schema", &schema},
+    };
+
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        const ddwaf_object *obj = inputs[i].obj;
+        size_t len = json_estimate_size(obj);
+
+        BENCH_RUN("segments", inputs[i].name, len, {
+            size_t out_len;
+            char *out = _seg_write(obj, &out_len);
+            bench_sink = (uintptr_t) out_len;
+            free(out);
+        });
+        BENCH_RUN("json_buf", inputs[i].name, len, {
+            struct json_buf buf;
+            json_buf_init(&buf, NULL, 0);
+            json_write_object(&buf, obj);
+            bench_sink = (uintptr_t) buf.len;
+            json_buf_free(&buf);
+        });
+        BENCH_RUN("json_buf/s", inputs[i].name, len, {
+            char storage[2048];
+            struct json_buf buf;
+            json_buf_init(&buf, storage, sizeof storage);
+            json_write_object(&buf, obj);
+            bench_sink = (uintptr_t) buf.len;
+            json_buf_free(&buf);
+        });
+    }
+
+    _free_tree(&events_small);
+    _free_tree(&events_large);
+    _free_tree(&schema);
+    return 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+// Benchmarks every UTF-16 to UTF-8 transcoder the CPU supports and the
+// previous implementation, after checking them against it (see
+// utf16_utf8_fuzz.h). Exits with 1 if the outputs or the computed lengths
+// differ.
+
+#include "bench.h"
+#include "utf16_utf8_fuzz.h"
+
+int main(void)
+{
+    cpu_features_init();
+    utf_transcode_init();
+    printf("selected implementation: %s\n", utf_transcode_impl->name);
+
+    if (utf16_utf8_fuzz(200000)) {
+        return 1;
+    }
+
+    static const size_t sizes[] = {16, 256, 4096};
+    for (int c = ASCII; c <= MIXED; c++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            size_t len = sizes[s];
+            uint16_t *data = malloc(len * sizeof *data);
+            if (!data) {
+                abort();
+            }
+            _fill((enum corpus) c, data, len, 42);
+            size_t out_len;
+            BENCH_RUN("previous", _corpus_names[c], len * 2, {
+                uint8_t *out = _reference(data, len, &out_len);
+                bench_sink = out_len + out[0];
+                free(out);
+            });
+            for (size_t i = 0; i < _num_impls; i++) {
+                const struct utf_transcode_impl *impl = &_impls[i];
+                if (!cpu_has(impl->required_features)) {
+                    continue;
+                }
+                BENCH_RUN(impl->name, _corpus_names[c], len * 2, {
+                    uint8_t *out = _transcode(impl, data, len, &out_len);
+                    bench_sink = out_len + out[0];
+                    free(out);
+                });
+            }
+            free(data);
+        }
+    }
+    return 0;
+}
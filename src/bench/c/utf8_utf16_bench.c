@@ -0,0 +1,52 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+// Checks every UTF-8 to UTF-16 decoder the CPU supports against the previous
+// implementation (see utf8_utf16_fuzz.h, also run as a test, here with more
+// iterations), then compares their speed on ASCII, Latin-1, CJK and emoji
+// text. Exits with 1 if any output differs.
+
+#include "bench.h"
+#include "utf8_utf16_fuzz.h"
+
+int main(void)
+{
+    cpu_features_init();
+    utf_transcode_init();
+    printf("selected implementation: %s\n", utf_transcode_impl->name);
+    if (utf8_utf16_fuzz(200000)) {
+        return 1;
+    }
+
+    static const size_t sizes[] = {16, 256, 4096};
+    for (int c = ASCII; c <= MIXED; c++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            uint8_t *data = malloc(sizes[s]);
+            uint16_t *out = malloc(sizes[s] * sizeof *out);
+            if (!data || !out) {
+                abort();
+            }
+            size_t len = _fill((enum corpus) c, data, sizes[s], 42);
+            BENCH_RUN("previous", _corpus_names[c], len, {
+                bench_sink = _reference(data, len, out) + out[0];
+            });
+            for (size_t i = 0; i < _num_impls; i++) {
+                const struct utf_transcode_impl *impl = &_impls[i];
+                if (!cpu_has(impl->required_features)) {
+                    continue;
+                }
+                BENCH_RUN(impl->name, _corpus_names[c], len, {
+                    bench_sink = impl->utf8_to_utf16(data, len, out) + out[0];
+                });
+            }
+            free(data);
+            free(out);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+package com.datadog.ddwaf;
+
+import groovy.json.JsonOutput;
+import groovy.json.JsonSlurper;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Files;
+import java.nio.file.Paths;
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.concurrent.TimeUnit;
+import org.openjdk.jmh.annotations.Benchmark;
+import org.openjdk.jmh.annotations.BenchmarkMode;
+import org.openjdk.jmh.annotations.Fork;
+import org.openjdk.jmh.annotations.Level;
+import org.openjdk.jmh.annotations.Measurement;
+import org.openjdk.jmh.annotations.Mode;
+import org.openjdk.jmh.annotations.OutputTimeUnit;
+import org.openjdk.jmh.annotations.Param;
+import org.openjdk.jmh.annotations.Scope;
+import org.openjdk.jmh.annotations.Setup;
+import org.openjdk.jmh.annotations.State;
+import org.openjdk.jmh.annotations.TearDown;
+import org.openjdk.jmh.annotations.Warmup;
+
+/**
+ * Adds a JSON configuration to a {@link WafBuilder}: parsed by {@link JsonSlurper} and converted
+ * from the resulting {@code Map} (the usual path for remote config payloads), converted from a
+ * {@code Map} parsed beforehand, or parsed natively; or, for the generated blocklist only, passed
+ * as packed values. All include libddwaf processing the update.
+ *
+ * <pre>
+ * ./gradlew jmh -Pjmh.includes=ConfigIngestion -Pjmh.params='config=/tmp/ruleset.json'
+ * </pre>
+ *
+ * Without a config, {@code rules_data} blocking {@code entries} IP addresses is generated. Run
+ * with {@code -prof gc} to compare the garbage of full and summary diagnostics.
+ */
+@Warmup(iterations = 2, time = 1000, timeUnit = TimeUnit.MILLISECONDS)
+@Measurement(iterations = 3, time = 1000, timeUnit = TimeUnit.MILLISECONDS)
+@Fork(3)
+@OutputTimeUnit(TimeUnit.MILLISECONDS)
+@BenchmarkMode(Mode.AverageTime)
+@State(Scope.Thread)
+public class ConfigIngestionBenchmark {
+
+  @Param({""})
+  public String config;
+
+  @Param({"1000", "100000"})
+  public int entries;
+
+  @Param({"false", "true"})
+  public boolean summaryDiagnostics;
+
+  private String[] ips;
+  private byte[] json;
+  private Map<String, Object> parsed;
+  private WafBuilder builder;
+
+  @Setup(Level.Trial)
+  @SuppressWarnings("unchecked")
+  public void setup() throws Exception {
+    Waf.initialize(System.getProperty("useReleaseBinaries") == null);
+    ips = new String[entries];
+    for (int i = 0; i < entries; i++) {
+      ips[i] = "10." + (i >> 16 & 0xFF) + "." + (i >> 8 & 0xFF) + "." + (i & 0xFF);
+    }
+    json =
+        config.isEmpty()
+            ? JsonOutput.toJson(ipRulesData(ips)).getBytes(StandardCharsets.UTF_8)
+            : Files.readAllBytes(Paths.get(config));
+    parsed = (Map<String, Object>) new JsonSlurper().parse(json);
+    WafConfig wafConfig = new WafConfig();
+    wafConfig.summaryDiagnostics = summaryDiagnostics;
+    builder = new WafBuilder(wafConfig);
+  }
+
+  // otherwise every invocation after the first would be skipped as unchanged
+  @TearDown(Level.Invocation)
+  public void removeConfig() throws Exception {
+    builder.removeConfig("bench");
+  }
+
+  @TearDown(Level.Trial)
+  public void teardown() {
+    builder.close();
+  }
+
+  @Benchmark
+  @SuppressWarnings("unchecked")
+  public WafDiagnostics jsonSlurperMap() throws Exception {
+    Map<String, Object> map = (Map<String, Object>) new JsonSlurper().parse(json);
+    return builder.addOrUpdateConfig("bench", map);
+  }
+
+  @Benchmark
+  public WafDiagnostics preparsedMap() throws Exception {
+    return builder.addOrUpdateConfig("bench", parsed);
+  }
+
+  @Benchmark
+  public WafDiagnostics nativeJson() throws Exception {
+    return builder.addOrUpdateConfig("bench", json);
+  }
+
+  @Benchmark
+  public WafDiagnostics packedData() throws Exception {
+    return builder.addOrUpdateDataConfig(
+        "bench", WafBuilder.DataSection.RULES_DATA, "blocked_ips", "ip_with_expiration", ips, null);
+  }
+
+  private static Map<String, Object> ipRulesData(String[] ips) {
+    List<Object> data = new ArrayList<>(ips.length);
+    for (String ip : ips) {
+      Map<String, Object> entry = new HashMap<>();
+      entry.put("value", ip);
+      entry.put("expiration", 0);
+      data.add(entry);
+    }
+    Map<String, Object> rulesData = new HashMap<>();
+    rulesData.put("id", "blocked_ips");
+    rulesData.put("type", "ip_with_expiration");
+    rulesData.put("data", data);
+    return Collections.singletonMap("rules_data", Collections.singletonList(rulesData));
+  }
+}
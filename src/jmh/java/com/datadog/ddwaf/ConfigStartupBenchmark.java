@@ -0,0 +1,147 @@
+package com.datadog.ddwaf;
+
+import groovy.json.JsonOutput;
+import groovy.json.JsonSlurper;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.nio.file.Paths;
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.concurrent.TimeUnit;
+import org.openjdk.jmh.annotations.Benchmark;
+import org.openjdk.jmh.annotations.BenchmarkMode;
+import org.openjdk.jmh.annotations.Fork;
+import org.openjdk.jmh.annotations.Level;
+import org.openjdk.jmh.annotations.Measurement;
+import org.openjdk.jmh.annotations.Mode;
+import org.openjdk.jmh.annotations.OutputTimeUnit;
+import org.openjdk.jmh.annotations.Param;
+import org.openjdk.jmh.annotations.Scope;
+import org.openjdk.jmh.annotations.Setup;
+import org.openjdk.jmh.annotations.State;
+import org.openjdk.jmh.annotations.TearDown;
+import org.openjdk.jmh.annotations.Warmup;
+
+/**
+ * Time to the first {@link WafHandle} in a fresh JVM, from a ruleset file: parsed by {@link
+ * JsonSlurper} and converted from the {@code Map}, parsed natively, or loaded from a {@link
+ * ConfigSnapshot} written beforehand. Each fork measures a single cold invocation; the native
+ * library is loaded outside of it.
+ *
+ * <pre>
+ * ./gradlew jmh -Pjmh.includes=ConfigStartup -Pjmh.params='ruleset=/tmp/recommended.json'
+ * </pre>
+ *
+ * The {@code default} ruleset has 150 generated rules, about the size of the recommended one.
+ */
+@Warmup(iterations = 0)
+@Measurement(iterations = 1)
+@Fork(20)
+@OutputTimeUnit(TimeUnit.MILLISECONDS)
+@BenchmarkMode(Mode.SingleShotTime)
+@State(Scope.Thread)
+public class ConfigStartupBenchmark {
+
+  @Param({"default"})
+  public String ruleset;
+
+  private Path json;
+  private Path snapshot;
+  private boolean tempJson;
+  private WafHandle handle;
+
+  @Setup(Level.Trial)
+  @SuppressWarnings("unchecked")
+  public void setup() throws Exception {
+    Waf.initialize(System.getProperty("useReleaseBinaries") == null);
+
+    if ("default".equals(ruleset)) {
+      json = Files.createTempFile("ddwaf-startup", ".json");
+      tempJson = true;
+      Files.write(json, JsonOutput.toJson(generatedRuleset()).getBytes(StandardCharsets.UTF_8));
+    } else {
+      json = Paths.get(ruleset);
+    }
+    snapshot = Files.createTempFile("ddwaf-startup", ".snapshot");
+    ConfigSnapshot.write(
+        (Map<String, Object>) new JsonSlurper().parse(Files.readAllBytes(json)), snapshot);
+  }
+
+  @TearDown(Level.Trial)
+  public void teardown() throws Exception {
+    if (handle != null) {
+      handle.close();
+    }
+    Files.deleteIfExists(snapshot);
+    if (tempJson) {
+      Files.deleteIfExists(json);
+    }
+  }
+
+  @Benchmark
+  @SuppressWarnings("unchecked")
+  public WafHandle jsonSlurperMap() throws Exception {
+    Map<String, Object> config =
+        (Map<String, Object>) new JsonSlurper().parse(Files.readAllBytes(json));
+    return firstHandle(builder -> builder.addOrUpdateConfig("ruleset", config));
+  }
+
+  @Benchmark
+  public WafHandle nativeJson() throws Exception {
+    return firstHandle(builder -> builder.addOrUpdateConfigFile("ruleset", json));
+  }
+
+  @Benchmark
+  public WafHandle snapshot() throws Exception {
+    return firstHandle(
+        builder -> builder.addOrUpdateConfig("ruleset", ConfigSnapshot.map(snapshot)));
+  }
+
+  private interface ConfigLoader {
+    void load(WafBuilder builder) throws Exception;
+  }
+
+  private WafHandle firstHandle(ConfigLoader loader) throws Exception {
+    WafBuilder builder = new WafBuilder(new WafConfig());
+    try {
+      loader.load(builder);
+      handle = builder.buildWafHandleInstance();
+      return handle;
+    } finally {
+      builder.close();
+    }
+  }
+
+  private static Map<String, Object> generatedRuleset() {
+    List<Object> rules = new ArrayList<>();
+    for (int i = 0; i < 150; i++) {
+      Map<String, Object> input = new HashMap<>();
+      input.put("address", i % 2 == 0 ? "server.request.query" : "server.request.body");
+      Map<String, Object> parameters = new HashMap<>();
+      parameters.put("inputs", Collections.singletonList(input));
+      parameters.put("regex", "(?i)\\b(?:attack|probe)_" + i + "\\b[^;]{0,64};");
+      Map<String, Object> condition = new HashMap<>();
+      condition.put("operator", "match_regex");
+      condition.put("parameters", parameters);
+
+      Map<String, Object> tags = new HashMap<>();
+      tags.put("type", "attack_attempt");
+      tags.put("category", "generated");
+      Map<String, Object> rule = new HashMap<>();
+      rule.put("id", "rule-" + i);
+      rule.put("name", "Generated rule " + i);
+      rule.put("tags", tags);
+      rule.put("conditions", Collections.singletonList(condition));
+      rule.put("transformers", Collections.singletonList("lowercase"));
+      rules.add(rule);
+    }
+    Map<String, Object> ruleset = new HashMap<>();
+    ruleset.put("version", "2.2");
+    ruleset.put("rules", rules);
+    return ruleset;
+  }
+}
@@ -0,0 +1,153 @@
+package com.datadog.ddwaf;
+
+import groovy.json.JsonSlurper;
+import java.io.File;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.nio.file.Paths;
+import java.util.Collections;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.concurrent.TimeUnit;
+import org.openjdk.jmh.annotations.Benchmark;
+import org.openjdk.jmh.annotations.BenchmarkMode;
+import org.openjdk.jmh.annotations.Fork;
+import org.openjdk.jmh.annotations.Level;
+import org.openjdk.jmh.annotations.Measurement;
+import org.openjdk.jmh.annotations.Mode;
+import org.openjdk.jmh.annotations.OutputTimeUnit;
+import org.openjdk.jmh.annotations.Param;
+import org.openjdk.jmh.annotations.Scope;
+import org.openjdk.jmh.annotations.Setup;
+import org.openjdk.jmh.annotations.State;
+import org.openjdk.jmh.annotations.TearDown;
+import org.openjdk.jmh.annotations.Warmup;
+
+/**
+ * Replays a file written by {@link InputRecorder} against rulesets, with no serialization: each
+ * invocation runs the next recorded input on a new {@link WafContext}. Throughput and the latency
+ * percentiles (sample time mode) are reported per ruleset.
+ *
+ * <pre>
+ * ./gradlew jmh -Pjmh.includes=RecordedInputReplay \
+ *     -Pjmh.params='recording=/tmp/inputs.rec;ruleset=/tmp/a.json,/tmp/b.json'
+ * </pre>
+ *
+ * Without a recording, a few small synthetic inputs are recorded first. The {@code default}
+ * ruleset is a single Arachni detection rule.
+ */
+@Warmup(iterations = 1, time = 1000, timeUnit = TimeUnit.MILLISECONDS)
+@Measurement(iterations = 3, time = 1000, timeUnit = TimeUnit.MILLISECONDS)
+@Fork(3)
+@OutputTimeUnit(TimeUnit.MICROSECONDS)
+@BenchmarkMode({Mode.Throughput, Mode.SampleTime})
+@State(Scope.Thread)
+public class RecordedInputReplayBenchmark {
+
+  @Param({""})
+  public String recording;
+
+  @Param({"default"})
+  public String ruleset;
+
+  private Path tempRecording;
+  private InputRecording inputs;
+  private List<InputRecording.Input> inputList;
+  private int next;
+  private WafBuilder builder;
+  private WafHandle handle;
+  private Waf.Limits limits;
+
+  @Setup(Level.Trial)
+  @SuppressWarnings("unchecked")
+  public void setup() throws Exception {
+    Waf.initialize(System.getProperty("useReleaseBinaries") == null);
+
+    builder = new WafBuilder(new WafConfig());
+    Map<String, Object> rules =
+        "default".equals(ruleset)
+            ? defaultRuleset()
+            : (Map<String, Object>) new JsonSlurper().parse(new File(ruleset));
+    builder.addOrUpdateConfig("replay", rules);
+    handle = builder.buildWafHandleInstance();
+    // a 10 s budget, so every input runs to completion
+    limits = new Waf.Limits(20, 256, 4096, 10_000_000, 0);
+
+    Path file;
+    if (recording.isEmpty()) {
+      tempRecording = Files.createTempFile("ddwaf-replay", ".rec");
+      recordSyntheticInputs(tempRecording);
+      file = tempRecording;
+    } else {
+      file = Paths.get(recording);
+    }
+    inputs = InputRecording.map(file);
+    inputList = inputs.getInputs();
+    if (inputList.isEmpty()) {
+      throw new IllegalStateException("Empty recording " + file);
+    }
+  }
+
+  @TearDown(Level.Trial)
+  public void teardown() throws Exception {
+    handle.close();
+    builder.close();
+    if (tempRecording != null) {
+      Files.deleteIfExists(tempRecording);
+    }
+  }
+
+  @Benchmark
+  public Waf.ResultWithData replay() throws Exception {
+    InputRecording.Input input = inputList.get(next);
+    next = next + 1 == inputList.size() ? 0 : next + 1;
+    try (WafContext context = new WafContext(handle)) {
+      return context.run(input, limits, null);
+    }
+  }
+
+  private void recordSyntheticInputs(Path file) throws Exception {
+    try (InputRecorder recorder = InputRecorder.open(file)) {
+      Waf.setInputRecorder(recorder);
+      try {
+        for (int i = 0; i < 64; i++) {
+          Map<String, Object> headers = new HashMap<>();
+          headers.put("user-agent", i % 8 == 0 ? "Arachni/v" + i : "Mozilla/5.0 " + i);
+          headers.put("accept", "text/html");
+          try (WafContext context = new WafContext(handle)) {
+            context.run(
+                Collections.singletonMap("server.request.headers.no_cookies", headers),
+                limits,
+                null);
+          }
+        }
+      } finally {
+        Waf.setInputRecorder(null);
+      }
+    }
+  }
+
+  private static Map<String, Object> defaultRuleset() {
+    Map<String, Object> input = new HashMap<>();
+    input.put("address", "server.request.headers.no_cookies");
+    input.put("key_path", Collections.singletonList("user-agent"));
+    Map<String, Object> parameters = new HashMap<>();
+    parameters.put("inputs", Collections.singletonList(input));
+    parameters.put("regex", "^Arachni");
+    Map<String, Object> condition = new HashMap<>();
+    condition.put("operator", "match_regex");
+    condition.put("parameters", parameters);
+
+    Map<String, Object> rule = new HashMap<>();
+    rule.put("id", "arachni_rule");
+    rule.put("name", "Arachni");
+    rule.put("conditions", Collections.singletonList(condition));
+    rule.put("tags", Collections.singletonMap("type", "security_scanner"));
+
+    Map<String, Object> rules = new HashMap<>();
+    rules.put("version", "2.1");
+    rules.put("rules", Collections.singletonList(rule));
+    return rules;
+  }
+}
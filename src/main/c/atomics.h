@@ -0,0 +1,62 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define FULL_MEMORY_BARRIER _ReadWriteBarrier
+_STATIC_ASSERT(sizeof(bool) == 1);
+#define COMPARE_AND_SWAP(ptr, old, new)                                        \
+    (_InterlockedCompareExchange8((volatile char *) (ptr), new, old) == (old))
+// release barrier; clears a flag set with COMPARE_AND_SWAP
+#define ATOMIC_CLEAR(ptr) _InterlockedExchange8((volatile char *) (ptr), 0)
+#define ATOMIC_INC_U64(ptr) _InterlockedIncrement64((volatile __int64 *) (ptr))
+#define ATOMIC_ADD_U64(ptr, val)                                               \
+    _InterlockedExchangeAdd64((volatile __int64 *) (ptr), (__int64) (val))
+// returns the previous value
+#define ATOMIC_EXCHANGE_PTR(ptr, val)                                          \
+    _InterlockedExchangePointer((void *volatile *) (ptr), val)
+#define ATOMIC_CAS_PTR(ptr, old, new)                                          \
+    (_InterlockedCompareExchangePointer((void *volatile *) (ptr), new, old) == \
+     (old))
+#define ATOMIC_LOAD_ACQ_U64(ptr)                                               \
+    ((uint64_t) _InterlockedCompareExchange64((volatile __int64 *) (ptr), 0, 0))
+#define ATOMIC_STORE_REL_U64(ptr, val)                                         \
+    _InterlockedExchange64((volatile __int64 *) (ptr), (__int64) (val))
+// returns the previous value
+#define ATOMIC_EXCHANGE_U64(ptr, val)                                          \
+    ((uint64_t) _InterlockedExchange64((volatile __int64 *) (ptr),             \
+                                       (__int64) (val)))
+#define ATOMIC_CAS_U64(ptr, old, new)                                          \
+    (_InterlockedCompareExchange64((volatile __int64 *) (ptr),                 \
+                                   (__int64) (new),                            \
+                                   (__int64) (old)) == (__int64) (old))
+#else
+#define FULL_MEMORY_BARRIER __sync_synchronize
+#define COMPARE_AND_SWAP(ptr, old, new)                                        \
+    __sync_bool_compare_and_swap(ptr, old, new)
+#define ATOMIC_CLEAR(ptr) __sync_lock_release(ptr)
+#define ATOMIC_INC_U64(ptr) __sync_fetch_and_add(ptr, 1)
+#define ATOMIC_ADD_U64(ptr, val) __sync_fetch_and_add(ptr, val)
+// acquire barrier only; pair with ATOMIC_CAS_PTR (full barrier) on release
+#define ATOMIC_EXCHANGE_PTR(ptr, val) __sync_lock_test_and_set(ptr, val)
+#define ATOMIC_CAS_PTR(ptr, old, new)                                          \
+    __sync_bool_compare_and_swap(ptr, old, new)
+#define ATOMIC_LOAD_ACQ_U64(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE_REL_U64(ptr, val)                                         \
+    __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+// returns the previous value
+#define ATOMIC_EXCHANGE_U64(ptr, val)                                          \
+    __atomic_exchange_n(ptr, val, __ATOMIC_ACQ_REL)
+#define ATOMIC_CAS_U64(ptr, old, new)                                          \
+    __sync_bool_compare_and_swap(ptr, old, new)
+#endif
@@ -33,6 +33,13 @@
 #include <stdint.h>
 #include <string.h>
 #include "base64.h"
+#include "cpu_features.h"
+
+#ifdef CPU_X86_64
+#include <immintrin.h>
+#elif defined(CPU_AARCH64)
+#include <arm_neon.h>
+#endif
 
 static inline void enc_loop_generic_64(const uint8_t **s, size_t *slen,
                                        uint8_t **o, size_t *olen);
@@ -110,6 +117,7 @@ void base64_stream_encode_plain(struct base64_state *state, const char *src,
     switch (st.bytes) {
         for (;;) {
         case 0:
+            base64_enc_impl->enc_loop(&s, &slen, &o, &olen);
             enc_loop_generic_64(&s, &slen, &o, &olen);
             if (slen-- == 0) {
                 break;
@@ -264,6 +272,276 @@ static inline void enc_loop_generic_64(const uint8_t **s, size_t *slen,
     } while (rounds > 0);
 }
 
+// The SIMD loops follow the design of the corresponding codecs in Alfred
+// Klomp's library: split 3 input bytes over 4 output bytes of 6 bits each,
+// then translate each 6-bit value to its character.
+
+#ifdef CPU_X86_64
+CPU_TARGET("ssse3")
+static inline __m128i enc_reshuffle_ssse3(__m128i in)
+{
+    // Input, bytes MSB to LSB:
+    // 0 0 0 0 l k j i h g f e d c b a
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3,
+                                           4, 1, 2, 0, 1));
+    // in, bytes MSB to LSB:
+    // k l j k
+    // h i g h
+    // e f d e
+    // b c a b
+
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+    // bits, upper case are most significant bits, lower case are least
+    // significant bits
+    // 0000kkkk LL000000 JJJJJJ00 00000000
+    // ...
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    // 00000000 00kkkkLL 00000000 00JJJJJJ
+
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+    // 00000000 00llllll 000000jj KKKK0000
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    // 00llllll 00000000 00jjKKKK 00000000
+
+    // 00llllll 00kkkkLL 00jjKKKK 00JJJJJJ
+    return _mm_or_si128(t1, t3);
+}
+
+CPU_TARGET("ssse3")
+static inline __m128i enc_translate_ssse3(const __m128i in)
+{
+    // A lookup table containing the absolute offsets for all ranges:
+    // #  From      To         Abs    Index  Characters
+    // 0  [0..25]   [65..90]   +65        0  ABCDEFGHIJKLMNOPQRSTUVWXYZ
+    // 1  [26..51]  [97..122]  +71        1  abcdefghijklmnopqrstuvwxyz
+    // 2  [52..61]  [48..57]    -4  [2..11]  0123456789
+    // 3  [62]      [43]       -19       12  +
+    // 4  [63]      [47]       -16       13  /
+    const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4,
+                                      -4, -4, -19, -16, 0, 0);
+
+    // Create LUT indices from the input. The index for range #0 is right,
+    // others are 1 less than expected:
+    __m128i indices = _mm_subs_epu8(in, _mm_set1_epi8(51));
+
+    // mask is 0xFF (-1) for range #[1..4] and 0x00 for range #0:
+    __m128i mask = _mm_cmpgt_epi8(in, _mm_set1_epi8(25));
+
+    // Subtract -1, so add 1 to indices for range #[1..4]. All indices are
+    // now correct:
+    indices = _mm_sub_epi8(indices, mask);
+
+    // Add offsets to input values:
+    return _mm_add_epi8(in, _mm_shuffle_epi8(lut, indices));
+}
+
+CPU_TARGET("ssse3")
+static void enc_loop_ssse3(const uint8_t **s, size_t *slen, uint8_t **o,
+                           size_t *olen)
+{
+    if (*slen < 16) {
+        return;
+    }
+
+    // Process blocks of 12 bytes at a time. Because blocks are loaded 16
+    // bytes at a time, ensure that there will be at least 4 remaining
+    // bytes after the last round, so that the final read will not pass
+    // beyond the bounds of the input buffer:
+    size_t rounds = (*slen - 4) / 12;
+
+    *slen -= rounds * 12; // 12 bytes consumed per round
+    *olen += rounds * 16; // 16 bytes produced per round
+
+    do {
+        __m128i str = _mm_loadu_si128((const __m128i *) (const void *) *s);
+        str = enc_reshuffle_ssse3(str);
+        str = enc_translate_ssse3(str);
+        _mm_storeu_si128((__m128i *) (void *) *o, str);
+        *s += 12;
+        *o += 16;
+    } while (--rounds > 0);
+}
+
+CPU_TARGET("avx2")
+static inline __m256i enc_reshuffle_avx2(__m256i in)
+{
+    // same as the SSSE3 version, on the 12 bytes at the start of each lane
+    in = _mm256_shuffle_epi8(
+            in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2,
+                                0, 1, 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4,
+                                1, 2, 0, 1));
+
+    const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+    const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+    const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    return _mm256_or_si256(t1, t3);
+}
+
+CPU_TARGET("avx2")
+static inline __m256i enc_translate_avx2(const __m256i in)
+{
+    // see enc_translate_ssse3
+    const __m256i lut = _mm256_setr_epi8(
+            65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0, 65,
+            71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    __m256i indices = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+    __m256i mask = _mm256_cmpgt_epi8(in, _mm256_set1_epi8(25));
+    indices = _mm256_sub_epi8(indices, mask);
+    return _mm256_add_epi8(in, _mm256_shuffle_epi8(lut, indices));
+}
+
+CPU_TARGET("avx2")
+static void enc_loop_avx2(const uint8_t **s, size_t *slen, uint8_t **o,
+                          size_t *olen)
+{
+    if (*slen < 28) {
+        return;
+    }
+
+    // Process blocks of 24 bytes at a time, loaded as two 16-byte halves
+    // 12 bytes apart; the last load ends 4 bytes after the block
+    size_t rounds = (*slen - 4) / 24;
+
+    *slen -= rounds * 24; // 24 bytes consumed per round
+    *olen += rounds * 32; // 32 bytes produced per round
+
+    do {
+        __m128i lo = _mm_loadu_si128((const __m128i *) (const void *) *s);
+        __m128i hi =
+                _mm_loadu_si128((const __m128i *) (const void *) (*s + 12));
+        __m256i str =
+                _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        str = enc_reshuffle_avx2(str);
+        str = enc_translate_avx2(str);
+        _mm256_storeu_si256((__m256i *) (void *) *o, str);
+        *s += 24;
+        *o += 32;
+    } while (--rounds > 0);
+}
+
+CPU_TARGET("avx512f,avx512bw,avx512vbmi")
+static void enc_loop_avx512(const uint8_t **s, size_t *slen, uint8_t **o,
+                            size_t *olen)
+{
+    if (*slen < 64) {
+        return;
+    }
+
+    // Process blocks of 48 bytes at a time. Blocks are loaded 64 bytes at a
+    // time, so keep 16 bytes after the last round:
+    size_t rounds = (*slen - 16) / 48;
+
+    *slen -= rounds * 48; // 48 bytes consumed per round
+    *olen += rounds * 64; // 64 bytes produced per round
+
+    const __m512i lookup = _mm512_loadu_si512(base64_table_enc_6bit);
+    // for every 3 input bytes A B C: B A C B
+    const __m512i shuffle_input = _mm512_setr_epi32(
+            0x01020001, 0x04050304, 0x07080607, 0x0a0b090a, 0x0d0e0c0d,
+            0x10110f10, 0x13141213, 0x16171516, 0x191a1819, 0x1c1d1b1c,
+            0x1f201e1f, 0x22232122, 0x25262425, 0x28292728, 0x2b2c2a2b,
+            0x2e2f2d2e);
+    // Divide bits of three input bytes over four output bytes. All output
+    // bytes except the first one are shifted over two bits to the left:
+    const __m512i multi_shifts =
+            _mm512_set1_epi64((long long) UINT64_C(0x3036242a1016040a));
+
+    do {
+        __m512i src = _mm512_loadu_si512(*s);
+        __m512i in = _mm512_permutexvar_epi8(shuffle_input, src);
+        in = _mm512_multishift_epi64_epi8(multi_shifts, in);
+        // only the low 6 bits of each index are used
+        __m512i dst = _mm512_permutexvar_epi8(in, lookup);
+        _mm512_storeu_si512(*o, dst);
+        *s += 48;
+        *o += 64;
+    } while (--rounds > 0);
+}
+#endif
+
+#ifdef CPU_AARCH64
+static void enc_loop_neon(const uint8_t **s, size_t *slen, uint8_t **o,
+                          size_t *olen)
+{
+    if (*slen < 48) {
+        return;
+    }
+
+    // Process blocks of 48 bytes at a time, deinterleaved on load
+    size_t rounds = *slen / 48;
+
+    *slen -= rounds * 48; // 48 bytes consumed per round
+    *olen += rounds * 64; // 64 bytes produced per round
+
+    uint8x16x4_t tbl;
+    tbl.val[0] = vld1q_u8(base64_table_enc_6bit);
+    tbl.val[1] = vld1q_u8(base64_table_enc_6bit + 16);
+    tbl.val[2] = vld1q_u8(base64_table_enc_6bit + 32);
+    tbl.val[3] = vld1q_u8(base64_table_enc_6bit + 48);
+    const uint8x16_t mask = vdupq_n_u8(0x3F);
+
+    do {
+        uint8x16x3_t src = vld3q_u8(*s);
+        uint8x16x4_t out;
+        out.val[0] = vshrq_n_u8(src.val[0], 2);
+        out.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(src.val[1], 4),
+                                       vshlq_n_u8(src.val[0], 4)),
+                              mask);
+        out.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(src.val[2], 6),
+                                       vshlq_n_u8(src.val[1], 2)),
+                              mask);
+        out.val[3] = vandq_u8(src.val[2], mask);
+
+        out.val[0] = vqtbl4q_u8(tbl, out.val[0]);
+        out.val[1] = vqtbl4q_u8(tbl, out.val[1]);
+        out.val[2] = vqtbl4q_u8(tbl, out.val[2]);
+        out.val[3] = vqtbl4q_u8(tbl, out.val[3]);
+        vst4q_u8(*o, out);
+        *s += 48;
+        *o += 64;
+    } while (--rounds > 0);
+}
+#endif
+
+static void enc_loop_generic(const uint8_t **s, size_t *slen, uint8_t **o,
+                             size_t *olen)
+{
+    enc_loop_generic_64(s, slen, o, olen);
+}
+
+static const struct base64_enc_impl base64_impls[] = {
+        {"generic", enc_loop_generic, 0},
+#ifdef CPU_X86_64
+        {"ssse3", enc_loop_ssse3, CPU_FEATURE_SSSE3},
+        {"avx2", enc_loop_avx2, CPU_FEATURE_AVX2},
+        {"avx512", enc_loop_avx512,
+         CPU_FEATURE_AVX512F | CPU_FEATURE_AVX512BW | CPU_FEATURE_AVX512VBMI},
+#endif
+#ifdef CPU_AARCH64
+        {"neon", enc_loop_neon, CPU_FEATURE_NEON},
+#endif
+};
+
+const struct base64_enc_impl *base64_enc_impl = &base64_impls[0];
+
+const struct base64_enc_impl *base64_enc_impls(size_t *count)
+{
+    *count = sizeof(base64_impls) / sizeof(base64_impls[0]);
+    return base64_impls;
+}
+
+void base64_init(void)
+{
+    // implementations are listed from slowest to fastest
+    for (size_t i = 0; i < sizeof(base64_impls) / sizeof(base64_impls[0]);
+         i++) {
+        if (cpu_has(base64_impls[i].required_features)) {
+            base64_enc_impl = &base64_impls[i];
+        }
+    }
+}
+
 static const uint8_t base64_table_enc_6bit[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
                                                "abcdefghijklmnopqrstuvwxyz"
                                                "0123456789"
@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdlib.h>
 
 struct base64_state {
@@ -11,3 +12,21 @@ void base64_stream_encode_plain(struct base64_state *state, const char *src,
                                 size_t srclen, char *out, size_t *outlen);
 void base64_stream_encode_final(struct base64_state *state, char *out,
                                 size_t *outlen);
+
+struct base64_enc_impl {
+    const char *name;
+    // Encodes as many whole blocks as the implementation can without reading
+    // past the end of the input, advancing the pointers and lengths. The rest
+    // is left to the generic code.
+    void (*enc_loop)(const uint8_t **s, size_t *slen, uint8_t **o,
+                     size_t *olen);
+    uint32_t required_features; // CPU_FEATURE_*
+};
+
+extern const struct base64_enc_impl *base64_enc_impl;
+
+// all implementations compiled in, including those the CPU may not support
+const struct base64_enc_impl *base64_enc_impls(size_t *count);
+
+// selects the fastest implementation supported; requires cpu_features_init()
+void base64_init(void);
@@ -0,0 +1,38 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#include <ddwaf.h>
+#include <jni.h>
+#include <stdint.h>
+#include "common.h"
+#include "object_image.h"
+#include "jni/com_datadog_ddwaf_ConfigSnapshot.h"
+
+// A snapshot has the configuration as the first root of its record (see
+// object_image.h) and no second one. It's loaded back by
+// WafBuilder.addOrUpdateSnapshotConfigNative, in waf_jni.c.
+
+/*
+ * Class:     com_datadog_ddwaf_ConfigSnapshot
+ * Method:    encodeConvertedConfig
+ * Signature: (J)[B
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_datadog_ddwaf_ConfigSnapshot_encodeConvertedConfig(JNIEnv *env,
+                                                            jclass clazz,
+                                                            jlong config_ptr)
+{
+    UNUSED(clazz);
+
+    const ddwaf_object *config = (const ddwaf_object *) (intptr_t) config_ptr;
+    if (!config) {
+        JNI(ThrowNew, jcls_iae, "config is null");
+        return NULL;
+    }
+    return object_image_encode_java_checked(env, config, NULL);
+}
@@ -0,0 +1,169 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#include "cpu_features.h"
+#include <string.h>
+
+#ifdef CPU_X86_64
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+uint32_t cpu_features;
+
+#ifdef CPU_X86_64
+static void _cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, (int) leaf, (int) subleaf);
+    for (int i = 0; i < 4; i++) {
+        regs[i] = (uint32_t) r[i];
+    }
+#else
+    unsigned a, b, c, d;
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+    regs[0] = a;
+    regs[1] = b;
+    regs[2] = c;
+    regs[3] = d;
+#endif
+}
+
+static uint64_t _xgetbv0(void)
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t) edx << 32) | eax;
+#endif
+}
+
+static uint32_t _detect(void)
+{
+    uint32_t feat = 0;
+    uint32_t regs[4]; // eax, ebx, ecx, edx
+
+    _cpuid(0, 0, regs);
+    uint32_t max_leaf = regs[0];
+    if (max_leaf < 1) {
+        return feat;
+    }
+
+    _cpuid(1, 0, regs);
+    if (regs[3] & (1u << 26)) {
+        feat |= CPU_FEATURE_SSE2;
+    }
+    if (regs[2] & (1u << 9)) {
+        feat |= CPU_FEATURE_SSSE3;
+    }
+    if (regs[2] & (1u << 19)) {
+        feat |= CPU_FEATURE_SSE41;
+    }
+    if (regs[2] & (1u << 20)) {
+        feat |= CPU_FEATURE_SSE42;
+    }
+
+    // the wider registers are only usable if the OS saves them
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+    if (!osxsave || !avx || max_leaf < 7) {
+        return feat;
+    }
+    uint64_t xcr0 = _xgetbv0();
+    bool os_ymm = (xcr0 & 0x6) == 0x6;
+    bool os_zmm = (xcr0 & 0xE6) == 0xE6;
+
+    _cpuid(7, 0, regs);
+    if (os_ymm && (regs[1] & (1u << 5))) {
+        feat |= CPU_FEATURE_AVX2;
+    }
+    if (os_zmm && (regs[1] & (1u << 16))) {
+        feat |= CPU_FEATURE_AVX512F;
+        if (regs[1] & (1u << 30)) {
+            feat |= CPU_FEATURE_AVX512BW;
+        }
+        if (regs[2] & (1u << 1)) {
+            feat |= CPU_FEATURE_AVX512VBMI;
+        }
+    }
+    return feat;
+}
+#elif defined(CPU_AARCH64)
+static uint32_t _detect(void)
+{
+    // Advanced SIMD is mandatory on AArch64
+    return CPU_FEATURE_NEON;
+}
+#else
+static uint32_t _detect(void)
+{
+    return 0;
+}
+#endif
+
+void cpu_features_init(void)
+{
+    cpu_features = _detect();
+}
+
+#define LEVEL_SSE2 CPU_FEATURE_SSE2
+#define LEVEL_SSSE3 (LEVEL_SSE2 | CPU_FEATURE_SSSE3)
+#define LEVEL_SSE42 (LEVEL_SSSE3 | CPU_FEATURE_SSE41 | CPU_FEATURE_SSE42)
+#define LEVEL_AVX2 (LEVEL_SSE42 | CPU_FEATURE_AVX2)
+#define LEVEL_AVX512                                                           \
+    (LEVEL_AVX2 | CPU_FEATURE_AVX512F | CPU_FEATURE_AVX512BW |                 \
+     CPU_FEATURE_AVX512VBMI)
+
+// from lowest to highest; each includes the features of the previous ones
+static const struct {
+    const char *name;
+    uint32_t features;
+} _levels[] = {
+        {"generic", 0},
+#ifdef CPU_X86_64
+        {"sse2", LEVEL_SSE2},
+        {"ssse3", LEVEL_SSSE3},
+        {"sse4.2", LEVEL_SSE42},
+        {"avx2", LEVEL_AVX2},
+        {"avx512", LEVEL_AVX512},
+#elif defined(CPU_AARCH64)
+        {"neon", CPU_FEATURE_NEON},
+#endif
+};
+
+#define NUM_LEVELS (sizeof(_levels) / sizeof(_levels[0]))
+
+bool cpu_features_limit(const char *level)
+{
+    for (size_t i = 0; i < NUM_LEVELS; i++) {
+        if (strcmp(_levels[i].name, level) == 0) {
+            cpu_features &= _levels[i].features;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *cpu_level(void)
+{
+    const char *name = _levels[0].name;
+    for (size_t i = 1; i < NUM_LEVELS; i++) {
+        if (!cpu_has(_levels[i].features)) {
+            break;
+        }
+        name = _levels[i].name;
+    }
+    return name;
+}
@@ -0,0 +1,58 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CPU_X86_64 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CPU_AARCH64 1
+#endif
+
+// allows compiling a function for an instruction set not enabled globally;
+// callers must check cpu_has() first
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CPU_TARGET(isa)
+#else
+#define CPU_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#define CPU_FEATURE_SSE2 (1u << 0)
+#define CPU_FEATURE_SSSE3 (1u << 1)
+#define CPU_FEATURE_SSE41 (1u << 2)
+#define CPU_FEATURE_AVX2 (1u << 3)
+#define CPU_FEATURE_AVX512F (1u << 4)
+#define CPU_FEATURE_AVX512BW (1u << 5)
+#define CPU_FEATURE_AVX512VBMI (1u << 6)
+#define CPU_FEATURE_NEON (1u << 7)
+#define CPU_FEATURE_SSE42 (1u << 8)
+
+extern uint32_t cpu_features;
+
+// detects the features of the running CPU. Must be called before any other
+// *_init function that selects implementations based on cpu_features
+void cpu_features_init(void);
+
+// Limits cpu_features to those of a level ("generic", which selects the
+// scalar implementations, then "sse2", "ssse3", "sse4.2", "avx2" and "avx512"
+// on x86-64, or "neon" on AArch64), so that the *_init functions select
+// implementations of that level or a lower one. Features the CPU lacks are
+// never added. Returns false, changing nothing, if the level is unknown.
+// Call between cpu_features_init and the other *_init functions
+bool cpu_features_limit(const char *level);
+
+// name of the highest level whose features are all in cpu_features
+const char *cpu_level(void);
+
+static inline bool cpu_has(uint32_t features)
+{
+    return (cpu_features & features) == features;
+}
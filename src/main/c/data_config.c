@@ -0,0 +1,134 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#include "data_config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LSTR(x) "" x, sizeof(x) - 1
+
+// the section array, its map and the id, type and data fields
+#define FIXED_OBJECTS 5
+// each data entry: its map and the value and expiration entries
+#define OBJECTS_PER_VALUE 3
+
+static char *_copy_str(char **strings, const char *str, size_t len)
+{
+    char *ret = *strings;
+    memcpy(ret, str, len);
+    ret[len] = '\0';
+    *strings += len + 1;
+    return ret;
+}
+
+static void _set_key(ddwaf_object *obj, const char *key, size_t key_len)
+{
+    obj->parameterName = key;
+    obj->parameterNameLength = key_len;
+}
+
+static void _set_str(ddwaf_object *obj, const char *str, size_t len)
+{
+    obj->type = DDWAF_OBJ_STRING;
+    obj->stringValue = str;
+    obj->nbEntries = len;
+}
+
+static void _set_container(ddwaf_object *obj, DDWAF_OBJ_TYPE type,
+                           ddwaf_object *elems, size_t n)
+{
+    obj->type = type;
+    obj->array = elems;
+    obj->nbEntries = n;
+}
+
+enum data_config_status data_config_build(const struct data_config_input *in,
+                                          struct data_config *out)
+{
+    out->mem = NULL;
+    out->root = (ddwaf_object){.type = DDWAF_OBJ_INVALID};
+
+    size_t values_len = 0;
+    for (size_t i = 0; i < in->count; i++) {
+        if (in->ends[i] < 0 || (size_t) in->ends[i] < values_len) {
+            return DATA_CONFIG_BAD_ENDS;
+        }
+        values_len = (size_t) in->ends[i];
+    }
+
+    if (in->count > (SIZE_MAX - FIXED_OBJECTS) / OBJECTS_PER_VALUE /
+                            sizeof(ddwaf_object)) {
+        return DATA_CONFIG_NO_MEMORY;
+    }
+    size_t num_objects = FIXED_OBJECTS + OBJECTS_PER_VALUE * in->count;
+    size_t objects_size = num_objects * sizeof(ddwaf_object);
+    // values and the section, id and type, each with a NUL
+    size_t strings_size = values_len + in->count + in->section_len +
+                          in->id_len + in->type_len + 3;
+    if (strings_size < values_len || objects_size > SIZE_MAX - strings_size) {
+        return DATA_CONFIG_NO_MEMORY;
+    }
+    void *mem = malloc(objects_size + strings_size);
+    if (!mem) {
+        return DATA_CONFIG_NO_MEMORY;
+    }
+
+    ddwaf_object *objs = mem;
+    char *strings = (char *) mem + objects_size;
+    ddwaf_object *section = &objs[0]; // the array under the section key
+    ddwaf_object *entry = &objs[1];   // its single map
+    ddwaf_object *fields = &objs[2];  // id, type and data
+    ddwaf_object *data = &objs[FIXED_OBJECTS];
+    ddwaf_object *data_fields = data + in->count; // value and expiration
+
+    _set_container(&out->root, DDWAF_OBJ_MAP, section, 1);
+    _set_container(section, DDWAF_OBJ_ARRAY, entry, 1);
+    _set_key(section, _copy_str(&strings, in->section, in->section_len),
+             in->section_len);
+    _set_container(entry, DDWAF_OBJ_MAP, fields, 3);
+    _set_key(entry, NULL, 0);
+
+    _set_str(&fields[0], _copy_str(&strings, in->id, in->id_len), in->id_len);
+    _set_key(&fields[0], LSTR("id"));
+    _set_str(&fields[1], _copy_str(&strings, in->type, in->type_len),
+             in->type_len);
+    _set_key(&fields[1], LSTR("type"));
+    _set_container(&fields[2], DDWAF_OBJ_ARRAY, in->count ? data : NULL,
+                   in->count);
+    _set_key(&fields[2], LSTR("data"));
+
+    size_t start = 0;
+    for (size_t i = 0; i < in->count; i++) {
+        size_t end = (size_t) in->ends[i];
+        ddwaf_object *value = &data_fields[2 * i];
+        ddwaf_object *expiration = &data_fields[2 * i + 1];
+
+        _set_container(&data[i], DDWAF_OBJ_MAP, value, 2);
+        _set_key(&data[i], NULL, 0);
+
+        _set_str(value, _copy_str(&strings, in->values + start, end - start),
+                 end - start);
+        _set_key(value, LSTR("value"));
+
+        expiration->type = DDWAF_OBJ_SIGNED;
+        expiration->intValue = in->expirations ? in->expirations[i] : 0;
+        expiration->nbEntries = 0;
+        _set_key(expiration, LSTR("expiration"));
+
+        start = end;
+    }
+
+    out->mem = mem;
+    return DATA_CONFIG_OK;
+}
+
+void data_config_free(struct data_config *config)
+{
+    free(config->mem);
+    config->mem = NULL;
+}
@@ -0,0 +1,47 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+#include <ddwaf.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A single rules_data or exclusion_data entry, with packed values
+struct data_config_input {
+    const char *section; // "rules_data" or "exclusion_data"
+    size_t section_len;
+    const char *id;
+    size_t id_len;
+    const char *type; // e.g. "ip_with_expiration"
+    size_t type_len;
+    const char *values;         // the UTF-8 values, concatenated
+    const int32_t *ends;        // ends[i]: where value i ends in values
+    const int64_t *expirations; // 0 for none; NULL if no value expires
+    size_t count;
+};
+
+enum data_config_status {
+    DATA_CONFIG_OK,
+    DATA_CONFIG_BAD_ENDS, // not ascending from 0
+    DATA_CONFIG_NO_MEMORY,
+};
+
+// The configuration { section: [{ id, type, data: [{ value, expiration }] }] }.
+// Like struct json_doc, everything lives in a single allocation: free it with
+// data_config_free(), never with ddwaf_object_free().
+struct data_config {
+    ddwaf_object root;
+    void *mem;
+};
+
+// Builds the configuration in one pass over the input. Makes no JNI calls.
+enum data_config_status data_config_build(const struct data_config_input *in,
+                                          struct data_config *out);
+
+void data_config_free(struct data_config *config);
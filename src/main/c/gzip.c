@@ -0,0 +1,211 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#include "gzip.h"
+#include <limits.h>
+#include <stdlib.h>
+
+#ifdef SQREEN_JNI_LIBDEFLATE
+#include <libdeflate.h>
+#else
+#include <zlib.h>
+#endif
+
+#include "atomics.h"
+
+// Setting up a deflate state is much more expensive than compressing a
+// schema (zlib allocates ~256 KB per stream), so states are kept in a small
+// lock-free pool. A thread takes a state by swapping a slot with NULL and puts
+// it back into any empty slot; states that don't fit are freed. Unlike
+// thread-local storage, this doesn't leak on the exit of the (many, often
+// short-lived) threads that run the WAF.
+#define POOL_SIZE 16
+
+struct _compressor {
+#ifdef SQREEN_JNI_LIBDEFLATE
+    struct libdeflate_compressor *impl;
+#else
+    z_stream strm;
+#endif
+    int level;
+};
+
+static struct _compressor *volatile _pool[POOL_SIZE];
+static volatile int _level = GZIP_DEFAULT_LEVEL;
+
+#ifdef SQREEN_JNI_LIBDEFLATE
+const char *const gzip_backend = "libdeflate";
+
+#define MIN_LEVEL 0
+#define MAX_LEVEL 12
+#define BACKEND_DEFAULT_LEVEL 6
+
+static struct _compressor *_compressor_new(int level)
+{
+    struct _compressor *c = malloc(sizeof *c);
+    if (!c) {
+        return NULL;
+    }
+    c->impl = libdeflate_alloc_compressor(
+            level == GZIP_DEFAULT_LEVEL ? BACKEND_DEFAULT_LEVEL : level);
+    if (!c->impl) {
+        free(c);
+        return NULL;
+    }
+    c->level = level;
+    return c;
+}
+
+static void _compressor_free(struct _compressor *c)
+{
+    libdeflate_free_compressor(c->impl);
+    free(c);
+}
+
+size_t gzip_bound(size_t in_len)
+{
+    return libdeflate_gzip_compress_bound(NULL, in_len);
+}
+
+// false if c can't be reused
+static bool _compress(struct _compressor *c, const char *in, size_t in_len,
+                      uint8_t *out, size_t *out_len)
+{
+    *out_len = libdeflate_gzip_compress(c->impl, in, in_len, out,
+                                        gzip_bound(in_len));
+    return true;
+}
+#else
+const char *const gzip_backend = "zlib";
+
+#define MIN_LEVEL Z_NO_COMPRESSION
+#define MAX_LEVEL Z_BEST_COMPRESSION
+
+static struct _compressor *_compressor_new(int level)
+{
+    struct _compressor *c = calloc(1, sizeof *c);
+    if (!c) {
+        return NULL;
+    }
+    // 31: 15 bits window + gzip header
+    if (deflateInit2(&c->strm, level, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY) !=
+        Z_OK) {
+        free(c);
+        return NULL;
+    }
+    c->level = level;
+    return c;
+}
+
+static void _compressor_free(struct _compressor *c)
+{
+    deflateEnd(&c->strm);
+    free(c);
+}
+
+size_t gzip_bound(size_t in_len)
+{
+    if (in_len > UINT_MAX) {
+        return SIZE_MAX;
+    }
+    // without a stream, deflateBound assumes a 6-byte zlib wrapper;
+    // the gzip header and trailer without optional fields take 18 bytes
+    return deflateBound(NULL, (uLong) in_len) + (18 - 6);
+}
+
+static bool _compress(struct _compressor *c, const char *in, size_t in_len,
+                      uint8_t *out, size_t *out_len)
+{
+    size_t bound = gzip_bound(in_len);
+    if (bound > UINT_MAX) {
+        *out_len = 0;
+        return true;
+    }
+
+    z_stream *strm = &c->strm;
+    strm->next_in = (const Bytef *) in;
+    strm->avail_in = (uInt) in_len;
+    strm->next_out = out;
+    strm->avail_out = (uInt) bound;
+
+    // the output is large enough for the whole stream in one call
+    int res = deflate(strm, Z_FINISH);
+    *out_len = res == Z_STREAM_END ? (size_t) strm->total_out : 0;
+
+    return deflateReset(strm) == Z_OK;
+}
+#endif
+
+bool gzip_set_level(int level)
+{
+    if (level != GZIP_DEFAULT_LEVEL &&
+        (level < MIN_LEVEL || level > MAX_LEVEL)) {
+        return false;
+    }
+    _level = level;
+    return true;
+}
+
+int gzip_get_level(void)
+{
+    return _level;
+}
+
+static struct _compressor *_acquire(int level)
+{
+    for (size_t i = 0; i < POOL_SIZE; i++) {
+        if (!_pool[i]) {
+            continue;
+        }
+        struct _compressor *c = ATOMIC_EXCHANGE_PTR(&_pool[i], NULL);
+        if (!c) {
+            continue; // lost the race
+        }
+        if (c->level == level) {
+            return c;
+        }
+        _compressor_free(c);
+    }
+    return _compressor_new(level);
+}
+
+static void _release(struct _compressor *c)
+{
+    for (size_t i = 0; i < POOL_SIZE; i++) {
+        if (!_pool[i] && ATOMIC_CAS_PTR(&_pool[i], NULL, c)) {
+            return;
+        }
+    }
+    _compressor_free(c);
+}
+
+size_t gzip_compress(const char *in, size_t in_len, uint8_t *out)
+{
+    struct _compressor *c = _acquire(_level);
+    if (!c) {
+        return 0;
+    }
+
+    size_t out_len;
+    if (_compress(c, in, in_len, out, &out_len)) {
+        _release(c);
+    } else {
+        _compressor_free(c);
+    }
+    return out_len;
+}
+
+void gzip_shutdown(void)
+{
+    for (size_t i = 0; i < POOL_SIZE; i++) {
+        struct _compressor *c = ATOMIC_EXCHANGE_PTR(&_pool[i], NULL);
+        if (c) {
+            _compressor_free(c);
+        }
+    }
+}
@@ -0,0 +1,36 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// use the default level of the backend
+#define GZIP_DEFAULT_LEVEL (-1)
+
+// "zlib" or "libdeflate" (SQREEN_JNI_LIBDEFLATE)
+extern const char *const gzip_backend;
+
+// Returns false (and keeps the current level) if the backend doesn't support
+// the given level. Compressor states created with another level are discarded
+// as they're taken from the pool
+bool gzip_set_level(int level);
+int gzip_get_level(void);
+
+// frees the pooled compressor states
+void gzip_shutdown(void);
+
+// upper bound on the output of gzip_compress for in_len input bytes
+size_t gzip_bound(size_t in_len);
+
+// Compresses in into out, which must have room for gzip_bound(in_len) bytes.
+// Returns the size of the gzip member written, or 0 on failure.
+// Thread-safe; the compressor state is reused across calls
+size_t gzip_compress(const char *in, size_t in_len, uint8_t *out);
@@ -0,0 +1,53 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#include <ddwaf.h>
+#include <jni.h>
+#include "common.h"
+#include "object_image.h"
+#include "jni/com_datadog_ddwaf_InputRecorder.h"
+
+// A record has the persistent data as its first root and the ephemeral data as
+// its second one (see object_image.h).
+
+static const ddwaf_object *_root_checked(JNIEnv *env, jobject buffer)
+{
+    if (!buffer) {
+        return NULL;
+    }
+    const ddwaf_object *root = JNI(GetDirectBufferAddress, buffer);
+    if (!root || JNI(GetDirectBufferCapacity, buffer) <
+                         (jlong) sizeof(ddwaf_object)) {
+        JNI(ThrowNew, jcls_iae, "Not a serialized ddwaf_object");
+        return NULL;
+    }
+    return root;
+}
+
+/*
+ * Class:     com_datadog_ddwaf_InputRecorder
+ * Method:    encodeRecord
+ * Signature: (Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_datadog_ddwaf_InputRecorder_encodeRecord(
+        JNIEnv *env, jclass clazz, jobject persistent_buffer,
+        jobject ephemeral_buffer)
+{
+    UNUSED(clazz);
+
+    const ddwaf_object *persistent = _root_checked(env, persistent_buffer);
+    if (JNI(ExceptionCheck)) {
+        return NULL;
+    }
+    const ddwaf_object *ephemeral = _root_checked(env, ephemeral_buffer);
+    if (JNI(ExceptionCheck)) {
+        return NULL;
+    }
+
+    return object_image_encode_java_checked(env, persistent, ephemeral);
+}
@@ -0,0 +1,22 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class com_datadog_ddwaf_ConfigSnapshot */
+
+#ifndef _Included_com_datadog_ddwaf_ConfigSnapshot
+#define _Included_com_datadog_ddwaf_ConfigSnapshot
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     com_datadog_ddwaf_ConfigSnapshot
+ * Method:    encodeConvertedConfig
+ * Signature: (J)[B
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_datadog_ddwaf_ConfigSnapshot_encodeConvertedConfig(JNIEnv *, jclass,
+                                                            jlong);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
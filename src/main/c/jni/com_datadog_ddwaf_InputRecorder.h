@@ -0,0 +1,21 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class com_datadog_ddwaf_InputRecorder */
+
+#ifndef _Included_com_datadog_ddwaf_InputRecorder
+#define _Included_com_datadog_ddwaf_InputRecorder
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     com_datadog_ddwaf_InputRecorder
+ * Method:    encodeRecord
+ * Signature: (Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_datadog_ddwaf_InputRecorder_encodeRecord(
+        JNIEnv *, jclass, jobject, jobject);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
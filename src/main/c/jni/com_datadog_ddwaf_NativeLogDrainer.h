@@ -0,0 +1,45 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class com_datadog_ddwaf_NativeLogDrainer */
+
+#ifndef _Included_com_datadog_ddwaf_NativeLogDrainer
+#define _Included_com_datadog_ddwaf_NativeLogDrainer
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     com_datadog_ddwaf_NativeLogDrainer
+ * Method:    startAsync
+ * Signature: ()Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_NativeLogDrainer_startAsync(JNIEnv *, jclass);
+
+/*
+ * Class:     com_datadog_ddwaf_NativeLogDrainer
+ * Method:    drain
+ * Signature: ()I
+ */
+JNIEXPORT jint JNICALL Java_com_datadog_ddwaf_NativeLogDrainer_drain(JNIEnv *,
+                                                                     jclass);
+
+/*
+ * Class:     com_datadog_ddwaf_NativeLogDrainer
+ * Method:    getDroppedRecords
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_datadog_ddwaf_NativeLogDrainer_getDroppedRecords(JNIEnv *, jclass);
+
+/*
+ * Class:     com_datadog_ddwaf_NativeLogDrainer
+ * Method:    logRecords
+ * Signature: (Ljava/lang/String;I)V
+ */
+JNIEXPORT void JNICALL Java_com_datadog_ddwaf_NativeLogDrainer_logRecords(
+        JNIEnv *, jclass, jstring, jint);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
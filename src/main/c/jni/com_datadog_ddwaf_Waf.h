@@ -31,6 +31,46 @@ JNIEXPORT jstring JNICALL Java_com_datadog_ddwaf_Waf_getVersion(JNIEnv *,
 JNIEXPORT void JNICALL Java_com_datadog_ddwaf_Waf_deinitialize(JNIEnv *,
                                                                jclass);
 
+/*
+ * Class:     com_datadog_ddwaf_Waf
+ * Method:    getSchemaCacheHits
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL Java_com_datadog_ddwaf_Waf_getSchemaCacheHits(JNIEnv *,
+                                                                      jclass);
+
+/*
+ * Class:     com_datadog_ddwaf_Waf
+ * Method:    getSchemaCacheMisses
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_datadog_ddwaf_Waf_getSchemaCacheMisses(JNIEnv *, jclass);
+
+/*
+ * Class:     com_datadog_ddwaf_Waf
+ * Method:    getCpuLevel
+ * Signature: ()Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_com_datadog_ddwaf_Waf_getCpuLevel(JNIEnv *,
+                                                                 jclass);
+
+/*
+ * Class:     com_datadog_ddwaf_Waf
+ * Method:    getSelectedKernels
+ * Signature: ()[Ljava/lang/String;
+ */
+JNIEXPORT jobjectArray JNICALL
+Java_com_datadog_ddwaf_Waf_getSelectedKernels(JNIEnv *, jclass);
+
+/*
+ * Class:     com_datadog_ddwaf_Waf
+ * Method:    drainSlowRunCaptures
+ * Signature: ()[B
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_datadog_ddwaf_Waf_drainSlowRunCaptures(JNIEnv *, jclass);
+
 #ifdef __cplusplus
 }
 #endif
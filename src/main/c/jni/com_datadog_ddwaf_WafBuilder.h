@@ -28,14 +28,74 @@ JNIEXPORT jlong JNICALL Java_com_datadog_ddwaf_WafBuilder_initBuilder(JNIEnv *,
  * Class:     com_datadog_ddwaf_WafBuilder
  * Method:    addOrUpdateConfigNative
  * Signature:
- * (Lcom/datadog/ddwaf/WafBuilder;Ljava/lang/String;Ljava/util/Map;[Lcom/datadog/ddwaf/WafDiagnostics;)Z
+ * (Lcom/datadog/ddwaf/WafBuilder;Ljava/lang/String;Ljava/util/Map;[J[Lcom/datadog/ddwaf/WafDiagnostics;)Z
  */
 JNIEXPORT jboolean JNICALL
 Java_com_datadog_ddwaf_WafBuilder_addOrUpdateConfigNative(JNIEnv *, jclass,
                                                           jobject, jstring,
-                                                          jobject,
+                                                          jobject, jlongArray,
                                                           jobjectArray);
 
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    convertConfig
+ * Signature: (Ljava/util/Map;)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_datadog_ddwaf_WafBuilder_convertConfig(JNIEnv *, jclass, jobject);
+
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    addOrUpdateConvertedConfig
+ * Signature:
+ * (Lcom/datadog/ddwaf/WafBuilder;Ljava/lang/String;J[J[Lcom/datadog/ddwaf/WafDiagnostics;)Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_WafBuilder_addOrUpdateConvertedConfig(JNIEnv *, jclass,
+                                                             jobject, jstring,
+                                                             jlong, jlongArray,
+                                                             jobjectArray);
+
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    freeConvertedConfig
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL
+Java_com_datadog_ddwaf_WafBuilder_freeConvertedConfig(JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    addOrUpdateJsonConfigNative
+ * Signature:
+ * (Lcom/datadog/ddwaf/WafBuilder;Ljava/lang/String;Ljava/nio/ByteBuffer;II[J[Lcom/datadog/ddwaf/WafDiagnostics;)Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_WafBuilder_addOrUpdateJsonConfigNative(
+        JNIEnv *, jclass, jobject, jstring, jobject, jint, jint, jlongArray,
+        jobjectArray);
+
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    addOrUpdateJsonArrayConfigNative
+ * Signature:
+ * (Lcom/datadog/ddwaf/WafBuilder;Ljava/lang/String;[BII[J[Lcom/datadog/ddwaf/WafDiagnostics;)Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_WafBuilder_addOrUpdateJsonArrayConfigNative(
+        JNIEnv *, jclass, jobject, jstring, jbyteArray, jint, jint,
+        jlongArray, jobjectArray);
+
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    addOrUpdateSnapshotConfigNative
+ * Signature:
+ * (Lcom/datadog/ddwaf/WafBuilder;Ljava/lang/String;Ljava/nio/ByteBuffer;[J[Lcom/datadog/ddwaf/WafDiagnostics;)Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_WafBuilder_addOrUpdateSnapshotConfigNative(
+        JNIEnv *, jclass, jobject, jstring, jobject, jlongArray, jobjectArray);
+
 /*
  * Class:     com_datadog_ddwaf_WafBuilder
  * Method:    removeConfigNative
@@ -52,6 +112,17 @@ JNIEXPORT jboolean JNICALL Java_com_datadog_ddwaf_WafBuilder_removeConfigNative(
 JNIEXPORT void JNICALL
 Java_com_datadog_ddwaf_WafBuilder_destroyBuilder(JNIEnv *, jclass, jlong);
 
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    addOrUpdateDataConfigNative
+ * Signature:
+ * (Lcom/datadog/ddwaf/WafBuilder;Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;[B[I[J[J[Lcom/datadog/ddwaf/WafDiagnostics;)Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_WafBuilder_addOrUpdateDataConfigNative(
+        JNIEnv *, jclass, jobject, jstring, jstring, jstring, jstring,
+        jbyteArray, jintArray, jlongArray, jlongArray, jobjectArray);
+
 #ifdef __cplusplus
 }
 #endif
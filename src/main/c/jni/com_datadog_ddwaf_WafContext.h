@@ -17,12 +17,15 @@ Java_com_datadog_ddwaf_WafContext_initWafContext(JNIEnv *, jclass, jobject);
 
 /*
  * Class:     com_datadog_ddwaf_WafContext
- * Method:    runWafContext
+ * Method:    runWafContextBinary
  * Signature:
- * (Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Lcom/datadog/ddwaf/Waf/Limits;Lcom/datadog/ddwaf/WafMetrics;)Lcom/datadog/ddwaf/Waf/ResultWithData;
+ * (Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Lcom/datadog/ddwaf/Waf/Limits;Lcom/datadog/ddwaf/WafMetrics;Ljava/nio/ByteBuffer;[Ljava/lang/Object;)Ljava/nio/ByteBuffer;
  */
-JNIEXPORT jobject JNICALL Java_com_datadog_ddwaf_WafContext_runWafContext(
-        JNIEnv *, jobject, jobject, jobject, jobject, jobject);
+JNIEXPORT jobject JNICALL
+Java_com_datadog_ddwaf_WafContext_runWafContextBinary(JNIEnv *, jobject,
+                                                      jobject, jobject,
+                                                      jobject, jobject,
+                                                      jobject, jobjectArray);
 
 /*
  * Class:     com_datadog_ddwaf_WafContext
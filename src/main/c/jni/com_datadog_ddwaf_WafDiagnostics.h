@@ -0,0 +1,22 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class com_datadog_ddwaf_WafDiagnostics */
+
+#ifndef _Included_com_datadog_ddwaf_WafDiagnostics
+#define _Included_com_datadog_ddwaf_WafDiagnostics
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     com_datadog_ddwaf_WafDiagnostics
+ * Method:    parseDetails
+ * Signature: ([B)Lcom/datadog/ddwaf/WafDiagnostics;
+ */
+JNIEXPORT jobject JNICALL
+Java_com_datadog_ddwaf_WafDiagnostics_parseDetails(JNIEnv *, jclass,
+                                                   jbyteArray);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,567 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#include "json.h"
+#include "cpu_features.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CPU_X86_64
+#include <immintrin.h>
+#elif defined(CPU_AARCH64)
+#include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/* Escaping rules (same as the original byte loop): '"' and '\\' are prefixed
+ * with a backslash, bytes 0x00-0x1F become \u00XX (uppercase hex) and
+ * everything else, including non-ASCII UTF-8, is copied verbatim. */
+
+// number of output bytes for each input byte
+static const uint8_t _escaped_len[256] = {
+        6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, // 0x00
+        6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, // 0x10
+        1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x20
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x30
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x40
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1, // 0x50
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x60
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x70
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x80
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x90
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xA0
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xB0
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xC0
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xD0
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xE0
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xF0
+};
+
+static const char _hex_digits[] = "0123456789ABCDEF";
+
+static inline char *_escape_byte(uint8_t c, char *o)
+{
+    switch (_escaped_len[c]) {
+    case 1:
+        *o = (char) c;
+        return o + 1;
+    case 2:
+        o[0] = '\\';
+        o[1] = (char) c;
+        return o + 2;
+    default:
+        memcpy(o, "\\u00", 4);
+        o[4] = _hex_digits[c >> 4];
+        o[5] = _hex_digits[c & 0xF];
+        return o + 6;
+    }
+}
+
+static size_t _escaped_size_scalar(const char *str, size_t len)
+{
+    const uint8_t *s = (const uint8_t *) str;
+    size_t res = 0;
+    for (size_t i = 0; i < len; i++) {
+        res += _escaped_len[s[i]];
+    }
+    return res;
+}
+
+static char *_escape_scalar(const char *str, size_t len, char *out)
+{
+    const uint8_t *s = (const uint8_t *) str;
+    for (size_t i = 0; i < len; i++) {
+        out = _escape_byte(s[i], out);
+    }
+    return out;
+}
+
+#if defined(CPU_X86_64) || defined(CPU_AARCH64)
+static inline unsigned _ctz32(uint32_t v)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward(&idx, v);
+    return (unsigned) idx;
+#else
+    return (unsigned) __builtin_ctz(v);
+#endif
+}
+
+// handles a block whose bytes needing escaping are flagged in mask
+static inline char *_escape_block_mask(const uint8_t *s, uint32_t mask,
+                                       unsigned block_len, char *o)
+{
+    unsigned pos = 0;
+    while (mask) {
+        unsigned idx = _ctz32(mask);
+        memcpy(o, s + pos, idx - pos);
+        o += idx - pos;
+        o = _escape_byte(s[idx], o);
+        pos = idx + 1;
+        mask &= mask - 1;
+    }
+    memcpy(o, s + pos, block_len - pos);
+    return o + (block_len - pos);
+}
+#endif
+
+#ifdef CPU_X86_64
+static inline unsigned _popcount32(uint32_t v)
+{
+    v = v - ((v >> 1) & 0x55555555u);
+    v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+    return (((v + (v >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+}
+
+// SSE2 is part of the x86-64 baseline
+static inline void _classify_sse2(__m128i v, uint32_t *special, uint32_t *ctl)
+{
+    __m128i is_quote = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+    __m128i is_bslash = _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+    // unsigned v <= 0x1F
+    __m128i is_ctl = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+    *special = (uint32_t) _mm_movemask_epi8(_mm_or_si128(is_quote, is_bslash));
+    *ctl = (uint32_t) _mm_movemask_epi8(is_ctl);
+}
+
+static size_t _escaped_size_sse2(const char *str, size_t len)
+{
+    size_t extra = 0;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint32_t special, ctl;
+        __m128i v = _mm_loadu_si128((const __m128i *) (const void *) (str + i));
+        _classify_sse2(v, &special, &ctl);
+        if (special | ctl) {
+            extra += _popcount32(special) + 5 * (size_t) _popcount32(ctl);
+        }
+    }
+    return i + extra + _escaped_size_scalar(str + i, len - i);
+}
+
+static char *_escape_sse2(const char *str, size_t len, char *out)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint32_t special, ctl;
+        __m128i v = _mm_loadu_si128((const __m128i *) (const void *) (str + i));
+        _classify_sse2(v, &special, &ctl);
+        if ((special | ctl) == 0) {
+            _mm_storeu_si128((__m128i *) (void *) out, v);
+            out += 16;
+        } else {
+            out = _escape_block_mask((const uint8_t *) str + i, special | ctl,
+                                     16, out);
+        }
+    }
+    return _escape_scalar(str + i, len - i, out);
+}
+
+CPU_TARGET("avx2")
+static inline void _classify_avx2(__m256i v, uint32_t *special, uint32_t *ctl)
+{
+    __m256i is_quote = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'));
+    __m256i is_bslash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'));
+    __m256i is_ctl =
+            _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v);
+    *special = (uint32_t) _mm256_movemask_epi8(
+            _mm256_or_si256(is_quote, is_bslash));
+    *ctl = (uint32_t) _mm256_movemask_epi8(is_ctl);
+}
+
+CPU_TARGET("avx2")
+static size_t _escaped_size_avx2(const char *str, size_t len)
+{
+    size_t extra = 0;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        uint32_t special, ctl;
+        __m256i v = _mm256_loadu_si256(
+                (const __m256i *) (const void *) (str + i));
+        _classify_avx2(v, &special, &ctl);
+        if (special | ctl) {
+            extra += _popcount32(special) + 5 * (size_t) _popcount32(ctl);
+        }
+    }
+    return i + extra + _escaped_size_sse2(str + i, len - i);
+}
+
+CPU_TARGET("avx2")
+static char *_escape_avx2(const char *str, size_t len, char *out)
+{
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        uint32_t special, ctl;
+        __m256i v = _mm256_loadu_si256(
+                (const __m256i *) (const void *) (str + i));
+        _classify_avx2(v, &special, &ctl);
+        if ((special | ctl) == 0) {
+            _mm256_storeu_si256((__m256i *) (void *) out, v);
+            out += 32;
+        } else {
+            out = _escape_block_mask((const uint8_t *) str + i, special | ctl,
+                                     32, out);
+        }
+    }
+    return _escape_sse2(str + i, len - i, out);
+}
+#endif
+
+#ifdef CPU_AARCH64
+// 16-bit movemask equivalent
+static inline uint32_t _movemask_neon(uint8x16_t v)
+{
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                     1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t masked = vandq_u8(v, vld1q_u8(bits));
+    uint32_t lo = vaddv_u8(vget_low_u8(masked));
+    uint32_t hi = vaddv_u8(vget_high_u8(masked));
+    return lo | (hi << 8);
+}
+
+static inline uint8x16_t _classify_neon(uint8x16_t v, uint8x16_t *ctl)
+{
+    uint8x16_t is_quote = vceqq_u8(v, vdupq_n_u8('"'));
+    uint8x16_t is_bslash = vceqq_u8(v, vdupq_n_u8('\\'));
+    *ctl = vcltq_u8(v, vdupq_n_u8(0x20));
+    return vorrq_u8(is_quote, is_bslash);
+}
+
+static size_t _escaped_size_neon(const char *str, size_t len)
+{
+    size_t extra = 0;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t ctl;
+        uint8x16_t special =
+                _classify_neon(vld1q_u8((const uint8_t *) str + i), &ctl);
+        if (vmaxvq_u8(vorrq_u8(special, ctl))) {
+            // lanes are 0xFF or 0; count them
+            extra += vaddvq_u8(vshrq_n_u8(special, 7)) +
+                     5 * (size_t) vaddvq_u8(vshrq_n_u8(ctl, 7));
+        }
+    }
+    return i + extra + _escaped_size_scalar(str + i, len - i);
+}
+
+static char *_escape_neon(const char *str, size_t len, char *out)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t ctl;
+        uint8x16_t v = vld1q_u8((const uint8_t *) str + i);
+        uint8x16_t any = vorrq_u8(_classify_neon(v, &ctl), ctl);
+        if (vmaxvq_u8(any) == 0) {
+            vst1q_u8((uint8_t *) out, v);
+            out += 16;
+        } else {
+            out = _escape_block_mask((const uint8_t *) str + i,
+                                     _movemask_neon(any), 16, out);
+        }
+    }
+    return _escape_scalar(str + i, len - i, out);
+}
+#endif
+
+static const struct json_escape_impl _impls[] = {
+        {"scalar", _escaped_size_scalar, _escape_scalar, 0},
+#ifdef CPU_X86_64
+        {"sse2", _escaped_size_sse2, _escape_sse2, CPU_FEATURE_SSE2},
+        {"avx2", _escaped_size_avx2, _escape_avx2, CPU_FEATURE_AVX2},
+#endif
+#ifdef CPU_AARCH64
+        {"neon", _escaped_size_neon, _escape_neon, CPU_FEATURE_NEON},
+#endif
+};
+
+const struct json_escape_impl *json_escape_impl = &_impls[0];
+
+const struct json_escape_impl *json_escape_impls(size_t *count)
+{
+    *count = sizeof(_impls) / sizeof(_impls[0]);
+    return _impls;
+}
+
+void json_escape_init(void)
+{
+    // implementations are listed from slowest to fastest
+    for (size_t i = 0; i < sizeof(_impls) / sizeof(_impls[0]); i++) {
+        if (cpu_has(_impls[i].required_features)) {
+            json_escape_impl = &_impls[i];
+        }
+    }
+}
+
+/* JSON writer: a first pass computes an upper bound of the output size, so
+ * the second one can write into a single buffer without bounds checks. */
+
+// "-1.2345678901234567e-308"
+#define JSON_MAX_DOUBLE_LEN 24
+#define JSON_MAX_INT_LEN 20 // "-9223372036854775808"
+
+static const char _digit_pairs[] = "00010203040506070809"
+                                   "10111213141516171819"
+                                   "20212223242526272829"
+                                   "30313233343536373839"
+                                   "40414243444546474849"
+                                   "50515253545556575859"
+                                   "60616263646566676869"
+                                   "70717273747576777879"
+                                   "80818283848586878889"
+                                   "90919293949596979899";
+
+static inline unsigned _u64_num_digits(uint64_t v)
+{
+    static const uint64_t pow10[] = {
+            10u,
+            100u,
+            1000u,
+            10000u,
+            100000u,
+            1000000u,
+            10000000u,
+            100000000u,
+            1000000000u,
+            10000000000u,
+            100000000000u,
+            1000000000000u,
+            10000000000000u,
+            100000000000000u,
+            1000000000000000u,
+            10000000000000000u,
+            100000000000000000u,
+            1000000000000000000u,
+            10000000000000000000u,
+    };
+    unsigned n = 1;
+    while (n < 20 && v >= pow10[n - 1]) {
+        n++;
+    }
+    return n;
+}
+
+static inline char *_write_u64(char *o, uint64_t v)
+{
+    char *end = o + _u64_num_digits(v);
+    char *p = end;
+    while (v >= 100) {
+        size_t idx = (size_t) (v % 100) * 2;
+        v /= 100;
+        p -= 2;
+        memcpy(p, &_digit_pairs[idx], 2);
+    }
+    if (v >= 10) {
+        p -= 2;
+        memcpy(p, &_digit_pairs[v * 2], 2);
+    } else {
+        *--p = (char) ('0' + v);
+    }
+    return end;
+}
+
+static inline uint64_t _abs_i64(int64_t v)
+{
+    // well-defined for INT64_MIN too
+    return v < 0 ? 0 - (uint64_t) v : (uint64_t) v;
+}
+
+static inline char *_write_i64(char *o, int64_t v)
+{
+    if (v < 0) {
+        *o++ = '-';
+    }
+    return _write_u64(o, _abs_i64(v));
+}
+
+static char *_write_double(char *o, double d)
+{
+    if (!isfinite(d)) {
+        memcpy(o, "null", 4);
+        return o + 4;
+    }
+
+    // integral values that are exactly representable: no need for printf.
+    // Doubles are compared bitwise, which also sends -0.0 to the slow path
+    if (fabs(d) < 1e15) {
+        double integral = (double) (int64_t) d;
+        if (memcmp(&integral, &d, sizeof d) == 0) {
+            o = _write_i64(o, (int64_t) d);
+            memcpy(o, ".0", 2);
+            return o + 2;
+        }
+    }
+
+    // the shortest of %.15g, %.16g and %.17g that parses back to d. Fewer
+    // than 15 significant digits are covered by %.15g dropping trailing zeros
+    char tmp[JSON_MAX_DOUBLE_LEN + 8];
+    int len = 0;
+    for (int prec = 15; prec <= 17; prec++) {
+        len = snprintf(tmp, sizeof tmp, "%.*g", prec, d);
+        double parsed = strtod(tmp, NULL);
+        if (prec == 17 || memcmp(&parsed, &d, sizeof d) == 0) {
+            break;
+        }
+    }
+    if (len <= 0 || len > JSON_MAX_DOUBLE_LEN) {
+        memcpy(o, "null", 4);
+        return o + 4;
+    }
+    for (int i = 0; i < len; i++) {
+        // the decimal separator depends on the locale
+        o[i] = tmp[i] == ',' ? '.' : tmp[i];
+    }
+    return o + len;
+}
+
+static inline size_t _sat_add(size_t a, size_t b)
+{
+    return a > SIZE_MAX - b ? SIZE_MAX : a + b;
+}
+
+static size_t _estimate(const ddwaf_object *obj, int depth)
+{
+    if (depth > MAX_JSON_DEPTH) {
+        return SIZE_MAX;
+    }
+
+    switch (obj->type) {
+    case DDWAF_OBJ_SIGNED:
+        return (size_t) (obj->intValue < 0) +
+               _u64_num_digits(_abs_i64(obj->intValue));
+    case DDWAF_OBJ_UNSIGNED:
+        return _u64_num_digits(obj->uintValue);
+    case DDWAF_OBJ_FLOAT:
+        return JSON_MAX_DOUBLE_LEN;
+    case DDWAF_OBJ_BOOL:
+        return obj->boolean ? 4 : 5;
+    case DDWAF_OBJ_STRING:
+        return _sat_add(2, json_escape_impl->escaped_size(obj->stringValue,
+                                                          obj->nbEntries));
+    case DDWAF_OBJ_ARRAY:
+    case DDWAF_OBJ_MAP: {
+        bool is_map = obj->type == DDWAF_OBJ_MAP;
+        size_t res = 2; // brackets
+        for (uint64_t i = 0; i < obj->nbEntries; i++) {
+            const ddwaf_object *o = &obj->array[i];
+            if (i != 0) {
+                res = _sat_add(res, 1);
+            }
+            if (is_map) {
+                // quotes + colon
+                res = _sat_add(res, 3 + json_escape_impl->escaped_size(
+                                                o->parameterName,
+                                                o->parameterNameLength));
+            }
+            res = _sat_add(res, _estimate(o, depth + 1));
+        }
+        return res;
+    }
+    case DDWAF_OBJ_NULL:
+    case DDWAF_OBJ_INVALID:
+    default:
+        return 4;
+    }
+}
+
+size_t json_estimate_size(const ddwaf_object *obj)
+{
+    return _estimate(obj, 0);
+}
+
+static char *_write(const ddwaf_object *obj, char *o)
+{
+    switch (obj->type) {
+    case DDWAF_OBJ_SIGNED:
+        return _write_i64(o, obj->intValue);
+    case DDWAF_OBJ_UNSIGNED:
+        return _write_u64(o, obj->uintValue);
+    case DDWAF_OBJ_FLOAT:
+        return _write_double(o, obj->f64);
+    case DDWAF_OBJ_BOOL:
+        if (obj->boolean) {
+            memcpy(o, "true", 4);
+            return o + 4;
+        }
+        memcpy(o, "false", 5);
+        return o + 5;
+    case DDWAF_OBJ_STRING:
+        *o++ = '"';
+        o = json_escape_impl->escape(obj->stringValue, obj->nbEntries, o);
+        *o++ = '"';
+        return o;
+    case DDWAF_OBJ_ARRAY:
+        *o++ = '[';
+        for (uint64_t i = 0; i < obj->nbEntries; i++) {
+            if (i != 0) {
+                *o++ = ',';
+            }
+            o = _write(&obj->array[i], o);
+        }
+        *o++ = ']';
+        return o;
+    case DDWAF_OBJ_MAP:
+        *o++ = '{';
+        for (uint64_t i = 0; i < obj->nbEntries; i++) {
+            const ddwaf_object *e = &obj->array[i];
+            if (i != 0) {
+                *o++ = ',';
+            }
+            *o++ = '"';
+            o = json_escape_impl->escape(e->parameterName,
+                                         e->parameterNameLength, o);
+            memcpy(o, "\":", 2);
+            o = _write(e, o + 2);
+        }
+        *o++ = '}';
+        return o;
+    case DDWAF_OBJ_NULL:
+    case DDWAF_OBJ_INVALID:
+    default:
+        memcpy(o, "null", 4);
+        return o + 4;
+    }
+}
+
+bool json_write_object(struct json_buf *buf, const ddwaf_object *obj)
+{
+    size_t estimate = json_estimate_size(obj);
+    if (estimate == SIZE_MAX || estimate > SIZE_MAX - 1 - buf->len) {
+        return false;
+    }
+
+    size_t needed = buf->len + estimate + 1; // + NUL
+    if (buf->cap < needed) {
+        char *data;
+        if (buf->owned) {
+            data = realloc(buf->data, needed);
+        } else {
+            data = malloc(needed);
+            if (data && buf->len > 0) {
+                memcpy(data, buf->data, buf->len);
+            }
+        }
+        if (!data) {
+            return false;
+        }
+        buf->data = data;
+        buf->cap = needed;
+        buf->owned = true;
+    }
+
+    char *end = _write(obj, buf->data + buf->len);
+    *end = '\0';
+    buf->len = (size_t) (end - buf->data);
+    return true;
+}
@@ -8,179 +8,68 @@
 
 #pragma once
 
+#include <ddwaf.h>
 #include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
 
-#define MIN_JSON_SEGMENT_SIZE ((uint32_t) 216)
 #define MAX_JSON_DEPTH 20
 
-struct json_segment {
-    uint32_t size, len;
-    struct json_segment *next;
-    char data[];
+// Output buffer of the JSON writer. Can start out pointing to caller-provided
+// storage (see json_buf_init); it's replaced by a heap buffer if too small.
+struct json_buf {
+    char *data;
+    size_t len;
+    size_t cap;
+    bool owned; // data is heap allocated and must be freed
 };
 
-struct json_iterator {
-    const struct json_segment *seg;
-    uint32_t pos;
-};
-
-static inline size_t json_length(const struct json_segment *seg)
-{
-    size_t res = 0;
-    for (const struct json_segment *p = seg; p; p = p->next) {
-        res += p->len;
-    }
-    return res;
-}
-
-static inline size_t json_it_read(struct json_iterator *it, char *out,
-                                  size_t out_len)
+static inline void json_buf_init(struct json_buf *buf, char *storage,
+                                 size_t storage_cap)
 {
-    size_t written = 0;
-    while (it->seg != NULL && written < out_len) {
-        uint32_t avail_in_seg = it->seg->len - it->pos;
-        if (avail_in_seg == 0) {
-            it->seg = it->seg->next;
-            it->pos = 0;
-            continue;
-        }
-        size_t left_in_out = out_len - written;
-        size_t to_copy =
-                avail_in_seg < left_in_out ? avail_in_seg : left_in_out;
-        memcpy(out + written, it->seg->data + it->pos, to_copy);
-        // cast and addition are safe. to_copy is never bigger than avail_in_seg
-        it->pos += (uint32_t) to_copy;
-        written += to_copy;
-    }
-    return written;
+    buf->data = storage;
+    buf->len = 0;
+    buf->cap = storage_cap;
+    buf->owned = false;
 }
 
-static inline struct json_segment *json_seg_new(size_t min_size)
+static inline void json_buf_free(struct json_buf *buf)
 {
-    if (min_size > UINT32_MAX) {
-        return NULL;
-    }
-
-    uint32_t size = ((uint32_t) min_size) < MIN_JSON_SEGMENT_SIZE
-                            ? MIN_JSON_SEGMENT_SIZE
-                            : (uint32_t) min_size;
-
-    _Static_assert(sizeof(size_t) > sizeof(size), "size_t is more than 32 bit");
-    struct json_segment *initial_seg = malloc(sizeof *initial_seg + size);
-    if (!initial_seg) {
-        return NULL;
+    if (buf->owned) {
+        free(buf->data);
     }
-    initial_seg->size = size;
-    initial_seg->len = 0;
-    initial_seg->next = 0;
-    return initial_seg;
+    buf->data = NULL;
+    buf->len = buf->cap = 0;
+    buf->owned = false;
 }
 
-static inline struct json_segment *_json_seg_ensure(struct json_segment *seg,
-                                                    size_t data_len)
-{
-    if (seg == NULL) {
-        return NULL;
-    }
-    if (data_len > UINT32_MAX) {
-        return NULL;
-    }
+// escapes JSON string contents (without the surrounding quotes)
+struct json_escape_impl {
+    const char *name;
+    // number of bytes the escaped string takes
+    size_t (*escaped_size)(const char *str, size_t str_len);
+    // writes escaped_size() bytes to out; returns the end of the output
+    char *(*escape)(const char *str, size_t str_len, char *out);
+    uint32_t required_features; // CPU_FEATURE_* bitmask
+};
 
-    uint32_t avail = seg->size - seg->len;
-    if (avail >= data_len) {
-        return seg;
-    } else {
-        struct json_segment *new_seg = json_seg_new(data_len);
-        if (!new_seg) {
-            return NULL;
-        }
-        seg->next = new_seg;
-        return new_seg;
-    }
-}
+// the best implementation for the running CPU; set by json_escape_init()
+extern const struct json_escape_impl *json_escape_impl;
 
-static inline struct json_segment *
-json_append(struct json_segment *seg, const char *data, size_t data_len)
-{
-    struct json_segment *actual_seg = _json_seg_ensure(seg, data_len);
-    if (actual_seg == NULL) {
-        return NULL;
-    }
+// all implementations compiled in, including those the CPU may not support
+const struct json_escape_impl *json_escape_impls(size_t *count);
 
-    memcpy(actual_seg->data + actual_seg->len, data, data_len);
-    // cast and addition is safe, o/wise _json_seg_ensure would return NULL
-    actual_seg->len += (uint32_t) data_len;
-    return actual_seg;
-}
+// requires cpu_features_init() to have been called
+void json_escape_init(void);
 
-static inline void json_seg_free(struct json_segment *seg)
-{
-    struct json_segment *cur = seg;
-    struct json_segment *next;
-    while (cur) {
-        next = cur->next;
-        free(cur);
-        cur = next;
-    }
-}
-static inline size_t _json_str_encoded_size(const char *str, size_t str_len)
-{
-    size_t res = 0;
-    for (const char *c = str; c < str + str_len; c++) {
-        if (*c == '\\' || *c == '"') {
-            res += 2;
-        } else if (*c >= 0 && *c < 0x20) {
-            res += 6; /* \uXXXX */
-        } else {
-            res += 1;
-        }
-    }
-    return res;
-}
-static inline void _json_encode_str(const char *str, size_t str_len, char *out)
-{
-    char *o = out;
-    for (const char *c = str; c < str + str_len; c++) {
-        if (*c == '\\' || *c == '"') {
-            o[0] = '\\';
-            o[1] = *c;
-            o += 2;
-        } else if (*c >= 0 && *c < 0x20) {
-            char s[3];
-            sprintf(s, "%02X", *c);
-            o[0] = '\\';
-            o[1] = 'u';
-            o[2] = '0';
-            o[3] = '0';
-            o[4] = s[0];
-            o[5] = s[1];
-            o += 6; /* \uXXXX */
-        } else {
-            *o = *c;
-            o += 1;
-        }
-    }
-}
+// Upper bound of the length of the JSON representation of obj. It's exact
+// unless obj contains floats. Returns SIZE_MAX if obj is nested deeper than
+// MAX_JSON_DEPTH.
+size_t json_estimate_size(const ddwaf_object *obj);
 
-static inline struct json_segment *json_encode_str(struct json_segment *seg,
-                                                   const char *raw_str,
-                                                   size_t raw_str_len)
-{
-    size_t encoded_len = _json_str_encoded_size(raw_str, raw_str_len);
-    struct json_segment *cur_seg = _json_seg_ensure(seg, encoded_len);
-    if (!cur_seg) {
-        return NULL;
-    }
-    if (encoded_len == raw_str_len) {
-        // can be copied as is
-        memcpy(cur_seg->data + cur_seg->len, raw_str, raw_str_len);
-    } else {
-        _json_encode_str(raw_str, raw_str_len, cur_seg->data + cur_seg->len);
-    }
-    // cast and addition are safe (see _json_seg_ensure)
-    cur_seg->len += (uint32_t) encoded_len;
-    return cur_seg;
-}
+// Appends the JSON representation of obj to buf, followed by a NUL (not
+// counted in len). Floats are written in their shortest round-trip form;
+// non-finite floats, nulls and invalid objects as null. Returns false if obj
+// is nested too deep or on allocation failure, leaving buf->len unchanged.
+bool json_write_object(struct json_buf *buf, const ddwaf_object *obj);
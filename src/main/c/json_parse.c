@@ -0,0 +1,594 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#include "json_parse.h"
+#include <locale.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The text is parsed twice. The first pass validates it and counts the
+// objects, the bytes of the strings and the number of elements of each
+// container, in document order. The second one lays the tree out in a single
+// allocation: the objects (the elements of each container contiguously), then
+// the NUL-terminated strings. Unlike building it with ddwaf_object_map_addl()
+// and friends, nothing is reallocated or freed element by element.
+
+#define SMALL_NUMBER_LEN 64
+
+struct parser {
+    const uint8_t *start;
+    const uint8_t *p;
+    const uint8_t *end;
+    const char *err;
+    bool out_of_memory;
+
+    // filled by the first pass
+    size_t objects; // excluding the root
+    size_t string_bytes;
+    size_t max_number_len;
+    uint32_t *counts; // elements of each container
+    size_t num_counts;
+    size_t counts_cap;
+
+    // used by the second pass
+    size_t next_count;
+    ddwaf_object *next_object;
+    char *next_string;
+    char *number_buf; // for numbers of SMALL_NUMBER_LEN bytes or more
+};
+
+static bool _fail(struct parser *ps, const char *msg)
+{
+    ps->err = msg;
+    return false;
+}
+
+static inline void _skip_ws(struct parser *ps)
+{
+    while (ps->p < ps->end && (*ps->p == ' ' || *ps->p == '\n' ||
+                               *ps->p == '\r' || *ps->p == '\t')) {
+        ps->p++;
+    }
+}
+
+static inline int _hex_digit(uint8_t c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static bool _hex4(const uint8_t *p, const uint8_t *end, uint32_t *out)
+{
+    if (end - p < 4) {
+        return false;
+    }
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        int d = _hex_digit(p[i]);
+        if (d < 0) {
+            return false;
+        }
+        v = (v << 4) | (uint32_t) d;
+    }
+    *out = v;
+    return true;
+}
+
+// decodes the escape sequence at ps->p (a backslash) and advances past it
+static bool _escape(struct parser *ps, uint32_t *cp)
+{
+    const uint8_t *p = ps->p + 1;
+    if (p >= ps->end) {
+        return _fail(ps, "Unterminated string");
+    }
+    switch (*p) {
+    case '"':
+    case '\\':
+    case '/':
+        *cp = *p;
+        break;
+    case 'b':
+        *cp = '\b';
+        break;
+    case 'f':
+        *cp = '\f';
+        break;
+    case 'n':
+        *cp = '\n';
+        break;
+    case 'r':
+        *cp = '\r';
+        break;
+    case 't':
+        *cp = '\t';
+        break;
+    case 'u': {
+        uint32_t hi;
+        if (!_hex4(p + 1, ps->end, &hi)) {
+            return _fail(ps, "Invalid \\u escape");
+        }
+        p += 5;
+        if (hi >= 0xD800 && hi < 0xDC00 && ps->end - p >= 6 && p[0] == '\\' &&
+            p[1] == 'u') {
+            uint32_t lo;
+            if (_hex4(p + 2, ps->end, &lo) && lo >= 0xDC00 && lo < 0xE000) {
+                *cp = 0x10000 + ((hi - 0xD800) << 10) + (lo - 0xDC00);
+                ps->p = p + 6;
+                return true;
+            }
+        }
+        *cp = hi >= 0xD800 && hi < 0xE000 ? 0xFFFD : hi;
+        ps->p = p;
+        return true;
+    }
+    default:
+        return _fail(ps, "Invalid escape sequence");
+    }
+    ps->p = p + 1;
+    return true;
+}
+
+static inline size_t _utf8_len(uint32_t cp)
+{
+    return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+}
+
+static inline char *_put_utf8(char *o, uint32_t cp)
+{
+    if (cp < 0x80) {
+        *o++ = (char) cp;
+    } else if (cp < 0x800) {
+        *o++ = (char) (0xC0 | (cp >> 6));
+        *o++ = (char) (0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *o++ = (char) (0xE0 | (cp >> 12));
+        *o++ = (char) (0x80 | ((cp >> 6) & 0x3F));
+        *o++ = (char) (0x80 | (cp & 0x3F));
+    } else {
+        *o++ = (char) (0xF0 | (cp >> 18));
+        *o++ = (char) (0x80 | ((cp >> 12) & 0x3F));
+        *o++ = (char) (0x80 | ((cp >> 6) & 0x3F));
+        *o++ = (char) (0x80 | (cp & 0x3F));
+    }
+    return o;
+}
+
+// end of the number at p, or NULL if there's none
+static const uint8_t *_number_end(const uint8_t *p, const uint8_t *end,
+                                  bool *integral)
+{
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+    *integral = true;
+    if (p < end && *p == '-') {
+        p++;
+    }
+    if (p >= end || !IS_DIGIT(*p)) {
+        return NULL;
+    }
+    if (*p == '0') {
+        p++;
+    } else {
+        while (p < end && IS_DIGIT(*p)) {
+            p++;
+        }
+    }
+    if (p < end && *p == '.') {
+        *integral = false;
+        p++;
+        if (p >= end || !IS_DIGIT(*p)) {
+            return NULL;
+        }
+        while (p < end && IS_DIGIT(*p)) {
+            p++;
+        }
+    }
+    if (p < end && (*p | 0x20) == 'e') {
+        *integral = false;
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) {
+            p++;
+        }
+        if (p >= end || !IS_DIGIT(*p)) {
+            return NULL;
+        }
+        while (p < end && IS_DIGIT(*p)) {
+            p++;
+        }
+    }
+    return p;
+#undef IS_DIGIT
+}
+
+/* first pass */
+
+static bool _scan_value(struct parser *ps, int depth);
+
+// decoded length of the string at ps->p (the opening quote)
+static bool _scan_string(struct parser *ps, size_t *len)
+{
+    size_t n = 0;
+    ps->p++;
+    for (;;) {
+        const uint8_t *run = ps->p;
+        while (ps->p < ps->end && *ps->p != '"' && *ps->p != '\\' &&
+               *ps->p >= 0x20) {
+            ps->p++;
+        }
+        n += (size_t) (ps->p - run);
+        if (ps->p >= ps->end) {
+            return _fail(ps, "Unterminated string");
+        }
+        if (*ps->p == '"') {
+            ps->p++;
+            *len = n;
+            return true;
+        }
+        if (*ps->p < 0x20) {
+            return _fail(ps, "Unescaped control character in string");
+        }
+        uint32_t cp;
+        if (!_escape(ps, &cp)) {
+            return false;
+        }
+        n += _utf8_len(cp);
+    }
+}
+
+static bool _scan_literal(struct parser *ps, const char *lit, size_t len)
+{
+    if ((size_t) (ps->end - ps->p) < len || memcmp(ps->p, lit, len) != 0) {
+        return _fail(ps, "Invalid literal");
+    }
+    ps->p += len;
+    return true;
+}
+
+static bool _push_count(struct parser *ps, size_t *slot)
+{
+    if (ps->num_counts == ps->counts_cap) {
+        size_t cap = ps->counts_cap ? ps->counts_cap * 2 : 64;
+        uint32_t *counts = realloc(ps->counts, cap * sizeof *counts);
+        if (!counts) {
+            ps->out_of_memory = true;
+            return _fail(ps, "Could not allocate memory");
+        }
+        ps->counts = counts;
+        ps->counts_cap = cap;
+    }
+    *slot = ps->num_counts++;
+    return true;
+}
+
+static bool _scan_container(struct parser *ps, int depth)
+{
+    if (depth >= JSON_PARSE_MAX_DEPTH) {
+        return _fail(ps, "Nested too deeply");
+    }
+    size_t slot;
+    if (!_push_count(ps, &slot)) {
+        return false;
+    }
+    bool is_map = *ps->p == '{';
+    uint8_t close = is_map ? '}' : ']';
+    size_t n = 0;
+    ps->p++;
+    _skip_ws(ps);
+    if (ps->p < ps->end && *ps->p == close) {
+        ps->p++;
+        goto end;
+    }
+    for (;;) {
+        if (is_map) {
+            _skip_ws(ps);
+            if (ps->p >= ps->end || *ps->p != '"') {
+                return _fail(ps, "Expected a string key");
+            }
+            size_t key_len;
+            if (!_scan_string(ps, &key_len)) {
+                return false;
+            }
+            ps->string_bytes += key_len + 1;
+            _skip_ws(ps);
+            if (ps->p >= ps->end || *ps->p != ':') {
+                return _fail(ps, "Expected ':'");
+            }
+            ps->p++;
+        }
+        if (!_scan_value(ps, depth + 1)) {
+            return false;
+        }
+        n++;
+        _skip_ws(ps);
+        if (ps->p >= ps->end) {
+            return _fail(ps, "Unexpected end of input");
+        }
+        if (*ps->p == ',') {
+            ps->p++;
+        } else if (*ps->p == close) {
+            ps->p++;
+            break;
+        } else {
+            return _fail(ps, is_map ? "Expected ',' or '}'"
+                                    : "Expected ',' or ']'");
+        }
+    }
+end:
+    if (n > UINT32_MAX) {
+        return _fail(ps, "Container too large");
+    }
+    ps->counts[slot] = (uint32_t) n;
+    ps->objects += n;
+    return true;
+}
+
+static bool _scan_value(struct parser *ps, int depth)
+{
+    _skip_ws(ps);
+    if (ps->p >= ps->end) {
+        return _fail(ps, "Unexpected end of input");
+    }
+    switch (*ps->p) {
+    case '{':
+    case '[':
+        return _scan_container(ps, depth);
+    case '"': {
+        size_t len;
+        if (!_scan_string(ps, &len)) {
+            return false;
+        }
+        ps->string_bytes += len + 1;
+        return true;
+    }
+    case 't':
+        return _scan_literal(ps, "true", 4);
+    case 'f':
+        return _scan_literal(ps, "false", 5);
+    case 'n':
+        return _scan_literal(ps, "null", 4);
+    default: {
+        bool integral;
+        const uint8_t *end = _number_end(ps->p, ps->end, &integral);
+        if (!end) {
+            return _fail(ps, "Invalid value");
+        }
+        size_t len = (size_t) (end - ps->p);
+        if (len > ps->max_number_len) {
+            ps->max_number_len = len;
+        }
+        ps->p = end;
+        return true;
+    }
+    }
+}
+
+/* second pass: the text is known to be valid */
+
+static void _build_value(struct parser *ps, ddwaf_object *obj);
+
+static const char *_build_string(struct parser *ps, uint64_t *len)
+{
+    char *start = ps->next_string;
+    char *o = start;
+    ps->p++;
+    for (;;) {
+        const uint8_t *run = ps->p;
+        while (*ps->p != '"' && *ps->p != '\\') {
+            ps->p++;
+        }
+        memcpy(o, run, (size_t) (ps->p - run));
+        o += ps->p - run;
+        if (*ps->p == '"') {
+            break;
+        }
+        uint32_t cp;
+        _escape(ps, &cp);
+        o = _put_utf8(o, cp);
+    }
+    ps->p++;
+    *len = (uint64_t) (o - start);
+    *o++ = '\0';
+    ps->next_string = o;
+    return start;
+}
+
+static double _parse_double(struct parser *ps, const uint8_t *start,
+                            size_t len)
+{
+    char small[SMALL_NUMBER_LEN];
+    char *s = len < sizeof small ? small : ps->number_buf;
+    memcpy(s, start, len);
+    s[len] = '\0';
+    // strtod() expects the decimal separator of the locale
+    char sep = localeconv()->decimal_point[0];
+    if (sep != '.') {
+        char *dot = memchr(s, '.', len);
+        if (dot) {
+            *dot = sep;
+        }
+    }
+    return strtod(s, NULL);
+}
+
+static void _build_number(struct parser *ps, ddwaf_object *obj)
+{
+    const uint8_t *start = ps->p;
+    bool integral;
+    const uint8_t *end = _number_end(start, ps->end, &integral);
+    ps->p = end;
+
+    if (integral) {
+        bool neg = *start == '-';
+        uint64_t v = 0;
+        const uint8_t *q = start + neg;
+        for (; q < end; q++) {
+            unsigned d = *q - '0';
+            if (v > (UINT64_MAX - d) / 10) {
+                break;
+            }
+            v = v * 10 + d;
+        }
+        if (q == end && !neg) {
+            if (v <= INT64_MAX) {
+                *obj = (ddwaf_object){
+                        .type = DDWAF_OBJ_SIGNED, .intValue = (int64_t) v};
+            } else {
+                *obj = (ddwaf_object){.type = DDWAF_OBJ_UNSIGNED,
+                                      .uintValue = v};
+            }
+            return;
+        }
+        if (q == end && v <= (uint64_t) INT64_MAX + 1) {
+            *obj = (ddwaf_object){
+                    .type = DDWAF_OBJ_SIGNED,
+                    .intValue = v == (uint64_t) INT64_MAX + 1
+                                        ? INT64_MIN
+                                        : -(int64_t) v};
+            return;
+        }
+    }
+    *obj = (ddwaf_object){
+            .type = DDWAF_OBJ_FLOAT,
+            .f64 = _parse_double(ps, start, (size_t) (end - start))};
+}
+
+static void _build_container(struct parser *ps, ddwaf_object *obj)
+{
+    bool is_map = *ps->p == '{';
+    size_t n = ps->counts[ps->next_count++];
+    ddwaf_object *elems = n ? ps->next_object : NULL;
+    ps->next_object += n;
+    *obj = (ddwaf_object){.type = is_map ? DDWAF_OBJ_MAP : DDWAF_OBJ_ARRAY,
+                          .array = elems,
+                          .nbEntries = n};
+
+    ps->p++;
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) {
+            _skip_ws(ps);
+            ps->p++; // ','
+        }
+        const char *key = NULL;
+        uint64_t key_len = 0;
+        if (is_map) {
+            _skip_ws(ps);
+            key = _build_string(ps, &key_len);
+            _skip_ws(ps);
+            ps->p++; // ':'
+        }
+        _build_value(ps, &elems[i]);
+        elems[i].parameterName = key;
+        elems[i].parameterNameLength = key_len;
+    }
+    _skip_ws(ps);
+    ps->p++; // '}' or ']'
+}
+
+static void _build_value(struct parser *ps, ddwaf_object *obj)
+{
+    _skip_ws(ps);
+    switch (*ps->p) {
+    case '{':
+    case '[':
+        _build_container(ps, obj);
+        return;
+    case '"': {
+        uint64_t len;
+        const char *str = _build_string(ps, &len);
+        *obj = (ddwaf_object){
+                .type = DDWAF_OBJ_STRING, .stringValue = str, .nbEntries = len};
+        return;
+    }
+    case 't':
+        *obj = (ddwaf_object){.type = DDWAF_OBJ_BOOL, .boolean = true};
+        ps->p += 4;
+        return;
+    case 'f':
+        *obj = (ddwaf_object){.type = DDWAF_OBJ_BOOL, .boolean = false};
+        ps->p += 5;
+        return;
+    case 'n':
+        *obj = (ddwaf_object){.type = DDWAF_OBJ_NULL};
+        ps->p += 4;
+        return;
+    default:
+        _build_number(ps, obj);
+        return;
+    }
+}
+
+bool json_parse(const char *data, size_t len, struct json_doc *doc,
+                struct json_parse_error *err)
+{
+    struct parser ps = {
+            .start = (const uint8_t *) data,
+            .p = (const uint8_t *) data,
+            .end = (const uint8_t *) data + len,
+    };
+    bool ok = false;
+    void *mem = NULL;
+
+    if (len >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        ps.p += 3;
+    }
+    const uint8_t *first = ps.p;
+    if (!_scan_value(&ps, 0)) {
+        goto end;
+    }
+    _skip_ws(&ps);
+    if (ps.p != ps.end) {
+        _fail(&ps, "Unexpected data after the value");
+        goto end;
+    }
+
+    if (ps.objects > (SIZE_MAX - ps.string_bytes - 1) / sizeof(ddwaf_object)) {
+        _fail(&ps, "Document too large");
+        goto end;
+    }
+    size_t objects_size = ps.objects * sizeof(ddwaf_object);
+    mem = malloc(objects_size + ps.string_bytes + 1);
+    if (ps.max_number_len >= SMALL_NUMBER_LEN) {
+        ps.number_buf = malloc(ps.max_number_len + 1);
+    }
+    if (!mem || (ps.max_number_len >= SMALL_NUMBER_LEN && !ps.number_buf)) {
+        ps.out_of_memory = true;
+        _fail(&ps, "Could not allocate memory");
+        goto end;
+    }
+
+    ps.next_object = mem;
+    ps.next_string = (char *) mem + objects_size;
+    ps.p = first;
+    _build_value(&ps, &doc->root);
+    doc->mem = mem;
+    mem = NULL;
+    ok = true;
+
+end:
+    if (!ok) {
+        err->offset = (size_t) (ps.p - ps.start);
+        err->msg = ps.err;
+        err->out_of_memory = ps.out_of_memory;
+    }
+    free(mem);
+    free(ps.counts);
+    free(ps.number_buf);
+    return ok;
+}
+
+void json_doc_free(struct json_doc *doc)
+{
+    free(doc->mem);
+    doc->mem = NULL;
+}
@@ -0,0 +1,43 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+#include <ddwaf.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// same limit as for configurations given as Java maps
+#define JSON_PARSE_MAX_DEPTH 20
+
+// A JSON document parsed into a ddwaf_object tree. All its containers and
+// strings live in a single allocation: free it with json_doc_free(), never
+// with ddwaf_object_free().
+struct json_doc {
+    ddwaf_object root;
+    void *mem;
+};
+
+struct json_parse_error {
+    size_t offset;   // in the input
+    const char *msg; // static
+    bool out_of_memory;
+};
+
+// Parses the UTF-8 JSON text data (not NUL-terminated, an optional BOM is
+// skipped) into doc. Integers become signed objects, or unsigned ones above
+// INT64_MAX; other numbers become floats. Escapes are decoded to UTF-8, with
+// lone surrogates replaced by U+FFFD; other bytes are copied unchecked. Map
+// entries keep the document order, duplicate keys included.
+//
+// Fails, filling err, on syntax errors, on containers nested deeper than
+// JSON_PARSE_MAX_DEPTH and on allocation failure. Makes no JNI calls.
+bool json_parse(const char *data, size_t len, struct json_doc *doc,
+                struct json_parse_error *err);
+
+void json_doc_free(struct json_doc *doc);
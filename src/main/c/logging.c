@@ -10,12 +10,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
 
 #include <ddwaf.h>
 
 #include "logging.h"
+#include "atomics.h"
 #include "common.h"
 #include "java_call.h"
+#include "jni/com_datadog_ddwaf_NativeLogDrainer.h"
 #include "utf16_utf8.h"
 #include "compat.h"
 
@@ -37,6 +41,35 @@ static JavaVM *_vm;
 
 static int file_strip_idx;
 
+// Once the Java drainer thread has started (see NativeLogDrainer), records
+// without a throwable are copied into a bounded ring, which that thread empties
+// in batches. Logging then neither calls into Java nor attaches the thread to
+// the JVM. Records are dropped (and counted) while the ring is full. This is a
+// bounded MPMC queue as described by Dmitry Vyukov, with a single consumer
+#define LOG_RING_SIZE 512 // power of 2
+#define LOG_FUNCTION_SIZE 64
+#define LOG_FILE_SIZE 64
+#define LOG_MESSAGE_SIZE 512
+#define LOG_DRAIN_BATCH 64
+#define LOG_TRUNCATED_MARK "..."
+#define LOG_SUPPRESSED_FMT " (%" PRIu64 " similar messages suppressed)"
+
+struct log_record {
+    // the position the record is free for, or that plus one once written
+    uint64_t seq;
+    DDWAF_LOG_LEVEL level;
+    int line;
+    char function[LOG_FUNCTION_SIZE];
+    char file[LOG_FILE_SIZE];
+    char message[LOG_MESSAGE_SIZE];
+};
+static struct log_record _ring[LOG_RING_SIZE];
+static uint64_t _enqueue_pos;
+static uint64_t _dequeue_pos; // protected by _draining
+static bool _draining;
+static volatile bool _async;
+static uint64_t _dropped;
+
 static bool _get_min_log_level(JNIEnv *env, DDWAF_LOG_LEVEL *level);
 static void _waf_logging_c(DDWAF_LOG_LEVEL level, const char *function,
                            const char *file, unsigned line, const char *message,
@@ -46,6 +79,14 @@ static void _waf_logging_c_throwable(DDWAF_LOG_LEVEL level,
                                      int line, const char *message,
                                      uint64_t message_len,
                                      jthrowable throwable);
+static void _log_to_java(JNIEnv *env, DDWAF_LOG_LEVEL level,
+                         const char *function, const char *file, int line,
+                         const char *message, jthrowable throwable);
+static struct log_record *_claim_record(uint64_t *pos);
+static void _copy_truncated(char *dst, size_t dst_size, const char *src,
+                            size_t src_len);
+static int _drain_records(JNIEnv *env, int max);
+static bool _log_site_acquire(struct log_site *site, uint64_t *suppressed);
 static const char *_remove_path(const char *path);
 static JNIEnv *_attach_vm(bool *attached);
 static void _detach_vm(void);
@@ -96,6 +137,12 @@ bool java_log_init(JavaVM *vm, JNIEnv *env)
 
     _vm = vm;
 
+    _async = false;
+    _enqueue_pos = _dequeue_pos = 0;
+    for (uint64_t i = 0; i < LOG_RING_SIZE; i++) {
+        _ring[i].seq = i;
+    }
+
     level_cls = JNI(FindClass, slf4j_active->level);
     if (!level_cls) {
         JNI(ExceptionClear);
@@ -228,46 +275,106 @@ error:
 
 void java_log_shutdown(JNIEnv *env)
 {
+    // wait for the drainer thread to finish its batch, then log what's left
+    // here. The drainer stops once it sees _logger is gone. Nothing is logged
+    // afterwards
+    min_level = DDWAF_LOG_OFF;
+    _async = false;
+    while (!COMPARE_AND_SWAP(&_draining, false, true)) {
+    }
+    if (_logger) {
+        _drain_records(env, LOG_RING_SIZE);
+    }
+
     if (_object_jcls) {
         JNI(DeleteGlobalRef, _object_jcls);
+        _object_jcls = NULL;
     }
     if (_trace) {
         JNI(DeleteWeakGlobalRef, _trace);
+        _trace = NULL;
     }
     if (_debug) {
         JNI(DeleteWeakGlobalRef, _debug);
+        _debug = NULL;
     }
     if (_info) {
         JNI(DeleteWeakGlobalRef, _info);
+        _info = NULL;
     }
     if (_warn) {
         JNI(DeleteWeakGlobalRef, _warn);
+        _warn = NULL;
     }
     if (_error) {
         JNI(DeleteWeakGlobalRef, _error);
+        _error = NULL;
     }
     if (_logger) {
         JNI(DeleteGlobalRef, _logger);
+        _logger = NULL;
     }
     if (_log_pattern) {
         JNI(DeleteGlobalRef, _log_pattern);
+        _log_pattern = NULL;
     }
+    ATOMIC_CLEAR(&_draining);
 
     // actually not needed, these are virtual so don't store the class
     java_meth_destroy(env, &_log_meth);
     java_meth_destroy(env, &_is_loggable);
 }
 
-void java_log(DDWAF_LOG_LEVEL level, const char *function, const char *file,
-              int line, jthrowable throwable, const char *fmt, ...)
+void java_log(struct log_site *site, DDWAF_LOG_LEVEL level,
+              const char *function, const char *file, int line,
+              jthrowable throwable, const char *fmt, ...)
 {
     if (!log_level_enabled(level)) {
         // don't even create the Java String if we won't log it anyway
         return;
     }
 
-    char *message = NULL;
+    uint64_t suppressed = 0;
+    if (site && !_log_site_acquire(site, &suppressed)) {
+        return;
+    }
+
     va_list ap;
+    if (!throwable && _async) {
+        uint64_t pos;
+        struct log_record *rec = _claim_record(&pos);
+        if (!rec) {
+            return;
+        }
+        rec->level = level;
+        rec->line = line;
+        _copy_truncated(rec->function, sizeof(rec->function), function,
+                        strlen(function));
+        file += file_strip_idx;
+        _copy_truncated(rec->file, sizeof(rec->file), file, strlen(file));
+        va_start(ap, fmt);
+        int len = vsnprintf(rec->message, sizeof(rec->message), fmt, ap);
+        va_end(ap);
+        if (len < 0) {
+            rec->message[0] = '\0';
+            len = 0;
+        }
+        if (suppressed && (size_t) len < sizeof(rec->message)) {
+            int suffix_len = snprintf(rec->message + len,
+                                      sizeof(rec->message) - (size_t) len,
+                                      LOG_SUPPRESSED_FMT, suppressed);
+            len += suffix_len > 0 ? suffix_len : 0;
+        }
+        if ((size_t) len >= sizeof(rec->message)) {
+            memcpy(rec->message + sizeof(rec->message) -
+                           sizeof(LOG_TRUNCATED_MARK),
+                   LOG_TRUNCATED_MARK, sizeof(LOG_TRUNCATED_MARK));
+        }
+        ATOMIC_STORE_REL_U64(&rec->seq, pos + 1);
+        return;
+    }
+
+    char *message = NULL;
     va_start(ap, fmt);
     int message_len = vasprintf(&message, fmt, ap);
     va_end(ap);
@@ -275,6 +382,16 @@ void java_log(DDWAF_LOG_LEVEL level, const char *function, const char *file,
     if (!message) {
         return;
     }
+    if (suppressed) {
+        char *with_suffix = NULL;
+        int len = asprintf(&with_suffix, "%s" LOG_SUPPRESSED_FMT, message,
+                           suppressed);
+        if (len >= 0) {
+            free(message);
+            message = with_suffix;
+            message_len = len;
+        }
+    }
     _waf_logging_c_throwable(level, function, file + file_strip_idx, line,
                              message, (uint64_t) message_len, throwable);
     free(message);
@@ -321,6 +438,23 @@ static void _waf_logging_c(DDWAF_LOG_LEVEL level, const char *function,
                            const char *file, unsigned line, const char *message,
                            uint64_t message_len)
 {
+    if (_async) {
+        uint64_t pos;
+        struct log_record *rec = _claim_record(&pos);
+        if (!rec) {
+            return;
+        }
+        rec->level = level;
+        rec->line = (int) line;
+        _copy_truncated(rec->function, sizeof(rec->function), function,
+                        strlen(function));
+        _copy_truncated(rec->file, sizeof(rec->file), file, strlen(file));
+        _copy_truncated(rec->message, sizeof(rec->message), message,
+                        (size_t) message_len);
+        ATOMIC_STORE_REL_U64(&rec->seq, pos + 1);
+        return;
+    }
+
     _waf_logging_c_throwable(level, function, file, (int) line, message,
                              message_len, NULL);
 }
@@ -337,6 +471,17 @@ static void _waf_logging_c_throwable(DDWAF_LOG_LEVEL level,
         return;
     }
 
+    _log_to_java(env, level, function, file, line, message, throwable);
+
+    if (attached) {
+        _detach_vm();
+    }
+}
+
+static void _log_to_java(JNIEnv *env, DDWAF_LOG_LEVEL level,
+                         const char *function, const char *file, int line,
+                         const char *message, jthrowable throwable)
+{
     jthrowable prev_thr = JNI(ExceptionOccurred);
     if (prev_thr) {
         JNI(ExceptionClear);
@@ -415,10 +560,179 @@ error:
         JNI(Throw, prev_thr);
         JNI(DeleteLocalRef, prev_thr);
     }
+}
+
+// NULL if the ring is full
+static struct log_record *_claim_record(uint64_t *pos_p)
+{
+    uint64_t pos = ATOMIC_LOAD_ACQ_U64(&_enqueue_pos);
+    for (;;) {
+        struct log_record *rec = &_ring[pos & (LOG_RING_SIZE - 1)];
+        int64_t dif = (int64_t) (ATOMIC_LOAD_ACQ_U64(&rec->seq) - pos);
+        if (dif == 0) {
+            if (ATOMIC_CAS_U64(&_enqueue_pos, pos, pos + 1)) {
+                *pos_p = pos;
+                return rec;
+            }
+        } else if (dif < 0) { // not yet consumed
+            ATOMIC_INC_U64(&_dropped);
+            return NULL;
+        }
+        pos = ATOMIC_LOAD_ACQ_U64(&_enqueue_pos);
+    }
+}
 
-    if (attached) {
-        _detach_vm();
+static int64_t _monotonic_ms(void)
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// false if the message should be suppressed. Otherwise, suppressed gets the
+// number of messages suppressed since the last one let through. Concurrent
+// callers don't wait for each other: the losers are suppressed
+static bool _log_site_acquire(struct log_site *site, uint64_t *suppressed)
+{
+    if (!COMPARE_AND_SWAP(&site->busy, false, true)) {
+        ATOMIC_INC_U64(&site->suppressed);
+        return false;
+    }
+
+    int64_t now_ms = _monotonic_ms();
+    if (site->last_refill_ms == 0) {
+        site->tokens = LOG_RATE_BURST;
+        site->last_refill_ms = now_ms;
+    } else {
+        int64_t refills = (now_ms - site->last_refill_ms) / LOG_RATE_REFILL_MS;
+        if (refills > 0) {
+            if (refills >= (int64_t) (LOG_RATE_BURST - site->tokens)) {
+                site->tokens = LOG_RATE_BURST;
+                site->last_refill_ms = now_ms;
+            } else {
+                site->tokens += (uint32_t) refills;
+                site->last_refill_ms += refills * LOG_RATE_REFILL_MS;
+            }
+        }
+    }
+
+    bool ret = site->tokens > 0;
+    if (ret) {
+        site->tokens--;
+        *suppressed = ATOMIC_EXCHANGE_U64(&site->suppressed, 0);
+    } else {
+        ATOMIC_INC_U64(&site->suppressed);
+    }
+    ATOMIC_CLEAR(&site->busy);
+    return ret;
+}
+
+// always NUL-terminates dst; a truncated string ends in LOG_TRUNCATED_MARK
+static void _copy_truncated(char *dst, size_t dst_size, const char *src,
+                            size_t src_len)
+{
+    if (src_len < dst_size) {
+        memcpy(dst, src, src_len);
+        dst[src_len] = '\0';
+        return;
+    }
+    size_t keep = dst_size - sizeof(LOG_TRUNCATED_MARK);
+    memcpy(dst, src, keep);
+    memcpy(dst + keep, LOG_TRUNCATED_MARK, sizeof(LOG_TRUNCATED_MARK));
+}
+
+// logs up to max records on the calling thread; requires _draining to be held
+static int _drain_records(JNIEnv *env, int max)
+{
+    int count = 0;
+    while (count < max) {
+        struct log_record *rec = &_ring[_dequeue_pos & (LOG_RING_SIZE - 1)];
+        if (ATOMIC_LOAD_ACQ_U64(&rec->seq) != _dequeue_pos + 1) {
+            break; // empty, or the next record is still being written
+        }
+        _log_to_java(env, rec->level, rec->function, rec->file, rec->line,
+                     rec->message, NULL);
+        ATOMIC_STORE_REL_U64(&rec->seq, _dequeue_pos + LOG_RING_SIZE);
+        _dequeue_pos++;
+        count++;
+    }
+    return count;
+}
+
+/*
+ * Class:     com_datadog_ddwaf_NativeLogDrainer
+ * Method:    startAsync
+ * Signature: ()Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_NativeLogDrainer_startAsync(JNIEnv *env, jclass clazz)
+{
+    UNUSED(env);
+    UNUSED(clazz);
+
+    if (!_logger) {
+        return JNI_FALSE;
+    }
+    _async = true;
+    return JNI_TRUE;
+}
+
+/*
+ * Class:     com_datadog_ddwaf_NativeLogDrainer
+ * Method:    drain
+ * Signature: ()I
+ */
+JNIEXPORT jint JNICALL Java_com_datadog_ddwaf_NativeLogDrainer_drain(
+        JNIEnv *env, jclass clazz)
+{
+    UNUSED(clazz);
+
+    if (!COMPARE_AND_SWAP(&_draining, false, true)) {
+        return 0; // being drained on shutdown
+    }
+    jint ret = _logger ? _drain_records(env, LOG_DRAIN_BATCH) : -1;
+    ATOMIC_CLEAR(&_draining);
+    return ret;
+}
+
+/*
+ * Class:     com_datadog_ddwaf_NativeLogDrainer
+ * Method:    getDroppedRecords
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_datadog_ddwaf_NativeLogDrainer_getDroppedRecords(JNIEnv *env,
+                                                          jclass clazz)
+{
+    UNUSED(env);
+    UNUSED(clazz);
+
+    return (jlong) ATOMIC_LOAD_ACQ_U64(&_dropped);
+}
+
+/*
+ * Class:     com_datadog_ddwaf_NativeLogDrainer
+ * Method:    logRecords
+ * Signature: (Ljava/lang/String;I)V
+ */
+JNIEXPORT void JNICALL Java_com_datadog_ddwaf_NativeLogDrainer_logRecords(
+        JNIEnv *env, jclass clazz, jstring message, jint count)
+{
+    UNUSED(clazz);
+
+    size_t len;
+    char *msg = java_to_utf8_checked(env, message, &len);
+    if (!msg) {
+        return;
+    }
+    // through the libddwaf callback, so no rate limiting
+    for (jint i = 0; i < count; i++) {
+        _waf_logging_c(DDWAF_LOG_DEBUG, __FUNCTION__, __FILE__ + file_strip_idx,
+                       __LINE__, msg, len);
     }
+    free(msg);
 }
 
 static JNIEnv *_attach_vm(bool *attached)
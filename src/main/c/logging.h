@@ -12,6 +12,8 @@
 #include <jni.h>
 #include "common.h"
 #include <ddwaf.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 extern DDWAF_LOG_LEVEL min_level;
 
@@ -25,13 +27,35 @@ void _java_wrap_exc_relay(JNIEnv *env, const char *format, const char *file,
                           const char *function, int line, ...)
         __attribute__((format(printf, 2, 6)));
 
+/* Each JAVA_LOG call site is rate limited by a token bucket: a burst of
+ * LOG_RATE_BURST messages, then one per LOG_RATE_REFILL_MS. The next message
+ * let through reports how many were suppressed. */
+#define LOG_RATE_BURST 10
+#define LOG_RATE_REFILL_MS 1000
+struct log_site {
+    bool busy;
+    uint32_t tokens;
+    int64_t last_refill_ms; // 0 before the first message
+    uint64_t suppressed;
+};
+
 #define JAVA_LOG(level, fmt, ...)                                              \
-    java_log(level, __FUNCTION__, __FILE__, __LINE__, NULL, fmt, ##__VA_ARGS__)
+    do {                                                                       \
+        static struct log_site _log_site;                                      \
+        java_log(&_log_site, level, __FUNCTION__, __FILE__, __LINE__, NULL,    \
+                 fmt, ##__VA_ARGS__);                                          \
+    } while (0)
 #define JAVA_LOG_THR(level, thr, fmt, ...)                                     \
-    java_log(level, __FUNCTION__, __FILE__, __LINE__, thr, fmt, ##__VA_ARGS__)
-void java_log(DDWAF_LOG_LEVEL level, const char *function, const char *file,
-              int line, jthrowable throwable, const char *fmt, ...)
-        __attribute__((format(printf, 6, 7)));
+    do {                                                                       \
+        static struct log_site _log_site;                                      \
+        java_log(&_log_site, level, __FUNCTION__, __FILE__, __LINE__, thr,     \
+                 fmt, ##__VA_ARGS__);                                          \
+    } while (0)
+/* site can be NULL (no rate limiting) */
+void java_log(struct log_site *site, DDWAF_LOG_LEVEL level,
+              const char *function, const char *file, int line,
+              jthrowable throwable, const char *fmt, ...)
+        __attribute__((format(printf, 7, 8)));
 inline bool log_level_enabled(DDWAF_LOG_LEVEL level)
 {
     return level >= min_level;
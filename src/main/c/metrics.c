@@ -8,13 +8,31 @@
 
 #include <ddwaf.h>
 #include <jni.h>
+#include <stdint.h>
+#include "atomics.h"
+#include "common.h"
 #include "logging.h"
 #include "metrics.h"
 
-static jfieldID _total_ddwaf_run_time_ns_field;
-static jfieldID _total_run_time_ns_field;
-static jclass _atomic_long_cls;
-static jmethodID _add_and_get;
+// layout of WafMetrics.nativeCounters: METRICS_STRIPES stripes, one cache
+// line each. Every thread adds to its own stripe (modulo the stripe count), so
+// threads sharing a WafMetrics rarely write to the same cache line. Java sums
+// the stripes when reading
+#define METRICS_STRIPES 16
+#define METRICS_STRIPE_SIZE 64
+#define METRICS_RUN_TIME_NS 0       // index of the counter in the stripe
+#define METRICS_DDWAF_RUN_TIME_NS 1 // idem
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+static jmethodID _native_counters_meth;
+static jfieldID _native_counters_address_field;
+static uint64_t _next_stripe;
+static THREAD_LOCAL size_t _stripe_idx_plus_one; // 0 until assigned
 
 bool metrics_init(JNIEnv *env)
 {
@@ -25,27 +43,15 @@ bool metrics_init(JNIEnv *env)
 
     bool ret = false;
 
-    _total_ddwaf_run_time_ns_field =
-            JNI(GetFieldID, pwaf_metrics_cls, "totalDdwafRunTimeNs",
-                "Ljava/util/concurrent/atomic/AtomicLong;");
-    if (!_total_ddwaf_run_time_ns_field) {
+    _native_counters_meth = JNI(GetMethodID, pwaf_metrics_cls, "nativeCounters",
+                                "()Ljava/nio/ByteBuffer;");
+    if (!_native_counters_meth) {
         goto error;
     }
 
-    _total_run_time_ns_field =
-            JNI(GetFieldID, pwaf_metrics_cls, "totalRunTimeNs",
-                "Ljava/util/concurrent/atomic/AtomicLong;");
-    if (!_total_run_time_ns_field) {
-        goto error;
-    }
-
-    _atomic_long_cls = JNI(FindClass, "java/util/concurrent/atomic/AtomicLong");
-    if (!_atomic_long_cls) {
-        goto error;
-    }
-
-    _add_and_get = JNI(GetMethodID, _atomic_long_cls, "addAndGet", "(J)J");
-    if (!_add_and_get) {
+    _native_counters_address_field =
+            JNI(GetFieldID, pwaf_metrics_cls, "nativeCountersAddress", "J");
+    if (!_native_counters_address_field) {
         goto error;
     }
 
@@ -55,43 +61,60 @@ error:
     return ret;
 }
 
-void metrics_update_checked(JNIEnv *env, jobject metrics_obj, jlong run_time_ns,
-                            jlong ddwaf_run_time_ns)
+static uint8_t *_get_counters_checked(JNIEnv *env, jobject metrics_obj)
 {
-    jobject rt_obj = NULL;
-    jobject ddrt_obj = NULL;
-
-    if (JNI(MonitorEnter, metrics_obj) < 0) {
-        JNI(ThrowNew, jcls_rte, "Error entering monitor on the metrics object");
-        goto error;
+    jlong address =
+            JNI(GetLongField, metrics_obj, _native_counters_address_field);
+    if (address) {
+        return (uint8_t *) (intptr_t) address;
     }
 
-    if (run_time_ns > 0) {
-        rt_obj = JNI(GetObjectField, metrics_obj, _total_run_time_ns_field);
-        if (JNI(ExceptionCheck)) {
-            goto error;
-        }
-        JNI(CallLongMethod, rt_obj, _add_and_get, run_time_ns);
-        if (JNI(ExceptionCheck)) {
-            goto error;
+    // first use of this WafMetrics: have Java allocate the counters. It does
+    // so only once, so racing threads store the same value
+    jobject buffer = JNI(CallObjectMethod, metrics_obj, _native_counters_meth);
+    if (!buffer) {
+        if (!JNI(ExceptionCheck)) {
+            JNI(ThrowNew, jcls_rte, "WafMetrics has no native counters");
         }
+        return NULL;
+    }
+    void *counters = JNI(GetDirectBufferAddress, buffer);
+    jlong capacity = JNI(GetDirectBufferCapacity, buffer);
+    JNI(DeleteLocalRef, buffer);
+    if (!counters ||
+        capacity < (jlong) (METRICS_STRIPES * METRICS_STRIPE_SIZE)) {
+        JNI(ThrowNew, jcls_rte, "Invalid native counters buffer in WafMetrics");
+        return NULL;
     }
+    JNI(SetLongField, metrics_obj, _native_counters_address_field,
+        (jlong) (intptr_t) counters);
+    return counters;
+}
 
-    ddrt_obj = JNI(GetObjectField, metrics_obj, _total_ddwaf_run_time_ns_field);
-    if (JNI(ExceptionCheck)) {
-        goto error;
+static uint64_t *_stripe(uint8_t *counters)
+{
+    if (!_stripe_idx_plus_one) {
+        _stripe_idx_plus_one =
+                (size_t) (ATOMIC_INC_U64(&_next_stripe) % METRICS_STRIPES) + 1;
     }
-    JNI(CallLongMethod, ddrt_obj, _add_and_get, ddwaf_run_time_ns);
-    if (JNI(ExceptionCheck)) {
-        goto error;
+    return (uint64_t *) (void *) (counters + (_stripe_idx_plus_one - 1) *
+                                                     METRICS_STRIPE_SIZE);
+}
+
+void metrics_update_checked(JNIEnv *env, jobject metrics_obj, jlong run_time_ns,
+                            jlong ddwaf_run_time_ns)
+{
+    uint8_t *counters = _get_counters_checked(env, metrics_obj);
+    if (!counters) {
+        return;
     }
 
-error:
-    if (rt_obj) {
-        JNI(DeleteLocalRef, rt_obj);
+    uint64_t *stripe = _stripe(counters);
+    if (run_time_ns > 0) {
+        ATOMIC_ADD_U64(&stripe[METRICS_RUN_TIME_NS], (uint64_t) run_time_ns);
     }
-    if (ddrt_obj) {
-        JNI(DeleteLocalRef, ddrt_obj);
+    if (ddwaf_run_time_ns > 0) {
+        ATOMIC_ADD_U64(&stripe[METRICS_DDWAF_RUN_TIME_NS],
+                       (uint64_t) ddwaf_run_time_ns);
     }
-    JNI(MonitorExit, metrics_obj);
 }
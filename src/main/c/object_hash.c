@@ -0,0 +1,232 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#include "object_hash.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HASH_MUL UINT64_C(0x9E3779B97F4A7C15)
+
+static inline uint64_t _mix(uint64_t h, uint64_t v)
+{
+    h = (h ^ v) * HASH_MUL;
+    return h ^ (h >> 29);
+}
+
+static uint64_t _hash_bytes(uint64_t h, const char *s, size_t len)
+{
+    h = _mix(h, len);
+    if (!s) {
+        return h;
+    }
+    for (; len >= 8; s += 8, len -= 8) {
+        uint64_t v;
+        memcpy(&v, s, 8);
+        h = _mix(h, v);
+    }
+    if (len) {
+        uint64_t v = 0;
+        memcpy(&v, s, len);
+        h = _mix(h, v);
+    }
+    return h;
+}
+
+// covers everything the json writer outputs, and nothing else
+static bool _hash(const ddwaf_object *obj, uint64_t *h, int depth,
+                  int max_depth)
+{
+    if (depth > max_depth) {
+        return false;
+    }
+
+    *h = _mix(*h, (uint64_t) obj->type);
+    switch (obj->type) {
+    case DDWAF_OBJ_SIGNED:
+    case DDWAF_OBJ_UNSIGNED:
+        *h = _mix(*h, obj->uintValue);
+        break;
+    case DDWAF_OBJ_FLOAT: {
+        uint64_t bits;
+        memcpy(&bits, &obj->f64, sizeof bits);
+        *h = _mix(*h, bits);
+        break;
+    }
+    case DDWAF_OBJ_BOOL:
+        *h = _mix(*h, obj->boolean);
+        break;
+    case DDWAF_OBJ_STRING:
+        *h = _hash_bytes(*h, obj->stringValue, obj->nbEntries);
+        break;
+    case DDWAF_OBJ_ARRAY:
+    case DDWAF_OBJ_MAP: {
+        bool is_map = obj->type == DDWAF_OBJ_MAP;
+        *h = _mix(*h, obj->nbEntries);
+        for (uint64_t i = 0; i < obj->nbEntries; i++) {
+            const ddwaf_object *o = &obj->array[i];
+            if (is_map) {
+                *h = _hash_bytes(*h, o->parameterName, o->parameterNameLength);
+            }
+            if (!_hash(o, h, depth + 1, max_depth)) {
+                return false;
+            }
+        }
+        break;
+    }
+    case DDWAF_OBJ_NULL:
+    case DDWAF_OBJ_INVALID:
+    default:
+        break;
+    }
+    return true;
+}
+
+uint64_t object_hash(const ddwaf_object *obj, uint64_t seed, int max_depth)
+{
+    uint64_t h = seed;
+    if (!_hash(obj, &h, 0, max_depth)) {
+        return 0;
+    }
+    // murmur3 finalizer
+    h ^= h >> 33;
+    h *= UINT64_C(0xFF51AFD7ED558CCD);
+    h ^= h >> 33;
+    h *= UINT64_C(0xC4CEB9FE1A85EC53);
+    h ^= h >> 33;
+    return h ? h : 1;
+}
+
+// Appends to a canonical encoding, or compares with one
+struct _key_writer {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    const uint8_t *expected; // comparing rather than appending if not NULL
+    size_t expected_len;
+    bool failed; // out of memory, or a difference
+};
+
+static void _key_put(struct _key_writer *w, const void *data, size_t len)
+{
+    if (w->failed) {
+        return;
+    }
+    if (w->expected) {
+        if (len > w->expected_len - w->len ||
+            memcmp(w->expected + w->len, data, len) != 0) {
+            w->failed = true;
+            return;
+        }
+        w->len += len;
+        return;
+    }
+    if (len > w->cap - w->len) {
+        size_t new_cap = w->cap ? w->cap : 256;
+        while (new_cap - w->len < len) {
+            if (new_cap > SIZE_MAX / 2) {
+                w->failed = true;
+                return;
+            }
+            new_cap *= 2;
+        }
+        uint8_t *new_buf = realloc(w->buf, new_cap);
+        if (!new_buf) {
+            w->failed = true;
+            return;
+        }
+        w->buf = new_buf;
+        w->cap = new_cap;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static void _key_u64(struct _key_writer *w, uint64_t v)
+{
+    _key_put(w, &v, sizeof v);
+}
+
+static void _key_bytes(struct _key_writer *w, const char *s, uint64_t len)
+{
+    if (!s) {
+        len = 0;
+    }
+    _key_u64(w, len);
+    if (len) {
+        _key_put(w, s, (size_t) len);
+    }
+}
+
+// the same fields as _hash, each with its length, so that the encoding can't
+// be ambiguous
+static bool _key(const ddwaf_object *obj, struct _key_writer *w, int depth,
+                 int max_depth)
+{
+    if (depth > max_depth) {
+        return false;
+    }
+
+    _key_u64(w, (uint64_t) obj->type);
+    switch (obj->type) {
+    case DDWAF_OBJ_SIGNED:
+    case DDWAF_OBJ_UNSIGNED:
+        _key_u64(w, obj->uintValue);
+        break;
+    case DDWAF_OBJ_FLOAT: {
+        uint64_t bits;
+        memcpy(&bits, &obj->f64, sizeof bits);
+        _key_u64(w, bits);
+        break;
+    }
+    case DDWAF_OBJ_BOOL:
+        _key_u64(w, obj->boolean);
+        break;
+    case DDWAF_OBJ_STRING:
+        _key_bytes(w, obj->stringValue, obj->nbEntries);
+        break;
+    case DDWAF_OBJ_ARRAY:
+    case DDWAF_OBJ_MAP: {
+        bool is_map = obj->type == DDWAF_OBJ_MAP;
+        _key_u64(w, obj->nbEntries);
+        for (uint64_t i = 0; i < obj->nbEntries && !w->failed; i++) {
+            const ddwaf_object *o = &obj->array[i];
+            if (is_map) {
+                _key_bytes(w, o->parameterName, o->parameterNameLength);
+            }
+            if (!_key(o, w, depth + 1, max_depth)) {
+                return false;
+            }
+        }
+        break;
+    }
+    case DDWAF_OBJ_NULL:
+    case DDWAF_OBJ_INVALID:
+    default:
+        break;
+    }
+    return true;
+}
+
+uint8_t *object_key(const ddwaf_object *obj, int max_depth, size_t *len)
+{
+    struct _key_writer w = {0};
+    if (!_key(obj, &w, 0, max_depth) || w.failed) {
+        free(w.buf);
+        return NULL;
+    }
+    *len = w.len;
+    return w.buf;
+}
+
+bool object_key_matches(const ddwaf_object *obj, int max_depth,
+                        const uint8_t *key, size_t len)
+{
+    struct _key_writer w = {.expected = key, .expected_len = len};
+    return _key(obj, &w, 0, max_depth) && !w.failed && w.len == len;
+}
@@ -0,0 +1,30 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+#include <ddwaf.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Non-cryptographic hash of a ddwaf_object tree: the types and values, the
+// keys of map entries and the order of elements, but not the key of the root
+// itself. Different seeds give independent hashes. Never 0, except when the
+// tree is nested deeper than max_depth.
+uint64_t object_hash(const ddwaf_object *obj, uint64_t seed, int max_depth);
+
+// The key of a tree: an encoding of everything object_hash covers, so that
+// trees with the same key are the same for it, to be compared on hash hits.
+// NULL if the tree is nested deeper than max_depth or out of memory; to be
+// freed by the caller
+uint8_t *object_key(const ddwaf_object *obj, int max_depth, size_t *len);
+
+// whether the key of obj is the len bytes at key, without encoding it
+bool object_key_matches(const ddwaf_object *obj, int max_depth,
+                        const uint8_t *key, size_t len);
@@ -0,0 +1,184 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#include "object_image.h"
+#include "common.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORD_HEADER_SIZE 24
+#define NO_ROOT UINT32_MAX
+#define MAX_DEPTH 64
+#define ALIGN8(x) (((x) + 7) & ~(size_t) 7)
+
+struct sizes {
+    size_t objects;
+    size_t strings;
+    size_t fixups;
+};
+
+struct writer {
+    uint8_t *image;
+    uint32_t *fixups;
+    size_t next_object;
+    size_t next_fixup;
+    size_t next_string; // offset in the image
+};
+
+static bool _measure(const ddwaf_object *obj, struct sizes *sizes, int depth)
+{
+    if (depth > MAX_DEPTH) {
+        return false;
+    }
+    if (obj->parameterName) {
+        sizes->strings += obj->parameterNameLength + 1;
+        sizes->fixups++;
+    }
+    if (obj->type == DDWAF_OBJ_STRING && obj->stringValue) {
+        sizes->strings += obj->nbEntries + 1;
+        sizes->fixups++;
+    } else if ((obj->type == DDWAF_OBJ_ARRAY || obj->type == DDWAF_OBJ_MAP) &&
+               obj->nbEntries > 0) {
+        sizes->objects += obj->nbEntries;
+        sizes->fixups++;
+        for (uint64_t i = 0; i < obj->nbEntries; i++) {
+            if (!_measure(&obj->array[i], sizes, depth + 1)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static uint64_t _put_string(struct writer *w, const char *str, uint64_t len,
+                            size_t field_off)
+{
+    size_t off = w->next_string;
+    memcpy(w->image + off, str, len);
+    w->image[off + len] = '\0';
+    w->next_string += len + 1;
+    w->fixups[w->next_fixup++] = (uint32_t) field_off;
+    return off;
+}
+
+static void _put_ptr(uint8_t *field, uint64_t off)
+{
+    memcpy(field, &off, sizeof off);
+}
+
+// writes a copy of src into the object at index dst_idx
+static void _write(struct writer *w, size_t dst_idx, const ddwaf_object *src)
+{
+    size_t dst_off = dst_idx * sizeof(ddwaf_object);
+    uint8_t *dst = w->image + dst_off;
+    memcpy(dst, src, sizeof *src);
+
+    if (src->parameterName) {
+        size_t field = dst_off + offsetof(ddwaf_object, parameterName);
+        _put_ptr(w->image + field,
+                 _put_string(w, src->parameterName, src->parameterNameLength,
+                             field));
+    }
+    if (src->type == DDWAF_OBJ_STRING && src->stringValue) {
+        size_t field = dst_off + offsetof(ddwaf_object, stringValue);
+        _put_ptr(w->image + field, _put_string(w, src->stringValue,
+                                               src->nbEntries, field));
+    } else if ((src->type == DDWAF_OBJ_ARRAY || src->type == DDWAF_OBJ_MAP) &&
+               src->nbEntries > 0) {
+        size_t field = dst_off + offsetof(ddwaf_object, array);
+        size_t first = w->next_object;
+        w->next_object += src->nbEntries;
+        _put_ptr(w->image + field, first * sizeof(ddwaf_object));
+        w->fixups[w->next_fixup++] = (uint32_t) field;
+        for (uint64_t i = 0; i < src->nbEntries; i++) {
+            _write(w, first + i, &src->array[i]);
+        }
+    }
+}
+
+enum object_image_status object_image_encode(const ddwaf_object *first,
+                                             const ddwaf_object *second,
+                                             uint8_t **out, size_t *size)
+{
+    struct sizes sizes = {0};
+    sizes.objects = (first ? 1 : 0) + (second ? 1 : 0);
+    if ((first && !_measure(first, &sizes, 0)) ||
+        (second && !_measure(second, &sizes, 0))) {
+        return OBJECT_IMAGE_TOO_DEEP;
+    }
+
+    size_t objects_size = sizes.objects * sizeof(ddwaf_object);
+    size_t image_size = ALIGN8(objects_size + sizes.strings);
+    size_t fixups_size = ALIGN8(sizes.fixups * sizeof(uint32_t));
+    size_t record_size = RECORD_HEADER_SIZE + fixups_size + image_size;
+    if (record_size > INT32_MAX) {
+        return OBJECT_IMAGE_TOO_LARGE;
+    }
+
+    uint8_t *record = calloc(1, record_size);
+    if (!record) {
+        return OBJECT_IMAGE_NO_MEMORY;
+    }
+
+    struct writer w = {
+            .image = record + RECORD_HEADER_SIZE + fixups_size,
+            .fixups = (uint32_t *) (void *) (record + RECORD_HEADER_SIZE),
+            .next_string = objects_size,
+    };
+    uint32_t header[6] = {(uint32_t) record_size, (uint32_t) sizes.fixups,
+                          NO_ROOT, NO_ROOT, (uint32_t) image_size, 0};
+    if (first) {
+        header[2] = (uint32_t) (w.next_object * sizeof(ddwaf_object));
+        w.next_object++;
+    }
+    if (second) {
+        header[3] = (uint32_t) (w.next_object * sizeof(ddwaf_object));
+        w.next_object++;
+    }
+    if (first) {
+        _write(&w, header[2] / sizeof(ddwaf_object), first);
+    }
+    if (second) {
+        _write(&w, header[3] / sizeof(ddwaf_object), second);
+    }
+    memcpy(record, header, sizeof header);
+
+    *out = record;
+    *size = record_size;
+    return OBJECT_IMAGE_OK;
+}
+
+jbyteArray object_image_encode_java_checked(JNIEnv *env,
+                                            const ddwaf_object *first,
+                                            const ddwaf_object *second)
+{
+    uint8_t *record = NULL;
+    size_t size = 0;
+    switch (object_image_encode(first, second, &record, &size)) {
+    case OBJECT_IMAGE_OK:
+        break;
+    case OBJECT_IMAGE_TOO_DEEP:
+        JNI(ThrowNew, jcls_iae, "Object nested too deeply");
+        return NULL;
+    case OBJECT_IMAGE_TOO_LARGE:
+        JNI(ThrowNew, jcls_iae, "Object too large to be recorded");
+        return NULL;
+    case OBJECT_IMAGE_NO_MEMORY:
+    default:
+        JNI(ThrowNew, jcls_rte, "Could not allocate the record");
+        return NULL;
+    }
+
+    jbyteArray ret = JNI(NewByteArray, (jsize) size);
+    if (ret) {
+        JNI(SetByteArrayRegion, ret, 0, (jsize) size, (const jbyte *) record);
+    }
+    free(record);
+    return ret;
+}
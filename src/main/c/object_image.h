@@ -0,0 +1,49 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+#include <ddwaf.h>
+#include <jni.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A record is a relocatable copy of up to two ddwaf_object trees, in the
+// layout ByteBufferSerializer produces. All fields in native byte order:
+//
+//   u32 record size, including this header and the padding (multiple of 8)
+//   u32 number of fixups
+//   u32 offset of the first root in the image, or UINT32_MAX
+//   u32 offset of the second root in the image, or UINT32_MAX
+//   u32 image size
+//   u32 reserved (0)
+//   u32 fixups[]: offsets in the image of pointer fields, padded to 8 bytes
+//   image: the ddwaf_objects (the roots, then every container's elements
+//          contiguously), then the NUL-terminated strings
+//
+// Pointer fields hold offsets from the start of the image; the reader adds
+// the address of the image to each of the fields listed in the fixups
+// (see InputRecording.java). NULL pointers are stored as 0 and not listed.
+
+enum object_image_status {
+    OBJECT_IMAGE_OK,
+    OBJECT_IMAGE_TOO_DEEP,  // more than 64 levels
+    OBJECT_IMAGE_TOO_LARGE, // 2 GiB or more
+    OBJECT_IMAGE_NO_MEMORY,
+};
+
+// Encodes the trees first and second (either can be NULL) into a record,
+// returned in *out (to be freed) with its size in *size.
+enum object_image_status object_image_encode(const ddwaf_object *first,
+                                             const ddwaf_object *second,
+                                             uint8_t **out, size_t *size);
+
+// the record as a byte[], or NULL with an exception pending
+jbyteArray object_image_encode_java_checked(JNIEnv *env,
+                                            const ddwaf_object *first,
+                                            const ddwaf_object *second);
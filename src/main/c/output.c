@@ -13,45 +13,40 @@
 #include <string.h>
 #include <inttypes.h>
 #include <limits.h>
-#include <zlib.h>
 
 #include "common.h"
 #include "java_call.h"
 #include "jni.h"
 #include "json.h"
 #include "utf16_utf8.h"
+#include "utf_transcode.h"
 #include "base64.h"
+#include "gzip.h"
+#include "schema_cache.h"
 #include "logging.h"
 
 #define LSTR(x) "" x, sizeof(x) - 1
 #define MAX_JINT ((jint) 0x7FFFFFFF)
 
 static struct j_method _rsi_init;
+static struct j_method _rsi_summary_init;
 static struct j_method _sect_info_err_init;
 static struct j_method _sect_info_normal_init;
+static struct j_method _sect_info_summary_init;
 static struct j_method _array_list_init;
 static struct j_method _array_list_add;
 static struct j_method _linked_hm_init;
 static struct j_method _map_put;
-
-// Add numeric wrapper class references
-static jclass long_cls = NULL;
-static jclass double_cls = NULL;
-static jclass boolean_cls = NULL;
-
-// Add numeric wrapper constructor methods
-static struct j_method long_valueOf;
-static struct j_method double_valueOf;
-static struct j_method boolean_valueOf;
+static struct j_method _byte_buffer_allocate_direct;
 
 static jstring _map_get_string_checked(JNIEnv *env, const ddwaf_object *obj,
                                        const char *str, size_t str_len);
 static jobject _convert_section_checked(JNIEnv *env, const ddwaf_object *root,
-                                        const char *sect_name, size_t sect_len);
+                                        const char *sect_name, size_t sect_len,
+                                        bool summary);
+static jbyteArray _diagnostics_json_checked(JNIEnv *env,
+                                            const ddwaf_object *obj);
 static jobject _convert_strarr_checked(JNIEnv *env, const ddwaf_object *o);
-static struct json_segment *_convert_json(const ddwaf_object *cur_obj,
-                                          int depth,
-                                          struct json_segment *cur_seg);
 
 static bool _is_derivative(const ddwaf_object *entry, const char *prefix)
 {
@@ -62,22 +57,8 @@ static bool _is_derivative(const ddwaf_object *entry, const char *prefix)
     return strncmp(prefix, entry->parameterName, prefix_size) == 0;
 }
 
-static bool _cache_single_class_strong(JNIEnv *env, const char *class_name,
-                                       jclass *out)
-{
-    jclass cls = JNI(FindClass, class_name);
-    if (JNI(ExceptionCheck)) {
-        return false;
-    }
-    *out = JNI(NewGlobalRef, cls);
-    JNI(DeleteLocalRef, cls);
-    if (JNI(ExceptionCheck)) {
-        return false;
-    }
-    return true;
-}
-
-jobject output_convert_diagnostics_checked(JNIEnv *env, const ddwaf_object *obj)
+jobject output_convert_diagnostics_checked(JNIEnv *env, const ddwaf_object *obj,
+                                           bool summary)
 {
     jstring rulesetVersion =
             _map_get_string_checked(env, obj, LSTR("ruleset_version"));
@@ -90,47 +71,66 @@ jobject output_convert_diagnostics_checked(JNIEnv *env, const ddwaf_object *obj)
             rules_override = NULL, exclusions = NULL, ret = NULL,
             exclusion_data = NULL, actions = NULL, processors = NULL,
             scanners = NULL;
+    jbyteArray details = NULL;
 
-    rules = _convert_section_checked(env, obj, LSTR("rules"));
+    rules = _convert_section_checked(env, obj, LSTR("rules"), summary);
     if (JNI(ExceptionCheck)) {
         goto err;
     }
-    custom_rules = _convert_section_checked(env, obj, LSTR("custom_rules"));
+    custom_rules = _convert_section_checked(env, obj, LSTR("custom_rules"),
+                                            summary);
     if (JNI(ExceptionCheck)) {
         goto err;
     }
-    rules_data = _convert_section_checked(env, obj, LSTR("rules_data"));
+    rules_data = _convert_section_checked(env, obj, LSTR("rules_data"),
+                                          summary);
     if (JNI(ExceptionCheck)) {
         goto err;
     }
-    rules_override = _convert_section_checked(env, obj, LSTR("rules_override"));
+    rules_override = _convert_section_checked(env, obj, LSTR("rules_override"),
+                                              summary);
     if (JNI(ExceptionCheck)) {
         goto err;
     }
-    exclusions = _convert_section_checked(env, obj, LSTR("exclusions"));
+    exclusions = _convert_section_checked(env, obj, LSTR("exclusions"),
+                                          summary);
     if (JNI(ExceptionCheck)) {
         goto err;
     }
-    exclusion_data = _convert_section_checked(env, obj, LSTR("exclusion_data"));
+    exclusion_data = _convert_section_checked(env, obj, LSTR("exclusion_data"),
+                                              summary);
     if (JNI(ExceptionCheck)) {
         goto err;
     }
-    actions = _convert_section_checked(env, obj, LSTR("actions"));
+    actions = _convert_section_checked(env, obj, LSTR("actions"), summary);
     if (JNI(ExceptionCheck)) {
         goto err;
     }
-    processors = _convert_section_checked(env, obj, LSTR("processors"));
+    processors = _convert_section_checked(env, obj, LSTR("processors"),
+                                          summary);
     if (JNI(ExceptionCheck)) {
         goto err;
     }
-    scanners = _convert_section_checked(env, obj, LSTR("scanners"));
+    scanners = _convert_section_checked(env, obj, LSTR("scanners"), summary);
     if (JNI(ExceptionCheck)) {
         goto err;
     }
 
-    ret = java_meth_call(env, &_rsi_init, NULL, error, rulesetVersion, rules,
-                         custom_rules, rules_data, rules_override, exclusions,
-                         exclusion_data, actions, processors, scanners);
+    if (summary) {
+        details = _diagnostics_json_checked(env, obj);
+        if (!details) {
+            goto err;
+        }
+        ret = java_meth_call(env, &_rsi_summary_init, NULL, error,
+                             rulesetVersion, rules, custom_rules, rules_data,
+                             rules_override, exclusions, exclusion_data,
+                             actions, processors, scanners, details);
+    } else {
+        ret = java_meth_call(env, &_rsi_init, NULL, error, rulesetVersion,
+                             rules, custom_rules, rules_data, rules_override,
+                             exclusions, exclusion_data, actions, processors,
+                             scanners);
+    }
 
 err:
     if (rulesetVersion) {
@@ -166,6 +166,9 @@ err:
     if (scanners) {
         JNI(DeleteLocalRef, scanners);
     }
+    if (details) {
+        JNI(DeleteLocalRef, details);
+    }
     return ret;
 }
 
@@ -187,6 +190,23 @@ void output_init_checked(JNIEnv *env)
                 JMETHOD_CONSTRUCTOR)) {
         goto err;
     }
+    if (!java_meth_init_checked(
+                env, &_rsi_summary_init, "com/datadog/ddwaf/WafDiagnostics",
+                "<init>",
+                "(Ljava/lang/String;"
+                "Ljava/lang/String;"
+                "Lcom/datadog/ddwaf/WafDiagnostics$SectionInfo;"
+                "Lcom/datadog/ddwaf/WafDiagnostics$SectionInfo;"
+                "Lcom/datadog/ddwaf/WafDiagnostics$SectionInfo;"
+                "Lcom/datadog/ddwaf/WafDiagnostics$SectionInfo;"
+                "Lcom/datadog/ddwaf/WafDiagnostics$SectionInfo;"
+                "Lcom/datadog/ddwaf/WafDiagnostics$SectionInfo;"
+                "Lcom/datadog/ddwaf/WafDiagnostics$SectionInfo;"
+                "Lcom/datadog/ddwaf/WafDiagnostics$SectionInfo;"
+                "Lcom/datadog/ddwaf/WafDiagnostics$SectionInfo;[B)V",
+                JMETHOD_CONSTRUCTOR)) {
+        goto err;
+    }
     if (!java_meth_init_checked(env, &_sect_info_err_init,
                                 "com/datadog/ddwaf/WafDiagnostics$SectionInfo",
                                 "<init>", "(Ljava/lang/String;)V",
@@ -201,6 +221,12 @@ void output_init_checked(JNIEnv *env)
                                 JMETHOD_CONSTRUCTOR)) {
         goto err;
     }
+    if (!java_meth_init_checked(
+                env, &_sect_info_summary_init,
+                "com/datadog/ddwaf/WafDiagnostics$SectionInfo", "<init>",
+                "(IIILjava/util/Map;Ljava/util/Map;)V", JMETHOD_CONSTRUCTOR)) {
+        goto err;
+    }
     if (!java_meth_init_checked(env, &_array_list_init, "java/util/ArrayList",
                                 "<init>", "(I)V", JMETHOD_CONSTRUCTOR)) {
         goto err;
@@ -222,30 +248,9 @@ void output_init_checked(JNIEnv *env)
         goto err;
     }
 
-    // Initialize numeric wrapper classes
-    if (!_cache_single_class_strong(env, "java/lang/Long", &long_cls)) {
-        goto err;
-    }
-    if (!_cache_single_class_strong(env, "java/lang/Double", &double_cls)) {
-        goto err;
-    }
-    if (!_cache_single_class_strong(env, "java/lang/Boolean", &boolean_cls)) {
-        goto err;
-    }
-
-    // Initialize numeric wrapper valueOf methods
-    if (!java_meth_init_checked(env, &long_valueOf, "java/lang/Long", "valueOf",
-                                "(J)Ljava/lang/Long;", JMETHOD_STATIC)) {
-        goto err;
-    }
-    if (!java_meth_init_checked(env, &double_valueOf, "java/lang/Double",
-                                "valueOf", "(D)Ljava/lang/Double;",
-                                JMETHOD_STATIC)) {
-        goto err;
-    }
-    if (!java_meth_init_checked(env, &boolean_valueOf, "java/lang/Boolean",
-                                "valueOf", "(Z)Ljava/lang/Boolean;",
-                                JMETHOD_STATIC)) {
+    if (!java_meth_init_checked(env, &_byte_buffer_allocate_direct,
+                                "java/nio/ByteBuffer", "allocateDirect",
+                                "(I)Ljava/nio/ByteBuffer;", JMETHOD_STATIC)) {
         goto err;
     }
 
@@ -257,31 +262,18 @@ err:
 void output_shutdown(JNIEnv *env)
 {
     java_meth_destroy(env, &_rsi_init);
+    java_meth_destroy(env, &_rsi_summary_init);
     java_meth_destroy(env, &_sect_info_err_init);
     java_meth_destroy(env, &_sect_info_normal_init);
+    java_meth_destroy(env, &_sect_info_summary_init);
     java_meth_destroy(env, &_array_list_init);
     java_meth_destroy(env, &_array_list_add);
     java_meth_destroy(env, &_linked_hm_init);
     java_meth_destroy(env, &_map_put);
+    java_meth_destroy(env, &_byte_buffer_allocate_direct);
 
-    // Clean up numeric wrapper methods
-    java_meth_destroy(env, &long_valueOf);
-    java_meth_destroy(env, &double_valueOf);
-    java_meth_destroy(env, &boolean_valueOf);
-
-    // Clean up numeric wrapper classes
-    if (long_cls) {
-        JNI(DeleteGlobalRef, long_cls);
-        long_cls = NULL;
-    }
-    if (double_cls) {
-        JNI(DeleteGlobalRef, double_cls);
-        double_cls = NULL;
-    }
-    if (boolean_cls) {
-        JNI(DeleteGlobalRef, boolean_cls);
-        boolean_cls = NULL;
-    }
+    gzip_shutdown();
+    schema_cache_shutdown(env);
 }
 
 static const ddwaf_object *_map_get_object_checked(JNIEnv *env,
@@ -443,8 +435,30 @@ err:
     return NULL;
 }
 
+// the number of elements of the array under key str, 0 if there's none
+static jint _map_get_array_size_checked(JNIEnv *env, const ddwaf_object *obj,
+                                        const char *str, size_t str_len)
+{
+    const ddwaf_object *o = _map_get_object_checked(env, obj, str, str_len);
+    if (JNI(ExceptionCheck) || o == NULL) {
+        return 0;
+    }
+    if (o->type != DDWAF_OBJ_ARRAY) {
+        JNI(ThrowNew, jcls_rte, "ddwaf array expected");
+        return 0;
+    }
+    if (o->nbEntries > MAX_JINT) {
+        JNI(ThrowNew, jcls_rte, "too many elements in ddwaf array");
+        return 0;
+    }
+    return (jint) o->nbEntries;
+}
+
+// In summary mode, only the errors and warnings are converted; the lists of
+// ids are replaced by their sizes
 static jobject _convert_section_checked(JNIEnv *env, const ddwaf_object *root,
-                                        const char *sect_name, size_t sect_len)
+                                        const char *sect_name, size_t sect_len,
+                                        bool summary)
 {
     const ddwaf_object *section =
             _map_get_object_checked(env, root, sect_name, sect_len);
@@ -469,6 +483,30 @@ static jobject _convert_section_checked(JNIEnv *env, const ddwaf_object *root,
     jobject loaded = NULL, skipped = NULL, failed = NULL, errors = NULL,
             warnings = NULL, ret = NULL;
 
+    if (summary) {
+        jint num_loaded =
+                _map_get_array_size_checked(env, section, LSTR("loaded"));
+        jint num_skipped =
+                _map_get_array_size_checked(env, section, LSTR("skipped"));
+        jint num_failed =
+                _map_get_array_size_checked(env, section, LSTR("failed"));
+        if (JNI(ExceptionCheck)) {
+            return NULL;
+        }
+        warnings = _map_get_object_errmap_checked(env, section,
+                                                  LSTR("warnings"));
+        if (JNI(ExceptionCheck)) {
+            goto err;
+        }
+        errors = _map_get_object_errmap_checked(env, section, LSTR("errors"));
+        if (JNI(ExceptionCheck)) {
+            goto err;
+        }
+        ret = java_meth_call(env, &_sect_info_summary_init, NULL, num_loaded,
+                             num_skipped, num_failed, warnings, errors);
+        goto err;
+    }
+
     loaded = _map_get_object_strarr_checked(env, section, LSTR("loaded"));
     if (JNI(ExceptionCheck)) {
         goto err;
@@ -513,364 +551,501 @@ err:
     return ret;
 }
 
-struct json_segment *output_convert_json(const ddwaf_object *obj)
+// the whole diagnostics object as UTF-8 JSON, to be parsed back on demand
+static jbyteArray _diagnostics_json_checked(JNIEnv *env,
+                                            const ddwaf_object *obj)
 {
-    struct json_segment *initial_seg = json_seg_new(0);
-    if (!initial_seg) {
+    struct json_buf json;
+    json_buf_init(&json, NULL, 0);
+    if (!json_write_object(&json, obj)) {
+        json_buf_free(&json);
+        JNI(ThrowNew, jcls_rte, "Could not encode diagnostics as JSON");
         return NULL;
     }
-    bool ok = _convert_json(obj, 0, initial_seg) != NULL;
-    if (ok) {
-        return initial_seg;
-    } else {
-        json_seg_free(initial_seg);
+    if (json.len > MAX_JINT) {
+        json_buf_free(&json);
+        JNI(ThrowNew, jcls_rte, "diagnostics too large");
         return NULL;
     }
+
+    jbyteArray ret = JNI(NewByteArray, (jsize) json.len);
+    if (ret) {
+        JNI(SetByteArrayRegion, ret, 0, (jsize) json.len,
+            (const jbyte *) json.data);
+    }
+    json_buf_free(&json);
+    if (JNI(ExceptionCheck)) {
+        if (ret) {
+            JNI(DeleteLocalRef, ret);
+        }
+        return NULL;
+    }
+    return ret;
 }
 
-static struct json_segment *_convert_json(const ddwaf_object *cur_obj,
-                                          int depth,
-                                          struct json_segment *cur_seg)
+#define MAX_SIZE_OF_SCHEMA 2500
+// base64 output size for n input bytes
+#define BASE64_SIZE(n) (((n) + 2) / 3 * 4)
+static jstring _encode_json_gzip_base64_checked(JNIEnv *env,
+                                                const ddwaf_object *obj)
 {
-    if (depth > MAX_JSON_DEPTH || !cur_obj || !cur_seg) {
+    char json_storage[MAX_SIZE_OF_SCHEMA + 1];
+    struct json_buf json;
+    json_buf_init(&json, json_storage, sizeof json_storage);
+    if (!json_write_object(&json, obj)) {
+        // too deep (or OOM)
         return NULL;
     }
 
-    switch (cur_obj->type) {
-    case DDWAF_OBJ_INVALID:
-        return false;
-    case DDWAF_OBJ_SIGNED: {
-        int64_t val = cur_obj->intValue;
-        char str[21];
-        int len = sprintf(str, "%" PRId64, val);
-        assert(len > 0); // can't fail
-        cur_seg = json_append(cur_seg, str, (size_t) len);
-    } break;
-    case DDWAF_OBJ_UNSIGNED: {
-        uint64_t val = cur_obj->uintValue;
-        char str[21];
-        int len = sprintf(str, "%" PRIu64, val);
-        assert(len > 0); // can't fail
-        cur_seg = json_append(cur_seg, str, (size_t) len);
-    } break;
-    case DDWAF_OBJ_STRING: {
-        cur_seg = json_append(cur_seg, "\"", 1);
-        cur_seg = json_encode_str(cur_seg, cur_obj->stringValue,
-                                  cur_obj->nbEntries);
-        cur_seg = json_append(cur_seg, "\"", 1);
-    } break;
-    case DDWAF_OBJ_ARRAY: {
-        cur_seg = json_append(cur_seg, "[", 1);
-        for (uint64_t i = 0; i < cur_obj->nbEntries; i++) {
-            const ddwaf_object *o = &cur_obj->array[i];
-            cur_seg = _convert_json(o, depth + 1, cur_seg);
-            if (i != cur_obj->nbEntries - 1) {
-                cur_seg = json_append(cur_seg, ",", 1);
-            }
-        }
-        cur_seg = json_append(cur_seg, "]", 1);
-    } break;
-    case DDWAF_OBJ_MAP: {
-        cur_seg = json_append(cur_seg, "{", 1);
-        for (uint64_t i = 0; i < cur_obj->nbEntries; i++) {
-            const ddwaf_object *o = &cur_obj->array[i];
+    if (json.len > MAX_SIZE_OF_SCHEMA) {
+        json_buf_free(&json);
+        return NULL;
+    }
 
-            cur_seg = json_append(cur_seg, "\"", 1);
-            cur_seg = json_encode_str(cur_seg, o->parameterName,
-                                      o->parameterNameLength);
-            cur_seg = json_append(cur_seg, "\":", 2);
+    // deflate into a buffer sized from the compression bound
+    size_t bound = gzip_bound(json.len);
+    uint8_t gzip_storage[3072];
+    uint8_t *gzip =
+            bound <= sizeof gzip_storage ? gzip_storage : malloc(bound);
+    if (gzip == NULL) {
+        json_buf_free(&json);
+        return NULL;
+    }
+    size_t gzip_size = gzip_compress(json.data, json.len, gzip);
+    json_buf_free(&json);
 
-            cur_seg = _convert_json(o, depth + 1, cur_seg);
+    jstring ret = NULL;
+    if (gzip_size == 0) {
+        JAVA_LOG(DDWAF_LOG_DEBUG, "%s", "gzip encoding of derivative failed");
+        goto end;
+    }
 
-            if (i != cur_obj->nbEntries - 1) {
-                cur_seg = json_append(cur_seg, ",", 1);
-            }
-        }
-        cur_seg = json_append(cur_seg, "}", 1);
-    } break;
-    case DDWAF_OBJ_BOOL: {
-        if (cur_obj->boolean) {
-            cur_seg = json_append(cur_seg, "true", 4);
-        } else {
-            cur_seg = json_append(cur_seg, "false", 5);
-        }
-    } break;
+    // base64 encode straight into the (Latin-1) java string's storage
+    size_t base64_len = BASE64_SIZE(gzip_size);
+    jbyteArray arr;
+    char *base64 = java_latin1_alloc_checked(env, base64_len, &arr);
+    if (base64 == NULL) {
+        goto end;
     }
+    size_t written;
+    base64_encode((const char *) gzip, gzip_size, base64, &written);
+    assert(written == base64_len);
+    ret = java_latin1_to_jstring_checked(env, arr, base64);
 
-    return cur_seg;
+end:
+    if (gzip != gzip_storage) {
+        free(gzip);
+    }
+    return ret;
 }
 
-static uint8_t *_encode_gzip(const struct json_segment *json, size_t json_len,
-                             size_t *out_size)
+static jstring _encode_schema_cached_checked(JNIEnv *env,
+                                             const ddwaf_object *obj)
 {
-    z_stream strm = {0};
-    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8,
-                     Z_DEFAULT_STRATEGY) != Z_OK) {
-        return NULL;
+    uint64_t hash = schema_cache_hash(obj);
+    jstring ret = schema_cache_get(env, hash, obj);
+    if (ret) {
+        return ret;
     }
 
-    size_t deflated_size = json_len < 1024 ? 1024 : json_len;
-    uint8_t *ret = malloc(deflated_size);
-    if (ret == NULL) {
-        deflateEnd(&strm);
-        return NULL;
+    ret = _encode_json_gzip_base64_checked(env, obj);
+    if (ret) {
+        schema_cache_put(env, hash, obj, ret);
     }
+    return ret;
+}
 
-    // Compress each string
-    struct json_iterator it = {0};
-    for (it.seg = json; it.seg != NULL; it.seg = it.seg->next) {
-        strm.avail_in = it.seg->len;
-        strm.next_in = (const uint8_t *) it.seg->data;
-
-        do {
-            if (strm.total_out >= deflated_size) {
-                deflated_size *= 2;
-                uint8_t *new_ret = realloc(ret, deflated_size);
-                if (new_ret == NULL) {
-                    free(ret);
-                    deflateEnd(&strm);
-                    return NULL;
-                }
-                ret = new_ret;
-            }
+// Writer of the binary result format (see ResultDecoder.java). It starts out
+// on the memory of the direct ByteBuffer provided by Java and moves to the
+// heap if that is too small; integers are written in native byte order.
+struct _result_writer {
+    JNIEnv *env;
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    bool owned; // data is heap allocated and must be freed
+    jobjectArray refs;
+    jsize refs_cap;
+    jsize refs_used;
+};
+
+#define RESULT_HEADER_SIZE 16
+#define RESULT_MIN_HEAP_CAP 1024
+
+#define RESULT_FLAG_KEEP 0x01
+#define RESULT_FLAG_EVENTS 0x02
+
+#define RESULT_TAG_NULL 0
+#define RESULT_TAG_LONG 1
+#define RESULT_TAG_DOUBLE 2
+#define RESULT_TAG_FALSE 3
+#define RESULT_TAG_TRUE 4
+#define RESULT_TAG_STRING 5
+#define RESULT_TAG_ARRAY 6
+#define RESULT_TAG_MAP 7
+#define RESULT_TAG_REF 8
+#define RESULT_TAG_ACTIONS 9
+
+static bool _rw_reserve(struct _result_writer *w, size_t add)
+{
+    if (w->cap - w->len >= add) {
+        return true;
+    }
+    // the whole result must fit in a java ByteBuffer
+    if (add > (size_t) MAX_JINT - w->len) {
+        return false;
+    }
 
-            size_t avail_out = deflated_size - strm.total_out;
-            if (avail_out > (unsigned) -1) {
-                avail_out = (unsigned) -1;
-            }
-            strm.avail_out = (unsigned) avail_out;
-            strm.next_out = ret + strm.total_out;
-
-            if (deflate(&strm, it.seg->next == NULL ? Z_FINISH : Z_NO_FLUSH) ==
-                Z_STREAM_ERROR) {
-                free(ret);
-                deflateEnd(&strm);
-                return NULL;
-            }
-        } while (strm.avail_out == 0);
+    size_t new_cap = w->cap * 2;
+    if (new_cap < w->len + add) {
+        new_cap = w->len + add;
+    }
+    if (new_cap < RESULT_MIN_HEAP_CAP) {
+        new_cap = RESULT_MIN_HEAP_CAP;
+    }
+    if (new_cap > (size_t) MAX_JINT) {
+        new_cap = (size_t) MAX_JINT;
     }
 
-    *out_size = strm.total_out;
-    if (deflateEnd(&strm) == Z_OK) {
-        return ret;
+    uint8_t *new_data;
+    if (w->owned) {
+        new_data = realloc(w->data, new_cap);
+    } else {
+        new_data = malloc(new_cap);
+        if (new_data && w->len > 0) {
+            memcpy(new_data, w->data, w->len);
+        }
     }
-    free(ret);
-    return NULL;
+    if (!new_data) {
+        return false;
+    }
+    w->data = new_data;
+    w->cap = new_cap;
+    w->owned = true;
+    return true;
 }
 
-#define MAX_SIZE_OF_SCHEMA 2500
-static jstring _encode_json_gzip_base64_checked(JNIEnv *env,
-                                                const ddwaf_object *obj)
+static inline bool _rw_bytes(struct _result_writer *w, const void *data,
+                             size_t len)
 {
-    struct json_segment *json = output_convert_json(obj);
-    if (json == NULL) {
-        // too deep (or OOM)
-        return NULL;
+    if (!_rw_reserve(w, len)) {
+        return false;
     }
+    if (len > 0) {
+        memcpy(w->data + w->len, data, len);
+        w->len += len;
+    }
+    return true;
+}
 
-    size_t json_len = json_length(json);
-    if (json_len > MAX_SIZE_OF_SCHEMA) {
-        json_seg_free(json);
-        return NULL;
+static inline bool _rw_u8(struct _result_writer *w, uint8_t v)
+{
+    return _rw_bytes(w, &v, sizeof v);
+}
+
+static inline bool _rw_u32(struct _result_writer *w, uint32_t v)
+{
+    return _rw_bytes(w, &v, sizeof v);
+}
+
+static inline void _rw_patch_u32(struct _result_writer *w, size_t off,
+                                 uint32_t v)
+{
+    memcpy(w->data + off, &v, sizeof v);
+}
+
+// u32 length followed by the UTF-8 bytes
+static bool _rw_str(struct _result_writer *w, const char *str, uint64_t len)
+{
+    if (len > UINT32_MAX) {
+        return false;
     }
+    return _rw_u32(w, (uint32_t) len) && _rw_bytes(w, str, (size_t) len);
+}
 
-    // deflate
-    size_t gzip_size;
-    uint8_t *gzip = _encode_gzip(json, json_len, &gzip_size);
-    json_seg_free(json);
-    if (gzip == NULL) {
-        JAVA_LOG(DDWAF_LOG_DEBUG, "%s", "gzip encoding of derivative failed");
-        return NULL;
+static bool _rw_object(struct _result_writer *w, const ddwaf_object *obj)
+{
+    switch (obj->type) {
+    case DDWAF_OBJ_SIGNED: {
+        int64_t v = obj->intValue;
+        return _rw_u8(w, RESULT_TAG_LONG) && _rw_bytes(w, &v, sizeof v);
+    }
+    case DDWAF_OBJ_UNSIGNED: {
+        int64_t v = (int64_t) obj->uintValue;
+        return _rw_u8(w, RESULT_TAG_LONG) && _rw_bytes(w, &v, sizeof v);
+    }
+    case DDWAF_OBJ_FLOAT: {
+        double v = obj->f64;
+        return _rw_u8(w, RESULT_TAG_DOUBLE) && _rw_bytes(w, &v, sizeof v);
+    }
+    case DDWAF_OBJ_BOOL:
+        return _rw_u8(w, obj->boolean ? RESULT_TAG_TRUE : RESULT_TAG_FALSE);
+    case DDWAF_OBJ_STRING:
+        return _rw_u8(w, RESULT_TAG_STRING) &&
+               _rw_str(w, obj->stringValue, obj->nbEntries);
+    case DDWAF_OBJ_ARRAY:
+    case DDWAF_OBJ_MAP: {
+        bool is_map = obj->type == DDWAF_OBJ_MAP;
+        if (obj->nbEntries > UINT32_MAX) {
+            return false;
+        }
+        if (!_rw_u8(w, is_map ? RESULT_TAG_MAP : RESULT_TAG_ARRAY) ||
+            !_rw_u32(w, (uint32_t) obj->nbEntries)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < obj->nbEntries; i++) {
+            const ddwaf_object *elem = &obj->array[i];
+            if (is_map && !_rw_str(w, elem->parameterName,
+                                   elem->parameterNameLength)) {
+                return false;
+            }
+            if (!_rw_object(w, elem)) {
+                return false;
+            }
+        }
+        return true;
     }
+    case DDWAF_OBJ_INVALID:
+    case DDWAF_OBJ_NULL:
+        break;
+    }
+    return _rw_u8(w, RESULT_TAG_NULL);
+}
 
-    // base64 encode
-    size_t base64_capacity = ((4 * gzip_size / 3) + 3) & ~3UL;
-    char *base64 = malloc(base64_capacity);
-    if (base64 == NULL) {
-        free(gzip);
-        return NULL;
+static uint64_t _rw_hash(const uint8_t *data, size_t len)
+{
+    uint64_t h = len;
+    for (; len >= 8; data += 8, len -= 8) {
+        uint64_t v;
+        memcpy(&v, data, 8);
+        h = (h ^ v) * UINT64_C(0x9E3779B97F4A7C15);
+        h ^= h >> 29;
+    }
+    uint64_t v = 0;
+    memcpy(&v, data, len);
+    h = (h ^ v) * UINT64_C(0x9E3779B97F4A7C15);
+    return h ^ (h >> 32);
+}
+
+// The actions map prefixed with a hash and the size of its encoding, so that
+// the Java side can look up the typed descriptors it converted earlier for
+// the same actions (they seldom change for a given WafHandle).
+static bool _rw_actions(struct _result_writer *w, const ddwaf_object *actions)
+{
+    if (!_rw_u8(w, RESULT_TAG_ACTIONS) || !_rw_reserve(w, 12)) {
+        return false;
     }
-    size_t base64_len;
-    base64_encode((const char *) gzip, gzip_size, base64, &base64_len);
-    free(gzip);
+    size_t hdr_off = w->len;
+    w->len += 12;
 
-    // finally, java string
-    jstring ret = java_utf8_to_jstring_checked(env, base64, base64_len);
-    free(base64);
-    return ret;
+    if (!_rw_object(w, actions)) {
+        return false;
+    }
+
+    size_t map_len = w->len - hdr_off - 12;
+    uint64_t hash = _rw_hash(w->data + hdr_off + 12, map_len);
+    memcpy(w->data + hdr_off, &hash, sizeof hash);
+    _rw_patch_u32(w, hdr_off + 8, (uint32_t) map_len);
+    return true;
+}
+
+// Java strings are handed over through the refs array, so that the decoder
+// returns the very same instance (e.g. one owned by the schema cache). If the
+// array is full, the string is copied inline.
+static bool _rw_jstring_checked(struct _result_writer *w, jstring str)
+{
+    JNIEnv *env = w->env;
+    if (w->refs_used < w->refs_cap) {
+        JNI(SetObjectArrayElement, w->refs, w->refs_used, str);
+        if (JNI(ExceptionCheck)) {
+            return false;
+        }
+        return _rw_u8(w, RESULT_TAG_REF) &&
+               _rw_u32(w, (uint32_t) w->refs_used++);
+    }
+
+    // standard UTF-8, which is what the decoder expects, rather than the
+    // modified UTF-8 of GetStringUTFRegion. No JNI calls until released
+    jsize len = JNI(GetStringLength, str);
+    const jchar *chars = JNI(GetStringCritical, str, NULL);
+    if (!chars) {
+        if (!JNI(ExceptionCheck)) {
+            JNI(ThrowNew, jcls_rte, "Could not get string characters");
+        }
+        return false;
+    }
+    size_t utf_len = utf16_to_utf8_length(chars, (size_t) len);
+    bool ok = utf_len <= (size_t) MAX_JINT && _rw_u8(w, RESULT_TAG_STRING) &&
+              _rw_u32(w, (uint32_t) utf_len) && _rw_reserve(w, utf_len);
+    if (ok) {
+        w->len += utf16_to_utf8(chars, (size_t) len, w->data + w->len, utf_len);
+    }
+    JNI(ReleaseStringCritical, str, chars);
+    return ok;
 }
 
-jobject output_convert_attributes_checked(JNIEnv *env, const ddwaf_object *obj)
+static bool _rw_attributes_checked(struct _result_writer *w,
+                                   const ddwaf_object *obj)
 {
+    JNIEnv *env = w->env;
     assert(obj->type == DDWAF_OBJ_MAP);
 
-    jobject ret = java_meth_call(env, &_linked_hm_init, NULL);
-    if (JNI(ExceptionCheck)) {
-        return NULL;
+    if (!_rw_u8(w, RESULT_TAG_MAP)) {
+        return false;
+    }
+    size_t count_off = w->len;
+    if (!_rw_u32(w, 0)) {
+        return false;
     }
 
+    uint32_t count = 0;
     for (size_t i = 0; i < obj->nbEntries; i++) {
-        ddwaf_object *entry = &obj->array[i];
-        jstring key = java_utf8_to_jstring_checked(env, entry->parameterName,
-                                                   entry->parameterNameLength);
-        if (JNI(ExceptionCheck)) {
-            goto error;
+        const ddwaf_object *entry = &obj->array[i];
+        size_t entry_off = w->len;
+        if (!_rw_str(w, entry->parameterName, entry->parameterNameLength)) {
+            return false;
         }
 
-        jobject value = NULL;
         if (_is_derivative(entry, "_dd.appsec.s.")) {
             // json schemas are json that has to be gzipped and encoded in
             // base64
-            value = _encode_json_gzip_base64_checked(env, entry);
-        } else if (_is_derivative(entry, "_dd.appsec.fp.")) {
-            // fingerprints are simple strings
-            value = java_utf8_to_jstring_checked(env, entry->stringValue,
-                                                 entry->nbEntries);
-        } else if (entry->type == DDWAF_OBJ_STRING) {
-            // general string attributes
-            value = java_utf8_to_jstring_checked(env, entry->stringValue,
-                                                 entry->nbEntries);
-        } else if (entry->type == DDWAF_OBJ_SIGNED) {
-            // signed integer attributes
-            value = java_meth_call(env, &long_valueOf, long_cls,
-                                   (jlong) entry->intValue);
-        } else if (entry->type == DDWAF_OBJ_UNSIGNED) {
-            // unsigned integer attributes
-            value = java_meth_call(env, &long_valueOf, long_cls,
-                                   (jlong) entry->uintValue);
-        } else if (entry->type == DDWAF_OBJ_FLOAT) {
-            // float/double attributes
-            value = java_meth_call(env, &double_valueOf, double_cls,
-                                   (jdouble) entry->f64);
-        } else if (entry->type == DDWAF_OBJ_BOOL) {
-            // boolean attributes
-            value = java_meth_call(env, &boolean_valueOf, boolean_cls,
-                                   (jboolean) entry->boolean);
-        } else if (entry->type == DDWAF_OBJ_MAP) {
-            // map-type attributes (like trace tagging objects)
-            jobject map_value = convert_ddwaf_object_to_jobject(env, entry);
+            jstring value = _encode_schema_cached_checked(env, entry);
             if (JNI(ExceptionCheck)) {
-                JNI(DeleteLocalRef, key);
-                goto error;
+                return false;
             }
-            java_meth_call(env, &_map_put, ret, key, map_value);
-            JNI(DeleteLocalRef, key);
-            JNI(DeleteLocalRef, map_value);
-            if (JNI(ExceptionCheck)) {
-                goto error;
+            if (value == NULL) {
+                JAVA_LOG(DDWAF_LOG_DEBUG,
+                         "Failed serializing derivative entry for %.*s",
+                         (int) entry->parameterNameLength,
+                         entry->parameterName);
+                w->len = entry_off;
+                continue;
             }
-            continue; // Skip the normal value handling since we already added
-                      // to map
-        }
-
-        if (JNI(ExceptionCheck)) {
-            JNI(DeleteLocalRef, key);
-            goto error;
-        } else if (value == NULL) {
+            bool ok = _rw_jstring_checked(w, value);
+            JNI(DeleteLocalRef, value);
+            if (!ok) {
+                return false;
+            }
+        } else if (entry->type == DDWAF_OBJ_STRING ||
+                   entry->type == DDWAF_OBJ_SIGNED ||
+                   entry->type == DDWAF_OBJ_UNSIGNED ||
+                   entry->type == DDWAF_OBJ_FLOAT ||
+                   entry->type == DDWAF_OBJ_BOOL ||
+                   entry->type == DDWAF_OBJ_MAP) {
+            // fingerprints and other scalar attributes, and maps (like trace
+            // tagging objects)
+            if (!_rw_object(w, entry)) {
+                return false;
+            }
+        } else {
             JAVA_LOG(DDWAF_LOG_DEBUG,
-                     "Failed serializing derivative entry for %*.s",
+                     "Skipping derivative entry of unsupported type for %.*s",
                      (int) entry->parameterNameLength, entry->parameterName);
-            JNI(DeleteLocalRef, key);
+            w->len = entry_off;
             continue;
         }
-
-        java_meth_call(env, &_map_put, ret, key, value);
-        JNI(DeleteLocalRef, key);
-        JNI(DeleteLocalRef, value);
-        if (JNI(ExceptionCheck)) {
-            goto error;
-        }
+        count++;
     }
 
-    return ret;
-
-error:
-    JNI(DeleteLocalRef, ret);
-    return NULL;
+    _rw_patch_u32(w, count_off, count);
+    return true;
 }
 
-jobject convert_ddwaf_object_to_jobject(JNIEnv *env, const ddwaf_object *obj)
+static bool _rw_events(struct _result_writer *w, const ddwaf_object *events)
 {
-    switch (obj->type) {
-    case DDWAF_OBJ_INVALID:
-        JNI(ThrowNew, jcls_rte, "Unsupported ddwaf object type");
-        return NULL;
-    case DDWAF_OBJ_SIGNED:
-        return java_meth_call(env, &long_valueOf, long_cls,
-                              (jlong) obj->intValue);
-    case DDWAF_OBJ_UNSIGNED:
-        return java_meth_call(env, &long_valueOf, long_cls,
-                              (jlong) obj->uintValue);
-    case DDWAF_OBJ_FLOAT:
-        return java_meth_call(env, &double_valueOf, double_cls,
-                              (jdouble) obj->f64);
-    case DDWAF_OBJ_BOOL:
-        return java_meth_call(env, &boolean_valueOf, boolean_cls,
-                              (jboolean) obj->boolean);
-    case DDWAF_OBJ_STRING:
-        return java_utf8_to_jstring_checked(env, obj->stringValue,
-                                            obj->nbEntries);
-    case DDWAF_OBJ_ARRAY: {
-        if (obj->nbEntries > MAX_JINT) {
-            JNI(ThrowNew, jcls_rte, "Too many elements in ddwaf array");
-            return NULL;
-        }
-        jobject ret = java_meth_call(env, &_array_list_init, NULL,
-                                     (jint) obj->nbEntries);
-        if (ret == NULL) {
-            return NULL;
-        }
+    char json_storage[2048];
+    struct json_buf json;
+    json_buf_init(&json, json_storage, sizeof json_storage);
+    if (!json_write_object(&json, events)) {
+        json_buf_free(&json);
+        return false;
+    }
 
-        for (uint64_t i = 0; i < obj->nbEntries; i++) {
-            jobject elem = convert_ddwaf_object_to_jobject(env, &obj->array[i]);
-            if (JNI(ExceptionCheck)) {
-                JNI(DeleteLocalRef, ret);
-                return NULL;
-            }
+    bool ok = _rw_u8(w, RESULT_TAG_STRING) && _rw_str(w, json.data, json.len);
+    json_buf_free(&json);
+    return ok;
+}
 
-            java_meth_call(env, &_array_list_add, ret, elem);
-            JNI(DeleteLocalRef, elem);
-            if (JNI(ExceptionCheck)) {
-                JNI(DeleteLocalRef, ret);
-                return NULL;
-            }
+jobject output_write_result_checked(JNIEnv *env,
+                                    const struct output_result *res,
+                                    jobject buffer, jobjectArray refs)
+{
+    struct _result_writer w = {
+            .env = env,
+            .refs = refs,
+            .refs_cap = JNI(IsSameObject, refs, NULL)
+                                ? 0
+                                : JNI(GetArrayLength, refs),
+    };
+    if (!JNI(IsSameObject, buffer, NULL)) {
+        w.data = JNI(GetDirectBufferAddress, buffer);
+        jlong cap = JNI(GetDirectBufferCapacity, buffer);
+        w.cap = w.data != NULL && cap > 0 ? (size_t) cap : 0;
+    }
+
+    uint8_t flags = (uint8_t) ((res->keep ? RESULT_FLAG_KEEP : 0) |
+                               (res->events ? RESULT_FLAG_EVENTS : 0));
+    uint8_t header[RESULT_HEADER_SIZE] = {0};
+    header[4] = res->code;
+    header[5] = flags;
+    memcpy(header + 8, &res->duration, sizeof res->duration);
+    if (!_rw_bytes(&w, header, sizeof header)) {
+        goto oom;
+    }
+
+    if (res->events_obj) {
+        if (!_rw_events(&w, res->events_obj)) {
+            JNI(ThrowNew, jcls_iae, "failed converting events array to json");
+            goto err;
         }
+    } else if (!_rw_u8(&w, RESULT_TAG_NULL)) {
+        goto oom;
+    }
 
-        return ret;
+    if (!(res->actions ? _rw_actions(&w, res->actions)
+                       : _rw_u8(&w, RESULT_TAG_NULL))) {
+        goto oom;
     }
-    case DDWAF_OBJ_MAP: {
-        jobject ret = java_meth_call(env, &_linked_hm_init, NULL);
-        if (ret == NULL) {
-            return NULL;
-        }
 
-        for (uint64_t i = 0; i < obj->nbEntries; i++) {
-            ddwaf_object *elem = &obj->array[i];
-            jstring key = java_utf8_to_jstring_checked(
-                    env, elem->parameterName, elem->parameterNameLength);
-            if (JNI(ExceptionCheck)) {
-                JNI(DeleteLocalRef, ret);
-                return NULL;
+    if (res->attributes) {
+        if (!_rw_attributes_checked(&w, res->attributes)) {
+            if (!JNI(ExceptionCheck)) {
+                JNI(ThrowNew, jcls_rte, "Failed encoding inferred attributes");
             }
+            goto err;
+        }
+    } else if (!_rw_u8(&w, RESULT_TAG_NULL)) {
+        goto oom;
+    }
 
-            jobject value = convert_ddwaf_object_to_jobject(env, elem);
-            if (JNI(ExceptionCheck)) {
-                JNI(DeleteLocalRef, key);
-                return NULL;
-            }
+    _rw_patch_u32(&w, 0, (uint32_t) w.len);
 
-            java_meth_call(env, &_map_put, ret, key, value);
-            JNI(DeleteLocalRef, key);
-            JNI(DeleteLocalRef, value);
-            if (JNI(ExceptionCheck)) {
-                JNI(DeleteLocalRef, ret);
-                return NULL;
-            }
-        }
+    if (!w.owned) {
+        return JNI(NewLocalRef, buffer);
+    }
 
-        return ret;
+    // didn't fit; hand a bigger buffer back to Java, which can keep it
+    jobject new_buffer =
+            java_meth_call(env, &_byte_buffer_allocate_direct, NULL,
+                           (jint) w.cap);
+    if (JNI(ExceptionCheck)) {
+        goto err;
     }
+    void *new_data = JNI(GetDirectBufferAddress, new_buffer);
+    if (!new_data) {
+        JNI(DeleteLocalRef, new_buffer);
+        JNI(ThrowNew, jcls_rte, "Could not get address of result buffer");
+        goto err;
+    }
+    memcpy(new_data, w.data, w.len);
+    free(w.data);
+    return new_buffer;
+
+oom:
+    JNI(ThrowNew, jcls_rte, "Failed encoding result: out of memory or too big");
+err:
+    if (w.owned) {
+        free(w.data);
     }
-    JNI(ThrowNew, jcls_rte, "Unknown ddwaf object type");
     return NULL;
 }
@@ -10,6 +10,8 @@
 
 #include <jni.h>
 #include <ddwaf.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 #include "json.h"
 
@@ -17,10 +19,36 @@
 
 void output_init_checked(JNIEnv *env);
 void output_shutdown(JNIEnv *env);
+// Converts the diagnostics of a configuration update into a WafDiagnostics. In
+// summary mode, only counts, errors and warnings are converted; the rest is
+// kept as a single JSON byte[], from which WafDiagnostics builds the full
+// diagnostics on demand.
 jobject output_convert_diagnostics_checked(JNIEnv *env,
-                                           const ddwaf_object *obj);
+                                           const ddwaf_object *obj,
+                                           bool summary);
 
-struct json_segment *output_convert_json(const ddwaf_object *obj);
-struct json_segment *output_convert_json(const ddwaf_object *obj);
-jobject output_convert_attributes_checked(JNIEnv *env, const ddwaf_object *obj);
-jobject convert_ddwaf_object_to_jobject(JNIEnv *env, const ddwaf_object *obj);
+// codes of Waf.Result
+#define OUTPUT_RESULT_OK 0
+#define OUTPUT_RESULT_MATCH 1
+#define OUTPUT_RESULT_TIMEOUT 2
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+struct output_result {
+    uint8_t code;
+    bool keep;
+    bool events;
+    uint64_t duration;              // in nanoseconds
+    const ddwaf_object *events_obj; // encoded as json; may be NULL
+    const ddwaf_object *actions;    // may be NULL
+    const ddwaf_object *attributes; // may be NULL
+};
+#pragma clang diagnostic pop
+
+// Encodes the result in the format read by ResultDecoder.java, in buffer if
+// it's large enough (buffer may be NULL). Otherwise, a larger direct
+// ByteBuffer is allocated. Java strings are passed through the refs array.
+// Returns a local reference to the ByteBuffer that holds the result.
+jobject output_write_result_checked(JNIEnv *env,
+                                    const struct output_result *res,
+                                    jobject buffer, jobjectArray refs);
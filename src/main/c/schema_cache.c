@@ -0,0 +1,139 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#include "schema_cache.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atomics.h"
+#include "common.h"
+#include "json.h"
+#include "object_hash.h"
+
+// Direct-mapped table. Each slot has a busy flag that is only ever tried:
+// a thread that finds the slot busy treats the lookup as a miss (or skips
+// the insertion) instead of waiting, so the cache never blocks a request.
+struct _entry {
+    uint64_t hash;  // 0 if empty
+    uint8_t *key;   // object_key of the schema
+    size_t key_len; // its length
+    jstring value;  // global reference
+    volatile bool busy;
+};
+
+static struct _entry *_entries;
+static size_t _mask;
+static volatile uint64_t _hits;
+static volatile uint64_t _misses;
+
+void schema_cache_init(size_t capacity)
+{
+    if (capacity == 0) {
+        return;
+    }
+    size_t size = 1;
+    while (size < capacity && size <= SIZE_MAX / 2) {
+        size *= 2;
+    }
+    _entries = calloc(size, sizeof *_entries);
+    _mask = _entries ? size - 1 : 0;
+}
+
+void schema_cache_shutdown(JNIEnv *env)
+{
+    if (!_entries) {
+        return;
+    }
+    for (size_t i = 0; i <= _mask; i++) {
+        if (_entries[i].value) {
+            JNI(DeleteGlobalRef, _entries[i].value);
+        }
+        free(_entries[i].key);
+    }
+    free(_entries);
+    _entries = NULL;
+    _mask = 0;
+}
+
+uint64_t schema_cache_hash(const ddwaf_object *obj)
+{
+    if (!_entries) {
+        return 0;
+    }
+    return object_hash(obj, 0, MAX_JSON_DEPTH);
+}
+
+jstring schema_cache_get(JNIEnv *env, uint64_t hash,
+                         const ddwaf_object *obj)
+{
+    if (hash == 0) {
+        return NULL;
+    }
+
+    jstring ret = NULL;
+    struct _entry *e = &_entries[hash & _mask];
+    if (COMPARE_AND_SWAP(&e->busy, false, true)) {
+        if (e->hash == hash && object_key_matches(obj, MAX_JSON_DEPTH, e->key,
+                                                  e->key_len)) {
+            ret = JNI(NewLocalRef, e->value);
+        }
+        ATOMIC_CLEAR(&e->busy);
+    }
+
+    ATOMIC_INC_U64(ret ? &_hits : &_misses);
+    return ret;
+}
+
+void schema_cache_put(JNIEnv *env, uint64_t hash, const ddwaf_object *obj,
+                      jstring value)
+{
+    if (hash == 0) {
+        return;
+    }
+
+    size_t key_len;
+    uint8_t *key = object_key(obj, MAX_JSON_DEPTH, &key_len);
+    if (!key) {
+        return;
+    }
+    jstring glob = JNI(NewGlobalRef, value);
+    if (!glob) {
+        free(key);
+        return;
+    }
+
+    struct _entry *e = &_entries[hash & _mask];
+    if (!COMPARE_AND_SWAP(&e->busy, false, true)) {
+        JNI(DeleteGlobalRef, glob);
+        free(key);
+        return;
+    }
+    jstring old = e->value;
+    uint8_t *old_key = e->key;
+    e->hash = hash;
+    e->key = key;
+    e->key_len = key_len;
+    e->value = glob;
+    ATOMIC_CLEAR(&e->busy);
+
+    if (old) {
+        JNI(DeleteGlobalRef, old);
+    }
+    free(old_key);
+}
+
+uint64_t schema_cache_hits(void)
+{
+    return _hits;
+}
+
+uint64_t schema_cache_misses(void)
+{
+    return _misses;
+}
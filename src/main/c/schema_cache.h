@@ -0,0 +1,37 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+#include <ddwaf.h>
+#include <jni.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Cache of the encoded (json, gzip, base64) API security schemas, keyed by the
+// schema's ddwaf_object: slots are picked by its hash and hits are confirmed
+// by comparing the object with the entry's key (see object_key). The same endpoint usually produces the
+// same schemas, so most lookups hit and return a shared String instance.
+
+#define SCHEMA_CACHE_DEFAULT_CAPACITY 256
+
+// capacity is rounded up to a power of 2; 0 disables the cache
+void schema_cache_init(size_t capacity);
+void schema_cache_shutdown(JNIEnv *env);
+
+// 0 if the object can't be cached (e.g. too deep)
+uint64_t schema_cache_hash(const ddwaf_object *obj);
+
+// a new local reference, or NULL on miss
+jstring schema_cache_get(JNIEnv *env, uint64_t hash,
+                         const ddwaf_object *obj);
+void schema_cache_put(JNIEnv *env, uint64_t hash, const ddwaf_object *obj,
+                      jstring value);
+
+uint64_t schema_cache_hits(void);
+uint64_t schema_cache_misses(void);
@@ -0,0 +1,283 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#include "slow_capture.h"
+#include "atomics.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DUMP_MAGIC "DDSC"
+#define DUMP_VERSION 1
+#define DUMP_HEADER_SIZE 8
+#define MAX_DEPTH 25
+
+#define FLAG_TIMED_OUT 0x01
+#define FLAG_TRUNCATED 0x02
+#define FLAG_PERSISTENT 0x04
+#define FLAG_EPHEMERAL 0x08
+
+struct slot {
+    uint8_t *data; // SLOW_CAPTURE_MAX_RECORD_SIZE bytes, allocated on use
+    size_t len;    // 0 if empty
+};
+
+static uint64_t _threshold_ns; // 0 if disabled
+static uint64_t _sample_every;
+static uint64_t _slow_runs;
+static struct slot *_slots;
+static size_t _num_slots;
+static size_t _next_slot; // the oldest capture once the ring is full
+static bool _busy;        // protects the slots
+
+struct writer {
+    uint8_t *p;
+    uint8_t *end;
+    bool overflow;
+    bool truncated;
+};
+
+void slow_capture_init(uint64_t threshold_ns, uint64_t sample_every,
+                       size_t slots)
+{
+    if (!threshold_ns || !slots) {
+        return;
+    }
+    _slots = calloc(slots, sizeof *_slots);
+    if (!_slots) {
+        return;
+    }
+    _num_slots = slots;
+    _next_slot = 0;
+    _sample_every = sample_every ? sample_every : 1;
+    _threshold_ns = threshold_ns;
+}
+
+void slow_capture_shutdown(void)
+{
+    if (!_slots) {
+        return;
+    }
+    _threshold_ns = 0;
+    while (!COMPARE_AND_SWAP(&_busy, false, true)) {
+    }
+    for (size_t i = 0; i < _num_slots; i++) {
+        free(_slots[i].data);
+    }
+    free(_slots);
+    _slots = NULL;
+    _num_slots = 0;
+    ATOMIC_CLEAR(&_busy);
+}
+
+bool slow_capture_wanted(int64_t total_ns, int64_t ddwaf_ns, bool timed_out)
+{
+    uint64_t threshold = _threshold_ns;
+    if (!threshold) {
+        return false;
+    }
+    if (!timed_out && (uint64_t) total_ns < threshold &&
+        (uint64_t) ddwaf_ns < threshold) {
+        return false;
+    }
+    return ATOMIC_INC_U64(&_slow_runs) % _sample_every == 0;
+}
+
+static void _write(struct writer *w, const void *data, size_t len)
+{
+    if (w->overflow || (size_t) (w->end - w->p) < len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->p, data, len);
+    w->p += len;
+}
+
+static void _write_u8(struct writer *w, uint8_t v)
+{
+    _write(w, &v, sizeof v);
+}
+
+static void _write_u32(struct writer *w, uint32_t v)
+{
+    _write(w, &v, sizeof v);
+}
+
+static void _write_u64(struct writer *w, uint64_t v)
+{
+    _write(w, &v, sizeof v);
+}
+
+static void _write_str(struct writer *w, const char *s, uint64_t len)
+{
+    if (len > SLOW_CAPTURE_MAX_STRING_SIZE) {
+        len = SLOW_CAPTURE_MAX_STRING_SIZE;
+        w->truncated = true;
+    }
+    _write_u32(w, (uint32_t) len);
+    if (len) {
+        _write(w, s, (size_t) len);
+    }
+}
+
+static void _write_object(struct writer *w, const ddwaf_object *obj,
+                          int depth)
+{
+    if (depth > MAX_DEPTH) {
+        _write_u8(w, DDWAF_OBJ_INVALID);
+        w->truncated = true;
+        return;
+    }
+    _write_u8(w, (uint8_t) obj->type);
+    switch (obj->type) {
+    case DDWAF_OBJ_SIGNED:
+        _write(w, &obj->intValue, sizeof obj->intValue);
+        break;
+    case DDWAF_OBJ_UNSIGNED:
+        _write(w, &obj->uintValue, sizeof obj->uintValue);
+        break;
+    case DDWAF_OBJ_FLOAT:
+        _write(w, &obj->f64, sizeof obj->f64);
+        break;
+    case DDWAF_OBJ_BOOL:
+        _write_u8(w, obj->boolean ? 1 : 0);
+        break;
+    case DDWAF_OBJ_STRING:
+        _write_str(w, obj->stringValue, obj->nbEntries);
+        break;
+    case DDWAF_OBJ_ARRAY:
+    case DDWAF_OBJ_MAP:
+        _write_u32(w, (uint32_t) obj->nbEntries);
+        for (uint64_t i = 0; i < obj->nbEntries && !w->overflow; i++) {
+            const ddwaf_object *child = &obj->array[i];
+            if (obj->type == DDWAF_OBJ_MAP) {
+                _write_str(w, child->parameterName,
+                           child->parameterNameLength);
+            }
+            _write_object(w, child, depth + 1);
+        }
+        break;
+    default: // INVALID, NULL
+        break;
+    }
+}
+
+// u32 record length | u64 wall clock time (ns since the epoch)
+// u64 native run time (ns) | u64 ddwaf_run duration (ns) | u8 flags
+// u32 handle id length, handle id | persistent value | ephemeral value
+static size_t _write_record(uint8_t *buf, const char *handle_id,
+                            size_t handle_id_len, int64_t total_ns,
+                            int64_t ddwaf_ns, uint8_t flags,
+                            const ddwaf_object *persistent,
+                            const ddwaf_object *ephemeral)
+{
+    struct writer w = {.p = buf, .end = buf + SLOW_CAPTURE_MAX_RECORD_SIZE};
+    struct timespec now;
+    uint64_t now_ns = 0;
+    if (timespec_get(&now, TIME_UTC) == TIME_UTC) {
+        now_ns = (uint64_t) now.tv_sec * 1000000000ULL +
+                 (uint64_t) now.tv_nsec;
+    }
+
+    _write_u32(&w, 0); // length, set below
+    _write_u64(&w, now_ns);
+    _write_u64(&w, (uint64_t) total_ns);
+    _write_u64(&w, (uint64_t) ddwaf_ns);
+    uint8_t *flags_p = w.p;
+    _write_u8(&w, flags);
+    _write_str(&w, handle_id, handle_id_len);
+    if (persistent) {
+        *flags_p |= FLAG_PERSISTENT;
+        _write_object(&w, persistent, 0);
+    }
+    if (ephemeral) {
+        *flags_p |= FLAG_EPHEMERAL;
+        _write_object(&w, ephemeral, 0);
+    }
+    if (w.overflow) {
+        return 0;
+    }
+    if (w.truncated) {
+        *flags_p |= FLAG_TRUNCATED;
+    }
+    uint32_t len = (uint32_t) (w.p - buf);
+    memcpy(buf, &len, sizeof len);
+    return len;
+}
+
+void slow_capture_record(const char *handle_id, size_t handle_id_len,
+                         int64_t total_ns, int64_t ddwaf_ns, bool timed_out,
+                         const ddwaf_object *persistent,
+                         const ddwaf_object *ephemeral)
+{
+    if (!COMPARE_AND_SWAP(&_busy, false, true)) {
+        return;
+    }
+    if (!_slots) {
+        goto end;
+    }
+
+    struct slot *slot = &_slots[_next_slot];
+    if (!slot->data) {
+        slot->data = malloc(SLOW_CAPTURE_MAX_RECORD_SIZE);
+        if (!slot->data) {
+            goto end;
+        }
+    }
+
+    uint8_t flags = timed_out ? FLAG_TIMED_OUT : 0;
+    size_t len = _write_record(slot->data, handle_id, handle_id_len, total_ns,
+                               ddwaf_ns, flags, persistent, ephemeral);
+    if (!len) { // too large; keep only the timings
+        len = _write_record(slot->data, handle_id, handle_id_len, total_ns,
+                            ddwaf_ns, flags | FLAG_TRUNCATED, NULL, NULL);
+    }
+    slot->len = len;
+    _next_slot = (_next_slot + 1) % _num_slots;
+
+end:
+    ATOMIC_CLEAR(&_busy);
+}
+
+// u32 magic "DDSC" | u16 version | u16 record count | records
+uint8_t *slow_capture_drain(size_t *len_p)
+{
+    while (!COMPARE_AND_SWAP(&_busy, false, true)) {
+    }
+
+    size_t len = DUMP_HEADER_SIZE;
+    for (size_t i = 0; i < _num_slots; i++) {
+        len += _slots[i].len;
+    }
+    uint8_t *out = malloc(len);
+    if (!out) {
+        goto end;
+    }
+
+    uint16_t version = DUMP_VERSION;
+    uint16_t count = 0;
+    uint8_t *p = out + DUMP_HEADER_SIZE;
+    for (size_t i = 0; i < _num_slots; i++) {
+        struct slot *slot = &_slots[(_next_slot + i) % _num_slots];
+        if (!slot->len) {
+            continue;
+        }
+        memcpy(p, slot->data, slot->len);
+        p += slot->len;
+        slot->len = 0;
+        count++;
+    }
+    memcpy(out, DUMP_MAGIC, 4);
+    memcpy(out + 4, &version, sizeof version);
+    memcpy(out + 6, &count, sizeof count);
+    *len_p = len;
+
+end:
+    ATOMIC_CLEAR(&_busy);
+    return out;
+}
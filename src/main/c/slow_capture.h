@@ -0,0 +1,48 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+#include <ddwaf.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Opt-in capture of the inputs of slow runs: runs whose ddwaf_run or native
+// time exceeds a threshold, or that time out, are sampled and their inputs
+// copied into a bounded ring (the oldest captures are overwritten), to be
+// drained with slow_capture_drain. See Waf.drainSlowRunCaptures() for the
+// format.
+
+#define SLOW_CAPTURE_DEFAULT_SLOTS 16
+// the dump has a u16 record count
+#define SLOW_CAPTURE_MAX_SLOTS UINT16_MAX
+#define SLOW_CAPTURE_DEFAULT_SAMPLE 1
+// the inputs are dropped from larger records
+#define SLOW_CAPTURE_MAX_RECORD_SIZE (64 * 1024)
+// longer strings are truncated
+#define SLOW_CAPTURE_MAX_STRING_SIZE 4096
+
+// threshold_ns 0 disables the capture; one slow run in sample_every is
+// captured
+void slow_capture_init(uint64_t threshold_ns, uint64_t sample_every,
+                       size_t slots);
+void slow_capture_shutdown(void);
+
+// cheap; whether the run should be captured (applies the sampling)
+bool slow_capture_wanted(int64_t total_ns, int64_t ddwaf_ns, bool timed_out);
+
+// never blocks: the capture is skipped if another one is in progress
+void slow_capture_record(const char *handle_id, size_t handle_id_len,
+                         int64_t total_ns, int64_t ddwaf_ns, bool timed_out,
+                         const ddwaf_object *persistent,
+                         const ddwaf_object *ephemeral);
+
+// the captures, oldest first, which are removed from the ring; NULL if out of
+// memory. To be freed by the caller
+uint8_t *slow_capture_drain(size_t *len);
@@ -8,300 +8,206 @@
 
 #include "utf16_utf8.h"
 #include "common.h"
-#include "json.h"
+#include "cpu_features.h"
+#include "java_call.h"
 #include "logging.h"
+#include "utf_transcode.h"
 #include <stdbool.h>
 #include <limits.h>
 #include <assert.h>
+#include <string.h>
 
-/* adapted from PHP code in ext/standard/html.c
- * (that I wrote back in the day, so no copyright problems) */
-
-#define MB_FAILURE(pos, advance)                                               \
-    do {                                                                       \
-        *cursor = pos + (advance);                                             \
-        *status = false;                                                       \
-        return 0;                                                              \
-    } while (0)
-
-#define CHECK_LEN(pos, chars_need) ((str_len - (pos)) >= (chars_need))
-
-#define UTF16_LEAD(c) ((c) >= 0xD800 && (c) <= 0xDBFF)
-#define UTF16_TRAIL(c) ((c) >= 0xDC00 && (c) <= 0xDFFF)
+#ifdef CPU_X86_64
+#include <immintrin.h>
+#elif defined(CPU_AARCH64)
+#include <arm_neon.h>
+#endif
 
-/* valid as single byte character or leading byte */
-#define UTF8_LEAD(c) ((c) < 0x80 || ((c) >= 0xC2 && (c) <= 0xF4))
-/* whether it's actually valid depends on other stuff;
- * this macro cannot check for non-shortest forms, surrogates or
- * code points above 0x10FFFF */
-#define UTF8_TRAIL(c) ((c) >= 0x80 && (c) <= 0xBF)
+// ASCII strings up to this size are widened on the stack and passed to
+// NewString; longer ones go through a byte[] and String(byte[], Charset),
+// which stores them as Latin-1 (compact strings) from JDK 9 on. Other
+// strings up to this size are also decoded on the stack
+#define SHORT_ASCII_LEN 128
 
-#define REPL_CHAR 0xFFFDU
+static struct j_method _string_init_charset;
+/* weak global reference; StandardCharsets won't be unloaded */
+static jobject _latin1_charset;
 
-static inline uint32_t
-_get_next_codepoint_utf16(const jchar *str, // jchar is unsigned
-                          size_t str_len /* in code units */, size_t *cursor,
-                          bool *status)
+void java_utf16_to_utf8_checked(JNIEnv *env, const jchar *in,
+                                jsize length /* in code units*/,
+                                uint8_t **out_p, size_t *out_len_p)
 {
-    size_t pos = *cursor;
-    uint32_t codepoint;
+    // the output length is computed first, so it's written in one pass.
+    // Cannot overflow (jsize is an int, and at most 3 bytes per code unit)
+    size_t out_len = utf16_to_utf8_length(in, (size_t) length);
 
-    *status = true;
-    assert(pos <= str_len);
-    if (!CHECK_LEN(pos, 1)) {
-        MB_FAILURE(pos, 1);
+    uint8_t *out = malloc(out_len + 1);
+    if (!out) {
+        JNI(ThrowNew, jcls_rte, "out of memory");
+        return;
     }
 
-    jchar c = str[pos];
-    if (!UTF16_LEAD(c)) {
-        if (UTF16_TRAIL(c)) {
-            MB_FAILURE(pos, 1);
-        }
-        codepoint = c;
-        pos++;
-    } else { // leading code unit
-        if (!CHECK_LEN(pos, 2)) {
-            // leading code unit without pair (strings ends)
-            MB_FAILURE(pos, 1);
-        }
+    size_t written = utf16_to_utf8(in, (size_t) length, out, out_len);
+    assert(written == out_len);
+    (void) written;
 
-        jchar c2 = str[pos + 1];
-        if (!UTF16_TRAIL(c2)) {
-            MB_FAILURE(pos, 1);
-        }
+    out[out_len] = '\0';
+    *out_p = out;
+    if (out_len_p) {
+        *out_len_p = out_len;
+    }
+}
 
-        codepoint = 0x10000 + ((c - 0xD800) * 0x400 + (c2 - 0xDC00));
-        pos += 2;
+void utf16_utf8_init_checked(JNIEnv *env)
+{
+    if (!java_meth_init_checked(env, &_string_init_charset, "java/lang/String",
+                                "<init>", "([BLjava/nio/charset/Charset;)V",
+                                JMETHOD_CONSTRUCTOR)) {
+        return;
     }
 
-    *cursor = pos;
-    return codepoint;
+    jclass charsets_cls = JNI(FindClass, "java/nio/charset/StandardCharsets");
+    if (!charsets_cls) {
+        return;
+    }
+    _latin1_charset = java_static_field_checked(
+            env, charsets_cls, "ISO_8859_1", "Ljava/nio/charset/Charset;");
+    JNI(DeleteLocalRef, charsets_cls);
 }
 
-static inline uint32_t _get_next_codepoint_utf8(const uint8_t *str,
-                                                size_t str_len, size_t *cursor,
-                                                bool *status)
+void utf16_utf8_shutdown(JNIEnv *env)
 {
-    /* We'll follow strategy 2. from section 3.6.1 of UTR #36:
-     * "In a reported illegal byte sequence, do not include any
-     *  non-initial byte that encodes a valid character or is a leading
-     *  byte for a valid sequence." */
-    size_t pos = *cursor;
-    uint32_t codepoint;
-    uint8_t c;
-
-    *status = true;
-
-    c = str[pos];
-    if (c < 0x80) {
-        codepoint = c;
-        pos++;
-    } else if (c < 0xc2) {
-        MB_FAILURE(pos, 1);
-    } else if (c < 0xe0) {
-        if (!CHECK_LEN(pos, 2))
-            MB_FAILURE(pos, 1);
-
-        if (!UTF8_TRAIL(str[pos + 1])) {
-            MB_FAILURE(pos, UTF8_LEAD(str[pos + 1]) ? 1 : 2);
-        }
-        codepoint = ((c & 0x1fU) << 6) | (str[pos + 1] & 0x3f);
-        if (codepoint < 0x80) { /* non-shortest form */
-            MB_FAILURE(pos, 2);
-        }
-        pos += 2;
-    } else if (c < 0xf0) {
-        size_t avail = str_len - pos;
-
-        if (avail < 3 || !UTF8_TRAIL(str[pos + 1]) ||
-            !UTF8_TRAIL(str[pos + 2])) {
-            if (avail < 2 || UTF8_LEAD(str[pos + 1]))
-                MB_FAILURE(pos, 1);
-            else if (avail < 3 || UTF8_LEAD(str[pos + 2]))
-                MB_FAILURE(pos, 2);
-            else
-                MB_FAILURE(pos, 3);
-        }
+    java_meth_destroy(env, &_string_init_charset);
+    if (_latin1_charset) {
+        JNI(DeleteWeakGlobalRef, _latin1_charset);
+        _latin1_charset = NULL;
+    }
+}
+
+#ifdef CPU_X86_64
+static inline __m128i _load128(const uint8_t *p)
+{
+    return _mm_loadu_si128((const __m128i *) (const void *) p);
+}
+#endif
 
-        codepoint = ((c & 0x0fU) << 12) | ((str[pos + 1] & 0x3fU) << 6) |
-                    (str[pos + 2] & 0x3f);
-        if (codepoint < 0x800) { /* non-shortest form */
-            MB_FAILURE(pos, 3);
-        } else if (codepoint >= 0xd800 && codepoint <= 0xdfff) { /* surrogate */
-            MB_FAILURE(pos, 3);
+static bool _is_ascii(const uint8_t *in, size_t len)
+{
+    size_t i = 0;
+#ifdef CPU_X86_64
+    // SSE2 is part of x86-64
+    for (; i + 64 <= len; i += 64) {
+        __m128i v = _mm_or_si128(
+                _mm_or_si128(_load128(in + i), _load128(in + i + 16)),
+                _mm_or_si128(_load128(in + i + 32), _load128(in + i + 48)));
+        if (_mm_movemask_epi8(v)) {
+            return false;
         }
-        pos += 3;
-    } else if (c < 0xf5) {
-        size_t avail = str_len - pos;
-
-        if (avail < 4 || !UTF8_TRAIL(str[pos + 1]) ||
-            !UTF8_TRAIL(str[pos + 2]) || !UTF8_TRAIL(str[pos + 3])) {
-            if (avail < 2 || UTF8_LEAD(str[pos + 1]))
-                MB_FAILURE(pos, 1);
-            else if (avail < 3 || UTF8_LEAD(str[pos + 2]))
-                MB_FAILURE(pos, 2);
-            else if (avail < 4 || UTF8_LEAD(str[pos + 3]))
-                MB_FAILURE(pos, 3);
-            else
-                MB_FAILURE(pos, 4);
+    }
+    for (; i + 16 <= len; i += 16) {
+        if (_mm_movemask_epi8(_load128(in + i))) {
+            return false;
         }
-
-        codepoint = ((c & 0x07U) << 18) | ((str[pos + 1] & 0x3fU) << 12) |
-                    ((str[pos + 2] & 0x3fU) << 6) | (str[pos + 3] & 0x3f);
-        if (codepoint < 0x10000 || codepoint > 0x10FFFF) {
-            /* non-shortest form or outside range */
-            MB_FAILURE(pos, 4);
+    }
+#elif defined(CPU_AARCH64)
+    for (; i + 16 <= len; i += 16) {
+        if (vmaxvq_u8(vld1q_u8(in + i)) >= 0x80) {
+            return false;
         }
-        pos += 4;
-    } else {
-        MB_FAILURE(pos, 1);
     }
-
-    *cursor = pos;
-    return codepoint;
+#endif
+    uint8_t acc = 0;
+    for (; i < len; i++) {
+        acc |= in[i];
+    }
+    return acc < 0x80;
 }
 
-static inline size_t _write_utf8_codeunits(uint8_t *buf, uint32_t k)
+char *java_latin1_alloc_checked(JNIEnv *env, size_t len, jbyteArray *arr)
 {
-    size_t retval = 0;
-
-    /* assert(0x0 <= k <= 0x10FFFF); */
-
-    if (k < 0x80) {
-        buf[0] = (uint8_t) k;
-        retval = 1;
-    } else if (k < 0x800) {
-        buf[0] = (uint8_t) (0xc0 | (k >> 6));
-        buf[1] = 0x80 | (k & 0x3f);
-        retval = 2;
-    } else if (k < 0x10000) {
-        buf[0] = (uint8_t) (0xe0 | (k >> 12));
-        buf[1] = 0x80 | ((k >> 6) & 0x3f);
-        buf[2] = 0x80 | (k & 0x3f);
-        retval = 3;
-    } else {
-        buf[0] = (uint8_t) (0xf0 | (k >> 18));
-        buf[1] = 0x80 | ((k >> 12) & 0x3f);
-        buf[2] = 0x80 | ((k >> 6) & 0x3f);
-        buf[3] = 0x80 | (k & 0x3f);
-        retval = 4;
+    if (len > INT_MAX) {
+        JNI(ThrowNew, jcls_rte, "string is too long");
+        return NULL;
     }
-    /* UTF-8 has been restricted to max 4 bytes since RFC 3629 */
-
-    return retval;
+    *arr = JNI(NewByteArray, (jsize) len);
+    if (!*arr) {
+        return NULL;
+    }
+    char *buf = JNI(GetPrimitiveArrayCritical, *arr, NULL);
+    if (!buf) {
+        JNI(DeleteLocalRef, *arr);
+        if (!JNI(ExceptionCheck)) {
+            JNI(ThrowNew, jcls_rte, "GetPrimitiveArrayCritical failed");
+        }
+        return NULL;
+    }
+    return buf;
 }
 
-static inline size_t _write_utf16_codeunits(jchar *buf, uint32_t k)
+jstring java_latin1_to_jstring_checked(JNIEnv *env, jbyteArray arr,
+                                       char *buf)
 {
-    if (k < 0x10000) {
-        buf[0] = (jchar) k;
-        return 1;
-    } else {
-        buf[0] = 0xD800 | ((k & 0xFFFF) >> 10); // high 10 bits excl over bit 20
-        buf[1] = 0xDC00 | (k & 0x3FF);          // low 10 bits
-        return 2;
+    JNI(ReleasePrimitiveArrayCritical, arr, buf, 0);
+    jstring ret = java_meth_call(env, &_string_init_charset, NULL, arr,
+                                 _latin1_charset);
+    JNI(DeleteLocalRef, arr);
+    if (JNI(ExceptionCheck)) {
+        return NULL;
     }
+    return ret;
 }
 
-void java_utf16_to_utf8_checked(JNIEnv *env, const jchar *in,
-                                jsize length /* in code units*/,
-                                uint8_t **out_p, size_t *out_len_p)
+static jstring _ascii_to_jstring_checked(JNIEnv *env, const uint8_t *in,
+                                         size_t len)
 {
-    assert(sizeof(jsize) < sizeof(size_t));
-
-    // let's be optimistic and assume the input string is all ascii
-    // +3 because we always require 4 bytes before writing
-    size_t out_cap = (size_t) length + 3; // not including NUL
-    size_t out_len = 0;
-
-    // Cannot overflow (jsize is an int)
-    uint8_t *out = malloc(out_cap + 1);
-    if (!out) {
-        JNI(ThrowNew, jcls_rte, "out of memory");
-        return;
-    }
-
-    size_t in_cursor = 0;
-    while (in_cursor < (size_t) length) {
-        size_t out_left = out_cap - out_len;
-        if (out_left < 4) {
-            out_cap *= 2;
-            uint8_t *new_out = realloc(out, out_cap + 1);
-            if (!new_out) {
-                free(out);
-                JNI(ThrowNew, jcls_rte, "out of memory");
-                return;
-            }
-            out = new_out;
-        }
-
-        bool status;
-        uint32_t cp = _get_next_codepoint_utf16(in, (size_t) length, &in_cursor,
-                                                &status);
-        if (!status) {
-            cp = REPL_CHAR;
+    if (len <= SHORT_ASCII_LEN) {
+        jchar out[SHORT_ASCII_LEN];
+        for (size_t i = 0; i < len; i++) {
+            out[i] = in[i];
         }
-
-        out_len += _write_utf8_codeunits(&out[out_len], cp);
+        return JNI(NewString, out, (jsize) len);
     }
 
-#ifndef __clang_analyzer__
-    // this is safe. _write_utf8_codeunits can only write 4 chars, which
-    // would make at most out_cap == out_len. And we always allocate out_cap +1
-    out[out_len] = '\0';
-#endif
-    *out_p = out;
-    if (out_len_p) {
-        *out_len_p = out_len;
+    jbyteArray arr;
+    char *buf = java_latin1_alloc_checked(env, len, &arr);
+    if (!buf) {
+        return NULL;
     }
+    memcpy(buf, in, len);
+    return java_latin1_to_jstring_checked(env, arr, buf);
 }
 
 jstring java_utf8_to_jstring_checked(JNIEnv *env, const char *in_signed,
                                      size_t in_len)
 {
     const uint8_t *in = (const uint8_t *) in_signed;
+    if (_is_ascii(in, in_len)) {
+        return _ascii_to_jstring_checked(env, in, in_len);
+    }
+
     // at most we'll have as many UTF-16 code units as UTF-8 code units
     // (in case of only ASCII characters)
-    size_t out_cap = in_len; // not including NUL
-    size_t out_len = 0;
-
-    jchar *out;
-    if (out_cap > ((size_t) -1) / sizeof(*out) - 1) {
-        JNI(ThrowNew, jcls_rte, "string is too large");
-        return NULL;
-    }
-    out = malloc((out_cap + 1) * sizeof(*out));
-    if (!out) {
-        JNI(ThrowNew, jcls_rte, "out of memory");
+    if (in_len > INT_MAX) {
+        JNI(ThrowNew, jcls_rte, "string is too long");
         return NULL;
     }
 
-    size_t in_cursor = 0;
-    while (in_cursor < in_len) {
-        bool status;
-        uint32_t cp = _get_next_codepoint_utf8(in, in_len, &in_cursor, &status);
-
-        if (!status) {
-            cp = REPL_CHAR;
-        }
-
-        if (out_cap < out_len + 1 || (cp > 0xFFFF && out_cap < out_len + 2)) {
-            JNI(ThrowNew, jcls_rte, "output string is unexpectedly too short");
-            free(out);
+    jchar stack_out[SHORT_ASCII_LEN];
+    jchar *out = stack_out;
+    if (in_len > SHORT_ASCII_LEN) {
+        out = malloc(in_len * sizeof(*out));
+        if (!out) {
+            JNI(ThrowNew, jcls_rte, "out of memory");
             return NULL;
         }
-        out_len += _write_utf16_codeunits(&out[out_len], cp);
     }
 
-    out[out_len] = '\0';
-    if (out_len > INT_MAX) {
-        JNI(ThrowNew, jcls_rte, "string is too long");
+    size_t out_len = utf8_to_utf16(in, in_len, out);
+
+    jstring ret = JNI(NewString, out, (jsize) out_len);
+    if (out != stack_out) {
         free(out);
-        return NULL;
     }
-
-    jstring ret = JNI(NewString, out, (jint) out_len);
-    free(out);
     return ret;
 }
 
@@ -375,73 +281,3 @@ char *java_to_utf8_limited_checked(JNIEnv *env, jstring str, size_t *len,
 
     return (char *) out;
 }
-
-jstring java_json_to_jstring_checked(JNIEnv *env,
-                                     const struct json_segment *seg)
-{
-    struct json_iterator it = {.seg = seg};
-    // at most we'll have as many UTF-16 code units as UTF-8 code units
-    // (in case of only ASCII characters)
-    size_t out_cap = json_length(seg); // not including NUL
-    size_t out_len = 0;
-
-    jchar *out;
-    if (out_cap > ((size_t) -1) / sizeof(*out) - 1) {
-        JNI(ThrowNew, jcls_rte, "string is too large");
-        return NULL;
-    }
-    out = malloc((out_cap + 1) * sizeof(*out));
-    if (!out) {
-        JNI(ThrowNew, jcls_rte, "out of memory");
-        return NULL;
-    }
-
-    uint8_t buffer[256];
-    size_t buffer_len = 0;
-    size_t buffer_cursor = 0;
-    bool eof = false;
-    while (true) {
-        size_t left_in_buffer = buffer_len - buffer_cursor;
-        if (left_in_buffer < 4 && !eof) {
-            memcpy(buffer, buffer + buffer_cursor, left_in_buffer); // compact
-            size_t max_read = sizeof(buffer) - left_in_buffer;
-            size_t read = json_it_read(&it, (char *) (buffer + left_in_buffer),
-                                       max_read);
-            buffer_cursor = 0;
-            buffer_len = left_in_buffer + read;
-            if (read < max_read) {
-                eof = true;
-            }
-            left_in_buffer = buffer_len;
-        }
-        if (left_in_buffer == 0) {
-            break;
-        }
-
-        bool status;
-        uint32_t cp = _get_next_codepoint_utf8(buffer, buffer_len,
-                                               &buffer_cursor, &status);
-
-        if (!status) {
-            cp = REPL_CHAR;
-        }
-
-        if (out_cap < out_len + 1 || (cp > 0xFFFF && out_cap < out_len + 2)) {
-            JNI(ThrowNew, jcls_rte, "output string is unexpectedly too short");
-            free(out);
-            return NULL;
-        }
-        out_len += _write_utf16_codeunits(&out[out_len], cp);
-    }
-
-    out[out_len] = '\0';
-    if (out_len > INT_MAX) {
-        JNI(ThrowNew, jcls_rte, "string is too long");
-        free(out);
-        return NULL;
-    }
-
-    jstring ret = JNI(NewString, out, (jint) out_len);
-    free(out);
-    return ret;
-}
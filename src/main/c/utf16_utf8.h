@@ -12,16 +12,24 @@
 #include <jni.h>
 #include <stdint.h>
 #include <stdlib.h>
-#include "json.h"
 
 void java_utf16_to_utf8_checked(JNIEnv *env, const jchar *in, jsize length,
                                 uint8_t **out_p, size_t *out_len_p);
 jstring java_utf8_to_jstring_checked(JNIEnv *env, const char *in,
                                      size_t in_len);
+
+void utf16_utf8_init_checked(JNIEnv *env);
+void utf16_utf8_shutdown(JNIEnv *env);
+
+// Two-step creation of a String from Latin-1 (e.g. ASCII) chars, for callers
+// that can write them directly: the caller fills the len bytes returned by
+// java_latin1_alloc_checked, which is a critical region (no JNI calls allowed)
+// until java_latin1_to_jstring_checked is called with arr and the buffer
+char *java_latin1_alloc_checked(JNIEnv *env, size_t len, jbyteArray *arr);
+jstring java_latin1_to_jstring_checked(JNIEnv *env, jbyteArray arr,
+                                       char *buf);
 char *java_to_utf8_checked(JNIEnv *env, jstring str, size_t *utf8_out_len);
 char *java_to_utf8_limited_checked(JNIEnv *env, jstring str, size_t *len,
                                    int max_len);
-jstring java_json_to_jstring_checked(JNIEnv *env,
-                                     const struct json_segment *seg);
 
 #endif
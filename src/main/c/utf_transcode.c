@@ -0,0 +1,643 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#include "utf_transcode.h"
+#include "cpu_features.h"
+#include <stdbool.h>
+
+#ifdef CPU_X86_64
+#include <immintrin.h>
+#elif defined(CPU_AARCH64)
+#include <arm_neon.h>
+#endif
+
+#define UTF16_LEAD(c) ((c) >= 0xD800 && (c) <= 0xDBFF)
+#define UTF16_TRAIL(c) ((c) >= 0xDC00 && (c) <= 0xDFFF)
+
+#ifdef _MSC_VER
+#define ALWAYS_INLINE __forceinline
+#else
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+// Code units processed per iteration of the vector loops
+#define BLOCK 8
+// Vector loops accumulate per lane in signed 16-bit counters, which decrease
+// by at most 2 per iteration; flush them before they can overflow
+#define FLUSH_ITERATIONS 8192
+
+/* Output length
+ *
+ * Each code unit below 0x80 yields 1 byte, below 0x800 2 bytes and otherwise
+ * 3 bytes. That includes unpaired surrogates (U+FFFD is 3 bytes too). A lead
+ * surrogate followed by a trail surrogate yields 4 bytes for the pair, so the
+ * lead is counted as 3 - 2. This only looks at adjacent code units, so the
+ * input can be split anywhere. */
+
+static size_t _utf8_length_scalar(const uint16_t *in, size_t len)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint16_t c = in[i];
+        if (c < 0x80) {
+            total += 1;
+        } else if (c < 0x800) {
+            total += 2;
+        } else if (UTF16_LEAD(c) && i + 1 < len && UTF16_TRAIL(in[i + 1])) {
+            total += 1;
+        } else {
+            total += 3;
+        }
+    }
+    return total;
+}
+
+#ifdef CPU_X86_64
+static inline __m128i _load_u16x8(const uint16_t *p)
+{
+    return _mm_loadu_si128((const __m128i *) (const void *) p);
+}
+
+static inline int32_t _hsum_i16x8(__m128i acc)
+{
+    __m128i s = _mm_madd_epi16(acc, _mm_set1_epi16(1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+// SSE2 is part of x86-64. Handles blocks while the code unit after the block
+// can be read (for the surrogate pair check); returns the units consumed
+static size_t _utf8_length_vector(const uint16_t *in, size_t len,
+                                  size_t *total)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max1 = _mm_set1_epi16(0x7F);
+    const __m128i max2 = _mm_set1_epi16(0x7FF);
+    const __m128i sur_mask = _mm_set1_epi16((short) 0xFC00);
+    const __m128i lead = _mm_set1_epi16((short) 0xD800);
+    const __m128i trail = _mm_set1_epi16((short) 0xDC00);
+
+    size_t i = 0;
+    while (i + BLOCK < len) {
+        // every lane starts at 3 bytes and gets -1 per mask below
+        __m128i acc = zero;
+        size_t n = 0;
+        for (; n < FLUSH_ITERATIONS && i + BLOCK < len; n++, i += BLOCK) {
+            __m128i v = _load_u16x8(in + i);
+            __m128i next = _load_u16x8(in + i + 1);
+            __m128i is1 = _mm_cmpeq_epi16(_mm_subs_epu16(v, max1), zero);
+            __m128i is2 = _mm_cmpeq_epi16(_mm_subs_epu16(v, max2), zero);
+            __m128i pair = _mm_and_si128(
+                    _mm_cmpeq_epi16(_mm_and_si128(v, sur_mask), lead),
+                    _mm_cmpeq_epi16(_mm_and_si128(next, sur_mask), trail));
+            acc = _mm_add_epi16(acc, _mm_add_epi16(is1, is2));
+            acc = _mm_add_epi16(acc, _mm_add_epi16(pair, pair));
+        }
+        *total += (size_t) ((int64_t) (3 * BLOCK * n) + _hsum_i16x8(acc));
+    }
+    return i;
+}
+
+static inline bool _ascii_u16x16(const uint16_t *in, __m128i *packed)
+{
+    __m128i a = _load_u16x8(in);
+    __m128i b = _load_u16x8(in + 8);
+    __m128i hi = _mm_subs_epu16(_mm_or_si128(a, b), _mm_set1_epi16(0x7F));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(hi, _mm_setzero_si128())) !=
+        0xFFFF) {
+        return false;
+    }
+    *packed = _mm_packus_epi16(a, b);
+    return true;
+}
+
+static inline void _store_u8x16(uint8_t *out, __m128i v)
+{
+    _mm_storeu_si128((__m128i *) (void *) out, v);
+}
+#elif defined(CPU_AARCH64)
+static size_t _utf8_length_vector(const uint16_t *in, size_t len,
+                                  size_t *total)
+{
+    const uint16x8_t max1 = vdupq_n_u16(0x7F);
+    const uint16x8_t max2 = vdupq_n_u16(0x7FF);
+    const uint16x8_t sur_mask = vdupq_n_u16(0xFC00);
+    const uint16x8_t lead = vdupq_n_u16(0xD800);
+    const uint16x8_t trail = vdupq_n_u16(0xDC00);
+
+    size_t i = 0;
+    while (i + BLOCK < len) {
+        // every lane starts at 3 bytes and gets -1 per mask below
+        int16x8_t acc = vdupq_n_s16(0);
+        size_t n = 0;
+        for (; n < FLUSH_ITERATIONS && i + BLOCK < len; n++, i += BLOCK) {
+            uint16x8_t v = vld1q_u16(in + i);
+            uint16x8_t next = vld1q_u16(in + i + 1);
+            uint16x8_t is1 = vcleq_u16(v, max1);
+            uint16x8_t is2 = vcleq_u16(v, max2);
+            uint16x8_t pair = vandq_u16(
+                    vceqq_u16(vandq_u16(v, sur_mask), lead),
+                    vceqq_u16(vandq_u16(next, sur_mask), trail));
+            acc = vaddq_s16(acc, vreinterpretq_s16_u16(vaddq_u16(is1, is2)));
+            acc = vaddq_s16(acc, vreinterpretq_s16_u16(vaddq_u16(pair, pair)));
+        }
+        *total += (size_t) ((int64_t) (3 * BLOCK * n) + vaddlvq_s16(acc));
+    }
+    return i;
+}
+
+static inline bool _ascii_u16x16(const uint16_t *in, uint8x16_t *packed)
+{
+    uint16x8_t a = vld1q_u16(in);
+    uint16x8_t b = vld1q_u16(in + 8);
+    if (vmaxvq_u16(vorrq_u16(a, b)) >= 0x80) {
+        return false;
+    }
+    *packed = vcombine_u8(vmovn_u16(a), vmovn_u16(b));
+    return true;
+}
+
+static inline void _store_u8x16(uint8_t *out, uint8x16_t v)
+{
+    vst1q_u8(out, v);
+}
+#endif
+
+#if defined(CPU_X86_64) || defined(CPU_AARCH64)
+static size_t _utf8_length_simd(const uint16_t *in, size_t len)
+{
+    size_t total = 0;
+    size_t i = _utf8_length_vector(in, len, &total);
+    return total + _utf8_length_scalar(in + i, len - i);
+}
+#endif
+
+/* Conversion */
+
+// converts until at least end (which is <= len); returns the new position
+static inline size_t _convert_until(const uint16_t *in, size_t len, size_t i,
+                                   size_t end, uint8_t **out_p)
+{
+    uint8_t *out = *out_p;
+    while (i < end) {
+        uint32_t c = in[i];
+        if (c < 0x80) {
+            *out++ = (uint8_t) c;
+            i++;
+        } else if (c < 0x800) {
+            out[0] = (uint8_t) (0xc0 | (c >> 6));
+            out[1] = (uint8_t) (0x80 | (c & 0x3f));
+            out += 2;
+            i++;
+        } else if (!UTF16_LEAD(c) && !UTF16_TRAIL(c)) {
+            out[0] = (uint8_t) (0xe0 | (c >> 12));
+            out[1] = (uint8_t) (0x80 | ((c >> 6) & 0x3f));
+            out[2] = (uint8_t) (0x80 | (c & 0x3f));
+            out += 3;
+            i++;
+        } else if (UTF16_LEAD(c) && i + 1 < len && UTF16_TRAIL(in[i + 1])) {
+            uint32_t cp =
+                    0x10000 + ((c - 0xD800U) << 10) + (in[i + 1] - 0xDC00U);
+            out[0] = (uint8_t) (0xf0 | (cp >> 18));
+            out[1] = (uint8_t) (0x80 | ((cp >> 12) & 0x3f));
+            out[2] = (uint8_t) (0x80 | ((cp >> 6) & 0x3f));
+            out[3] = (uint8_t) (0x80 | (cp & 0x3f));
+            out += 4;
+            i += 2;
+        } else { // unpaired surrogate
+            out[0] = (uint8_t) (0xe0 | (UTF_REPL_CHAR >> 12));
+            out[1] = (uint8_t) (0x80 | ((UTF_REPL_CHAR >> 6) & 0x3f));
+            out[2] = (uint8_t) (0x80 | (UTF_REPL_CHAR & 0x3f));
+            out += 3;
+            i++;
+        }
+    }
+    *out_p = out;
+    return i;
+}
+
+static size_t _utf16_to_utf8_scalar(const uint16_t *in, size_t len,
+                                    uint8_t *out, size_t out_cap)
+{
+    (void) out_cap;
+    uint8_t *const out_start = out;
+    _convert_until(in, len, 0, len, &out);
+    return (size_t) (out - out_start);
+}
+
+#if defined(CPU_X86_64) || defined(CPU_AARCH64)
+// ASCII blocks are narrowed 16 code units at a time; other blocks are
+// converted one code point at a time. A surrogate pair can straddle the end
+// of a block, so the next block may start one unit later
+static size_t _utf16_to_utf8_simd(const uint16_t *in, size_t len,
+                                  uint8_t *out, size_t out_cap)
+{
+    (void) out_cap;
+    uint8_t *const out_start = out;
+    size_t i = 0;
+    while (i + 16 <= len) {
+#ifdef CPU_X86_64
+        __m128i packed;
+#else
+        uint8x16_t packed;
+#endif
+        if (_ascii_u16x16(in + i, &packed)) {
+            _store_u8x16(out, packed);
+            i += 16;
+            out += 16;
+            continue;
+        }
+        i = _convert_until(in, len, i, i + 16, &out);
+    }
+    _convert_until(in, len, i, len, &out);
+    return (size_t) (out - out_start);
+}
+#endif
+
+#ifdef CPU_X86_64
+// by mask of the lanes holding ASCII characters: shuffle that drops the high
+// byte of those lanes, and the number of bytes left
+static uint8_t _pack2_shuffle[256][16];
+static uint8_t _pack2_len[256];
+
+static void _init_pack2_shuffle(void)
+{
+    for (unsigned mask = 0; mask < 256; mask++) {
+        uint8_t *shuf = _pack2_shuffle[mask];
+        unsigned n = 0;
+        for (unsigned lane = 0; lane < 8; lane++) {
+            shuf[n++] = (uint8_t) (2 * lane);
+            if (!(mask & (1u << lane))) {
+                shuf[n++] = (uint8_t) (2 * lane + 1);
+            }
+        }
+        _pack2_len[mask] = (uint8_t) n;
+        for (; n < 16; n++) {
+            shuf[n] = 0x80;
+        }
+    }
+}
+
+// Converts 8 code units if they are all below 0x800 (at most 2 bytes each)
+// or all 3 bytes long (BMP, no surrogates). The former writes 16 bytes, even
+// if it advances out less, so it needs the room
+CPU_TARGET("ssse3")
+static inline bool _convert_block8_ssse3(__m128i v, uint8_t **out_p,
+                                         const uint8_t *out_end)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i low6 = _mm_set1_epi16(0x3F);
+    const __m128i cont = _mm_set1_epi16(0x80);
+    uint8_t *out = *out_p;
+
+    __m128i le7ff = _mm_cmpeq_epi16(
+            _mm_subs_epu16(v, _mm_set1_epi16(0x7FF)), zero);
+    if (_mm_movemask_epi8(le7ff) == 0xFFFF) {
+        if (out_end - out < 16) {
+            return false;
+        }
+        __m128i ascii =
+                _mm_cmpeq_epi16(_mm_subs_epu16(v, _mm_set1_epi16(0x7F)), zero);
+        __m128i b0 = _mm_or_si128(_mm_srli_epi16(v, 6), _mm_set1_epi16(0xC0));
+        __m128i b1 = _mm_or_si128(_mm_and_si128(v, low6), cont);
+        __m128i two = _mm_or_si128(b0, _mm_slli_epi16(b1, 8));
+        __m128i t = _mm_or_si128(_mm_and_si128(ascii, v),
+                                 _mm_andnot_si128(ascii, two));
+        unsigned mask = (unsigned) _mm_movemask_epi8(
+                                _mm_packs_epi16(ascii, zero)) &
+                        0xFF;
+        __m128i shuf = _mm_loadu_si128(
+                (const __m128i *) (const void *) _pack2_shuffle[mask]);
+        _store_u8x16(out, _mm_shuffle_epi8(t, shuf));
+        *out_p = out + _pack2_len[mask];
+        return true;
+    }
+
+    __m128i sur = _mm_cmpeq_epi16(
+            _mm_and_si128(v, _mm_set1_epi16((short) 0xF800)),
+            _mm_set1_epi16((short) 0xD800));
+    if (_mm_movemask_epi8(_mm_or_si128(le7ff, sur)) != 0) {
+        return false;
+    }
+
+    // b0 b1 of each code unit in its 16-bit lane, b2 of lane k in byte k
+    __m128i b0 = _mm_or_si128(_mm_srli_epi16(v, 12), _mm_set1_epi16(0xE0));
+    __m128i b1 = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 6), low6), cont);
+    __m128i b01 = _mm_or_si128(b0, _mm_slli_epi16(b1, 8));
+    __m128i b2 = _mm_packus_epi16(
+            _mm_or_si128(_mm_and_si128(v, low6), cont), zero);
+
+    // 24 bytes: b0 b1 b2 of lanes 0-4 and b0 of lane 5, then the rest
+    const __m128i shuf01_lo = _mm_setr_epi8(0, 1, -1, 2, 3, -1, 4, 5, -1, 6,
+                                            7, -1, 8, 9, -1, 10);
+    const __m128i shuf2_lo = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1,
+                                           -1, 3, -1, -1, 4, -1);
+    const __m128i shuf01_hi = _mm_setr_epi8(11, -1, 12, 13, -1, 14, 15, -1, -1,
+                                            -1, -1, -1, -1, -1, -1, -1);
+    const __m128i shuf2_hi = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1,
+                                           -1, -1, -1, -1, -1, -1);
+    _store_u8x16(out, _mm_or_si128(_mm_shuffle_epi8(b01, shuf01_lo),
+                                   _mm_shuffle_epi8(b2, shuf2_lo)));
+    _mm_storel_epi64((__m128i *) (void *) (out + 16),
+                     _mm_or_si128(_mm_shuffle_epi8(b01, shuf01_hi),
+                                  _mm_shuffle_epi8(b2, shuf2_hi)));
+    *out_p = out + 24;
+    return true;
+}
+
+CPU_TARGET("ssse3")
+static size_t _utf16_to_utf8_ssse3(const uint16_t *in, size_t len,
+                                   uint8_t *out, size_t out_cap)
+{
+    uint8_t *const out_start = out;
+    const uint8_t *const out_end = out + out_cap;
+    size_t i = 0;
+    while (i + 8 <= len) {
+        __m128i packed;
+        if (i + 16 <= len && _ascii_u16x16(in + i, &packed)) {
+            _store_u8x16(out, packed);
+            i += 16;
+            out += 16;
+            continue;
+        }
+        if (_convert_block8_ssse3(_load_u16x8(in + i), &out, out_end)) {
+            i += 8;
+            continue;
+        }
+        i = _convert_until(in, len, i, i + 8, &out);
+    }
+    _convert_until(in, len, i, len, &out);
+    return (size_t) (out - out_start);
+}
+#endif
+
+/* UTF-8 to UTF-16 */
+
+/* adapted from PHP code in ext/standard/html.c
+ * (that I wrote back in the day, so no copyright problems) */
+
+#define MB_FAILURE(pos, advance)                                               \
+    do {                                                                       \
+        *cursor = pos + (advance);                                             \
+        *status = false;                                                       \
+        return 0;                                                              \
+    } while (0)
+
+#define CHECK_LEN(pos, chars_need) ((str_len - (pos)) >= (chars_need))
+
+/* valid as single byte character or leading byte */
+#define UTF8_LEAD(c) ((c) < 0x80 || ((c) >= 0xC2 && (c) <= 0xF4))
+/* whether it's actually valid depends on other stuff;
+ * this macro cannot check for non-shortest forms, surrogates or
+ * code points above 0x10FFFF */
+#define UTF8_TRAIL(c) ((c) >= 0x80 && (c) <= 0xBF)
+
+static ALWAYS_INLINE uint32_t _get_next_codepoint_utf8(const uint8_t *str,
+                                                       size_t str_len,
+                                                       size_t *cursor,
+                                                       bool *status)
+{
+    /* We'll follow strategy 2. from section 3.6.1 of UTR #36:
+     * "In a reported illegal byte sequence, do not include any
+     *  non-initial byte that encodes a valid character or is a leading
+     *  byte for a valid sequence." */
+    size_t pos = *cursor;
+    uint32_t codepoint;
+    uint8_t c;
+
+    *status = true;
+
+    c = str[pos];
+    if (c < 0x80) {
+        codepoint = c;
+        pos++;
+    } else if (c < 0xc2) {
+        MB_FAILURE(pos, 1);
+    } else if (c < 0xe0) {
+        if (!CHECK_LEN(pos, 2))
+            MB_FAILURE(pos, 1);
+
+        if (!UTF8_TRAIL(str[pos + 1])) {
+            MB_FAILURE(pos, UTF8_LEAD(str[pos + 1]) ? 1 : 2);
+        }
+        codepoint = ((c & 0x1fU) << 6) | (str[pos + 1] & 0x3f);
+        if (codepoint < 0x80) { /* non-shortest form */
+            MB_FAILURE(pos, 2);
+        }
+        pos += 2;
+    } else if (c < 0xf0) {
+        size_t avail = str_len - pos;
+
+        if (avail < 3 || !UTF8_TRAIL(str[pos + 1]) ||
+            !UTF8_TRAIL(str[pos + 2])) {
+            if (avail < 2 || UTF8_LEAD(str[pos + 1]))
+                MB_FAILURE(pos, 1);
+            else if (avail < 3 || UTF8_LEAD(str[pos + 2]))
+                MB_FAILURE(pos, 2);
+            else
+                MB_FAILURE(pos, 3);
+        }
+
+        codepoint = ((c & 0x0fU) << 12) | ((str[pos + 1] & 0x3fU) << 6) |
+                    (str[pos + 2] & 0x3f);
+        if (codepoint < 0x800) { /* non-shortest form */
+            MB_FAILURE(pos, 3);
+        } else if (codepoint >= 0xd800 && codepoint <= 0xdfff) { /* surrogate */
+            MB_FAILURE(pos, 3);
+        }
+        pos += 3;
+    } else if (c < 0xf5) {
+        size_t avail = str_len - pos;
+
+        if (avail < 4 || !UTF8_TRAIL(str[pos + 1]) ||
+            !UTF8_TRAIL(str[pos + 2]) || !UTF8_TRAIL(str[pos + 3])) {
+            if (avail < 2 || UTF8_LEAD(str[pos + 1]))
+                MB_FAILURE(pos, 1);
+            else if (avail < 3 || UTF8_LEAD(str[pos + 2]))
+                MB_FAILURE(pos, 2);
+            else if (avail < 4 || UTF8_LEAD(str[pos + 3]))
+                MB_FAILURE(pos, 3);
+            else
+                MB_FAILURE(pos, 4);
+        }
+
+        codepoint = ((c & 0x07U) << 18) | ((str[pos + 1] & 0x3fU) << 12) |
+                    ((str[pos + 2] & 0x3fU) << 6) | (str[pos + 3] & 0x3f);
+        if (codepoint < 0x10000 || codepoint > 0x10FFFF) {
+            /* non-shortest form or outside range */
+            MB_FAILURE(pos, 4);
+        }
+        pos += 4;
+    } else {
+        MB_FAILURE(pos, 1);
+    }
+
+    *cursor = pos;
+    return codepoint;
+}
+
+static inline size_t _write_utf16_codeunits(uint16_t *buf, uint32_t k)
+{
+    if (k < 0x10000) {
+        buf[0] = (uint16_t) k;
+        return 1;
+    } else {
+        buf[0] = (uint16_t) (0xD800 | ((k & 0xFFFF) >> 10)); // high 10 bits
+        buf[1] = (uint16_t) (0xDC00 | (k & 0x3FF));          // low 10 bits
+        return 2;
+    }
+}
+
+/* Each output code unit takes at least one input byte, so out (with room for
+ * len units) is never ahead of the input position, and the 16-unit stores for
+ * the 16 bytes at i (with i + 16 <= len) stay within it, even when only some
+ * of the units are kept. */
+
+#ifdef CPU_X86_64
+static inline unsigned _ctz32(uint32_t v)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward(&idx, v);
+    return (unsigned) idx;
+#else
+    return (unsigned) __builtin_ctz(v);
+#endif
+}
+
+// widens the 16 bytes at in; returns how many of them are leading ASCII
+// characters (the number of units to keep)
+static inline size_t _widen_ascii_prefix(const uint8_t *in, uint16_t *out)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *) (const void *) in);
+    __m128i zero = _mm_setzero_si128();
+    _mm_storeu_si128((__m128i *) (void *) out, _mm_unpacklo_epi8(v, zero));
+    _mm_storeu_si128((__m128i *) (void *) (out + 8),
+                     _mm_unpackhi_epi8(v, zero));
+    unsigned mask = (unsigned) _mm_movemask_epi8(v);
+    return mask ? _ctz32(mask) : 16;
+}
+#elif defined(CPU_AARCH64)
+static inline unsigned _ctz64(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return (unsigned) idx;
+#else
+    return (unsigned) __builtin_ctzll(v);
+#endif
+}
+
+static inline size_t _widen_ascii_prefix(const uint8_t *in, uint16_t *out)
+{
+    uint8x16_t v = vld1q_u8(in);
+    vst1q_u16(out, vmovl_u8(vget_low_u8(v)));
+    vst1q_u16(out + 8, vmovl_high_u8(v));
+    // 4 bits per byte, set for non-ASCII bytes
+    uint8x16_t hi = vcgeq_u8(v, vdupq_n_u8(0x80));
+    uint64_t mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hi), 4)), 0);
+    return mask ? _ctz64(mask) / 4 : 16;
+}
+#endif
+
+// one code point at a time; the vector and table driven decoders tried for
+// the 2, 3 and 4-byte sequences lost to it on anything but Latin-1 text
+static size_t _utf8_to_utf16_scalar(const uint8_t *in, size_t len,
+                                    uint16_t *out)
+{
+    size_t out_len = 0;
+    size_t i = 0;
+    while (i < len) {
+        bool status;
+        uint32_t cp = _get_next_codepoint_utf8(in, len, &i, &status);
+        if (!status) {
+            cp = UTF_REPL_CHAR;
+        }
+        out_len += _write_utf16_codeunits(out + out_len, cp);
+    }
+    return out_len;
+}
+
+#if defined(CPU_X86_64) || defined(CPU_AARCH64)
+static size_t _utf8_to_utf16_simd(const uint8_t *in, size_t len,
+                                  uint16_t *out)
+{
+    // strings get here only when they have non-ASCII characters (ASCII-only
+    // ones are built from the bytes directly), typically after an ASCII
+    // prefix; once past it, going back and forth between the vector and the
+    // scalar code costs more than it saves
+    size_t i = 0;
+    while (i + 16 <= len) {
+        size_t n = _widen_ascii_prefix(in + i, out + i);
+        i += n;
+        if (n < 16) {
+            break;
+        }
+    }
+    return i + _utf8_to_utf16_scalar(in + i, len - i, out + i);
+}
+#endif
+
+static const struct utf_transcode_impl _impls[] = {
+        {"scalar", _utf8_length_scalar, _utf16_to_utf8_scalar,
+         _utf8_to_utf16_scalar, 0},
+#ifdef CPU_X86_64
+        {"sse2", _utf8_length_simd, _utf16_to_utf8_simd, _utf8_to_utf16_simd,
+         CPU_FEATURE_SSE2},
+        // a pshufb decoder for 2-byte sequences lost to the sse2 one as soon
+        // as the text mixed in 3 and 4-byte sequences
+        {"ssse3", _utf8_length_simd, _utf16_to_utf8_ssse3,
+         _utf8_to_utf16_simd, CPU_FEATURE_SSSE3},
+#endif
+#ifdef CPU_AARCH64
+        {"neon", _utf8_length_simd, _utf16_to_utf8_simd, _utf8_to_utf16_simd,
+         CPU_FEATURE_NEON},
+#endif
+};
+
+const struct utf_transcode_impl *utf_transcode_impl = &_impls[0];
+
+const struct utf_transcode_impl *utf_transcode_impls(size_t *count)
+{
+    *count = sizeof(_impls) / sizeof(_impls[0]);
+    return _impls;
+}
+
+void utf_transcode_init(void)
+{
+#ifdef CPU_X86_64
+    // the tables are small, and the benchmarks run every implementation
+    _init_pack2_shuffle();
+#endif
+    // implementations are listed from slowest to fastest; a level reuses the
+    // function of the level below where it has nothing faster
+    for (size_t i = 0; i < sizeof(_impls) / sizeof(_impls[0]); i++) {
+        if (cpu_has(_impls[i].required_features)) {
+            utf_transcode_impl = &_impls[i];
+        }
+    }
+}
+
+size_t utf16_to_utf8_length(const uint16_t *in, size_t len)
+{
+    return utf_transcode_impl->utf8_length(in, len);
+}
+
+size_t utf16_to_utf8(const uint16_t *in, size_t len, uint8_t *out,
+                     size_t out_cap)
+{
+    return utf_transcode_impl->utf16_to_utf8(in, len, out, out_cap);
+}
+
+size_t utf8_to_utf16(const uint8_t *in, size_t len, uint16_t *out)
+{
+    return utf_transcode_impl->utf8_to_utf16(in, len, out);
+}
@@ -0,0 +1,49 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Transcoding between UTF-16 (Java strings) and UTF-8, independent of JNI.
+// Invalid input (e.g. unpaired surrogates) is replaced with U+FFFD.
+
+#define UTF_REPL_CHAR 0xFFFDU
+
+struct utf_transcode_impl {
+    const char *name;
+    size_t (*utf8_length)(const uint16_t *in, size_t len);
+    size_t (*utf16_to_utf8)(const uint16_t *in, size_t len, uint8_t *out,
+                            size_t out_cap);
+    size_t (*utf8_to_utf16)(const uint8_t *in, size_t len, uint16_t *out);
+    uint32_t required_features; // CPU_FEATURE_*
+};
+
+extern const struct utf_transcode_impl *utf_transcode_impl;
+
+// all implementations compiled in, including those the CPU may not support
+const struct utf_transcode_impl *utf_transcode_impls(size_t *count);
+
+// selects the fastest implementation supported; requires cpu_features_init()
+void utf_transcode_init(void);
+
+// The functions below use the selected implementation.
+
+// exact number of bytes utf16_to_utf8 writes for the len code units in in
+size_t utf16_to_utf8_length(const uint16_t *in, size_t len);
+
+// out_cap must be at least utf16_to_utf8_length(in, len); returns the number
+// of bytes written (that length)
+size_t utf16_to_utf8(const uint16_t *in, size_t len, uint8_t *out,
+                     size_t out_cap);
+
+// out must have room for len code units (the most len bytes can decode to);
+// returns the number of code units written. Invalid sequences are replaced
+// following strategy 2 of section 3.6.1 of UTR #36
+size_t utf8_to_utf16(const uint8_t *in, size_t len, uint16_t *out);
@@ -10,16 +10,27 @@
 #include "jni/com_datadog_ddwaf_Waf.h"
 #include "jni/com_datadog_ddwaf_WafContext.h"
 #include "jni/com_datadog_ddwaf_WafBuilder.h"
+#include "jni/com_datadog_ddwaf_WafDiagnostics.h"
 #include "jni/com_datadog_ddwaf_WafHandle.h"
 #include "common.h"
 #include "java_call.h"
 #include "json.h"
+#include "json_parse.h"
+#include "object_hash.h"
 #include "utf16_utf8.h"
 #include "output.h"
 #include "logging.h"
 #include "metrics.h"
 #include "cs_wrapper.h"
+#include "data_config.h"
 #include "compat.h"
+#include "atomics.h"
+#include "base64.h"
+#include "gzip.h"
+#include "schema_cache.h"
+#include "slow_capture.h"
+#include "cpu_features.h"
+#include "utf_transcode.h"
 #include <ddwaf.h>
 #include <assert.h>
 #ifndef _MSC_VER
@@ -31,6 +42,7 @@
 #include <inttypes.h>
 #include <time.h>
 #include <limits.h>
+#include <stdio.h>
 
 struct _limits {
     int64_t general_budget_in_us;
@@ -38,15 +50,14 @@ struct _limits {
     int max_depth;
     int max_elements;
     int max_string_size;
-    char _padding[4];
+    bool timeout_as_result;
+    char _padding[3];
 };
 
 // suffix _checked means if a function fails it leaves a pending exception
 static bool _check_init(JNIEnv *env);
 static void _deinitialize(JNIEnv *env);
 static bool _cache_references(JNIEnv *env);
-static void _dispose_of_action_enums(JNIEnv *env);
-static void _dispose_of_result_with_data_fields(JNIEnv *env);
 static void _dispose_of_cache_references(JNIEnv *env);
 struct _init_or_update {
     bool is_update;
@@ -77,20 +88,33 @@ static bool _set_waf_context_context_checked(JNIEnv *env,
                                              ddwaf_context ctx);
 static bool _get_time_checked(JNIEnv *env, struct timespec *time);
 static inline int64_t _timespec_diff_ns(struct timespec a, struct timespec b);
-static int64_t _get_pw_run_timeout_checked(JNIEnv *env);
+static char *_get_string_property_checked(JNIEnv *env, const char *name);
+static long long _get_long_property_checked(JNIEnv *env, const char *name,
+                                            long long def);
 static size_t get_run_budget(int64_t rem_gen_budget_in_us,
                              struct _limits *limits);
 static int64_t get_remaining_budget(struct timespec start, struct timespec end,
                                     struct _limits *limits);
 static void _throw_pwaf_exception(JNIEnv *env, DDWAF_RET_CODE retcode);
 static void _throw_pwaf_timeout_exception(JNIEnv *env);
+static jobject _report_timeout_checked(JNIEnv *env,
+                                       const struct _limits *limits,
+                                       jobject result_buffer,
+                                       jobjectArray result_refs);
 static void _update_metrics(JNIEnv *env, jobject metrics_obj,
                             const ddwaf_object *ret);
+static void _capture_slow_run(JNIEnv *env, jobject waf_context_obj,
+                              struct timespec start,
+                              const ddwaf_object *ddwaf_result, bool timed_out,
+                              const ddwaf_object *persistent,
+                              const ddwaf_object *ephemeral);
 static bool _convert_ddwaf_config_checked(JNIEnv *env, jobject jconfig,
                                           ddwaf_config *out_config);
 static void _dispose_of_ddwaf_config(ddwaf_config *cfg);
 static jobject _create_result_checked(JNIEnv *env, DDWAF_RET_CODE code,
-                                      const ddwaf_object *ddwaf_result);
+                                      const ddwaf_object *ddwaf_result,
+                                      jobject result_buffer,
+                                      jobjectArray result_refs);
 static inline bool _has_events(const ddwaf_object *res);
 static void consume_json_and_free(const ddwaf_object *obj);
 
@@ -104,26 +128,22 @@ jclass jcls_iae;
 jmethodID rte_constr_cause;
 
 static struct j_method _create_exception;
-static struct j_method _timeout_exception_init;
-/* these three are weak global references
- * we don't need strong ones because they are static fields of a class that
- * won't be unloaded as long as the Waf class is loaded */
-static jobject _action_ok;
-static jobject _action_match;
-static jobject _result_with_data_ok_null;
-static jobject _result_with_data_empty_map;
-static struct j_method result_with_data_init;
+static struct j_method _create_timeout_exception;
 static jfieldID _limit_max_depth;
 static jfieldID _limit_max_elements;
 static jfieldID _limit_max_string_size;
 static jfieldID _limit_general_budget_in_us;
 static jfieldID _limit_run_budget_in_us;
+static jfieldID _limit_timeout_as_result;
 
 static jfieldID _config_key_regex;
 static jfieldID _config_value_regex;
 
 static jfieldID _waf_context_ptr;
+static jfieldID _waf_context_handle;
+static jfieldID _waf_handle_unique_name;
 static jfieldID _builder_ptr;
+static jfieldID _builder_summary_diagnostics;
 
 jclass charSequence_cls;
 struct j_method charSequence_length;
@@ -179,14 +199,6 @@ static bool _init_ok;
 
 #ifdef _MSC_VER
 #include <crtdbg.h>
-#define FULL_MEMORY_BARRIER _ReadWriteBarrier
-_STATIC_ASSERT(sizeof(bool) == 1);
-#define COMPARE_AND_SWAP(ptr, old, new)                                        \
-    _InterlockedCompareExchange8(ptr, new, old)
-#else
-#define FULL_MEMORY_BARRIER __sync_synchronize
-#define COMPARE_AND_SWAP(ptr, old, new)                                        \
-    __sync_bool_compare_and_swap(ptr, old, new)
 #endif
 
 // TODO move global intialization/deinitialization to another file
@@ -197,6 +209,10 @@ JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved)
     JNIEnv *env;
     (*vm)->GetEnv(vm, (void **) &env, JNI_VERSION_1_6);
 
+    // the SIMD kernels are selected once the properties can be read; until
+    // then, the scalar implementations are used
+    cpu_features_init();
+
     bool cache_ref_ok = _cache_references(env);
     if (!cache_ref_ok) {
         if (!JNI(ExceptionCheck)) {
@@ -251,12 +267,87 @@ JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved)
         goto error;
     }
 
+    utf16_utf8_init_checked(env);
+    if (JNI(ExceptionCheck)) {
+        java_wrap_exc("Failed initializing references for utf16_utf8.c");
+        goto error;
+    }
+
     cs_wrapper_init(env);
 
-    pw_run_timeout = _get_pw_run_timeout_checked(env);
+    char *cpu_level_prop =
+            _get_string_property_checked(env, "DD_APPSEC_WAF_CPU_LEVEL");
     if (JNI(ExceptionCheck)) {
         goto error;
     }
+    if (cpu_level_prop && !cpu_features_limit(cpu_level_prop)) {
+        JAVA_LOG(DDWAF_LOG_WARN, "Unknown CPU level '%s'; using %s",
+                 cpu_level_prop, cpu_level());
+    }
+    free(cpu_level_prop);
+    json_escape_init();
+    base64_init();
+    utf_transcode_init();
+    JAVA_LOG(DDWAF_LOG_INFO,
+             "CPU level %s; kernels: base64 %s, json_escape %s, "
+             "utf_transcode %s",
+             cpu_level(), base64_enc_impl->name, json_escape_impl->name,
+             utf_transcode_impl->name);
+
+    pw_run_timeout = (int64_t) _get_long_property_checked(
+            env, "DD_APPSEC_WAF_TIMEOUT", DDWAF_RUN_TIMEOUT);
+    if (JNI(ExceptionCheck)) {
+        goto error;
+    }
+
+    long long gzip_level = _get_long_property_checked(
+            env, "DD_APPSEC_WAF_SCHEMA_GZIP_LEVEL", GZIP_DEFAULT_LEVEL);
+    if (JNI(ExceptionCheck)) {
+        goto error;
+    }
+    if (gzip_level < INT_MIN || gzip_level > INT_MAX ||
+        !gzip_set_level((int) gzip_level)) {
+        JAVA_LOG(DDWAF_LOG_WARN,
+                 "Unsupported %s compression level %lld; using the default",
+                 gzip_backend, gzip_level);
+    }
+
+    long long schema_cache_capacity =
+            _get_long_property_checked(env, "DD_APPSEC_WAF_SCHEMA_CACHE_SIZE",
+                                       SCHEMA_CACHE_DEFAULT_CAPACITY);
+    if (JNI(ExceptionCheck)) {
+        goto error;
+    }
+    schema_cache_init(
+            schema_cache_capacity > 0 ? (size_t) schema_cache_capacity : 0);
+
+    long long slow_run_threshold = _get_long_property_checked(
+            env, "DD_APPSEC_WAF_SLOW_RUN_THRESHOLD_US", 0);
+    if (JNI(ExceptionCheck)) {
+        goto error;
+    }
+    long long slow_run_sample = _get_long_property_checked(
+            env, "DD_APPSEC_WAF_SLOW_RUN_SAMPLE", SLOW_CAPTURE_DEFAULT_SAMPLE);
+    if (JNI(ExceptionCheck)) {
+        goto error;
+    }
+    long long slow_run_slots = _get_long_property_checked(
+            env, "DD_APPSEC_WAF_SLOW_RUN_SLOTS", SLOW_CAPTURE_DEFAULT_SLOTS);
+    if (JNI(ExceptionCheck)) {
+        goto error;
+    }
+    if (slow_run_slots > SLOW_CAPTURE_MAX_SLOTS) {
+        slow_run_slots = SLOW_CAPTURE_MAX_SLOTS;
+    }
+    if (slow_run_threshold > 0 && slow_run_slots > 0) {
+        slow_capture_init((uint64_t) slow_run_threshold * 1000ULL,
+                          slow_run_sample > 0 ? (uint64_t) slow_run_sample : 1,
+                          (size_t) slow_run_slots);
+        JAVA_LOG(DDWAF_LOG_INFO,
+                 "Capturing one in %lld runs slower than %lld us in %lld "
+                 "slots",
+                 slow_run_sample, slow_run_threshold, slow_run_slots);
+    }
 
     // probably not needed, as we piggyback on Java's synchronization
     FULL_MEMORY_BARRIER();
@@ -288,6 +379,129 @@ JNIEXPORT void JNICALL Java_com_datadog_ddwaf_Waf_deinitialize(JNIEnv *env,
     _deinitialize(env);
 }
 
+/*
+ * Class:     com_datadog_ddwaf_Waf
+ * Method:    getSchemaCacheHits
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL Java_com_datadog_ddwaf_Waf_getSchemaCacheHits(
+        JNIEnv *env, jclass clazz)
+{
+    UNUSED(env);
+    UNUSED(clazz);
+
+    return (jlong) schema_cache_hits();
+}
+
+/*
+ * Class:     com_datadog_ddwaf_Waf
+ * Method:    getSchemaCacheMisses
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL Java_com_datadog_ddwaf_Waf_getSchemaCacheMisses(
+        JNIEnv *env, jclass clazz)
+{
+    UNUSED(env);
+    UNUSED(clazz);
+
+    return (jlong) schema_cache_misses();
+}
+
+/*
+ * Class:     com_datadog_ddwaf_Waf
+ * Method:    getCpuLevel
+ * Signature: ()Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_com_datadog_ddwaf_Waf_getCpuLevel(JNIEnv *env,
+                                                                 jclass clazz)
+{
+    UNUSED(clazz);
+
+    if (!_check_init(env)) {
+        return NULL;
+    }
+
+    const char *level = cpu_level();
+    return java_utf8_to_jstring_checked(env, level, strlen(level));
+}
+
+/*
+ * Class:     com_datadog_ddwaf_Waf
+ * Method:    getSelectedKernels
+ * Signature: ()[Ljava/lang/String;
+ */
+JNIEXPORT jobjectArray JNICALL
+Java_com_datadog_ddwaf_Waf_getSelectedKernels(JNIEnv *env, jclass clazz)
+{
+    UNUSED(clazz);
+
+    if (!_check_init(env)) {
+        return NULL;
+    }
+
+    // kernel name, implementation name
+    const char *const kernels[] = {
+            "base64",        base64_enc_impl->name,
+            "json_escape",   json_escape_impl->name,
+            "utf_transcode", utf_transcode_impl->name,
+    };
+    const jsize count = (jsize) (sizeof(kernels) / sizeof(kernels[0]));
+
+    jobjectArray ret_jarr = JNI(NewObjectArray, count, string_cls, NULL);
+    if (!ret_jarr) {
+        return NULL;
+    }
+    for (jsize i = 0; i < count; i++) {
+        jstring jstr = java_utf8_to_jstring_checked(env, kernels[i],
+                                                    strlen(kernels[i]));
+        if (!jstr) {
+            return NULL;
+        }
+        JNI(SetObjectArrayElement, ret_jarr, i, jstr);
+        JNI(DeleteLocalRef, jstr);
+        if (JNI(ExceptionCheck)) {
+            return NULL;
+        }
+    }
+    return ret_jarr;
+}
+
+/*
+ * Class:     com_datadog_ddwaf_Waf
+ * Method:    drainSlowRunCaptures
+ * Signature: ()[B
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_datadog_ddwaf_Waf_drainSlowRunCaptures(JNIEnv *env, jclass clazz)
+{
+    UNUSED(clazz);
+
+    if (!_check_init(env)) {
+        return NULL;
+    }
+
+    size_t len;
+    uint8_t *dump = slow_capture_drain(&len);
+    if (!dump) {
+        JNI(ThrowNew, jcls_rte, "Could not allocate the slow run captures");
+        return NULL;
+    }
+    jbyteArray ret = NULL;
+    if (len > INT32_MAX) {
+        JNI(ThrowNew, jcls_rte, "Slow run captures too large");
+        goto end;
+    }
+    ret = JNI(NewByteArray, (jsize) len);
+    if (!ret) {
+        goto end;
+    }
+    JNI(SetByteArrayRegion, ret, 0, (jsize) len, (const jbyte *) dump);
+
+end:
+    free(dump);
+    return ret;
+}
+
 /*
  * Class:     com_datadog_ddwaf_Waf
  * Method:    getKnownAddresses
@@ -445,7 +659,9 @@ JNIEXPORT jlong JNICALL Java_com_datadog_ddwaf_WafContext_initWafContext(
 static jobject _run_waf_context_common(JNIEnv *env, jobject this,
                                        jobject persistent_data,
                                        jobject ephemeral_data,
-                                       jobject limits_obj, jobject metrics_obj)
+                                       jobject limits_obj, jobject metrics_obj,
+                                       jobject result_buffer,
+                                       jobjectArray result_refs)
 {
     jobject result = NULL;
     ddwaf_context context = NULL;
@@ -456,6 +672,7 @@ static jobject _run_waf_context_common(JNIEnv *env, jobject this,
     struct _limits limits;
     ddwaf_object ddwaf_result;
     struct timespec start;
+    bool timed_out = false;
 
     if (!_get_time_checked(env, &start)) {
         return NULL;
@@ -527,8 +744,11 @@ static jobject _run_waf_context_common(JNIEnv *env, jobject this,
                  "General budget of %" PRId64
                  " us exhausted after native conversion",
                  limits.general_budget_in_us);
-        _throw_pwaf_timeout_exception(env);
-        goto err;
+        result = _report_timeout_checked(env, &limits, result_buffer,
+                                         result_refs);
+        _capture_slow_run(env, this, start, NULL, true, persistent_input_ptr,
+                          ephemeral_input_ptr);
+        return result;
     }
 
     size_t run_budget = get_run_budget(rem_gen_budget_in_us, &limits);
@@ -538,16 +758,19 @@ static jobject _run_waf_context_common(JNIEnv *env, jobject this,
                       &ddwaf_result, run_budget);
     const ddwaf_object *timeout =
             ddwaf_object_find(&ddwaf_result, "timeout", 7);
-    if (timeout != NULL && timeout->type == DDWAF_OBJ_BOOL &&
-        ddwaf_object_get_bool(timeout)) {
-        _throw_pwaf_timeout_exception(env);
+    timed_out = timeout != NULL && timeout->type == DDWAF_OBJ_BOOL &&
+                ddwaf_object_get_bool(timeout);
+    if (timed_out) {
+        result = _report_timeout_checked(env, &limits, result_buffer,
+                                         result_refs);
         goto freeRet;
     }
 
     switch (ret_code) {
     case DDWAF_OK:
     case DDWAF_MATCH:
-        result = _create_result_checked(env, ret_code, &ddwaf_result);
+        result = _create_result_checked(env, ret_code, &ddwaf_result,
+                                        result_buffer, result_refs);
         break;
     case DDWAF_ERR_INTERNAL: {
         JAVA_LOG(DDWAF_LOG_ERROR, "libddwaf returned DDWAF_ERR_INTERNAL. "
@@ -566,6 +789,9 @@ static jobject _run_waf_context_common(JNIEnv *env, jobject this,
 
 freeRet:
     _update_metrics(env, metrics_obj, &ddwaf_result);
+    // the inputs are views into the Java buffers, which ddwaf_run didn't free
+    _capture_slow_run(env, this, start, &ddwaf_result, timed_out,
+                      persistent_input_ptr, ephemeral_input_ptr);
     ddwaf_object_free(&ddwaf_result);
 
     return result;
@@ -576,16 +802,18 @@ err:
 
 /*
  * Class:     com_datadog_ddwaf_WafContext
- * Method:    runWafContext
+ * Method:    runWafContextBinary
  * Signature:
- * (Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Lcom/datadog/ddwaf/Waf$Limits;Lcom/datadog/ddwaf/WafMetrics;)Lcom/datadog/ddwaf/Waf$ResultWithData;
+ * (Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Lcom/datadog/ddwaf/Waf$Limits;Lcom/datadog/ddwaf/WafMetrics;Ljava/nio/ByteBuffer;[Ljava/lang/Object;)Ljava/nio/ByteBuffer;
  */
-JNIEXPORT jobject JNICALL Java_com_datadog_ddwaf_WafContext_runWafContext(
+JNIEXPORT jobject JNICALL Java_com_datadog_ddwaf_WafContext_runWafContextBinary(
         JNIEnv *env, jobject this, jobject persistent_buffer,
-        jobject ephemeral_buffer, jobject limits_obj, jobject metrics_obj)
+        jobject ephemeral_buffer, jobject limits_obj, jobject metrics_obj,
+        jobject result_buffer, jobjectArray result_refs)
 {
     return _run_waf_context_common(env, this, persistent_buffer,
-                                   ephemeral_buffer, limits_obj, metrics_obj);
+                                   ephemeral_buffer, limits_obj, metrics_obj,
+                                   result_buffer, result_refs);
 }
 
 /*
@@ -625,6 +853,12 @@ static void _deinitialize(JNIEnv *env)
     }
 
     JAVA_LOG(DDWAF_LOG_DEBUG, "Deinitializing JNI library");
+
+    // logging goes first: the pending records are drained with the cached
+    // classes and charsets released below
+    ddwaf_set_log_cb(NULL, DDWAF_LOG_ERROR);
+    java_log_shutdown(env);
+
     _dispose_of_cache_references(env);
 
     // do not delete reference to jcls_rte, as _check_init uses it
@@ -634,93 +868,46 @@ static void _deinitialize(JNIEnv *env)
     //    }
 
     output_shutdown(env);
-
-    ddwaf_set_log_cb(NULL, DDWAF_LOG_ERROR);
-
-    java_log_shutdown(env);
+    utf16_utf8_shutdown(env);
+    slow_capture_shutdown();
 }
 
-#define RESULT_ENUM_DESCR "Lcom/datadog/ddwaf/Waf$Result;"
-static bool _fetch_action_enums(JNIEnv *env)
-{
-    bool ret = false;
-
-    jclass action_jclass = JNI(FindClass, "com/datadog/ddwaf/Waf$Result");
-    if (!action_jclass) {
-        goto error;
-    }
-
-    _action_ok = java_static_field_checked(env, action_jclass, "OK",
-                                           RESULT_ENUM_DESCR);
-    if (!_action_ok) {
-        goto error;
-    }
-    _action_match = java_static_field_checked(env, action_jclass, "MATCH",
-                                              RESULT_ENUM_DESCR);
-    if (!_action_match) {
-        goto error;
-    }
-
-    ret = true;
-
-error:
-    JNI(DeleteLocalRef, action_jclass);
-    if (!ret) {
-        _dispose_of_action_enums(env);
-    }
-    return ret;
-}
-
-#define RESULT_WITH_DATA_DESCR "Lcom/datadog/ddwaf/Waf$ResultWithData;"
-static bool _fetch_result_with_data_fields(JNIEnv *env)
+static bool _fetch_waf_context_fields(JNIEnv *env)
 {
     bool ret = false;
 
-    jclass result_with_data_jclass =
-            JNI(FindClass, "com/datadog/ddwaf/Waf$ResultWithData");
-    if (!result_with_data_jclass) {
+    jclass waf_handle_jclass = NULL;
+    jclass waf_context_jclass = JNI(FindClass, "com/datadog/ddwaf/WafContext");
+    if (!waf_context_jclass) {
         goto error;
     }
 
-    _result_with_data_ok_null = java_static_field_checked(
-            env, result_with_data_jclass, "OK_NULL", RESULT_WITH_DATA_DESCR);
-    if (!_result_with_data_ok_null) {
+    _waf_context_ptr = JNI(GetFieldID, waf_context_jclass, "ptr", "J");
+    if (!_waf_context_ptr) {
         goto error;
     }
-
-    _result_with_data_empty_map = java_static_field_checked(
-            env, result_with_data_jclass, "EMPTY_ACTIONS", "Ljava/util/Map;");
-    if (!_result_with_data_empty_map) {
+    _waf_context_handle = JNI(GetFieldID, waf_context_jclass, "wafHandle",
+                              "Lcom/datadog/ddwaf/WafHandle;");
+    if (!_waf_context_handle) {
         goto error;
     }
 
-    ret = true;
-
-error:
-    JNI(DeleteLocalRef, result_with_data_jclass);
-    if (!ret) {
-        _dispose_of_result_with_data_fields(env);
-    }
-    return ret;
-}
-
-static bool _fetch_waf_context_fields(JNIEnv *env)
-{
-    bool ret = false;
-
-    jclass waf_context_jclass = JNI(FindClass, "com/datadog/ddwaf/WafContext");
-    if (!waf_context_jclass) {
+    waf_handle_jclass = JNI(FindClass, "com/datadog/ddwaf/WafHandle");
+    if (!waf_handle_jclass) {
         goto error;
     }
-
-    _waf_context_ptr = JNI(GetFieldID, waf_context_jclass, "ptr", "J");
-    if (!_waf_context_ptr) {
+    _waf_handle_unique_name = JNI(GetFieldID, waf_handle_jclass, "uniqueName",
+                                  "Ljava/lang/String;");
+    if (!_waf_handle_unique_name) {
         goto error;
     }
 
     ret = true;
 error:
     JNI(DeleteLocalRef, waf_context_jclass);
+    if (waf_handle_jclass) {
+        JNI(DeleteLocalRef, waf_handle_jclass);
+    }
     return ret;
 }
 
@@ -737,6 +924,11 @@ static bool _fetch_builder_fields(JNIEnv *env)
     if (!_builder_ptr) {
         goto error;
     }
+    _builder_summary_diagnostics =
+            JNI(GetFieldID, builder_jclass, "summaryDiagnostics", "Z");
+    if (!_builder_summary_diagnostics) {
+        goto error;
+    }
 
     ret = true;
 error:
@@ -778,6 +970,11 @@ static bool _fetch_limit_fields(JNIEnv *env)
     if (!_limit_run_budget_in_us) {
         goto error;
     }
+    _limit_timeout_as_result =
+            JNI(GetFieldID, limits_jclass, "timeoutAsResult", "Z");
+    if (!_limit_timeout_as_result) {
+        goto error;
+    }
 
     ret = true;
 error:
@@ -846,29 +1043,6 @@ static bool _fetch_native_order_obj(JNIEnv *env)
     return true;
 }
 
-static void _dispose_of_action_enums(JNIEnv *env)
-{
-    if (_action_ok) {
-        JNI(DeleteWeakGlobalRef, _action_ok);
-        _action_ok = NULL;
-    }
-    if (_action_match) {
-        JNI(DeleteWeakGlobalRef, _action_match);
-        _action_match = NULL;
-    }
-}
-
-static void _dispose_of_result_with_data_fields(JNIEnv *env)
-{
-    if (_result_with_data_ok_null) {
-        JNI(DeleteWeakGlobalRef, _result_with_data_ok_null);
-        _result_with_data_ok_null = NULL;
-    }
-    if (_result_with_data_empty_map) {
-        JNI(DeleteWeakGlobalRef, _result_with_data_empty_map);
-        _result_with_data_empty_map = NULL;
-    }
-}
 
 /*
  * Caches a Java class reference as a weak global reference using JNI.
@@ -962,36 +1136,71 @@ error:
     return result;
 }
 
-JNIEXPORT jboolean JNICALL
-Java_com_datadog_ddwaf_WafBuilder_addOrUpdateConfigNative(
-        JNIEnv *env, jclass clazz, jobject builder, jstring path,
-        jobject configuration, jobject diagnostics)
+// the (independent) seeds of the two halves of a config digest
+#define CONFIG_DIGEST_SEED_LO UINT64_C(0x243F6A8885A308D3)
+#define CONFIG_DIGEST_SEED_HI UINT64_C(0x13198A2E03707344)
+#define CONFIG_DIGEST_MAX_DEPTH 64
+
+// Returns whether the update of a config is redundant: digest_ref (a long[2],
+// or NULL to always update) holds the digest of the config last applied at
+// the same path, {0, 0} if none, and has the same contents. If not, it's set
+// to the digest of config ({0, 0} if it can't be computed).
+static bool _is_unchanged_config_checked(JNIEnv *env,
+                                         const ddwaf_object *config,
+                                         jlongArray digest_ref)
+{
+    if (!digest_ref) {
+        return false;
+    }
+    jlong digest[2] = {
+            (jlong) object_hash(config, CONFIG_DIGEST_SEED_LO,
+                                CONFIG_DIGEST_MAX_DEPTH),
+            (jlong) object_hash(config, CONFIG_DIGEST_SEED_HI,
+                                CONFIG_DIGEST_MAX_DEPTH),
+    };
+    jlong previous[2];
+    JNI(GetLongArrayRegion, digest_ref, 0, 2, previous);
+    if (JNI(ExceptionCheck)) {
+        return false;
+    }
+    if (digest[0] != 0 && digest[0] == previous[0] &&
+        digest[1] == previous[1]) {
+        return true;
+    }
+    JNI(SetLongArrayRegion, digest_ref, 0, 2, digest);
+    return false;
+}
+
+// The caller frees ddwaf_configuration. Skips the update, returning true
+// without diagnostics, if it's redundant (see _is_unchanged_config_checked)
+static jboolean _add_or_update_config(JNIEnv *env, jclass clazz,
+                                      jobject builder, jstring path,
+                                      const ddwaf_object *ddwaf_configuration,
+                                      jlongArray digest_ref,
+                                      jobject diagnostics)
 {
     jboolean result = JNI_FALSE;
     const char *path_string = NULL;
+    jobject result_diagnostics = NULL;
+    ddwaf_object ddwaf_diagnostics;
+    ddwaf_object_invalid(&ddwaf_diagnostics);
 
     if (!builder) {
         JNI(ThrowNew, jcls_rte, "builder is null");
-        return JNI_FALSE;
+        goto error;
     }
     if (!path) {
         JNI(ThrowNew, jcls_iae, "path is null");
-        return JNI_FALSE;
+        goto error;
     }
 
-    jobject result_diagnostics = NULL;
-    ddwaf_object ddwaf_diagnostics;
-    ddwaf_object_invalid(&ddwaf_diagnostics);
-    struct _limits limits = {
-            .max_depth = 20,
-            .max_elements = 1000000,
-            .max_string_size = 1000000,
-    };
-    ddwaf_object ddwaf_configuration =
-            _convert_checked(env, configuration, &limits, 0);
+    if (_is_unchanged_config_checked(env, ddwaf_configuration, digest_ref)) {
+        return JNI_TRUE;
+    }
     if (JNI(ExceptionCheck)) {
         goto error;
     }
+
     jsize path_length = JNI(GetStringLength, path);
     if (JNI(ExceptionCheck)) {
         goto error;
@@ -1006,12 +1215,14 @@ Java_com_datadog_ddwaf_WafBuilder_addOrUpdateConfigNative(
     }
 
     result = ddwaf_builder_add_or_update_config(
-            ddwaf_builder, path_string, path_length, &ddwaf_configuration,
+            ddwaf_builder, path_string, path_length, ddwaf_configuration,
             &ddwaf_diagnostics);
 
     if (ddwaf_object_type(&ddwaf_diagnostics) != DDWAF_OBJ_INVALID) {
-        result_diagnostics =
-                output_convert_diagnostics_checked(env, &ddwaf_diagnostics);
+        bool summary = JNI(GetBooleanField, builder,
+                           _builder_summary_diagnostics) == JNI_TRUE;
+        result_diagnostics = output_convert_diagnostics_checked(
+                env, &ddwaf_diagnostics, summary);
 
         if (JNI(ExceptionCheck)) {
             java_wrap_exc("Error converting diagnostics structure");
@@ -1031,11 +1242,369 @@ error:
     if (result_diagnostics) {
         JNI(DeleteLocalRef, result_diagnostics);
     }
-    ddwaf_object_free(&ddwaf_configuration);
     ddwaf_object_free(&ddwaf_diagnostics);
     return result;
 }
 
+static ddwaf_object _convert_config_checked(JNIEnv *env, jobject configuration)
+{
+    struct _limits limits = {
+            .max_depth = 20,
+            .max_elements = 1000000,
+            .max_string_size = 1000000,
+    };
+    return _convert_checked(env, configuration, &limits, 0);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_WafBuilder_addOrUpdateConfigNative(
+        JNIEnv *env, jclass clazz, jobject builder, jstring path,
+        jobject configuration, jlongArray digest_ref, jobject diagnostics)
+{
+    ddwaf_object ddwaf_configuration =
+            _convert_config_checked(env, configuration);
+    if (JNI(ExceptionCheck)) {
+        ddwaf_object_free(&ddwaf_configuration);
+        return JNI_FALSE;
+    }
+    jboolean ret = _add_or_update_config(env, clazz, builder, path,
+                                         &ddwaf_configuration, digest_ref,
+                                         diagnostics);
+    ddwaf_object_free(&ddwaf_configuration);
+    return ret;
+}
+
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    convertConfig
+ * Signature: (Ljava/util/Map;)J
+ */
+JNIEXPORT jlong JNICALL Java_com_datadog_ddwaf_WafBuilder_convertConfig(
+        JNIEnv *env, jclass clazz, jobject configuration)
+{
+    UNUSED(clazz);
+
+    ddwaf_object *config = malloc(sizeof *config);
+    if (!config) {
+        JNI(ThrowNew, jcls_rte, "Could not allocate ddwaf_object");
+        return 0L;
+    }
+    *config = _convert_config_checked(env, configuration);
+    if (JNI(ExceptionCheck)) {
+        ddwaf_object_free(config);
+        free(config);
+        return 0L;
+    }
+    return (jlong) (intptr_t) config;
+}
+
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    addOrUpdateConvertedConfig
+ * Signature:
+ * (Lcom/datadog/ddwaf/WafBuilder;Ljava/lang/String;J[J[Lcom/datadog/ddwaf/WafDiagnostics;)Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_WafBuilder_addOrUpdateConvertedConfig(
+        JNIEnv *env, jclass clazz, jobject builder, jstring path,
+        jlong config_ptr, jlongArray digest_ref, jobjectArray diagnostics)
+{
+    ddwaf_object *config = (ddwaf_object *) (intptr_t) config_ptr;
+    if (!config) {
+        JNI(ThrowNew, jcls_iae, "config is null");
+        return JNI_FALSE;
+    }
+    jboolean ret = _add_or_update_config(env, clazz, builder, path, config,
+                                         digest_ref, diagnostics);
+    ddwaf_object_free(config);
+    free(config);
+    return ret;
+}
+
+static void _throw_json_error(JNIEnv *env, const struct json_parse_error *err)
+{
+    if (err->out_of_memory) {
+        JNI(ThrowNew, jcls_rte, "Could not allocate memory for the config");
+        return;
+    }
+    char msg[128];
+    snprintf(msg, sizeof msg, "Invalid JSON at offset %" PRIu64 ": %s",
+             (uint64_t) err->offset, err->msg);
+    JNI(ThrowNew, jcls_iae, msg);
+}
+
+// copies length bytes of arr from offset into a malloc'd buffer (freed by the
+// caller), so that the array isn't pinned while they're parsed. The range must
+// have been checked. NULL with an exception pending on failure
+static char *_copy_byte_array_checked(JNIEnv *env, jbyteArray arr, jint offset,
+                                      jint length)
+{
+    char *copy = malloc(length > 0 ? (size_t) length : 1);
+    if (!copy) {
+        JNI(ThrowNew, jcls_rte, "Could not allocate memory for the json");
+        return NULL;
+    }
+    JNI(GetByteArrayRegion, arr, offset, length, (jbyte *) copy);
+    if (JNI(ExceptionCheck)) {
+        free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    addOrUpdateJsonConfigNative
+ * Signature:
+ * (Lcom/datadog/ddwaf/WafBuilder;Ljava/lang/String;Ljava/nio/ByteBuffer;II[J[Lcom/datadog/ddwaf/WafDiagnostics;)Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_WafBuilder_addOrUpdateJsonConfigNative(
+        JNIEnv *env, jclass clazz, jobject builder, jstring path,
+        jobject json, jint offset, jint length, jlongArray digest_ref,
+        jobjectArray diagnostics)
+{
+    const char *data = JNI(GetDirectBufferAddress, json);
+    if (!data) {
+        JNI(ThrowNew, jcls_iae, "Not a direct buffer");
+        return JNI_FALSE;
+    }
+    jlong capacity = JNI(GetDirectBufferCapacity, json);
+    if (offset < 0 || length < 0 || (jlong) offset + length > capacity) {
+        JNI(ThrowNew, jcls_iae, "Invalid buffer range");
+        return JNI_FALSE;
+    }
+
+    struct json_doc doc;
+    struct json_parse_error err;
+    if (!json_parse(data + offset, (size_t) length, &doc, &err)) {
+        _throw_json_error(env, &err);
+        return JNI_FALSE;
+    }
+    jboolean ret = _add_or_update_config(env, clazz, builder, path, &doc.root,
+                                         digest_ref, diagnostics);
+    json_doc_free(&doc);
+    return ret;
+}
+
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    addOrUpdateJsonArrayConfigNative
+ * Signature:
+ * (Lcom/datadog/ddwaf/WafBuilder;Ljava/lang/String;[BII[J[Lcom/datadog/ddwaf/WafDiagnostics;)Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_WafBuilder_addOrUpdateJsonArrayConfigNative(
+        JNIEnv *env, jclass clazz, jobject builder, jstring path,
+        jbyteArray json, jint offset, jint length, jlongArray digest_ref,
+        jobjectArray diagnostics)
+{
+    if (!json) {
+        JNI(ThrowNew, jcls_iae, "json is null");
+        return JNI_FALSE;
+    }
+    jsize array_len = JNI(GetArrayLength, json);
+    if (offset < 0 || length < 0 || offset > array_len - length) {
+        JNI(ThrowNew, jcls_iae, "Invalid array range");
+        return JNI_FALSE;
+    }
+
+    char *data = _copy_byte_array_checked(env, json, offset, length);
+    if (!data) {
+        return JNI_FALSE;
+    }
+    struct json_doc doc;
+    struct json_parse_error err;
+    bool parsed = json_parse(data, (size_t) length, &doc, &err);
+    free(data);
+    if (!parsed) {
+        _throw_json_error(env, &err);
+        return JNI_FALSE;
+    }
+    jboolean ret = _add_or_update_config(env, clazz, builder, path, &doc.root,
+                                         digest_ref, diagnostics);
+    json_doc_free(&doc);
+    return ret;
+}
+
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    freeConvertedConfig
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_datadog_ddwaf_WafBuilder_freeConvertedConfig(
+        JNIEnv *env, jclass clazz, jlong config_ptr)
+{
+    UNUSED(env);
+    UNUSED(clazz);
+
+    ddwaf_object *config = (ddwaf_object *) (intptr_t) config_ptr;
+    if (config) {
+        ddwaf_object_free(config);
+        free(config);
+    }
+}
+
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    addOrUpdateSnapshotConfigNative
+ * Signature:
+ * (Lcom/datadog/ddwaf/WafBuilder;Ljava/lang/String;Ljava/nio/ByteBuffer;[J[Lcom/datadog/ddwaf/WafDiagnostics;)Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_WafBuilder_addOrUpdateSnapshotConfigNative(
+        JNIEnv *env, jclass clazz, jobject builder, jstring path,
+        jobject snapshot_root, jlongArray digest_ref, jobjectArray diagnostics)
+{
+    // the relocated tree, in the mapping of the snapshot file
+    const ddwaf_object *config = JNI(GetDirectBufferAddress, snapshot_root);
+    if (!config || JNI(GetDirectBufferCapacity, snapshot_root) <
+                           (jlong) sizeof(ddwaf_object)) {
+        JNI(ThrowNew, jcls_iae, "Not a mapped snapshot");
+        return JNI_FALSE;
+    }
+    return _add_or_update_config(env, clazz, builder, path, config, digest_ref,
+                                 diagnostics);
+}
+
+/*
+ * Class:     com_datadog_ddwaf_WafBuilder
+ * Method:    addOrUpdateDataConfigNative
+ * Signature:
+ * (Lcom/datadog/ddwaf/WafBuilder;Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;[B[I[J[J[Lcom/datadog/ddwaf/WafDiagnostics;)Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_datadog_ddwaf_WafBuilder_addOrUpdateDataConfigNative(
+        JNIEnv *env, jclass clazz, jobject builder, jstring path,
+        jstring section, jstring id, jstring type, jbyteArray values,
+        jintArray ends, jlongArray expirations, jlongArray digest_ref,
+        jobjectArray diagnostics)
+{
+    jboolean ret = JNI_FALSE;
+    struct data_config_input in = {0};
+    struct data_config config = {.mem = NULL};
+    char *section_c = NULL, *id_c = NULL, *type_c = NULL;
+    void *values_c = NULL, *ends_c = NULL, *expirations_c = NULL;
+    enum data_config_status status = DATA_CONFIG_NO_MEMORY;
+
+    if (!section || !id || !type || !values || !ends) {
+        JNI(ThrowNew, jcls_iae, "data config argument is null");
+        return JNI_FALSE;
+    }
+    jsize count = JNI(GetArrayLength, ends);
+    jsize values_len = JNI(GetArrayLength, values);
+    if (expirations && JNI(GetArrayLength, expirations) != count) {
+        JNI(ThrowNew, jcls_iae, "There must be one expiration per value");
+        return JNI_FALSE;
+    }
+
+    section_c = java_to_utf8_checked(env, section, &in.section_len);
+    if (!section_c) {
+        goto error;
+    }
+    id_c = java_to_utf8_checked(env, id, &in.id_len);
+    if (!id_c) {
+        goto error;
+    }
+    type_c = java_to_utf8_checked(env, type, &in.type_len);
+    if (!type_c) {
+        goto error;
+    }
+
+    // the config is built without JNI calls and copies everything out of
+    // the arrays, so the critical section ends before it's applied
+    values_c = JNI(GetPrimitiveArrayCritical, values, NULL);
+    if (!values_c) {
+        goto release;
+    }
+    ends_c = JNI(GetPrimitiveArrayCritical, ends, NULL);
+    if (!ends_c) {
+        goto release;
+    }
+    if (expirations) {
+        expirations_c = JNI(GetPrimitiveArrayCritical, expirations, NULL);
+        if (!expirations_c) {
+            goto release;
+        }
+    }
+    in.section = section_c;
+    in.id = id_c;
+    in.type = type_c;
+    in.values = values_c;
+    in.ends = (const int32_t *) ends_c;
+    in.expirations = (const int64_t *) expirations_c;
+    in.count = (size_t) count;
+    if (count > 0 && in.ends[count - 1] > values_len) {
+        status = DATA_CONFIG_BAD_ENDS;
+    } else {
+        status = data_config_build(&in, &config);
+    }
+
+release:
+    if (expirations_c) {
+        JNI(ReleasePrimitiveArrayCritical, expirations, expirations_c,
+            JNI_ABORT);
+    }
+    if (ends_c) {
+        JNI(ReleasePrimitiveArrayCritical, ends, ends_c, JNI_ABORT);
+    }
+    if (values_c) {
+        JNI(ReleasePrimitiveArrayCritical, values, values_c, JNI_ABORT);
+    }
+    if (JNI(ExceptionCheck)) {
+        goto error;
+    }
+    if (status == DATA_CONFIG_BAD_ENDS) {
+        JNI(ThrowNew, jcls_iae, "Invalid ends of the packed values");
+        goto error;
+    }
+    if (status != DATA_CONFIG_OK) {
+        JNI(ThrowNew, jcls_rte, "Could not allocate memory for the config");
+        goto error;
+    }
+
+    ret = _add_or_update_config(env, clazz, builder, path, &config.root,
+                                digest_ref, diagnostics);
+
+error:
+    data_config_free(&config);
+    free(section_c);
+    free(id_c);
+    free(type_c);
+    return ret;
+}
+
+/*
+ * Class:     com_datadog_ddwaf_WafDiagnostics
+ * Method:    parseDetails
+ * Signature: ([B)Lcom/datadog/ddwaf/WafDiagnostics;
+ */
+JNIEXPORT jobject JNICALL Java_com_datadog_ddwaf_WafDiagnostics_parseDetails(
+        JNIEnv *env, jclass clazz, jbyteArray json)
+{
+    UNUSED(clazz);
+    if (!json) {
+        JNI(ThrowNew, jcls_iae, "json is null");
+        return NULL;
+    }
+    jsize len = JNI(GetArrayLength, json);
+    char *data = _copy_byte_array_checked(env, json, 0, len);
+    if (!data) {
+        return NULL;
+    }
+    struct json_doc doc;
+    struct json_parse_error err;
+    bool parsed = json_parse(data, (size_t) len, &doc, &err);
+    free(data);
+    if (!parsed) {
+        _throw_json_error(env, &err);
+        return NULL;
+    }
+    jobject ret = output_convert_diagnostics_checked(env, &doc.root, false);
+    json_doc_free(&doc);
+    return ret;
+}
+
 JNIEXPORT jlong JNICALL Java_com_datadog_ddwaf_WafBuilder_initBuilder(
         JNIEnv *env, jclass clazz, jobject config)
 {
@@ -1146,9 +1715,10 @@ static bool _cache_methods(JNIEnv *env)
     }
 
     if (!java_meth_init_checked(
-                env, &_timeout_exception_init,
-                "com/datadog/ddwaf/exception/TimeoutWafException", "<init>",
-                "()V", JMETHOD_CONSTRUCTOR)) {
+                env, &_create_timeout_exception, "com/datadog/ddwaf/Waf",
+                "createTimeoutException",
+                "()Lcom/datadog/ddwaf/exception/TimeoutWafException;",
+                JMETHOD_STATIC)) {
         goto error;
     }
 
@@ -1213,19 +1783,6 @@ static bool _cache_methods(JNIEnv *env)
         goto error;
     }
 
-    if (!java_meth_init_checked(env, &result_with_data_init,
-                                "com/datadog/ddwaf/Waf$ResultWithData",
-                                "<init>",
-                                "(Lcom/datadog/ddwaf/Waf$Result;"
-                                "Ljava/lang/String;"
-                                "Ljava/util/Map;"
-                                "Ljava/util/Map;"
-                                "ZJ"
-                                "Z)V",
-                                JMETHOD_CONSTRUCTOR)) {
-        goto error;
-    }
-
     if (!java_meth_init_checked(env, &_pwaf_handle_init,
                                 "com/datadog/ddwaf/WafHandle", "<init>", "(J)V",
                                 JMETHOD_CONSTRUCTOR)) {
@@ -1297,7 +1854,7 @@ static void _dispose_of_cached_methods(JNIEnv *env)
     }
 
     DESTROY_METH(_create_exception)
-    DESTROY_METH(_timeout_exception_init)
+    DESTROY_METH(_create_timeout_exception)
     DESTROY_METH(charSequence_length)
     DESTROY_METH(charSequence_subSequence)
     DESTROY_METH(charBuffer_hasArray)
@@ -1308,7 +1865,6 @@ static void _dispose_of_cached_methods(JNIEnv *env)
     DESTROY_METH(to_string)
     DESTROY_METH(number_longValue)
     DESTROY_METH(_boolean_booleanValue)
-    DESTROY_METH(result_with_data_init)
     DESTROY_METH(_pwaf_handle_init)
     DESTROY_METH(map_entryset)
     DESTROY_METH(map_size)
@@ -1333,14 +1889,6 @@ static bool _cache_references(JNIEnv *env)
         goto error;
     }
 
-    if (!_fetch_action_enums(env)) {
-        goto error;
-    }
-
-    if (!_fetch_result_with_data_fields(env)) {
-        goto error;
-    }
-
     if (!_fetch_waf_context_fields(env)) {
         goto error;
     }
@@ -1377,8 +1925,6 @@ error:
 
 static void _dispose_of_cache_references(JNIEnv *env)
 {
-    _dispose_of_action_enums(env);
-    _dispose_of_result_with_data_fields(env);
     _dispose_of_weak_classes(env);
     _dispose_of_native_order_obj(env);
     _dispose_of_cached_methods(env);
@@ -1895,6 +2441,11 @@ static struct _limits _fetch_limits_checked(JNIEnv *env, jobject limits_obj)
     }
     // DD_APPSEC_WAF_TIMEOUT is in us
     l.run_budget_in_us = run_budget > 0 ? (int64_t) run_budget : pw_run_timeout;
+    l.timeout_as_result =
+            JNI(GetBooleanField, limits_obj, _limit_timeout_as_result);
+    if (JNI(ExceptionCheck)) {
+        goto error;
+    }
 
     return l;
 error:
@@ -1917,13 +2468,13 @@ static inline int64_t _timespec_diff_ns(struct timespec a, struct timespec b)
            ((int64_t) a.tv_nsec - (int64_t) b.tv_nsec);
 }
 
-static int64_t _get_pw_run_timeout_checked(JNIEnv *env)
+// value of a system property (to be freed), or NULL if unset or on error
+static char *_get_string_property_checked(JNIEnv *env, const char *name)
 {
     struct j_method get_prop = {0};
     jstring env_key = NULL;
     jstring val_jstr = NULL;
     char *val_cstr = NULL;
-    long long val = DDWAF_RUN_TIMEOUT;
 
     if (!java_meth_init_checked(
                 env, &get_prop, "java/lang/System", "getProperty",
@@ -1931,8 +2482,7 @@ static int64_t _get_pw_run_timeout_checked(JNIEnv *env)
         goto end;
     }
 
-    env_key = java_utf8_to_jstring_checked(env, "DD_APPSEC_WAF_TIMEOUT",
-                                           strlen("DD_APPSEC_WAF_TIMEOUT"));
+    env_key = java_utf8_to_jstring_checked(env, name, strlen(name));
     if (!env_key) {
         goto end;
     }
@@ -1943,29 +2493,13 @@ static int64_t _get_pw_run_timeout_checked(JNIEnv *env)
     }
 
     if (JNI(IsSameObject, val_jstr, NULL)) {
-        JAVA_LOG(DDWAF_LOG_DEBUG,
-                 "No property DD_APPSEC_WAF_TIMEOUT; using default %lld", val);
+        JAVA_LOG(DDWAF_LOG_DEBUG, "No property %s", name);
         goto end;
     }
 
     size_t len;
     // java_to_utf8_checked gives out a NUL-terminated string
-    if ((val_cstr = java_to_utf8_checked(env, val_jstr, &len)) == NULL) {
-        goto end;
-    }
-
-    char *end;
-    val = strtoll(val_cstr, &end, 10);
-    if (*end != '\0') {
-        JAVA_LOG(DDWAF_LOG_WARN,
-                 "Invalid value of system property "
-                 "DD_APPSEC_WAF_TIMEOUT: '%s'",
-                 val_cstr);
-        goto end;
-    }
-
-    JAVA_LOG(DDWAF_LOG_INFO, "Using value %lld us for DD_APPSEC_WAF_TIMEOUT",
-             val);
+    val_cstr = java_to_utf8_checked(env, val_jstr, &len);
 
 end:
     if (get_prop.class_glob) {
@@ -1977,6 +2511,34 @@ end:
     if (val_jstr) {
         JNI(DeleteLocalRef, val_jstr);
     }
+    return val_cstr;
+}
+
+// value of a numeric system property, or def if unset or invalid
+static long long _get_long_property_checked(JNIEnv *env, const char *name,
+                                            long long def)
+{
+    long long val = def;
+    char *val_cstr = _get_string_property_checked(env, name);
+    if (!val_cstr) {
+        if (!JNI(ExceptionCheck)) {
+            JAVA_LOG(DDWAF_LOG_DEBUG, "Using default %lld for %s", val, name);
+        }
+        return val;
+    }
+
+    char *end;
+    long long parsed = strtoll(val_cstr, &end, 10);
+    if (*end != '\0') {
+        JAVA_LOG(DDWAF_LOG_WARN, "Invalid value of system property %s: '%s'",
+                 name, val_cstr);
+        goto end;
+    }
+    val = parsed;
+
+    JAVA_LOG(DDWAF_LOG_INFO, "Using value %lld for %s", val, name);
+
+end:
     free(val_cstr);
     return val;
 }
@@ -2041,12 +2603,28 @@ static void _throw_pwaf_exception(JNIEnv *env, DDWAF_RET_CODE retcode)
 
 static void _throw_pwaf_timeout_exception(JNIEnv *env)
 {
-    jobject exc = java_meth_call(env, &_timeout_exception_init, NULL);
+    jobject exc = java_meth_call(env, &_create_timeout_exception, NULL);
     if (!JNI(ExceptionCheck)) {
         JNI(Throw, exc);
     }
 }
 
+// writes a TIMEOUT result if the caller opted into it, otherwise throws
+// TimeoutWafException and returns NULL
+static jobject _report_timeout_checked(JNIEnv *env,
+                                       const struct _limits *limits,
+                                       jobject result_buffer,
+                                       jobjectArray result_refs)
+{
+    if (limits->timeout_as_result) {
+        struct output_result res = {.code = OUTPUT_RESULT_TIMEOUT};
+        return output_write_result_checked(env, &res, result_buffer,
+                                           result_refs);
+    }
+    _throw_pwaf_timeout_exception(env);
+    return NULL;
+}
+
 static void _update_metrics(JNIEnv *env, jobject metrics_obj,
                             const ddwaf_object *ddwaf_result)
 {
@@ -2085,6 +2663,55 @@ static void _update_metrics(JNIEnv *env, jobject metrics_obj,
     }
 }
 
+static void _capture_slow_run(JNIEnv *env, jobject waf_context_obj,
+                              struct timespec start,
+                              const ddwaf_object *ddwaf_result, bool timed_out,
+                              const ddwaf_object *persistent,
+                              const ddwaf_object *ephemeral)
+{
+    struct timespec end;
+    if (clock_gettime(CLOCK_MONOTONIC, &end) != 0) {
+        return;
+    }
+    int64_t total_ns = _timespec_diff_ns(end, start);
+    int64_t ddwaf_ns = 0;
+    if (ddwaf_result) {
+        const ddwaf_object *duration_obj =
+                ddwaf_object_find(ddwaf_result, "duration", 8);
+        if (duration_obj != NULL && duration_obj->type == DDWAF_OBJ_UNSIGNED) {
+            ddwaf_ns = (int64_t) ddwaf_object_get_unsigned(duration_obj);
+        }
+    }
+    if (!slow_capture_wanted(total_ns, ddwaf_ns, timed_out)) {
+        return;
+    }
+
+    // the handle id is left out rather than disturbing a pending exception
+    char *handle_id = NULL;
+    size_t handle_id_len = 0;
+    if (!JNI(ExceptionCheck)) {
+        jobject handle_obj =
+                JNI(GetObjectField, waf_context_obj, _waf_context_handle);
+        if (handle_obj) {
+            jstring name = (jstring) JNI(GetObjectField, handle_obj,
+                                         _waf_handle_unique_name);
+            if (name) {
+                handle_id = java_to_utf8_checked(env, name, &handle_id_len);
+                JNI(DeleteLocalRef, name);
+            }
+            JNI(DeleteLocalRef, handle_obj);
+        }
+        if (JNI(ExceptionCheck)) {
+            JNI(ExceptionClear);
+            handle_id_len = 0;
+        }
+    }
+
+    slow_capture_record(handle_id ? handle_id : "", handle_id_len, total_ns,
+                        ddwaf_ns, timed_out, persistent, ephemeral);
+    free(handle_id);
+}
+
 static bool _convert_ddwaf_config_checked(JNIEnv *env, jobject jconfig,
                                           ddwaf_config *out_config)
 {
@@ -2156,90 +2783,60 @@ static void _dispose_of_ddwaf_config(ddwaf_config *cfg)
 }
 
 static jobject _create_result_checked(JNIEnv *env, DDWAF_RET_CODE code,
-                                      const ddwaf_object *ddwaf_result)
+                                      const ddwaf_object *ddwaf_result,
+                                      jobject result_buffer,
+                                      jobjectArray result_refs)
 {
-    bool has_events = _has_events(ddwaf_result);
+    struct output_result res = {
+            .code = code == DDWAF_OK ? OUTPUT_RESULT_OK : OUTPUT_RESULT_MATCH,
+            .events = _has_events(ddwaf_result),
+    };
+
     const ddwaf_object *actions_obj =
             ddwaf_object_find(ddwaf_result, "actions", 7);
-    jobject actions_jmap;
-    bool del_actions_jmap = false;
-    if (actions_obj == NULL || actions_obj->type != DDWAF_OBJ_MAP ||
-        ddwaf_object_size(actions_obj) == 0) {
-        actions_jmap = _result_with_data_empty_map;
-    } else {
-        actions_jmap = convert_ddwaf_object_to_jobject(env, actions_obj);
-        if (!actions_jmap) {
-            java_wrap_exc("%s", "Error creating actions map");
-            return NULL;
-        }
-        del_actions_jmap = true;
+    if (actions_obj != NULL && actions_obj->type == DDWAF_OBJ_MAP &&
+        ddwaf_object_size(actions_obj) > 0) {
+        res.actions = actions_obj;
     }
 
     // Get events from the ddwaf_object structure and use as data
     const ddwaf_object *events_obj =
             ddwaf_object_find(ddwaf_result, "events", 6);
-    jstring data_obj = NULL;
     if (events_obj != NULL && events_obj->type == DDWAF_OBJ_ARRAY &&
         ddwaf_object_size(events_obj) > 0) {
-        struct json_segment *seg = output_convert_json(events_obj);
-        if (!seg) {
-            JNI(ThrowNew, jcls_iae, "failed converting events array to json");
-            goto err;
-        }
-
-        data_obj = java_json_to_jstring_checked(env, seg);
-        json_seg_free(seg);
-        if (JNI(ExceptionCheck)) {
-            java_wrap_exc("%s", "Failed converting json to Java string");
-            goto err;
-        }
+        res.events_obj = events_obj;
     }
 
     // Get attributes (formerly derivatives) from the new ddwaf_object structure
     const ddwaf_object *attributes_obj =
             ddwaf_object_find(ddwaf_result, "attributes", 10);
-    jobject attributes = NULL;
 
     consume_json_and_free(ddwaf_result);
     consume_json_and_free(attributes_obj);
     if (attributes_obj != NULL && attributes_obj->type == DDWAF_OBJ_MAP &&
         ddwaf_object_size(attributes_obj) > 0) {
-        attributes = output_convert_attributes_checked(env, attributes_obj);
-        if (!attributes) {
-            java_wrap_exc("%s", "Failed encoding inferred attributes");
-            goto err;
-        }
+        res.attributes = attributes_obj;
     }
 
     // Get keep and duration from the ddwaf_object structure
     const ddwaf_object *keep_obj = ddwaf_object_find(ddwaf_result, "keep", 4);
-    jboolean keep = JNI_TRUE; // Default to true when NULL/missing
+    res.keep = true; // Default to true when NULL/missing
     if (keep_obj != NULL && keep_obj->type == DDWAF_OBJ_BOOL) {
-        keep = (jboolean) ddwaf_object_get_bool(keep_obj);
+        res.keep = ddwaf_object_get_bool(keep_obj);
     }
 
     const ddwaf_object *duration_obj =
             ddwaf_object_find(ddwaf_result, "duration", 8);
-    jlong duration = 0;
     if (duration_obj != NULL && duration_obj->type == DDWAF_OBJ_UNSIGNED) {
-        duration = (jlong) ddwaf_object_get_unsigned(duration_obj);
+        res.duration = ddwaf_object_get_unsigned(duration_obj);
     }
 
-    jobject result = java_meth_call(
-            env, &result_with_data_init, NULL,
-            code == DDWAF_OK ? _action_ok : _action_match, data_obj,
-            actions_jmap, attributes, keep, duration, has_events);
-    if (del_actions_jmap) {
-        JNI(DeleteLocalRef, actions_jmap);
+    jobject result =
+            output_write_result_checked(env, &res, result_buffer, result_refs);
+    if (!result) {
+        java_wrap_exc("%s", "Error encoding WAF result");
     }
-    JNI(DeleteLocalRef, data_obj);
     return result;
-
-err:
-    if (del_actions_jmap) {
-        JNI(DeleteLocalRef, actions_jmap);
-    }
-    return NULL;
 }
 
 static inline bool _has_events(const ddwaf_object *res)
@@ -2253,17 +2850,11 @@ static void consume_json_and_free(const ddwaf_object *obj)
 {
     if (!obj)
         return;
-    struct json_segment *seg = output_convert_json(obj);
-    if (!seg)
+    char json_storage[1024];
+    struct json_buf json;
+    json_buf_init(&json, json_storage, sizeof json_storage);
+    if (!json_write_object(&json, obj))
         return;
 
-    size_t len = json_length(seg);
-    char *str = malloc(len + 1);
-    if (str) {
-        struct json_iterator it = {.seg = seg, .pos = 0};
-        size_t read = json_it_read(&it, str, len);
-        str[read] = '\0';
-        free(str);
-    }
-    json_seg_free(seg);
+    json_buf_free(&json);
 }
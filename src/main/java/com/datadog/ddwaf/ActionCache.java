@@ -0,0 +1,100 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf;
+
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.LinkedHashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.concurrent.ConcurrentHashMap;
+
+/**
+ * Converted actions of a {@link WafHandle}, keyed by the hash of their encoding in the result
+ * buffer (see {@link ResultDecoder}). A handle returns few distinct sets of actions, so results
+ * that block or redirect share the same maps and {@link WafAction} instances.
+ */
+final class ActionCache {
+  static final int MAX_ENTRIES = 64;
+
+  static final class Entry {
+    private final byte[] encoded;
+    final Map<String, Map<String, Object>> actions;
+    final List<WafAction> typedActions;
+
+    Entry(
+        byte[] encoded, Map<String, Map<String, Object>> actions, List<WafAction> typedActions) {
+      this.encoded = encoded;
+      this.actions = actions;
+      this.typedActions = typedActions;
+    }
+
+    boolean matches(ByteBuffer buf, int pos, int len) {
+      if (encoded.length != len) {
+        return false;
+      }
+      for (int i = 0; i < len; i++) {
+        if (encoded[i] != buf.get(pos + i)) {
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+
+  private final ConcurrentHashMap<Long, Entry> entries = new ConcurrentHashMap<>();
+
+  /** The entry for the actions encoded in {@code buf[pos, pos + len)}, or null. */
+  Entry get(long hash, ByteBuffer buf, int pos, int len) {
+    Entry e = entries.get(hash);
+    if (e != null && e.matches(buf, pos, len)) {
+      return e;
+    }
+    return null;
+  }
+
+  /**
+   * Creates the entry for freshly decoded actions and caches it, unless the cache is full or the
+   * actions are specific to the request (stack ids).
+   */
+  Entry put(long hash, ByteBuffer buf, int pos, int len, Map<String, Map<String, Object>> actions) {
+    Map<String, Map<String, Object>> frozen = new LinkedHashMap<>(actions.size() * 2);
+    List<WafAction> typed = new ArrayList<>(actions.size());
+    boolean cacheable = true;
+    for (Map.Entry<String, Map<String, Object>> e : actions.entrySet()) {
+      Map<String, Object> params = e.getValue();
+      params =
+          params == null
+              ? Collections.<String, Object>emptyMap()
+              : Collections.unmodifiableMap(params);
+      frozen.put(e.getKey(), params);
+      typed.add(new WafAction(e.getKey(), params));
+      if (WafAction.Type.GENERATE_STACK.wafName.equals(e.getKey())) {
+        cacheable = false;
+      }
+    }
+
+    byte[] encoded = new byte[len];
+    for (int i = 0; i < len; i++) {
+      encoded[i] = buf.get(pos + i);
+    }
+    Entry entry =
+        new Entry(
+            encoded, Collections.unmodifiableMap(frozen), Collections.unmodifiableList(typed));
+    if (cacheable && entries.size() < MAX_ENTRIES) {
+      entries.put(hash, entry);
+    }
+    return entry;
+  }
+
+  int size() {
+    return entries.size();
+  }
+}
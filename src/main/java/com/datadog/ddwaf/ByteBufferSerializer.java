@@ -8,6 +8,7 @@
 
 package com.datadog.ddwaf;
 
+import com.datadog.ddwaf.logging.LogRateLimiter;
 import java.io.Closeable;
 import java.lang.reflect.Array;
 import java.lang.reflect.UndeclaredThrowableException;
@@ -38,6 +39,12 @@ public class ByteBufferSerializer {
   private static final int STRINGS_MIN_SEGMENTS_SIZE = 81920;
 
   private static final Logger LOGGER = LoggerFactory.getLogger(ByteBufferSerializer.class);
+  // these messages can be logged once per element
+  private static final LogRateLimiter PARAM_TRUNCATED_LOG = new LogRateLimiter();
+  private static final LogRateLimiter MAX_ELEMENTS_LOG = new LogRateLimiter();
+  private static final LogRateLimiter MAX_DEPTH_LOG = new LogRateLimiter();
+  private static final LogRateLimiter STRING_TRUNCATED_LOG = new LogRateLimiter();
+  private static final LogRateLimiter UNKNOWN_TYPE_LOG = new LogRateLimiter();
 
   private final Waf.Limits limits;
 
@@ -94,11 +101,15 @@ public class ByteBufferSerializer {
       int[] remainingElements,
       int depthRemaining,
       WafMetrics metrics) {
+    long suppressed;
     if (parameterName != null && parameterName.length() > limits.maxStringSize) {
-      LOGGER.debug(
-          "Truncating parameter string from size {} to size {}",
-          parameterName.length(),
-          limits.maxStringSize);
+      if (LOGGER.isDebugEnabled() && (suppressed = PARAM_TRUNCATED_LOG.tryAcquire()) >= 0) {
+        LOGGER.debug(
+            "Truncating parameter string from size {} to size {}{}",
+            parameterName.length(),
+            limits.maxStringSize,
+            LogRateLimiter.suppressedSuffix(suppressed));
+      }
       parameterName = parameterName.substring(0, limits.maxStringSize);
       if (metrics != null) {
         metrics.incrementTruncatedStringTooLongCount();
@@ -114,15 +125,19 @@ public class ByteBufferSerializer {
 
     if (remainingElements[0] < 0 || depthRemaining < 0) {
       if (remainingElements[0] < 0) {
-        if (LOGGER.isDebugEnabled()) {
-          LOGGER.debug("Ignoring element, for maxElements was exceeded");
+        if (LOGGER.isDebugEnabled() && (suppressed = MAX_ELEMENTS_LOG.tryAcquire()) >= 0) {
+          LOGGER.debug(
+              "Ignoring element, for maxElements was exceeded{}",
+              LogRateLimiter.suppressedSuffix(suppressed));
         }
         if (metrics != null) {
           metrics.incrementTruncatedListMapTooLargeCount();
         }
       } else if (depthRemaining <= 0) {
-        if (LOGGER.isDebugEnabled()) {
-          LOGGER.debug("Ignoring element, for maxDepth was exceeded");
+        if (LOGGER.isDebugEnabled() && (suppressed = MAX_DEPTH_LOG.tryAcquire()) >= 0) {
+          LOGGER.debug(
+              "Ignoring element, for maxDepth was exceeded{}",
+              LogRateLimiter.suppressedSuffix(suppressed));
         }
         if (metrics != null) {
           metrics.incrementTruncatedObjectTooDeepCount();
@@ -142,8 +157,13 @@ public class ByteBufferSerializer {
     } else if (value instanceof CharSequence) {
       CharSequence svalue = (CharSequence) value;
       if (svalue.length() > limits.maxStringSize) {
-        LOGGER.debug(
-            "Truncating string from size {} to size {}", svalue.length(), limits.maxStringSize);
+        if (LOGGER.isDebugEnabled() && (suppressed = STRING_TRUNCATED_LOG.tryAcquire()) >= 0) {
+          LOGGER.debug(
+              "Truncating string from size {} to size {}{}",
+              svalue.length(),
+              limits.maxStringSize,
+              LogRateLimiter.suppressedSuffix(suppressed));
+        }
         svalue = svalue.subSequence(0, limits.maxStringSize);
         if (metrics != null) {
           metrics.incrementTruncatedStringTooLongCount();
@@ -251,7 +271,12 @@ public class ByteBufferSerializer {
       }
     } else {
       // unknown value; write null
-      LOGGER.info("Do not know how to serialize value of type {}", value.getClass());
+      if (LOGGER.isInfoEnabled() && (suppressed = UNKNOWN_TYPE_LOG.tryAcquire()) >= 0) {
+        LOGGER.info(
+            "Do not know how to serialize value of type {}{}",
+            value.getClass(),
+            LogRateLimiter.suppressedSuffix(suppressed));
+      }
       if (!pwargsSlot.writeNull(arena, parameterName)) {
         throw new RuntimeException("Error writing null for unknown type");
       }
@@ -472,6 +497,17 @@ public class ByteBufferSerializer {
       return ByteBufferSerializer.serializeMore(this, limits, map, metrics);
     }
 
+    /**
+     * Makes the whole arena available again without returning it to the pool. Buffers previously
+     * returned by {@link #serializeMore(Waf.Limits, Map, WafMetrics)} must not be used afterwards.
+     */
+    public void reset() {
+      if (closeCalled) {
+        throw new IllegalStateException("Lease has already been closed");
+      }
+      arena.reset();
+    }
+
     @Override
     public void close() {
       if (closeCalled) {
@@ -789,7 +825,7 @@ public class ByteBufferSerializer {
     }
   }
 
-  private static native long getByteBufferAddress(ByteBuffer bb);
+  static native long getByteBufferAddress(ByteBuffer bb);
 
   private static class GenericArrayIterator implements Iterator<Object> {
     final Object array;
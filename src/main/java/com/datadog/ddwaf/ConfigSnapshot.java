@@ -0,0 +1,129 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf;
+
+import java.io.IOException;
+import java.nio.BufferUnderflowException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.MappedByteBuffer;
+import java.nio.channels.FileChannel;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.nio.file.StandardCopyOption;
+import java.nio.file.StandardOpenOption;
+import java.util.Arrays;
+import java.util.Map;
+
+/**
+ * A configuration converted to libddwaf objects and saved to a file, so that it can be loaded at
+ * startup with {@link WafBuilder#addOrUpdateConfig(String, ConfigSnapshot)} without being parsed
+ * or converted again. The file is mapped into memory and its pointers relocated in place; the
+ * mapping is private, so relocation doesn't change the file.
+ *
+ * <p>The file starts with the magic {@code "DDWAFCFG"}, a {@code u32} version and the {@code u32}
+ * size of a {@code ddwaf_object}, followed by a single record with the configuration as its first
+ * root (see {@code object_image.h}). It is in native byte order and only readable on machines with
+ * the same byte order and pointer size. Only the structure of the file is checked when it's mapped;
+ * the strings and nesting are trusted.
+ *
+ * <p>The mapping is only released when the {@code ConfigSnapshot} is garbage collected. On Windows,
+ * a mapped file can't be deleted or replaced until then, so {@link #write(Map, Path)} can't
+ * overwrite a snapshot that's still mapped; write new snapshots to new paths instead.
+ */
+public final class ConfigSnapshot {
+  static final byte[] MAGIC = "DDWAFCFG".getBytes(StandardCharsets.US_ASCII);
+  static final int VERSION = 1;
+  static final int HEADER_SIZE = 16;
+
+  // the root points into it
+  private final MappedByteBuffer mapped;
+  final ByteBuffer root;
+
+  private ConfigSnapshot(MappedByteBuffer mapped, ByteBuffer root) {
+    this.mapped = mapped;
+    this.root = root;
+  }
+
+  /**
+   * Converts {@code config} like {@link WafBuilder#addOrUpdateConfig(String, Map)} and writes it to
+   * {@code file}, replacing it atomically if the file system allows.
+   */
+  public static void write(Map<String, Object> config, Path file) throws IOException {
+    if (config == null) {
+      throw new IllegalArgumentException("Config cannot be null");
+    }
+    byte[] record;
+    long converted = WafBuilder.convertConfig(config);
+    try {
+      record = encodeConvertedConfig(converted);
+    } finally {
+      WafBuilder.freeConvertedConfig(converted);
+    }
+
+    ByteBuffer header = ByteBuffer.allocate(HEADER_SIZE).order(ByteOrder.nativeOrder());
+    header.put(MAGIC).putInt(VERSION).putInt(InputRecorder.SIZEOF_DDWAF_OBJECT).flip();
+    Path dir = file.toAbsolutePath().getParent();
+    Path tmp = Files.createTempFile(dir, file.getFileName().toString(), ".tmp");
+    try {
+      try (FileChannel channel = FileChannel.open(tmp, StandardOpenOption.WRITE)) {
+        ByteBuffer[] bufs = {header, ByteBuffer.wrap(record)};
+        while (bufs[1].hasRemaining()) {
+          channel.write(bufs);
+        }
+      }
+      try {
+        Files.move(
+            tmp, file, StandardCopyOption.REPLACE_EXISTING, StandardCopyOption.ATOMIC_MOVE);
+      } catch (IOException e) {
+        Files.move(tmp, file, StandardCopyOption.REPLACE_EXISTING);
+      }
+    } finally {
+      Files.deleteIfExists(tmp);
+    }
+  }
+
+  /**
+   * Maps a snapshot written by {@link #write(Map, Path)}. The mapping lives until the returned
+   * object is garbage collected; libddwaf copies what it needs when the snapshot is added.
+   *
+   * @throws IOException if the file can't be read or isn't a snapshot for this machine
+   */
+  public static ConfigSnapshot map(Path file) throws IOException {
+    MappedByteBuffer mapped;
+    try (FileChannel channel = FileChannel.open(file, StandardOpenOption.READ)) {
+      if (channel.size() > Integer.MAX_VALUE) {
+        throw new IOException("Snapshot larger than 2 GiB: " + file);
+      }
+      mapped = channel.map(FileChannel.MapMode.PRIVATE, 0, channel.size());
+    }
+    mapped.order(ByteOrder.nativeOrder());
+
+    try {
+      byte[] magic = new byte[MAGIC.length];
+      mapped.get(magic);
+      if (!Arrays.equals(magic, MAGIC)
+          || mapped.getInt() != VERSION
+          || mapped.getInt() != InputRecorder.SIZEOF_DDWAF_OBJECT) {
+        throw new IOException("Not a config snapshot of this version and architecture: " + file);
+      }
+      long base = ByteBufferSerializer.getByteBufferAddress(mapped);
+      ByteBuffer[] roots = InputRecording.relocateRecord(mapped, base, HEADER_SIZE);
+      if (roots[0] == null || HEADER_SIZE + mapped.getInt(HEADER_SIZE) != mapped.limit()) {
+        throw new IOException("Corrupt config snapshot " + file);
+      }
+      return new ConfigSnapshot(mapped, roots[0]);
+    } catch (IndexOutOfBoundsException | BufferUnderflowException e) {
+      throw new IOException("Corrupt config snapshot " + file, e);
+    }
+  }
+
+  private static native byte[] encodeConvertedConfig(long convertedConfig);
+}
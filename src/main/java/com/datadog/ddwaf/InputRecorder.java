@@ -0,0 +1,103 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf;
+
+import java.io.Closeable;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.channels.FileChannel;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Path;
+import java.nio.file.StandardOpenOption;
+import java.util.concurrent.atomic.AtomicLong;
+import org.slf4j.Logger;
+import org.slf4j.LoggerFactory;
+
+/**
+ * Appends the inputs of {@link WafContext} runs, as serialized for libddwaf, to a file that {@link
+ * InputRecording} maps back for replay. Install it with {@link Waf#setInputRecorder}.
+ *
+ * <p>The file starts with the magic {@code "DDWAFREC"}, a {@code u32} version and the {@code u32}
+ * size of a {@code ddwaf_object}, then has one record per run (see {@code object_image.h}). It is
+ * in native byte order and has the inputs after the serialization limits were applied. Records are
+ * only readable on machines with the same byte order and pointer size.
+ */
+public final class InputRecorder implements Closeable {
+  private static final Logger LOGGER = LoggerFactory.getLogger(InputRecorder.class);
+
+  static final byte[] MAGIC = "DDWAFREC".getBytes(StandardCharsets.US_ASCII);
+  static final int VERSION = 1;
+  static final int HEADER_SIZE = 16;
+  static final int SIZEOF_DDWAF_OBJECT = 40;
+
+  private final FileChannel channel;
+  private final AtomicLong records = new AtomicLong();
+  private final AtomicLong failures = new AtomicLong();
+
+  private InputRecorder(FileChannel channel) {
+    this.channel = channel;
+  }
+
+  /** Opens {@code file} for appending, creating it if needed. */
+  public static InputRecorder open(Path file) throws IOException {
+    FileChannel channel =
+        FileChannel.open(
+            file, StandardOpenOption.CREATE, StandardOpenOption.WRITE, StandardOpenOption.APPEND);
+    try {
+      if (channel.size() == 0) {
+        ByteBuffer header = ByteBuffer.allocate(HEADER_SIZE).order(ByteOrder.nativeOrder());
+        header.put(MAGIC).putInt(VERSION).putInt(SIZEOF_DDWAF_OBJECT).flip();
+        writeFully(channel, header);
+      }
+    } catch (IOException | RuntimeException e) {
+      channel.close();
+      throw e;
+    }
+    return new InputRecorder(channel);
+  }
+
+  /** Number of runs recorded. */
+  public long getRecords() {
+    return records.get();
+  }
+
+  /** Number of runs that couldn't be recorded; the errors are logged at debug level. */
+  public long getFailures() {
+    return failures.get();
+  }
+
+  // never throws, so recording can't fail the run
+  void record(ByteBuffer persistentBuffer, ByteBuffer ephemeralBuffer) {
+    try {
+      byte[] record = encodeRecord(persistentBuffer, ephemeralBuffer);
+      synchronized (this) {
+        writeFully(channel, ByteBuffer.wrap(record));
+      }
+      records.incrementAndGet();
+    } catch (IOException | RuntimeException e) {
+      failures.incrementAndGet();
+      LOGGER.debug("Could not record WAF run inputs", e);
+    }
+  }
+
+  @Override
+  public synchronized void close() throws IOException {
+    channel.close();
+  }
+
+  private static void writeFully(FileChannel channel, ByteBuffer buf) throws IOException {
+    while (buf.hasRemaining()) {
+      channel.write(buf);
+    }
+  }
+
+  private static native byte[] encodeRecord(
+      ByteBuffer persistentBuffer, ByteBuffer ephemeralBuffer);
+}
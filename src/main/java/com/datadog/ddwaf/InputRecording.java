@@ -0,0 +1,168 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.MappedByteBuffer;
+import java.nio.channels.FileChannel;
+import java.nio.file.Path;
+import java.nio.file.StandardOpenOption;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Collections;
+import java.util.List;
+
+/**
+ * A file written by {@link InputRecorder}, mapped into memory and relocated in place so that its
+ * inputs can be passed to {@link WafContext#run(Input, Waf.Limits, WafMetrics)} without being
+ * serialized again. The mapping is private: relocation doesn't change the file.
+ *
+ * <p>Only the structure of the file is checked; the strings and nesting are trusted. The inputs
+ * stay valid as long as this object is reachable, which must be longer than the {@link
+ * WafContext}s they were run on, as libddwaf keeps referencing persistent data. The mapping is
+ * only released once this object is garbage collected; on Windows, the file can't be deleted or
+ * replaced until then.
+ */
+public final class InputRecording {
+  private static final int RECORD_HEADER_SIZE = 24;
+  private static final int NO_ROOT = -1; // UINT32_MAX
+
+  // the inputs point into it
+  private final MappedByteBuffer mapped;
+  private final List<Input> inputs;
+
+  private InputRecording(MappedByteBuffer mapped) throws IOException {
+    this.mapped = mapped;
+    this.inputs = relocate(mapped);
+  }
+
+  public static InputRecording map(Path file) throws IOException {
+    MappedByteBuffer mapped;
+    try (FileChannel channel = FileChannel.open(file, StandardOpenOption.READ)) {
+      if (channel.size() > Integer.MAX_VALUE) {
+        throw new IOException("Recording larger than 2 GiB: " + file);
+      }
+      mapped = channel.map(FileChannel.MapMode.PRIVATE, 0, channel.size());
+    }
+    mapped.order(ByteOrder.nativeOrder());
+    try {
+      return new InputRecording(mapped);
+    } catch (IndexOutOfBoundsException e) {
+      throw new IOException("Corrupt recording " + file, e);
+    }
+  }
+
+  /** Number of recorded runs. */
+  public int size() {
+    return inputs.size();
+  }
+
+  public Input get(int i) {
+    return inputs.get(i);
+  }
+
+  public List<Input> getInputs() {
+    return inputs;
+  }
+
+  private List<Input> relocate(MappedByteBuffer buf) throws IOException {
+    byte[] magic = new byte[InputRecorder.MAGIC.length];
+    buf.get(magic);
+    if (!Arrays.equals(magic, InputRecorder.MAGIC)
+        || buf.getInt() != InputRecorder.VERSION
+        || buf.getInt() != InputRecorder.SIZEOF_DDWAF_OBJECT) {
+      throw new IOException("Not a recording of this version and architecture");
+    }
+
+    long base = ByteBufferSerializer.getByteBufferAddress(buf);
+    List<Input> inputs = new ArrayList<>();
+    int pos = InputRecorder.HEADER_SIZE;
+    while (pos < buf.limit()) {
+      ByteBuffer[] roots = relocateRecord(buf, base, pos);
+      inputs.add(new Input(roots[0], roots[1]));
+      pos += buf.getInt(pos);
+    }
+    return Collections.unmodifiableList(inputs);
+  }
+
+  /**
+   * Relocates the record at {@code pos} of {@code buf} (see {@code object_image.h}), whose address
+   * is {@code base}, and returns its two roots, {@code null} if absent.
+   */
+  static ByteBuffer[] relocateRecord(ByteBuffer buf, long base, int pos) throws IOException {
+    int recordSize = buf.getInt(pos);
+    int numFixups = buf.getInt(pos + 4);
+    int firstRoot = buf.getInt(pos + 8);
+    int secondRoot = buf.getInt(pos + 12);
+    int imageSize = buf.getInt(pos + 16);
+    int fixupsStart = pos + RECORD_HEADER_SIZE;
+    int imageStart = fixupsStart + ((numFixups * 4 + 7) & ~7);
+    if (numFixups < 0
+        || imageSize < 0
+        || recordSize < RECORD_HEADER_SIZE
+        || recordSize > buf.limit() - pos
+        || imageStart + imageSize != pos + recordSize) {
+      throw new IOException("Corrupt record at offset " + pos);
+    }
+
+    long imageAddress = base + imageStart;
+    for (int i = 0; i < numFixups; i++) {
+      int field = buf.getInt(fixupsStart + i * 4);
+      long target = field >= 0 && field <= imageSize - 8 ? buf.getLong(imageStart + field) : -1;
+      if (target < 0 || target >= imageSize) {
+        throw new IOException("Corrupt pointer in record at offset " + pos);
+      }
+      buf.putLong(imageStart + field, imageAddress + target);
+    }
+
+    return new ByteBuffer[] {
+      root(buf, imageStart, imageSize, firstRoot), root(buf, imageStart, imageSize, secondRoot)
+    };
+  }
+
+  private static ByteBuffer root(ByteBuffer buf, int imageStart, int imageSize, int offset)
+      throws IOException {
+    if (offset == NO_ROOT) {
+      return null;
+    }
+    if (offset < 0 || offset > imageSize - InputRecorder.SIZEOF_DDWAF_OBJECT) {
+      throw new IOException("Corrupt root at offset " + (imageStart + offset));
+    }
+    int start = imageStart + offset;
+    ByteBuffer dup = buf.duplicate();
+    dup.position(start);
+    dup.limit(start + InputRecorder.SIZEOF_DDWAF_OBJECT);
+    return dup.slice().order(ByteOrder.nativeOrder());
+  }
+
+  /** The inputs of one recorded run. */
+  public final class Input {
+    final ByteBuffer persistent;
+    final ByteBuffer ephemeral;
+
+    Input(ByteBuffer persistent, ByteBuffer ephemeral) {
+      this.persistent = persistent;
+      this.ephemeral = ephemeral;
+    }
+
+    public boolean hasPersistentData() {
+      return persistent != null;
+    }
+
+    public boolean hasEphemeralData() {
+      return ephemeral != null;
+    }
+
+    InputRecording getRecording() {
+      return InputRecording.this;
+    }
+  }
+}
@@ -0,0 +1,172 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf;
+
+import java.util.concurrent.atomic.AtomicLongArray;
+import java.util.concurrent.atomic.AtomicReference;
+
+/**
+ * Lock-free log-linear histogram of durations in nanoseconds, in the style of HdrHistogram: values
+ * below 64 ns are counted exactly, larger ones in buckets of at most 1/32 of their value (about 3%
+ * precision), up to {@link #MAX_TRACKABLE_NS}, above which they're counted in the last bucket.
+ *
+ * <p>Recording threads update one of a few stripes, chosen by thread id, with atomic increments.
+ * Snapshots merge the stripes.
+ */
+public final class LatencyHistogram {
+  private static final int SUB_BUCKET_BITS = 5;
+  private static final int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  private static final int MAX_VALUE_BITS = 36;
+  /** About 68 seconds. */
+  public static final long MAX_TRACKABLE_NS = (1L << MAX_VALUE_BITS) - 1;
+
+  // values below 2 * SUB_BUCKETS have a bucket each; then SUB_BUCKETS buckets per power of 2
+  static final int NUM_BUCKETS =
+      2 * SUB_BUCKETS + (MAX_VALUE_BITS - SUB_BUCKET_BITS - 1) * SUB_BUCKETS;
+  private static final int STRIPES = 4; // power of 2
+  // per stripe: the bucket counts, then the sum of the recorded values
+  private static final int SUM_IDX = NUM_BUCKETS;
+
+  private final AtomicReference<AtomicLongArray[]> recording =
+      new AtomicReference<>(newRecording());
+
+  public void record(long durationNs) {
+    if (durationNs < 0) {
+      return;
+    }
+    AtomicLongArray stripe =
+        recording.get()[(int) Thread.currentThread().getId() & (STRIPES - 1)];
+    stripe.incrementAndGet(bucketIndex(durationNs));
+    stripe.addAndGet(SUM_IDX, durationNs);
+  }
+
+  /** The values recorded since creation or the last {@link #snapshotAndReset()}. */
+  public Snapshot snapshot() {
+    return new Snapshot(recording.get());
+  }
+
+  /**
+   * The values recorded since creation or the previous reset, which starts a new interval. Values
+   * recorded while the interval is being switched may be missing from both.
+   */
+  public Snapshot snapshotAndReset() {
+    return new Snapshot(recording.getAndSet(newRecording()));
+  }
+
+  static int bucketIndex(long value) {
+    if (value < 2 * SUB_BUCKETS) {
+      return (int) value;
+    }
+    if (value > MAX_TRACKABLE_NS) {
+      return NUM_BUCKETS - 1;
+    }
+    int shift = 63 - Long.numberOfLeadingZeros(value) - SUB_BUCKET_BITS;
+    int top = (int) (value >>> shift); // in [SUB_BUCKETS, 2 * SUB_BUCKETS)
+    return 2 * SUB_BUCKETS + (shift - 1) * SUB_BUCKETS + (top - SUB_BUCKETS);
+  }
+
+  // the highest value counted in the bucket
+  static long bucketUpperBound(int idx) {
+    if (idx < 2 * SUB_BUCKETS) {
+      return idx;
+    }
+    int shift = (idx - 2 * SUB_BUCKETS) / SUB_BUCKETS + 1;
+    long top = SUB_BUCKETS + (idx - 2 * SUB_BUCKETS) % SUB_BUCKETS;
+    return ((top + 1) << shift) - 1;
+  }
+
+  private static AtomicLongArray[] newRecording() {
+    AtomicLongArray[] stripes = new AtomicLongArray[STRIPES];
+    for (int i = 0; i < STRIPES; i++) {
+      stripes[i] = new AtomicLongArray(NUM_BUCKETS + 1);
+    }
+    return stripes;
+  }
+
+  /** Immutable merge of the stripes of a histogram. */
+  public static final class Snapshot {
+    private final long[] counts = new long[NUM_BUCKETS];
+    private final long count;
+    private final long sum;
+
+    Snapshot(AtomicLongArray[] stripes) {
+      long count = 0;
+      long sum = 0;
+      for (AtomicLongArray stripe : stripes) {
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+          long c = stripe.get(i);
+          counts[i] += c;
+          count += c;
+        }
+        sum += stripe.get(SUM_IDX);
+      }
+      this.count = count;
+      this.sum = sum;
+    }
+
+    public long getCount() {
+      return count;
+    }
+
+    public long getSum() {
+      return sum;
+    }
+
+    public double getMean() {
+      return count == 0 ? 0.0 : (double) sum / count;
+    }
+
+    /** Upper bound of the bucket of the largest value; 0 if empty. */
+    public long getMax() {
+      for (int i = NUM_BUCKETS - 1; i >= 0; i--) {
+        if (counts[i] != 0) {
+          return bucketUpperBound(i);
+        }
+      }
+      return 0;
+    }
+
+    /**
+     * @param percentile in [0, 100], e.g. 99.9
+     * @return the upper bound of the bucket holding the value at the percentile; 0 if empty
+     */
+    public long getValueAtPercentile(double percentile) {
+      if (count == 0) {
+        return 0;
+      }
+      double p = Math.min(Math.max(percentile, 0.0), 100.0);
+      long rank = Math.max(1, (long) Math.ceil(p / 100.0 * count));
+      long seen = 0;
+      for (int i = 0; i < NUM_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+          return bucketUpperBound(i);
+        }
+      }
+      return getMax();
+    }
+
+    @Override
+    public String toString() {
+      return "Snapshot{count="
+          + count
+          + ", mean="
+          + (long) getMean()
+          + ", p50="
+          + getValueAtPercentile(50)
+          + ", p99="
+          + getValueAtPercentile(99)
+          + ", p99.9="
+          + getValueAtPercentile(99.9)
+          + ", max="
+          + getMax()
+          + '}';
+    }
+  }
+}
@@ -0,0 +1,82 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf;
+
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.locks.LockSupport;
+import org.slf4j.Logger;
+import org.slf4j.LoggerFactory;
+
+/**
+ * Daemon thread logging the records the native library queues. Once it runs, native code only
+ * copies log records into a bounded ring instead of calling the logger (and possibly attaching its
+ * thread to the JVM) itself. Records are dropped when the ring is full.
+ *
+ * <p>The thread stops after {@link Waf#deinitialize()}, which logs the records still queued.
+ */
+final class NativeLogDrainer implements Runnable {
+  static final String THREAD_NAME = "ddwaf-native-log-drainer";
+
+  private static final Logger LOGGER = LoggerFactory.getLogger(NativeLogDrainer.class);
+  private static final long IDLE_PARK_NANOS = TimeUnit.MILLISECONDS.toNanos(20);
+  // held around each batch; tests hold it to keep records queued
+  static final Object PAUSE_LOCK = new Object();
+
+  private long reportedDropped;
+
+  private NativeLogDrainer() {}
+
+  static void start() {
+    if (!startAsync()) {
+      return;
+    }
+    Thread thread = new Thread(new NativeLogDrainer(), THREAD_NAME);
+    thread.setDaemon(true);
+    thread.start();
+  }
+
+  @Override
+  public void run() {
+    while (true) {
+      int drained;
+      try {
+        synchronized (PAUSE_LOCK) {
+          drained = drain();
+        }
+      } catch (RuntimeException | Error e) {
+        LOGGER.warn("Error logging native log records", e);
+        drained = 0;
+      }
+      if (drained < 0) {
+        return; // deinitialized
+      }
+
+      long dropped = getDroppedRecords();
+      if (dropped != reportedDropped) {
+        LOGGER.warn("Dropped {} native log records", dropped - reportedDropped);
+        reportedDropped = dropped;
+      }
+
+      if (drained == 0) {
+        LockSupport.parkNanos(IDLE_PARK_NANOS);
+      }
+    }
+  }
+
+  // makes native code queue the records; false if logging isn't initialized
+  private static native boolean startAsync();
+
+  // logs a batch of queued records; returns how many, or -1 after deinitialization
+  private static native int drain();
+
+  static native long getDroppedRecords();
+
+  // queues count debug records, as the libddwaf log callback does; used by tests
+  static native void logRecords(String message, int count);
+}
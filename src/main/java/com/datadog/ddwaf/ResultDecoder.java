@@ -0,0 +1,251 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf;
+
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Collections;
+import java.util.LinkedHashMap;
+import java.util.List;
+import java.util.Map;
+
+/**
+ * Decodes the results that the native code writes into a direct {@link ByteBuffer}, so that a run
+ * costs a single JNI call instead of one upcall per returned object.
+ *
+ * <p>Layout (native byte order):
+ *
+ * <pre>
+ *   u32 total length | u8 result code | u8 flags (1: keep, 2: events) | u16 reserved (0)
+ *   u64 duration (ns)
+ *   value data (STRING or NULL) | value actions (ACTIONS or NULL) | value attributes (MAP or NULL)
+ *
+ *   value := u8 tag, then
+ *     NULL, FALSE, TRUE: nothing
+ *     LONG: i64 | DOUBLE: f64
+ *     STRING: u32 length, UTF-8 bytes
+ *     ARRAY: u32 count, values | MAP: u32 count, (u32 length, UTF-8 key bytes, value) per entry
+ *     REF: u32 index into the refs array, filled by the native code with Java strings
+ *     ACTIONS: u64 hash and u32 length of the encoded map that follows (see {@link ActionCache})
+ * </pre>
+ *
+ * <p>Instances are not thread-safe; each {@link WafContext} owns one.
+ */
+final class ResultDecoder {
+  static final int INITIAL_BUFFER_SIZE = 1024;
+  // larger buffers returned by the native code are used once and then dropped
+  static final int MAX_RETAINED_BUFFER_SIZE = 64 * 1024;
+  static final int NUM_REFS = 16;
+
+  private static final int HEADER_SIZE = 16;
+  private static final int FLAG_KEEP = 0x01;
+  private static final int FLAG_EVENTS = 0x02;
+
+  private static final int TAG_NULL = 0;
+  private static final int TAG_LONG = 1;
+  private static final int TAG_DOUBLE = 2;
+  private static final int TAG_FALSE = 3;
+  private static final int TAG_TRUE = 4;
+  private static final int TAG_STRING = 5;
+  private static final int TAG_ARRAY = 6;
+  private static final int TAG_MAP = 7;
+  private static final int TAG_REF = 8;
+  private static final int TAG_ACTIONS = 9;
+
+  private static final Waf.Result[] RESULTS = {Waf.Result.OK, Waf.Result.MATCH, Waf.Result.TIMEOUT};
+
+  private final ActionCache actionCache;
+  private ByteBuffer buffer;
+  private final Object[] refs = new Object[NUM_REFS];
+  private byte[] scratch = new byte[256];
+
+  // state of the current decode
+  private ByteBuffer in;
+  private int pos;
+
+  /** @param actionCache the cache of the handle, or null to use one private to this decoder */
+  ResultDecoder(ActionCache actionCache) {
+    this.actionCache = actionCache != null ? actionCache : new ActionCache();
+  }
+
+  /** The buffer to pass to the native code. */
+  ByteBuffer buffer() {
+    if (buffer == null) {
+      buffer = ByteBuffer.allocateDirect(INITIAL_BUFFER_SIZE);
+    }
+    return buffer;
+  }
+
+  /** The array through which the native code passes Java strings. */
+  Object[] refs() {
+    return refs;
+  }
+
+  /**
+   * Decodes the result written by the native code.
+   *
+   * @param out the buffer returned by the native code; either {@link #buffer()} or a larger one
+   */
+  Waf.ResultWithData decode(ByteBuffer out) {
+    out.order(ByteOrder.nativeOrder());
+    if (out != buffer && out.capacity() <= MAX_RETAINED_BUFFER_SIZE) {
+      buffer = out;
+    }
+    this.in = out;
+    try {
+      int length = out.getInt(0);
+      int code = out.get(4);
+      int flags = out.get(5);
+      long duration = out.getLong(8);
+      if (code < 0 || code >= RESULTS.length || length < HEADER_SIZE) {
+        throw new IllegalStateException("Invalid result header (code " + code + ")");
+      }
+      Waf.Result result = RESULTS[code];
+      if (result == Waf.Result.TIMEOUT) {
+        return Waf.ResultWithData.TIMEOUT;
+      }
+
+      this.pos = HEADER_SIZE;
+      String data = (String) readValue();
+      Map<String, Map<String, Object>> actions;
+      List<WafAction> typedActions;
+      ActionCache.Entry cachedActions = readActions();
+      if (cachedActions != null) {
+        actions = cachedActions.actions;
+        typedActions = cachedActions.typedActions;
+      } else {
+        actions = Waf.ResultWithData.EMPTY_ACTIONS;
+        typedActions = Collections.emptyList();
+      }
+      @SuppressWarnings("unchecked")
+      Map<String, Object> attributes = (Map<String, Object>) readValue();
+      if (pos != length) {
+        throw new IllegalStateException(
+            "Result length mismatch: read " + pos + " bytes out of " + length);
+      }
+
+      return new Waf.ResultWithData(
+          result,
+          data,
+          actions,
+          typedActions,
+          attributes,
+          (flags & FLAG_KEEP) != 0,
+          duration,
+          (flags & FLAG_EVENTS) != 0);
+    } finally {
+      this.in = null;
+      Arrays.fill(refs, null);
+    }
+  }
+
+  private ActionCache.Entry readActions() {
+    int tag = in.get(pos++);
+    if (tag == TAG_NULL) {
+      return null;
+    }
+    if (tag != TAG_ACTIONS) {
+      throw new IllegalStateException("Expected actions at position " + (pos - 1));
+    }
+    long hash = in.getLong(pos);
+    int len = in.getInt(pos + 8);
+    pos += 12;
+
+    ActionCache.Entry entry = actionCache.get(hash, in, pos, len);
+    if (entry != null) {
+      pos += len;
+      return entry;
+    }
+
+    int start = pos;
+    @SuppressWarnings("unchecked")
+    Map<String, Map<String, Object>> actions = (Map<String, Map<String, Object>>) readValue();
+    if (actions == null || pos - start != len) {
+      throw new IllegalStateException("Invalid actions at position " + start);
+    }
+    return actionCache.put(hash, in, start, len, actions);
+  }
+
+  private Object readValue() {
+    int tag = in.get(pos++);
+    switch (tag) {
+      case TAG_NULL:
+        return null;
+      case TAG_LONG:
+        {
+          long v = in.getLong(pos);
+          pos += 8;
+          return v;
+        }
+      case TAG_DOUBLE:
+        {
+          double v = in.getDouble(pos);
+          pos += 8;
+          return v;
+        }
+      case TAG_FALSE:
+        return Boolean.FALSE;
+      case TAG_TRUE:
+        return Boolean.TRUE;
+      case TAG_STRING:
+        return readString();
+      case TAG_ARRAY:
+        {
+          int count = readCount();
+          List<Object> list = new ArrayList<>(count);
+          for (int i = 0; i < count; i++) {
+            list.add(readValue());
+          }
+          return list;
+        }
+      case TAG_MAP:
+        {
+          int count = readCount();
+          Map<String, Object> map = new LinkedHashMap<>();
+          for (int i = 0; i < count; i++) {
+            String key = readString();
+            map.put(key, readValue());
+          }
+          return map;
+        }
+      case TAG_REF:
+        return refs[readCount()];
+      default:
+        throw new IllegalStateException("Unknown tag " + tag + " at position " + (pos - 1));
+    }
+  }
+
+  private int readCount() {
+    int v = in.getInt(pos);
+    pos += 4;
+    if (v < 0) {
+      throw new IllegalStateException("Invalid count or length at position " + (pos - 4));
+    }
+    return v;
+  }
+
+  private String readString() {
+    int len = readCount();
+    if (len == 0) {
+      return "";
+    }
+    if (scratch.length < len) {
+      scratch = new byte[Math.max(len, scratch.length * 2)];
+    }
+    // Buffer cast: ByteBuffer.position(int) only exists from Java 9
+    ((Buffer) in).position(pos);
+    in.get(scratch, 0, len);
+    pos += len;
+    return new String(scratch, 0, len, StandardCharsets.UTF_8);
+  }
+}
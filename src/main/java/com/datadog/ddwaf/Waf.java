@@ -9,12 +9,15 @@
 package com.datadog.ddwaf;
 
 import com.datadog.ddwaf.exception.AbstractWafException;
+import com.datadog.ddwaf.exception.TimeoutWafException;
 import com.datadog.ddwaf.exception.UnclassifiedWafException;
 import com.datadog.ddwaf.exception.UnsupportedVMException;
 import java.io.IOException;
 import java.nio.ByteBuffer;
 import java.util.Arrays;
 import java.util.Collections;
+import java.util.LinkedHashMap;
+import java.util.List;
 import java.util.Map;
 import org.slf4j.Logger;
 import org.slf4j.LoggerFactory;
@@ -24,6 +27,9 @@ public final class Waf {
 
   private static final Logger LOGGER = LoggerFactory.getLogger(Waf.class);
   static final boolean EXIT_ON_LEAK;
+  static final boolean STACKLESS_EXCEPTIONS;
+  static final boolean ASYNC_NATIVE_LOGGING;
+  static volatile InputRecorder inputRecorder;
 
   private static boolean triedInitializing;
   private static boolean initialized;
@@ -31,6 +37,10 @@ public final class Waf {
   static {
     String exl = System.getProperty("DD_APPSEC_DDWAF_EXIT_ON_LEAK", "false");
     EXIT_ON_LEAK = !exl.equalsIgnoreCase("false");
+    String sle = System.getProperty("DD_APPSEC_DDWAF_STACKLESS_EXCEPTIONS", "false");
+    STACKLESS_EXCEPTIONS = !sle.equalsIgnoreCase("false");
+    String anl = System.getProperty("DD_APPSEC_DDWAF_ASYNC_NATIVE_LOGGING", "true");
+    ASYNC_NATIVE_LOGGING = !anl.equalsIgnoreCase("false");
   }
 
   private Waf() {}
@@ -57,6 +67,9 @@ public final class Waf {
       LOGGER.error("Failure loading native library", e);
       throw new RuntimeException("Error loading native lib", e);
     }
+    if (ASYNC_NATIVE_LOGGING) {
+      NativeLogDrainer.start();
+    }
     initialized = true;
   }
 
@@ -75,15 +88,108 @@ public final class Waf {
    */
   public static native void deinitialize();
 
+  /**
+   * Number of API security schemas whose encoded form was found in the native cache. The size of
+   * the cache is set with the system property {@code DD_APPSEC_WAF_SCHEMA_CACHE_SIZE} (0 disables
+   * it).
+   */
+  public static native long getSchemaCacheHits();
+
+  /** Number of API security schemas that had to be encoded. */
+  public static native long getSchemaCacheMisses();
+
+  /**
+   * Number of native log records dropped because they were produced faster than they could be
+   * logged. Native log records are logged asynchronously unless the system property {@code
+   * DD_APPSEC_DDWAF_ASYNC_NATIVE_LOGGING} is {@code false}.
+   */
+  public static long getDroppedNativeLogRecords() {
+    return NativeLogDrainer.getDroppedRecords();
+  }
+
+  /**
+   * Highest CPU feature level the native kernels may use: {@code generic}, {@code sse2}, {@code
+   * ssse3}, {@code sse4.2}, {@code avx2} or {@code avx512} on x86-64, {@code neon} on AArch64. It
+   * can be lowered (never raised) with the system property {@code DD_APPSEC_WAF_CPU_LEVEL}, read
+   * when the native library is loaded.
+   */
+  public static native String getCpuLevel();
+
+  /**
+   * Implementation selected for each native kernel, e.g. {@code base64 -> ssse3}, in a stable
+   * order.
+   */
+  public static Map<String, String> getKernelImplementations() {
+    String[] pairs = getSelectedKernels();
+    Map<String, String> ret = new LinkedHashMap<>();
+    for (int i = 0; i + 1 < pairs.length; i += 2) {
+      ret.put(pairs[i], pairs[i + 1]);
+    }
+    return Collections.unmodifiableMap(ret);
+  }
+
+  // kernel and implementation names, alternating
+  private static native String[] getSelectedKernels();
+
+  /**
+   * Records the inputs of every subsequent {@link WafContext} run with {@code recorder}, or stops
+   * recording if it's {@code null}. The caller closes the recorder.
+   */
+  public static void setInputRecorder(InputRecorder recorder) {
+    inputRecorder = recorder;
+  }
+
+  /**
+   * Removes and returns the inputs captured from slow runs. Capture is off unless the system
+   * property {@code DD_APPSEC_WAF_SLOW_RUN_THRESHOLD_US} is positive when the native library is
+   * loaded; then one in {@code DD_APPSEC_WAF_SLOW_RUN_SAMPLE} (default 1) runs whose native time
+   * or {@code ddwaf_run} duration reaches the threshold, or that time out, is kept in a ring of
+   * {@code DD_APPSEC_WAF_SLOW_RUN_SLOTS} (default 16, at most 65535) entries, overwriting the
+   * oldest ones.
+   *
+   * <p>The dump is in native byte order: the magic {@code "DDSC"}, a {@code u16} version (1) and
+   * a {@code u16} record count, then the records, oldest first:
+   *
+   * <ul>
+   *   <li>{@code u32} record length, including this field
+   *   <li>{@code u64} wall clock time in ns since the epoch
+   *   <li>{@code u64} native run time and {@code u64} {@code ddwaf_run} duration, in ns
+   *   <li>{@code u8} flags: 1 timed out, 2 truncated, 4 has persistent data, 8 has ephemeral data
+   *   <li>{@code u32} length and UTF-8 bytes of the {@link WafHandle} name
+   *   <li>the persistent, then the ephemeral data, if present
+   * </ul>
+   *
+   * <p>A value is its {@code u8} ddwaf object type followed by: {@code i64}, {@code u64}, {@code
+   * f64} or {@code u8} for scalars; {@code u32} length and bytes for strings; {@code u32} count and
+   * the elements for arrays; {@code u32} count and, per entry, {@code u32} key length, key bytes
+   * and value for maps. Strings longer than 4096 bytes and objects nested deeper than 25 levels
+   * (replaced with type 0) are truncated; the inputs of records beyond 64 KiB are left out. Both
+   * set the truncated flag.
+   */
+  public static native byte[] drainSlowRunCaptures();
+
   // called from JNI
   private static AbstractWafException createException(int retCode) {
+    if (STACKLESS_EXCEPTIONS) {
+      return AbstractWafException.preallocatedFromErrorCode(retCode);
+    }
     return AbstractWafException.createFromErrorCode(retCode);
   }
 
+  // called from JNI
+  static TimeoutWafException createTimeoutException() {
+    if (STACKLESS_EXCEPTIONS) {
+      return TimeoutWafException.PREALLOCATED;
+    }
+    return new TimeoutWafException();
+  }
+
   public enum Result {
-    // there references to these static fields on native code
+    // the codes are also written by native code (see ResultDecoder)
     OK(0),
-    MATCH(1);
+    MATCH(1),
+    // only returned if Limits.timeoutAsResult is set; otherwise a TimeoutWafException is thrown
+    TIMEOUT(2);
 
     public final int code;
 
@@ -93,16 +199,24 @@ public final class Waf {
   }
 
   public static class ResultWithData {
-    // used also from JNI
-    private static final Map<String, Map<String, Object>> EMPTY_ACTIONS = Collections.emptyMap();
+    // used also by ResultDecoder
+    static final Map<String, Map<String, Object>> EMPTY_ACTIONS = Collections.emptyMap();
 
-    // reuse this from JNI when there is no actions or data
     public static final ResultWithData OK_NULL =
         new ResultWithData(Result.OK, null, EMPTY_ACTIONS, null, false, 0, false);
 
+    // returned instead of throwing TimeoutWafException if Limits.timeoutAsResult
+    public static final ResultWithData TIMEOUT =
+        new ResultWithData(Result.TIMEOUT, null, EMPTY_ACTIONS, null, false, 0, false);
+
     public final Result result;
     public final String data;
     public final Map<String, Map<String, Object>> actions;
+    /**
+     * Typed view of {@link #actions}. Results of the same {@link WafHandle} that return the same
+     * actions share the instances (and the {@link #actions} map).
+     */
+    public final List<WafAction> typedActions;
     public final Map<String, Object> attributes;
     public final boolean keep;
     public final long duration; // in nanoseconds
@@ -116,9 +230,30 @@ public final class Waf {
         boolean keep,
         long duration,
         boolean events) {
+      this(
+          result,
+          data,
+          actions,
+          WafAction.fromActions(actions),
+          attributes,
+          keep,
+          duration,
+          events);
+    }
+
+    public ResultWithData(
+        Result result,
+        String data,
+        Map<String, Map<String, Object>> actions,
+        List<WafAction> typedActions,
+        Map<String, Object> attributes,
+        boolean keep,
+        long duration,
+        boolean events) {
       this.result = result;
       this.data = data;
       this.actions = actions;
+      this.typedActions = typedActions;
       this.attributes = attributes;
       this.keep = keep;
       this.duration = duration;
@@ -145,6 +280,11 @@ public final class Waf {
     public final int maxStringSize;
     public final long generalBudgetInUs;
     public final long runBudgetInUs; // <= 0
+    /**
+     * If set, an exhausted budget is reported as {@link ResultWithData#TIMEOUT} instead of by
+     * throwing a {@link TimeoutWafException}.
+     */
+    public final boolean timeoutAsResult;
 
     public Limits(
         int maxDepth,
@@ -152,11 +292,22 @@ public final class Waf {
         int maxStringSize,
         long generalBudgetInUs,
         long runBudgetInUs) {
+      this(maxDepth, maxElements, maxStringSize, generalBudgetInUs, runBudgetInUs, false);
+    }
+
+    public Limits(
+        int maxDepth,
+        int maxElements,
+        int maxStringSize,
+        long generalBudgetInUs,
+        long runBudgetInUs,
+        boolean timeoutAsResult) {
       this.maxDepth = maxDepth;
       this.maxElements = maxElements;
       this.maxStringSize = maxStringSize;
       this.generalBudgetInUs = generalBudgetInUs;
       this.runBudgetInUs = runBudgetInUs;
+      this.timeoutAsResult = timeoutAsResult;
     }
 
     public Limits reduceBudget(long amountInUs) {
@@ -164,7 +315,8 @@ public final class Waf {
       if (newBudget < 0) {
         newBudget = 0;
       }
-      return new Limits(maxDepth, maxElements, maxStringSize, newBudget, runBudgetInUs);
+      return new Limits(
+          maxDepth, maxElements, maxStringSize, newBudget, runBudgetInUs, timeoutAsResult);
     }
 
     @Override
@@ -175,6 +327,7 @@ public final class Waf {
       sb.append(", maxStringSize=").append(maxStringSize);
       sb.append(", generalBudgetInUs=").append(generalBudgetInUs);
       sb.append(", runBudgetInUs=").append(runBudgetInUs);
+      sb.append(", timeoutAsResult=").append(timeoutAsResult);
       sb.append('}');
       return sb.toString();
     }
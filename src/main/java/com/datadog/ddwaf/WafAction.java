@@ -0,0 +1,118 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf;
+
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.List;
+import java.util.Map;
+
+/**
+ * Typed view of an action returned by the WAF (an entry of {@link Waf.ResultWithData#actions}).
+ * Instances are immutable and, for a given {@link WafHandle}, shared between the results that
+ * return the same actions.
+ */
+public final class WafAction {
+  public enum Type {
+    BLOCK_REQUEST("block_request"),
+    REDIRECT_REQUEST("redirect_request"),
+    GENERATE_STACK("generate_stack"),
+    GENERATE_SCHEMA("generate_schema"),
+    /** Custom actions; see {@link WafAction#name}. */
+    OTHER(null);
+
+    public final String wafName;
+
+    Type(String wafName) {
+      this.wafName = wafName;
+    }
+
+    static Type fromWafName(String name) {
+      for (Type t : values()) {
+        if (name.equals(t.wafName)) {
+          return t;
+        }
+      }
+      return OTHER;
+    }
+  }
+
+  public static final int NO_STATUS_CODE = -1;
+
+  public final Type type;
+  /** The action type as returned by the WAF (the key in the actions map). */
+  public final String name;
+  /** The {@code status_code} parameter, or {@link #NO_STATUS_CODE}. */
+  public final int statusCode;
+  /** The {@code grpc_status_code} parameter, or {@link #NO_STATUS_CODE}. */
+  public final int grpcStatusCode;
+  /** The {@code type} parameter of blocking actions (e.g. {@code auto}, {@code json}), or null. */
+  public final String blockingType;
+  /** The {@code location} parameter of redirects, or null. */
+  public final String location;
+  /** The {@code stack_id} parameter of {@link Type#GENERATE_STACK}, or null. */
+  public final String stackId;
+  /** All the parameters; unmodifiable. */
+  public final Map<String, Object> parameters;
+
+  WafAction(String name, Map<String, Object> parameters) {
+    this.type = Type.fromWafName(name);
+    this.name = name;
+    this.parameters = parameters;
+    this.statusCode = intParameter(parameters, "status_code");
+    this.grpcStatusCode = intParameter(parameters, "grpc_status_code");
+    this.blockingType = stringParameter(parameters, "type");
+    this.location = stringParameter(parameters, "location");
+    this.stackId = stringParameter(parameters, "stack_id");
+  }
+
+  /** Converts an actions map; the parameter maps are wrapped, not copied. */
+  static List<WafAction> fromActions(Map<String, Map<String, Object>> actions) {
+    if (actions == null || actions.isEmpty()) {
+      return Collections.emptyList();
+    }
+    List<WafAction> list = new ArrayList<>(actions.size());
+    for (Map.Entry<String, Map<String, Object>> e : actions.entrySet()) {
+      Map<String, Object> params = e.getValue();
+      list.add(
+          new WafAction(
+              e.getKey(),
+              params == null
+                  ? Collections.<String, Object>emptyMap()
+                  : Collections.unmodifiableMap(params)));
+    }
+    return Collections.unmodifiableList(list);
+  }
+
+  // the waf reports numeric parameters either as numbers or strings
+  private static int intParameter(Map<String, Object> params, String key) {
+    Object v = params.get(key);
+    if (v instanceof Number) {
+      return ((Number) v).intValue();
+    }
+    if (v instanceof String) {
+      try {
+        return Integer.parseInt((String) v);
+      } catch (NumberFormatException e) {
+        return NO_STATUS_CODE;
+      }
+    }
+    return NO_STATUS_CODE;
+  }
+
+  private static String stringParameter(Map<String, Object> params, String key) {
+    Object v = params.get(key);
+    return v instanceof String ? (String) v : null;
+  }
+
+  @Override
+  public String toString() {
+    return "WafAction{type=" + type + ", name=" + name + ", parameters=" + parameters + '}';
+  }
+}
@@ -10,16 +10,45 @@ package com.datadog.ddwaf;
 
 import com.datadog.ddwaf.exception.InvalidRuleSetException;
 import com.datadog.ddwaf.exception.UnclassifiedWafException;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.channels.FileChannel;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Path;
+import java.nio.file.StandardOpenOption;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Collections;
+import java.util.HashMap;
+import java.util.LinkedHashMap;
+import java.util.List;
 import java.util.Map;
+import java.util.concurrent.CompletableFuture;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
 import org.slf4j.Logger;
 import org.slf4j.LoggerFactory;
 
 public final class WafBuilder {
   private static final Logger log = LoggerFactory.getLogger(WafBuilder.class);
+  private static final int MAX_PACKED_SIZE = Integer.MAX_VALUE - 8;
   // The ptr field holds the pointer to PWAddContext and managed by PowerWAF
   private final long ptr; // KEEP THIS FIELD!
+  private final boolean summaryDiagnostics; // read by the native code
   private boolean online;
   private final LeakDetection.PhantomRefWithName<Object> selfRef;
+  // guarded by this: the digests of the configs last applied successfully, by path
+  private final Map<String, AppliedConfig> appliedConfigs = new HashMap<>();
+  private boolean modifiedSinceBuild;
+
+  // updates queued by the async methods, guarded by pendingLock rather than this, so that they can
+  // be queued while a build holds this
+  private final Object pendingLock = new Object();
+  private Map<String, PendingUpdate> pendingUpdates = new LinkedHashMap<>();
+  private List<CompletableFuture<WafHandle>> pendingBuilds = new ArrayList<>();
+  private int coalescedUpdates;
+  private long pendingSinceNs;
+  private boolean buildScheduled;
 
   public WafBuilder() {
     this(null);
@@ -28,6 +57,7 @@ public final class WafBuilder {
   public WafBuilder(WafConfig config) {
     online = true;
     config = config == null ? WafConfig.DEFAULT_CONFIG : config;
+    this.summaryDiagnostics = config.summaryDiagnostics;
     this.ptr = initBuilder(config);
     if (Waf.EXIT_ON_LEAK) {
       this.selfRef = LeakDetection.registerCloseable(this);
@@ -37,7 +67,9 @@ public final class WafBuilder {
   }
 
   /**
-   * Adds or updates a configuration file.
+   * Adds or updates a configuration file. The update is skipped if the configuration is identical
+   * to the one last applied at the same path, as told by a digest of its contents; the diagnostics
+   * returned are then those of that update, and {@link WafDiagnostics#isUnchanged()} is true.
    *
    * @param path Path to the config.
    * @param config The configuration to add, update or remove.
@@ -59,12 +91,302 @@ public final class WafBuilder {
     if (path.isEmpty()) {
       throw new IllegalArgumentException("Path cannot be empty");
     }
+    return runUpdate(
+        path,
+        (digestRef, infoRef) -> addOrUpdateConfigNative(this, path, config, digestRef, infoRef));
+  }
+
+  /**
+   * Adds or updates a configuration given as UTF-8 JSON text. The JSON is parsed natively straight
+   * into libddwaf objects, without building a {@code Map} first. Duplicate keys are all passed on
+   * to libddwaf; there is no limit on the number of elements or the length of strings, but
+   * containers can be nested at most 20 levels deep.
+   *
+   * @param path Path to the config.
+   * @param json The configuration, as UTF-8 JSON.
+   * @return The diagnostics of the configuration.
+   * @throws InvalidRuleSetException if the JSON is malformed or the config is invalid.
+   * @throws UnclassifiedWafException if request is not valid.
+   */
+  public WafDiagnostics addOrUpdateConfig(String path, byte[] json)
+      throws UnclassifiedWafException {
+    if (json == null) {
+      throw new IllegalArgumentException("Config cannot be null");
+    }
+    return addOrUpdateJsonConfig(path, null, json, 0, json.length);
+  }
+
+  /**
+   * Like {@link #addOrUpdateConfig(String, byte[])}, with the JSON between the position and the
+   * limit of {@code json}, which are left unchanged. Direct buffers are parsed in place.
+   */
+  public WafDiagnostics addOrUpdateConfig(String path, ByteBuffer json)
+      throws UnclassifiedWafException {
+    if (json == null) {
+      throw new IllegalArgumentException("Config cannot be null");
+    }
+    if (json.isDirect()) {
+      return addOrUpdateJsonConfig(path, json, null, json.position(), json.remaining());
+    }
+    if (json.hasArray()) {
+      return addOrUpdateJsonConfig(
+          path, null, json.array(), json.arrayOffset() + json.position(), json.remaining());
+    }
+    byte[] copy = new byte[json.remaining()]; // read-only heap buffer
+    json.duplicate().get(copy);
+    return addOrUpdateJsonConfig(path, null, copy, 0, copy.length);
+  }
+
+  /**
+   * Like {@link #addOrUpdateConfig(String, byte[])}, with the JSON read from {@code file} into a
+   * direct buffer and parsed in place. The file isn't mapped, so it's closed and can be replaced or
+   * deleted as soon as this returns.
+   *
+   * @throws IOException if the file can't be read.
+   */
+  public WafDiagnostics addOrUpdateConfigFile(String path, Path file)
+      throws IOException, UnclassifiedWafException {
+    ByteBuffer json;
+    try (FileChannel channel = FileChannel.open(file, StandardOpenOption.READ)) {
+      long size = channel.size();
+      if (size > Integer.MAX_VALUE) {
+        throw new IOException("Config larger than 2 GiB: " + file);
+      }
+      json = ByteBuffer.allocateDirect((int) size);
+      while (json.hasRemaining()) {
+        if (channel.read(json) < 0) {
+          throw new IOException("Config truncated while reading: " + file);
+        }
+      }
+    }
+    json.flip();
+    return addOrUpdateConfig(path, json);
+  }
+
+  /**
+   * Like {@link #addOrUpdateConfig(String, Map)}, with a configuration converted beforehand and
+   * loaded from a snapshot file, with no parsing, conversion or allocation per object.
+   */
+  public synchronized WafDiagnostics addOrUpdateConfig(String path, ConfigSnapshot snapshot)
+      throws UnclassifiedWafException {
+    if (!online) {
+      throw new UnclassifiedWafException("WafBuilder is offline");
+    }
+    if (snapshot == null) {
+      throw new IllegalArgumentException("Config cannot be null");
+    }
+    if (path == null) {
+      throw new IllegalArgumentException("Path cannot be null");
+    }
+    if (path.isEmpty()) {
+      throw new IllegalArgumentException("Path cannot be empty");
+    }
+    return runUpdate(
+        path,
+        (digestRef, infoRef) ->
+            addOrUpdateSnapshotConfigNative(this, path, snapshot.root, digestRef, infoRef));
+  }
+
+  /** The configuration sections holding data, such as blocked IP addresses or user ids. */
+  public enum DataSection {
+    RULES_DATA("rules_data"),
+    EXCLUSION_DATA("exclusion_data");
+
+    final String key;
+
+    DataSection(String key) {
+      this.key = key;
+    }
+  }
+
+  /**
+   * Adds or updates a configuration with a single data entry, such as a list of blocked IPs or
+   * users: {@code {section: [{id: id, type: type, data: [{value: values[i], expiration:
+   * expirations[i]}, ...]}]}}. The configuration is the same as if it were passed as a {@code Map}
+   * to {@link #addOrUpdateConfig(String, Map)}, but the values are handed over packed and it's
+   * built natively in a single pass, rather than converted map by map.
+   *
+   * @param path Path to the configuration.
+   * @param section The section the entry belongs to.
+   * @param id The data id referred to by the rules or exclusions, e.g. {@code "blocked_ips"}.
+   * @param type The data type, e.g. {@code "ip_with_expiration"} or {@code
+   *     "data_with_expiration"}.
+   * @param values The values.
+   * @param expirations The expiration of each value, 0 if it never expires; null if none expire.
+   * @return The diagnostics of the configuration.
+   * @throws InvalidRuleSetException If the configuration is invalid.
+   * @throws UnclassifiedWafException If the builder is closed.
+   * @throws IllegalArgumentException If an argument or value is null, or an expiration negative.
+   */
+  public synchronized WafDiagnostics addOrUpdateDataConfig(
+      String path, DataSection section, String id, String type, String[] values, long[] expirations)
+      throws UnclassifiedWafException {
+    if (!online) {
+      throw new UnclassifiedWafException("WafBuilder is offline");
+    }
+    if (path == null) {
+      throw new IllegalArgumentException("Path cannot be null");
+    }
+    if (path.isEmpty()) {
+      throw new IllegalArgumentException("Path cannot be empty");
+    }
+    if (section == null || id == null || type == null || values == null) {
+      throw new IllegalArgumentException("Section, id, type and values cannot be null");
+    }
+    if (expirations != null) {
+      if (expirations.length != values.length) {
+        throw new IllegalArgumentException("There must be one expiration per value");
+      }
+      for (long expiration : expirations) {
+        if (expiration < 0) {
+          throw new IllegalArgumentException("Expirations cannot be negative");
+        }
+      }
+    }
+    int[] ends = new int[values.length];
+    byte[] packed = packValues(values, ends);
+    return runUpdate(
+        path,
+        (digestRef, infoRef) ->
+            addOrUpdateDataConfigNative(
+                this, path, section.key, id, type, packed, ends, expirations, digestRef, infoRef));
+  }
+
+  // The values in UTF-8, concatenated; ends[i] is set to where values[i] ends. ASCII values, such
+  // as IP addresses, are copied without an intermediate array
+  @SuppressWarnings("deprecation")
+  static byte[] packValues(String[] values, int[] ends) {
+    long rest = 0; // chars of the values not packed yet
+    for (String value : values) {
+      if (value == null) {
+        throw new IllegalArgumentException("Values cannot be null");
+      }
+      rest += value.length();
+    }
+    if (rest > MAX_PACKED_SIZE) {
+      throw new IllegalArgumentException("Values too large");
+    }
+    // large enough for the rest if it's ASCII
+    byte[] packed = new byte[(int) rest];
+    int pos = 0;
+    for (int i = 0; i < values.length; i++) {
+      String value = values[i];
+      int len = value.length();
+      rest -= len;
+      if (isAscii(value)) {
+        value.getBytes(0, len, packed, pos);
+        pos += len;
+      } else {
+        byte[] utf8 = value.getBytes(StandardCharsets.UTF_8);
+        long needed = pos + utf8.length + rest;
+        if (needed > MAX_PACKED_SIZE) {
+          throw new IllegalArgumentException("Values too large");
+        }
+        if (needed > packed.length) {
+          packed = Arrays.copyOf(packed, (int) Math.min(MAX_PACKED_SIZE, needed + needed / 2));
+        }
+        System.arraycopy(utf8, 0, packed, pos, utf8.length);
+        pos += utf8.length;
+      }
+      ends[i] = pos;
+    }
+    return packed;
+  }
+
+  private static boolean isAscii(String value) {
+    for (int i = 0; i < value.length(); i++) {
+      if (value.charAt(i) >= 0x80) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  private synchronized WafDiagnostics addOrUpdateJsonConfig(
+      String path, ByteBuffer buffer, byte[] array, int offset, int length)
+      throws UnclassifiedWafException {
+    if (!online) {
+      throw new UnclassifiedWafException("WafBuilder is offline");
+    }
+    if (path == null) {
+      throw new IllegalArgumentException("Path cannot be null");
+    }
+    if (path.isEmpty()) {
+      throw new IllegalArgumentException("Path cannot be empty");
+    }
+    if (length == 0) {
+      throw new InvalidRuleSetException(null, "Empty WAF configuration");
+    }
+    try {
+      return runUpdate(
+          path,
+          (digestRef, infoRef) ->
+              buffer != null
+                  ? addOrUpdateJsonConfigNative(
+                      this, path, buffer, offset, length, digestRef, infoRef)
+                  : addOrUpdateJsonArrayConfigNative(
+                      this, path, array, offset, length, digestRef, infoRef));
+    } catch (IllegalArgumentException e) {
+      throw new InvalidRuleSetException(null, e); // malformed JSON
+    }
+  }
+
+  // the native half of an update, filling digestRef and infoRef (see addOrUpdateConfigNative)
+  interface NativeUpdate {
+    boolean apply(long[] digestRef, WafDiagnostics[] infoRef);
+  }
+
+  // Called with this locked. If the native update throws, libddwaf may have applied the config
+  // all the same (e.g. if only its diagnostics couldn't be converted), so the digest of the path
+  // is forgotten and the next build isn't skipped
+  WafDiagnostics runUpdate(String path, NativeUpdate update) throws InvalidRuleSetException {
     WafDiagnostics[] infoRef = new WafDiagnostics[1];
-    if (addOrUpdateConfigNative(this, path, config, infoRef)) {
-      return infoRef[0];
+    long[] digestRef = digestRef(path);
+    boolean ok;
+    try {
+      ok = update.apply(digestRef, infoRef);
+    } catch (RuntimeException | Error e) {
+      appliedConfigs.remove(path);
+      modifiedSinceBuild = true;
+      throw e;
+    }
+    return afterUpdate(path, digestRef, ok, infoRef[0]);
+  }
+
+  // called with this locked: the digest of the config last applied at path, or {0, 0}
+  private long[] digestRef(String path) {
+    AppliedConfig applied = appliedConfigs.get(path);
+    return applied != null ? applied.digest.clone() : new long[2];
+  }
+
+  // called with this locked; digestRef was filled by the native update. Returns the diagnostics of
+  // the update, or of the earlier one if it was skipped
+  private WafDiagnostics afterUpdate(
+      String path, long[] digestRef, boolean ok, WafDiagnostics diagnostics)
+      throws InvalidRuleSetException {
+    AppliedConfig applied = appliedConfigs.get(path);
+    if (ok && applied != null && Arrays.equals(applied.digest, digestRef)) {
+      return applied.diagnostics != null ? applied.diagnostics.asUnchanged() : null;
+    }
+    modifiedSinceBuild = true;
+    if (ok && (digestRef[0] != 0 || digestRef[1] != 0)) {
+      appliedConfigs.put(path, new AppliedConfig(digestRef, diagnostics));
     } else {
-      throw new InvalidRuleSetException(infoRef[0], "Invalid WAF configuration");
+      appliedConfigs.remove(path);
+    }
+    if (!ok) {
+      throw new InvalidRuleSetException(diagnostics, "Invalid WAF configuration");
     }
+    return diagnostics;
+  }
+
+  /**
+   * Whether a configuration was added, updated or removed since the last handle was built. Skipped
+   * updates of unchanged configurations don't count, so a caller applying a batch of remote
+   * configurations can avoid rebuilding an identical handle.
+   */
+  public synchronized boolean isModifiedSinceLastBuild() {
+    return modifiedSinceBuild;
   }
 
   /**
@@ -87,6 +409,8 @@ public final class WafBuilder {
     if (!removeConfigNative(this, path)) {
       throw new UnclassifiedWafException("Failed to remove configuration");
     }
+    appliedConfigs.remove(path);
+    modifiedSinceBuild = true;
   }
 
   /**
@@ -100,37 +424,414 @@ public final class WafBuilder {
     if (!online) {
       throw new UnclassifiedWafException("WafBuilder is offline");
     }
+    long buildStart = System.nanoTime();
     WafHandle handle = buildInstance(this);
     if (handle == null) {
       throw new UnclassifiedWafException(
           "Failed to build WafHandle instance, "
               + "check rules to make sure there is at least one valid one");
     }
+    modifiedSinceBuild = false;
+    handle.buildReport =
+        new WafHandle.BuildReport(
+            0, 0, 0, System.nanoTime() - buildStart, 0, 0, 0, Collections.emptyMap());
     return handle;
   }
 
-  /** Closes the WafBuilder instance and frees the resources. */
-  public synchronized void close() {
-    if (!online) {
-      return;
+  /**
+   * Queues a configuration update and returns the handle of the next build that includes it.
+   * Conversion and build happen on a dedicated daemon thread, shared by all builders; the
+   * configuration is converted without holding this builder's monitor.
+   *
+   * <p>Updates queued while a build is in flight are applied together in the next one. An update
+   * superseded by a later one for the same path before being applied is dropped, and its future
+   * completes like the later one's. All the futures of a build complete with the same handle, which
+   * the caller closes once. Its {@link WafHandle#getBuildReport() build report} has the timings of
+   * the phases and the diagnostics of the updates. Updates of unchanged configurations are skipped
+   * like with {@link #addOrUpdateConfig(String, Map)}, but the handle is still built.
+   *
+   * <p>The future fails with {@link InvalidRuleSetException} if this configuration is invalid
+   * (the others of the build are still applied), and with {@link UnclassifiedWafException} if the
+   * build fails or the builder is closed first.
+   *
+   * @throws IllegalArgumentException if the path is null or empty, or the config is null
+   */
+  public CompletableFuture<WafHandle> addOrUpdateConfigAsync(
+      String path, Map<String, Object> config) {
+    if (config == null) {
+      throw new IllegalArgumentException("Config cannot be null");
     }
-    online = false;
-    destroyBuilder(ptr);
-    if (this.selfRef != null) {
-      LeakDetection.notifyClose(this.selfRef);
+    return enqueue(path, config);
+  }
+
+  /**
+   * Queues the removal of a configuration, like {@link #addOrUpdateConfigAsync}. The future fails
+   * with {@link UnclassifiedWafException} if there was no configuration to remove.
+   */
+  public CompletableFuture<WafHandle> removeConfigAsync(String path) {
+    return enqueue(path, null);
+  }
+
+  /** Builds a handle on the build thread, with the updates queued by then. */
+  public CompletableFuture<WafHandle> buildWafHandleInstanceAsync() {
+    CompletableFuture<WafHandle> future = new CompletableFuture<>();
+    synchronized (pendingLock) {
+      markPendingLocked();
+      pendingBuilds.add(future);
+      scheduleBuildLocked();
+    }
+    return future;
+  }
+
+  /** Closes the WafBuilder instance and frees the resources. Queued async updates fail. */
+  public void close() {
+    synchronized (this) {
+      if (!online) {
+        return;
+      }
+      online = false;
+      destroyBuilder(ptr);
+      if (this.selfRef != null) {
+        LeakDetection.notifyClose(this.selfRef);
+      }
+    }
+    Batch batch;
+    synchronized (pendingLock) {
+      batch = takePendingLocked();
+    }
+    batch.failAll(new UnclassifiedWafException("WafBuilder is offline"));
+  }
+
+  private CompletableFuture<WafHandle> enqueue(String path, Map<String, Object> config) {
+    if (path == null) {
+      throw new IllegalArgumentException("Path cannot be null");
+    }
+    if (path.isEmpty()) {
+      throw new IllegalArgumentException("Path cannot be empty");
+    }
+    CompletableFuture<WafHandle> future = new CompletableFuture<>();
+    synchronized (pendingLock) {
+      markPendingLocked();
+      PendingUpdate update = new PendingUpdate(config);
+      PendingUpdate superseded = pendingUpdates.remove(path);
+      if (superseded != null) {
+        update.futures.addAll(superseded.futures);
+        coalescedUpdates++;
+      }
+      update.futures.add(future);
+      pendingUpdates.put(path, update);
+      scheduleBuildLocked();
+    }
+    return future;
+  }
+
+  private void markPendingLocked() {
+    if (pendingUpdates.isEmpty() && pendingBuilds.isEmpty()) {
+      pendingSinceNs = System.nanoTime();
     }
   }
 
+  private void scheduleBuildLocked() {
+    if (!buildScheduled) {
+      buildScheduled = true;
+      BuildExecutor.INSTANCE.execute(this::buildPending);
+    }
+  }
+
+  private Batch takePendingLocked() {
+    long queuedNs = System.nanoTime() - pendingSinceNs;
+    Batch batch = new Batch(pendingUpdates, pendingBuilds, coalescedUpdates, queuedNs);
+    pendingUpdates = new LinkedHashMap<>();
+    pendingBuilds = new ArrayList<>();
+    coalescedUpdates = 0;
+    return batch;
+  }
+
+  // on the build thread; one batch per task, so builders take turns
+  private void buildPending() {
+    Batch batch;
+    synchronized (pendingLock) {
+      batch = takePendingLocked();
+    }
+    try {
+      build(batch);
+    } catch (RuntimeException | Error e) {
+      log.warn("Error building WafHandle", e);
+      batch.failAll(e);
+    } finally {
+      synchronized (pendingLock) {
+        if (pendingUpdates.isEmpty() && pendingBuilds.isEmpty()) {
+          buildScheduled = false;
+        } else {
+          BuildExecutor.INSTANCE.execute(this::buildPending);
+        }
+      }
+    }
+  }
+
+  private void build(Batch batch) {
+    long conversionStart = System.nanoTime();
+    Map<String, Long> converted = new LinkedHashMap<>();
+    try {
+      for (Map.Entry<String, PendingUpdate> e : batch.updates.entrySet()) {
+        if (e.getValue().config == null) {
+          continue;
+        }
+        try {
+          converted.put(e.getKey(), convertConfig(e.getValue().config));
+        } catch (RuntimeException exc) {
+          e.getValue().fail(new InvalidRuleSetException(null, exc));
+        }
+      }
+      long conversionNs = System.nanoTime() - conversionStart;
+
+      Map<String, WafDiagnostics> diagnostics = new LinkedHashMap<>();
+      int unchangedUpdates = 0;
+      long updateNs;
+      long buildNs;
+      WafHandle handle;
+      synchronized (this) {
+        if (!online) {
+          batch.failAll(new UnclassifiedWafException("WafBuilder is offline"));
+          return;
+        }
+        long updateStart = System.nanoTime();
+        for (Map.Entry<String, PendingUpdate> e : batch.updates.entrySet()) {
+          if (applyUpdate(e.getKey(), e.getValue(), converted, diagnostics)) {
+            unchangedUpdates++;
+          }
+        }
+        long buildStart = System.nanoTime();
+        updateNs = buildStart - updateStart;
+        handle = buildInstance(this);
+        buildNs = System.nanoTime() - buildStart;
+        if (handle != null) {
+          modifiedSinceBuild = false;
+        }
+      }
+
+      if (handle == null) {
+        batch.failAll(
+            new UnclassifiedWafException(
+                "Failed to build WafHandle instance, "
+                    + "check rules to make sure there is at least one valid one"));
+        return;
+      }
+      handle.buildReport =
+          new WafHandle.BuildReport(
+              batch.queuedNs,
+              conversionNs,
+              updateNs,
+              buildNs,
+              batch.updates.size(),
+              batch.coalescedUpdates,
+              unchangedUpdates,
+              Collections.unmodifiableMap(diagnostics));
+      if (!batch.completeAll(handle)) {
+        handle.close(); // every update failed, and no build was requested
+      }
+    } finally {
+      for (long configPtr : converted.values()) {
+        freeConvertedConfig(configPtr);
+      }
+    }
+  }
+
+  // called with this locked; removes the applied config from converted. Returns whether the update
+  // was skipped because the config was unchanged
+  private boolean applyUpdate(
+      String path,
+      PendingUpdate update,
+      Map<String, Long> converted,
+      Map<String, WafDiagnostics> diagnostics) {
+    try {
+      if (update.config == null) {
+        if (removeConfigNative(this, path)) {
+          appliedConfigs.remove(path);
+          modifiedSinceBuild = true;
+        } else {
+          update.fail(new UnclassifiedWafException("Failed to remove configuration " + path));
+        }
+        return false;
+      }
+      Long configPtr = converted.remove(path);
+      if (configPtr == null) {
+        return false; // conversion failed
+      }
+      long convertedPtr = configPtr;
+      WafDiagnostics result =
+          runUpdate(
+              path,
+              (digestRef, infoRef) ->
+                  addOrUpdateConvertedConfig(this, path, convertedPtr, digestRef, infoRef));
+      if (result != null) {
+        diagnostics.put(path, result);
+      }
+      return result != null && result.isUnchanged();
+    } catch (InvalidRuleSetException e) {
+      if (e.wafDiagnostics != null) {
+        diagnostics.put(path, e.wafDiagnostics);
+      }
+      update.fail(e);
+    } catch (RuntimeException e) {
+      update.fail(new UnclassifiedWafException("Failed to update configuration " + path, e));
+    }
+    return false;
+  }
+
+  private static final class AppliedConfig {
+    final long[] digest;
+    final WafDiagnostics diagnostics;
+
+    AppliedConfig(long[] digest, WafDiagnostics diagnostics) {
+      this.digest = digest;
+      this.diagnostics = diagnostics;
+    }
+  }
+
+  private static final class PendingUpdate {
+    final Map<String, Object> config; // null for removals
+    final List<CompletableFuture<WafHandle>> futures = new ArrayList<>(1);
+    boolean failed;
+
+    PendingUpdate(Map<String, Object> config) {
+      this.config = config;
+    }
+
+    void fail(Throwable t) {
+      failed = true;
+      for (CompletableFuture<WafHandle> future : futures) {
+        future.completeExceptionally(t);
+      }
+    }
+  }
+
+  private static final class Batch {
+    final Map<String, PendingUpdate> updates;
+    final List<CompletableFuture<WafHandle>> builds;
+    final int coalescedUpdates;
+    final long queuedNs;
+
+    Batch(
+        Map<String, PendingUpdate> updates,
+        List<CompletableFuture<WafHandle>> builds,
+        int coalescedUpdates,
+        long queuedNs) {
+      this.updates = updates;
+      this.builds = builds;
+      this.coalescedUpdates = coalescedUpdates;
+      this.queuedNs = queuedNs;
+    }
+
+    // whether any future received the handle
+    boolean completeAll(WafHandle handle) {
+      boolean delivered = false;
+      for (PendingUpdate update : updates.values()) {
+        if (!update.failed) {
+          for (CompletableFuture<WafHandle> future : update.futures) {
+            delivered |= future.complete(handle);
+          }
+        }
+      }
+      for (CompletableFuture<WafHandle> future : builds) {
+        delivered |= future.complete(handle);
+      }
+      return delivered;
+    }
+
+    void failAll(Throwable t) {
+      for (PendingUpdate update : updates.values()) {
+        update.fail(t);
+      }
+      for (CompletableFuture<WafHandle> future : builds) {
+        future.completeExceptionally(t);
+      }
+    }
+  }
+
+  // package-private so that tests can hold the build thread with a task of their own
+  static final class BuildExecutor {
+    static final ExecutorService INSTANCE =
+        Executors.newSingleThreadExecutor(
+            r -> {
+              Thread thread = new Thread(r, "ddwaf-handle-builder");
+              thread.setDaemon(true);
+              return thread;
+            });
+  }
+
   /** Builds a new WafHandle. This method is NOT THREAD SAFE. */
   private static native WafHandle buildInstance(WafBuilder wafBuilder);
 
   private static native long initBuilder(WafConfig config);
 
+  // digestRef holds the digest of the config last applied at path, or {0, 0}. The update is skipped
+  // (returning true, with no diagnostics) if the config has the same digest; otherwise digestRef
+  // is set to its digest, or {0, 0} if it couldn't be computed
   private static native boolean addOrUpdateConfigNative(
-      WafBuilder wafBuilder, String path, Map<String, Object> definition, WafDiagnostics[] infoRef);
+      WafBuilder wafBuilder,
+      String path,
+      Map<String, Object> definition,
+      long[] digestRef,
+      WafDiagnostics[] infoRef);
+
+  // parses the JSON between offset and offset + length of the direct buffer; throws
+  // IllegalArgumentException if it's malformed
+  private static native boolean addOrUpdateJsonConfigNative(
+      WafBuilder wafBuilder,
+      String path,
+      ByteBuffer json,
+      int offset,
+      int length,
+      long[] digestRef,
+      WafDiagnostics[] infoRef);
+
+  private static native boolean addOrUpdateJsonArrayConfigNative(
+      WafBuilder wafBuilder,
+      String path,
+      byte[] json,
+      int offset,
+      int length,
+      long[] digestRef,
+      WafDiagnostics[] infoRef);
+
+  // snapshotRoot is the relocated root of a ConfigSnapshot
+  private static native boolean addOrUpdateSnapshotConfigNative(
+      WafBuilder wafBuilder,
+      String path,
+      ByteBuffer snapshotRoot,
+      long[] digestRef,
+      WafDiagnostics[] infoRef);
+
+  // values holds the UTF-8 values, concatenated, with value i ending at ends[i]; expirations may
+  // be null
+  private static native boolean addOrUpdateDataConfigNative(
+      WafBuilder wafBuilder,
+      String path,
+      String section,
+      String id,
+      String type,
+      byte[] values,
+      int[] ends,
+      long[] expirations,
+      long[] digestRef,
+      WafDiagnostics[] infoRef);
 
   private static native boolean removeConfigNative(WafBuilder wafBuilder, String oldPath);
 
+  // converts the config into a ddwaf_object, to be passed to addOrUpdateConvertedConfig or freed
+  static native long convertConfig(Map<String, Object> definition);
+
+  // frees the converted config, even on failure
+  private static native boolean addOrUpdateConvertedConfig(
+      WafBuilder wafBuilder,
+      String path,
+      long convertedConfig,
+      long[] digestRef,
+      WafDiagnostics[] infoRef);
+
+  static native void freeConvertedConfig(long convertedConfig);
+
   private static native void destroyBuilder(long builderPtr);
 
   public boolean isOnline() {
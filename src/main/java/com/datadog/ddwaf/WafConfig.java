@@ -19,4 +19,11 @@ public class WafConfig {
 
   public String obfuscatorKeyRegex = DEFAULT_KEY_REGEX;
   public String obfuscatorValueRegex = DEFAULT_VALUE_REGEX;
+
+  /**
+   * Whether builders return summary diagnostics, with only counts, errors and warnings converted
+   * when a configuration is applied, so that updates of large rulesets don't create a Java string
+   * per rule id. See {@link WafDiagnostics#isSummary()}.
+   */
+  public boolean summaryDiagnostics;
 }
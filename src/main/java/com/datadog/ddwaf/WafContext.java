@@ -9,7 +9,6 @@
 package com.datadog.ddwaf;
 
 import com.datadog.ddwaf.exception.AbstractWafException;
-import com.datadog.ddwaf.exception.TimeoutWafException;
 import com.datadog.ddwaf.exception.UnclassifiedWafException;
 import java.io.Closeable;
 import java.lang.reflect.UndeclaredThrowableException;
@@ -36,7 +35,10 @@ public class WafContext implements Closeable {
   private static volatile Object leaseFenceSink;
 
   private final ByteBufferSerializer.ArenaLease lease;
+  // reset after each run and only returned to the pool on close(); taken on first ephemeral run
+  private ByteBufferSerializer.ArenaLease ephemeralLease;
   private final LeakDetection.PhantomRefWithName<Object> selfRef;
+  private final ResultDecoder resultDecoder;
 
   /** The ptr field holds the pointer to PWAddContext and managed by Waf */
   private long ptr; // KEEP THIS FIELD!
@@ -49,6 +51,7 @@ public class WafContext implements Closeable {
     LOGGER.debug("Creating WafContext for {}", wafHandle);
     this.ptr = initWafContext(wafHandle);
     this.lease = ByteBufferSerializer.getBlankLease();
+    this.resultDecoder = new ResultDecoder(wafHandle.actionCache);
     this.online = true;
     if (Waf.EXIT_ON_LEAK) {
       this.selfRef = LeakDetection.registerCloseable(this);
@@ -59,13 +62,39 @@ public class WafContext implements Closeable {
 
   private static native long initWafContext(WafHandle handle);
 
-  private native Waf.ResultWithData runWafContext(
+  /**
+   * Runs the WAF and writes the result into {@code resultBuffer}, or into a new direct buffer if it
+   * doesn't fit. See {@link ResultDecoder} for the format.
+   *
+   * @return the buffer holding the result
+   */
+  private native ByteBuffer runWafContextBinary(
       ByteBuffer persistentBuffer,
       ByteBuffer ephemeralBuffer,
       Waf.Limits limits,
-      WafMetrics metrics)
+      WafMetrics metrics,
+      ByteBuffer resultBuffer,
+      Object[] resultRefs)
       throws AbstractWafException;
 
+  private Waf.ResultWithData runWafContext(
+      ByteBuffer persistentBuffer,
+      ByteBuffer ephemeralBuffer,
+      Waf.Limits limits,
+      WafMetrics metrics)
+      throws AbstractWafException {
+    ResultDecoder decoder = this.resultDecoder;
+    ByteBuffer out =
+        runWafContextBinary(
+            persistentBuffer,
+            ephemeralBuffer,
+            limits,
+            metrics,
+            decoder.buffer(),
+            decoder.refs());
+    return decoder.decode(out);
+  }
+
   /**
    * Clear given WafContext (free PWAddContext in Waf)
    *
@@ -81,7 +110,8 @@ public class WafContext implements Closeable {
    * @param ephemeralData data to push to Waf
    * @param limits request execution limits
    * @param metrics a metrics collector, or null
-   * @return execution results
+   * @return execution results; {@link Waf.ResultWithData#TIMEOUT} on timeout if {@link
+   *     Waf.Limits#timeoutAsResult} is set
    * @throws AbstractWafException rethrow from native code, timeout or param serialization failure
    */
   private Waf.ResultWithData run(
@@ -108,7 +138,10 @@ public class WafContext implements Closeable {
               persistentBuffer = this.lease.serializeMore(limits, persistentData, metrics);
             }
             if (ephemeralData != null) {
-              ephemeralLease = ByteBufferSerializer.getBlankLease();
+              if (this.ephemeralLease == null) {
+                this.ephemeralLease = ByteBufferSerializer.getBlankLease();
+              }
+              ephemeralLease = this.ephemeralLease;
               ephemeralBuffer = ephemeralLease.serializeMore(limits, ephemeralData, metrics);
             }
           } catch (Exception e) {
@@ -117,14 +150,29 @@ public class WafContext implements Closeable {
           }
 
           long elapsedNs = System.nanoTime() - before;
+          WafHandle.Latencies latencies = wafHandle.latencies;
+          latencies.serialization.record(elapsedNs);
           Waf.Limits newLimits = limits.reduceBudget(elapsedNs / 1000);
+          InputRecorder recorder = Waf.inputRecorder;
+          if (recorder != null) {
+            recorder.record(persistentBuffer, ephemeralBuffer);
+          }
           if (newLimits.generalBudgetInUs == 0L) {
             LOGGER.debug(
                 "Budget exhausted after serialization; not running on wafContext {}", this);
-            throw new TimeoutWafException();
+            if (!limits.timeoutAsResult) {
+              throw Waf.createTimeoutException();
+            }
+            result = Waf.ResultWithData.TIMEOUT;
+          } else {
+            long runStart = System.nanoTime();
+            result = runWafContext(persistentBuffer, ephemeralBuffer, newLimits, metrics);
+            long runNs = System.nanoTime() - runStart;
+            if (result.result != Waf.Result.TIMEOUT) {
+              latencies.ddwafRunTime.record(result.duration);
+              latencies.resultConversion.record(Math.max(0, runNs - result.duration));
+            }
           }
-
-          result = runWafContext(persistentBuffer, ephemeralBuffer, newLimits, metrics);
         } finally {
           // Keep lease/ephemeralLease strongly reachable past the ddwaf_run JNI boundary.
           // The JIT may elide references to this.lease and ephemeralLease after the last
@@ -135,11 +183,12 @@ public class WafContext implements Closeable {
           leaseFenceSink = this.lease;
           leaseFenceSink = ephemeralLease;
           if (ephemeralLease != null) {
-            ephemeralLease.close();
+            // ephemeral data is not retained by libddwaf past ddwaf_run
+            ephemeralLease.reset();
           }
+          long totalTimeNs = System.nanoTime() - before;
+          wafHandle.latencies.totalRunTime.record(totalTimeNs);
           if (metrics != null) {
-            long after = System.nanoTime();
-            long totalTimeNs = after - before;
             metrics.addTotalRunTimeNs(totalTimeNs);
           }
         }
@@ -163,6 +212,36 @@ public class WafContext implements Closeable {
     return run(null, ephemeralData, limits, metrics);
   }
 
+  /**
+   * Runs the WAF on recorded inputs, which are passed to libddwaf as they are, without
+   * serialization. The recording must stay reachable until this context is closed.
+   */
+  public Waf.ResultWithData run(InputRecording.Input input, Waf.Limits limits, WafMetrics metrics)
+      throws AbstractWafException {
+    if (limits == null) {
+      throw new IllegalArgumentException("limits must be provided");
+    }
+    long before = System.nanoTime();
+    synchronized (this) {
+      checkOnline();
+      try {
+        Waf.ResultWithData result =
+            runWafContext(input.persistent, input.ephemeral, limits, metrics);
+        if (result.result != Waf.Result.TIMEOUT) {
+          wafHandle.latencies.ddwafRunTime.record(result.duration);
+        }
+        return result;
+      } finally {
+        leaseFenceSink = input.getRecording();
+        long totalTimeNs = System.nanoTime() - before;
+        wafHandle.latencies.totalRunTime.record(totalTimeNs);
+        if (metrics != null) {
+          metrics.addTotalRunTimeNs(totalTimeNs);
+        }
+      }
+    }
+  }
+
   @Override
   public void close() {
     Throwable exc = null;
@@ -182,6 +261,14 @@ public class WafContext implements Closeable {
       } catch (Throwable t) {
         exc = t;
       }
+
+      if (this.ephemeralLease != null) {
+        try {
+          this.ephemeralLease.close();
+        } catch (Throwable t) {
+          exc = t;
+        }
+      }
     }
 
     // if we reach this point, we were originally online
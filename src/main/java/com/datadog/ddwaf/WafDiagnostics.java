@@ -8,14 +8,22 @@
 
 package com.datadog.ddwaf;
 
+import java.nio.charset.StandardCharsets;
 import java.util.Collections;
 import java.util.List;
 import java.util.Map;
 import java.util.Objects;
 import java.util.StringJoiner;
+import java.util.function.Function;
 import java.util.stream.Collectors;
 import java.util.stream.Stream;
 
+/**
+ * The diagnostics of a configuration update. With {@link WafConfig#summaryDiagnostics}, only the
+ * counts, errors and warnings are converted when the update is applied; the lists of loaded,
+ * skipped and failed ids are built from the retained JSON diagnostics the first time they're
+ * requested (see {@link #isSummary()}).
+ */
 public class WafDiagnostics {
 
   public static class SectionInfo {
@@ -26,6 +34,12 @@ public class WafDiagnostics {
     // map error string -> array of rule ids
     private final Map<String, List<String>> errors;
     private final Map<String, List<String>> warnings;
+    private final int numLoaded;
+    private final int numSkipped;
+    private final int numFailed;
+    // summaries: the full diagnostics this section is taken from, and how to find it there
+    private WafDiagnostics owner;
+    private Function<WafDiagnostics, SectionInfo> inFull;
 
     // used in output.c to create a new SectionInfo with only an error message
     public SectionInfo(String error) {
@@ -35,6 +49,9 @@ public class WafDiagnostics {
       this.errors = null;
       this.skipped = null;
       this.warnings = null;
+      this.numLoaded = 0;
+      this.numSkipped = 0;
+      this.numFailed = 0;
     }
 
     // used in output.c to create a new SectionInfo with full information
@@ -50,6 +67,28 @@ public class WafDiagnostics {
       this.errors = errors;
       this.skipped = skipped;
       this.warnings = warnings;
+      this.numLoaded = loaded == null ? 0 : loaded.size();
+      this.numSkipped = skipped == null ? 0 : skipped.size();
+      this.numFailed = failed == null ? 0 : failed.size();
+    }
+
+    // used in output.c to create a new SectionInfo for summary diagnostics: the lists of ids are
+    // only counted
+    public SectionInfo(
+        int numLoaded,
+        int numSkipped,
+        int numFailed,
+        Map<String, List<String>> warnings,
+        Map<String, List<String>> errors) {
+      this.error = null;
+      this.loaded = null;
+      this.failed = null;
+      this.errors = errors;
+      this.skipped = null;
+      this.warnings = warnings;
+      this.numLoaded = numLoaded;
+      this.numSkipped = numSkipped;
+      this.numFailed = numFailed;
     }
 
     public String getError() {
@@ -58,18 +97,44 @@ public class WafDiagnostics {
 
     public List<String> getLoaded() {
       if (loaded == null) {
-        return Collections.emptyList();
+        return numLoaded == 0 ? Collections.<String>emptyList() : inFull().getLoaded();
       }
       return loaded;
     }
 
+    public List<String> getSkipped() {
+      if (skipped == null) {
+        return numSkipped == 0 ? Collections.<String>emptyList() : inFull().getSkipped();
+      }
+      return skipped;
+    }
+
     public List<String> getFailed() {
       if (failed == null) {
-        return Collections.emptyList();
+        return numFailed == 0 ? Collections.<String>emptyList() : inFull().getFailed();
       }
       return failed;
     }
 
+    public int getNumLoaded() {
+      return numLoaded;
+    }
+
+    public int getNumSkipped() {
+      return numSkipped;
+    }
+
+    public int getNumFailed() {
+      return numFailed;
+    }
+
+    public Map<String, List<String>> getWarnings() {
+      if (warnings == null) {
+        return Collections.emptyMap();
+      }
+      return warnings;
+    }
+
     public Map<String, List<String>> getErrors() {
       if (errors == null) {
         return Collections.emptyMap();
@@ -85,13 +150,21 @@ public class WafDiagnostics {
             .toString();
       }
       return new StringJoiner(", ", SectionInfo.class.getSimpleName() + "[", "]")
-          .add("loaded=" + loaded)
-          .add("skipped=" + skipped)
-          .add("failed=" + failed)
+          .add("loaded=" + (loaded != null || numLoaded == 0 ? loaded : numLoaded + " ids"))
+          .add("skipped=" + (skipped != null || numSkipped == 0 ? skipped : numSkipped + " ids"))
+          .add("failed=" + (failed != null || numFailed == 0 ? failed : numFailed + " ids"))
           .add("errors=" + errors)
           .add("warnings=" + warnings)
           .toString();
     }
+
+    private SectionInfo inFull() {
+      SectionInfo section = owner == null ? null : inFull.apply(owner.full());
+      if (section == null) {
+        throw new IllegalStateException("Section missing from the full diagnostics");
+      }
+      return section;
+    }
   }
 
   public final String error;
@@ -105,6 +178,10 @@ public class WafDiagnostics {
   public final SectionInfo actions;
   public final SectionInfo processors;
   public final SectionInfo scanners;
+  private final boolean unchanged;
+  // summaries: the diagnostics as UTF-8 JSON, and the full diagnostics parsed from them
+  private final byte[] details;
+  private volatile WafDiagnostics full;
 
   // used in output.c to create a new WafDiagnostics
   public WafDiagnostics(
@@ -119,6 +196,75 @@ public class WafDiagnostics {
       SectionInfo actions,
       SectionInfo processors,
       SectionInfo scanners) {
+    this(
+        error,
+        rulesetVersion,
+        rules,
+        customRules,
+        rulesData,
+        rulesOverride,
+        exclusions,
+        exclusionData,
+        actions,
+        processors,
+        scanners,
+        null,
+        false);
+  }
+
+  // used in output.c to create a new WafDiagnostics with summary sections
+  public WafDiagnostics(
+      String error,
+      String rulesetVersion,
+      SectionInfo rules,
+      SectionInfo customRules,
+      SectionInfo rulesData,
+      SectionInfo rulesOverride,
+      SectionInfo exclusions,
+      SectionInfo exclusionData,
+      SectionInfo actions,
+      SectionInfo processors,
+      SectionInfo scanners,
+      byte[] details) {
+    this(
+        error,
+        rulesetVersion,
+        rules,
+        customRules,
+        rulesData,
+        rulesOverride,
+        exclusions,
+        exclusionData,
+        actions,
+        processors,
+        scanners,
+        details,
+        false);
+    attach(rules, d -> d.rules);
+    attach(customRules, d -> d.customRules);
+    attach(rulesData, d -> d.rulesData);
+    attach(rulesOverride, d -> d.rulesOverride);
+    attach(exclusions, d -> d.exclusions);
+    attach(exclusionData, d -> d.exclusionData);
+    attach(actions, d -> d.actions);
+    attach(processors, d -> d.processors);
+    attach(scanners, d -> d.scanners);
+  }
+
+  private WafDiagnostics(
+      String error,
+      String rulesetVersion,
+      SectionInfo rules,
+      SectionInfo customRules,
+      SectionInfo rulesData,
+      SectionInfo rulesOverride,
+      SectionInfo exclusions,
+      SectionInfo exclusionData,
+      SectionInfo actions,
+      SectionInfo processors,
+      SectionInfo scanners,
+      byte[] details,
+      boolean unchanged) {
     this.error = error;
     this.rulesetVersion = rulesetVersion;
     this.rules = rules;
@@ -130,6 +276,68 @@ public class WafDiagnostics {
     this.actions = actions;
     this.processors = processors;
     this.scanners = scanners;
+    this.details = details;
+    this.unchanged = unchanged;
+  }
+
+  private void attach(SectionInfo section, Function<WafDiagnostics, SectionInfo> inFull) {
+    if (section != null) {
+      section.owner = this;
+      section.inFull = inFull;
+    }
+  }
+
+  // the same diagnostics, for an update skipped because the config was already applied
+  WafDiagnostics asUnchanged() {
+    return new WafDiagnostics(
+        error,
+        rulesetVersion,
+        rules,
+        customRules,
+        rulesData,
+        rulesOverride,
+        exclusions,
+        exclusionData,
+        actions,
+        processors,
+        scanners,
+        details,
+        true);
+  }
+
+  /**
+   * Whether only the counts, errors and warnings were converted. The lists of ids are then built on
+   * the first call to a getter that needs them, such as {@link SectionInfo#getLoaded()}.
+   */
+  public boolean isSummary() {
+    return details != null;
+  }
+
+  /** The diagnostics as returned by libddwaf, in JSON; null unless {@link #isSummary()}. */
+  public String getDetailsJson() {
+    return details == null ? null : new String(details, StandardCharsets.UTF_8);
+  }
+
+  // the full diagnostics of a summary, parsed on first use
+  private WafDiagnostics full() {
+    WafDiagnostics result = full;
+    if (result == null) {
+      synchronized (this) {
+        result = full;
+        if (result == null) {
+          full = result = parseDetails(details);
+        }
+      }
+    }
+    return result;
+  }
+
+  /**
+   * Whether the update was skipped because the configuration was identical to the one last applied
+   * at the same path. The diagnostics are then those of that earlier update.
+   */
+  public boolean isUnchanged() {
+    return unchanged;
   }
 
   public int getNumConfigOK() {
@@ -207,8 +415,8 @@ public class WafDiagnostics {
     if (section != null && section.getError() != null && !section.getError().isEmpty()) {
       return 1;
     }
-    if (section != null && section.getFailed() != null && !section.getFailed().isEmpty()) {
-      return section.getFailed().size();
+    if (section != null && section.getNumFailed() != 0) {
+      return section.getNumFailed();
     }
     if (section != null && section.getErrors() != null && !section.getErrors().isEmpty()) {
       return section.getErrors().size();
@@ -217,9 +425,11 @@ public class WafDiagnostics {
   }
 
   private int countLoadedForSection(WafDiagnostics.SectionInfo section) {
-    if (section != null && section.getLoaded() != null) {
-      return section.getLoaded().size();
+    if (section != null) {
+      return section.getNumLoaded();
     }
     return 0;
   }
+
+  private static native WafDiagnostics parseDetails(byte[] json);
 }
@@ -8,6 +8,7 @@
 
 package com.datadog.ddwaf;
 
+import java.util.Map;
 import java.util.UUID;
 import java.util.concurrent.locks.Lock;
 import java.util.concurrent.locks.ReentrantReadWriteLock;
@@ -22,6 +23,11 @@ public class WafHandle {
   private final Lock readLock;
   private final String uniqueName;
   private final LeakDetection.PhantomRefWithName<Object> selfRef;
+  // actions returned by the contexts of this handle
+  final ActionCache actionCache = new ActionCache();
+  final Latencies latencies = new Latencies();
+  // set by WafBuilder before the handle is published
+  BuildReport buildReport;
 
   // called from JNI
   private WafHandle(long handle) {
@@ -88,6 +94,136 @@ public class WafHandle {
     }
   }
 
+  /**
+   * Latencies of the runs of the contexts of this handle, which can be reset by interval with
+   * {@link LatencyHistogram#snapshotAndReset()}.
+   */
+  public Latencies getLatencies() {
+    return latencies;
+  }
+
+  /** How and how fast this handle was built. */
+  public BuildReport getBuildReport() {
+    return buildReport;
+  }
+
+  /**
+   * Timings of the phases of the build of a handle, in nanoseconds. For {@link
+   * WafBuilder#buildWafHandleInstance()}, only the build itself is timed; the other phases happened
+   * in earlier calls.
+   */
+  public static final class BuildReport {
+    private final long queueTimeNs;
+    private final long conversionTimeNs;
+    private final long updateTimeNs;
+    private final long buildTimeNs;
+    private final int appliedUpdates;
+    private final int coalescedUpdates;
+    private final int unchangedUpdates;
+    private final Map<String, WafDiagnostics> diagnostics;
+
+    BuildReport(
+        long queueTimeNs,
+        long conversionTimeNs,
+        long updateTimeNs,
+        long buildTimeNs,
+        int appliedUpdates,
+        int coalescedUpdates,
+        int unchangedUpdates,
+        Map<String, WafDiagnostics> diagnostics) {
+      this.queueTimeNs = queueTimeNs;
+      this.conversionTimeNs = conversionTimeNs;
+      this.updateTimeNs = updateTimeNs;
+      this.buildTimeNs = buildTimeNs;
+      this.appliedUpdates = appliedUpdates;
+      this.coalescedUpdates = coalescedUpdates;
+      this.unchangedUpdates = unchangedUpdates;
+      this.diagnostics = diagnostics;
+    }
+
+    /** From the first queued update (or build request) to the start of the build. */
+    public long getQueueTimeNs() {
+      return queueTimeNs;
+    }
+
+    /** Converting the configurations to libddwaf objects, without holding the builder. */
+    public long getConversionTimeNs() {
+      return conversionTimeNs;
+    }
+
+    /** Adding, updating and removing the configurations in libddwaf's builder. */
+    public long getUpdateTimeNs() {
+      return updateTimeNs;
+    }
+
+    /** {@code ddwaf_builder_build_instance}. */
+    public long getBuildTimeNs() {
+      return buildTimeNs;
+    }
+
+    /** Configuration updates and removals attempted for the build, including failed ones. */
+    public int getAppliedUpdates() {
+      return appliedUpdates;
+    }
+
+    /** Updates superseded by a later one for the same path, which were never applied. */
+    public int getCoalescedUpdates() {
+      return coalescedUpdates;
+    }
+
+    /**
+     * Updates skipped because the configuration was identical to the one already applied at the
+     * same path (see {@link WafDiagnostics#isUnchanged()}).
+     */
+    public int getUnchangedUpdates() {
+      return unchangedUpdates;
+    }
+
+    /** Diagnostics of the configuration updates, by path. */
+    public Map<String, WafDiagnostics> getDiagnostics() {
+      return diagnostics;
+    }
+
+    @Override
+    public String toString() {
+      return "BuildReport{queue="
+          + queueTimeNs
+          + ", conversion="
+          + conversionTimeNs
+          + ", update="
+          + updateTimeNs
+          + ", build="
+          + buildTimeNs
+          + ", applied="
+          + appliedUpdates
+          + ", coalesced="
+          + coalescedUpdates
+          + ", unchanged="
+          + unchangedUpdates
+          + '}';
+    }
+  }
+
+  /** Histograms of the phases of {@link WafContext} runs, in nanoseconds. */
+  public static final class Latencies {
+    /** Whole runs, including waiting for the context lock. */
+    public final LatencyHistogram totalRunTime = new LatencyHistogram();
+
+    /** Serialization of the inputs, including waiting for the context lock. */
+    public final LatencyHistogram serialization = new LatencyHistogram();
+
+    /** {@code ddwaf_run}, as reported by libddwaf. Not recorded for timeouts. */
+    public final LatencyHistogram ddwafRunTime = new LatencyHistogram();
+
+    /**
+     * The native call minus {@code ddwaf_run}: mostly converting the inputs for libddwaf and the
+     * result back. Not recorded for timeouts.
+     */
+    public final LatencyHistogram resultConversion = new LatencyHistogram();
+
+    Latencies() {}
+  }
+
   @Override
   public String toString() {
     final StringBuilder sb = new StringBuilder("WafHandle{");
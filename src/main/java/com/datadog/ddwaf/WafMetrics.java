@@ -8,51 +8,87 @@
 
 package com.datadog.ddwaf;
 
-import java.util.concurrent.atomic.AtomicLong;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.concurrent.atomic.LongAdder;
 
 public class WafMetrics {
+  // layout of the counters updated natively; see metrics.c. Each thread adds to
+  // one of the stripes, and reads sum them (like LongAdder)
+  static final int STRIPES = 16;
+  static final int STRIPE_SIZE = 64; // a cache line
+  static final int RUN_TIME_NS_OFFSET = 0;
+  static final int DDWAF_RUN_TIME_NS_OFFSET = 8;
+
+  // allocated on first native use: most instances only live for one request, and many never
+  // reach native code
+  volatile ByteBuffer nativeCounters;
+  // address of nativeCounters, set by native code on first use
+  long nativeCountersAddress;
+
   // total accumulated time between runs, including metrics
-  AtomicLong totalRunTimeNs = new AtomicLong();
-  AtomicLong totalDdwafRunTimeNs = new AtomicLong();
-  AtomicLong truncatedStringTooLongCount = new AtomicLong();
-  AtomicLong truncatedListMapTooLargeCount = new AtomicLong();
-  AtomicLong truncatedObjectTooDeepCount = new AtomicLong();
+  final LongAdder totalRunTimeNs = new LongAdder();
+  final LongAdder truncatedStringTooLongCount = new LongAdder();
+  final LongAdder truncatedListMapTooLargeCount = new LongAdder();
+  final LongAdder truncatedObjectTooDeepCount = new LongAdder();
 
   public WafMetrics() {}
 
   public long getTotalRunTimeNs() {
-    return totalRunTimeNs.get();
+    return totalRunTimeNs.sum() + sumNative(RUN_TIME_NS_OFFSET);
   }
 
   protected void addTotalRunTimeNs(long increment) {
-    totalRunTimeNs.addAndGet(increment);
+    totalRunTimeNs.add(increment);
   }
 
   public long getTotalDdwafRunTimeNs() {
-    return totalDdwafRunTimeNs.get();
+    return sumNative(DDWAF_RUN_TIME_NS_OFFSET);
   }
 
   public long getTruncatedStringTooLongCount() {
-    return truncatedStringTooLongCount.get();
+    return truncatedStringTooLongCount.sum();
   }
 
   public long getTruncatedListMapTooLargeCount() {
-    return truncatedListMapTooLargeCount.get();
+    return truncatedListMapTooLargeCount.sum();
   }
 
   public long getTruncatedObjectTooDeepCount() {
-    return truncatedObjectTooDeepCount.get();
+    return truncatedObjectTooDeepCount.sum();
   }
 
   protected void incrementTruncatedStringTooLongCount() {
-    truncatedStringTooLongCount.incrementAndGet();
+    truncatedStringTooLongCount.increment();
   }
 
   protected void incrementTruncatedListMapTooLargeCount() {
-    truncatedListMapTooLargeCount.incrementAndGet();
+    truncatedListMapTooLargeCount.increment();
   }
 
   protected void incrementTruncatedObjectTooDeepCount() {
-    truncatedObjectTooDeepCount.incrementAndGet();
+    truncatedObjectTooDeepCount.increment();
+  }
+
+  // called by native code until it has the address of the counters
+  synchronized ByteBuffer nativeCounters() {
+    ByteBuffer counters = nativeCounters;
+    if (counters == null) {
+      counters = ByteBuffer.allocateDirect(STRIPES * STRIPE_SIZE).order(ByteOrder.nativeOrder());
+      nativeCounters = counters;
+    }
+    return counters;
+  }
+
+  private long sumNative(int offset) {
+    ByteBuffer counters = nativeCounters;
+    if (counters == null) {
+      return 0;
+    }
+    long sum = 0;
+    for (int i = 0; i < STRIPES; i++) {
+      sum += counters.getLong(i * STRIPE_SIZE + offset);
+    }
+    return sum;
   }
 }
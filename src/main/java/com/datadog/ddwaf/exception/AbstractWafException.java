@@ -23,6 +23,15 @@ public abstract class AbstractWafException extends Exception {
     this.code = code;
   }
 
+  /**
+   * For shared, preallocated instances: no stack trace, no suppressed exceptions and no cause can
+   * be set on them afterwards.
+   */
+  protected AbstractWafException(String message, int code, boolean writableStackTrace) {
+    super(message, null, false, writableStackTrace);
+    this.code = code;
+  }
+
   public static AbstractWafException createFromErrorCode(int errorCode) {
     WafErrorCode wafErrorCode = WafErrorCode.fromCode(errorCode);
 
@@ -43,4 +52,26 @@ public abstract class AbstractWafException extends Exception {
     // This point should never be reached unless a new enum value is added and not handled above
     throw new IllegalStateException("Unhandled WafErrorCode: " + wafErrorCode);
   }
+
+  /**
+   * Like {@link #createFromErrorCode(int)}, but returns shared stackless instances for the known
+   * error codes. Unknown codes still get a fresh {@link UnclassifiedWafException}.
+   */
+  public static AbstractWafException preallocatedFromErrorCode(int errorCode) {
+    WafErrorCode wafErrorCode = WafErrorCode.fromCode(errorCode);
+    if (wafErrorCode == null) {
+      return new UnclassifiedWafException(errorCode);
+    }
+
+    switch (wafErrorCode) {
+      case INVALID_ARGUMENT:
+        return InvalidArgumentWafException.PREALLOCATED;
+      case INVALID_OBJECT:
+        return InvalidObjectWafException.PREALLOCATED;
+      case INTERNAL_ERROR:
+        return InternalWafException.PREALLOCATED;
+    }
+
+    throw new IllegalStateException("Unhandled WafErrorCode: " + wafErrorCode);
+  }
 }
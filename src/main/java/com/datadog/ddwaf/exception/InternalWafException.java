@@ -8,8 +8,17 @@
 
 package com.datadog.ddwaf.exception;
 
+import com.datadog.ddwaf.WafErrorCode;
+
 public class InternalWafException extends AbstractWafException {
+  static final InternalWafException PREALLOCATED =
+      new InternalWafException(WafErrorCode.INTERNAL_ERROR.getCode(), false);
+
   public InternalWafException(int errorCode) {
     super("Internal error", errorCode);
   }
+
+  private InternalWafException(int errorCode, boolean writableStackTrace) {
+    super("Internal error", errorCode, writableStackTrace);
+  }
 }
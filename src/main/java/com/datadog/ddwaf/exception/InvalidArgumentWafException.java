@@ -8,8 +8,17 @@
 
 package com.datadog.ddwaf.exception;
 
+import com.datadog.ddwaf.WafErrorCode;
+
 public class InvalidArgumentWafException extends AbstractWafException {
+  static final InvalidArgumentWafException PREALLOCATED =
+      new InvalidArgumentWafException(WafErrorCode.INVALID_ARGUMENT.getCode(), false);
+
   public InvalidArgumentWafException(int errorCode) {
     super("Invalid argument", errorCode);
   }
+
+  private InvalidArgumentWafException(int errorCode, boolean writableStackTrace) {
+    super("Invalid argument", errorCode, writableStackTrace);
+  }
 }
@@ -8,8 +8,17 @@
 
 package com.datadog.ddwaf.exception;
 
+import com.datadog.ddwaf.WafErrorCode;
+
 public class InvalidObjectWafException extends AbstractWafException {
+  static final InvalidObjectWafException PREALLOCATED =
+      new InvalidObjectWafException(WafErrorCode.INVALID_OBJECT.getCode(), false);
+
   public InvalidObjectWafException(int errorCode) {
     super("Invalid object", errorCode);
   }
+
+  private InvalidObjectWafException(int errorCode, boolean writableStackTrace) {
+    super("Invalid object", errorCode, writableStackTrace);
+  }
 }
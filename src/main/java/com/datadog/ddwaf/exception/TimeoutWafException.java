@@ -9,7 +9,14 @@
 package com.datadog.ddwaf.exception;
 
 public class TimeoutWafException extends AbstractWafException {
+  /** Shared stackless instance. */
+  public static final TimeoutWafException PREALLOCATED = new TimeoutWafException(false);
+
   public TimeoutWafException() {
     super("Timeout", 0);
   }
+
+  private TimeoutWafException(boolean writableStackTrace) {
+    super("Timeout", 0, writableStackTrace);
+  }
 }
@@ -0,0 +1,84 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf.logging;
+
+import java.util.concurrent.TimeUnit;
+import java.util.function.LongSupplier;
+
+/**
+ * Token bucket limiting how often a log statement is emitted: a burst of messages, then one per
+ * refill period. Meant to be kept in a static field next to the statement it limits, as the native
+ * library does for each {@code JAVA_LOG} call site:
+ *
+ * <pre>{@code
+ * long suppressed;
+ * if (LOGGER.isInfoEnabled() && (suppressed = LIMITER.tryAcquire()) >= 0) {
+ *   LOGGER.info("Something happened{}", LogRateLimiter.suppressedSuffix(suppressed));
+ * }
+ * }</pre>
+ */
+public final class LogRateLimiter {
+  public static final int DEFAULT_BURST = 10;
+  public static final long DEFAULT_REFILL_NANOS = TimeUnit.SECONDS.toNanos(1);
+
+  private final int burst;
+  private final long refillNanos;
+  private final LongSupplier nanoClock;
+
+  private int tokens;
+  private long lastRefill;
+  private long suppressed;
+
+  public LogRateLimiter() {
+    this(DEFAULT_BURST, DEFAULT_REFILL_NANOS, System::nanoTime);
+  }
+
+  LogRateLimiter(int burst, long refillNanos, LongSupplier nanoClock) {
+    this.burst = burst;
+    this.refillNanos = refillNanos;
+    this.nanoClock = nanoClock;
+    this.tokens = burst;
+    this.lastRefill = nanoClock.getAsLong();
+  }
+
+  /**
+   * @return -1 if the message should be suppressed; otherwise the number of messages suppressed
+   *     since the last one let through
+   */
+  public synchronized long tryAcquire() {
+    long now = nanoClock.getAsLong();
+    long refills = (now - lastRefill) / refillNanos;
+    if (refills > 0) {
+      if (refills >= burst - tokens) {
+        tokens = burst;
+        lastRefill = now;
+      } else {
+        tokens += (int) refills;
+        lastRefill += refills * refillNanos;
+      }
+    }
+
+    if (tokens == 0) {
+      suppressed++;
+      return -1;
+    }
+    tokens--;
+    long ret = suppressed;
+    suppressed = 0;
+    return ret;
+  }
+
+  /** Text to append to a message let through after suppressed ones, matching the native one. */
+  public static String suppressedSuffix(long suppressed) {
+    if (suppressed <= 0) {
+      return "";
+    }
+    return " (" + suppressed + " similar messages suppressed)";
+  }
+}
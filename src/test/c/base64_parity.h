@@ -0,0 +1,132 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+// Compares the base64 encoding loops the CPU supports against the generic
+// one, for every input length up to a few blocks of the widest loop and for
+// streamed input. Shared by base64_test and base64_bench.
+
+#include "base64.h"
+#include "cpu_features.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BASE64_SIZE(n) (((n) + 2) / 3 * 4)
+
+static const struct base64_enc_impl *_generic;
+
+static size_t _encode_with(const struct base64_enc_impl *impl,
+                           const uint8_t *in, size_t len, char *out)
+{
+    const struct base64_enc_impl *prev = base64_enc_impl;
+    base64_enc_impl = impl;
+    size_t out_len;
+    base64_encode((const char *) in, len, out, &out_len);
+    base64_enc_impl = prev;
+    return out_len;
+}
+
+static int _check(const struct base64_enc_impl *impl, const uint8_t *in,
+                  size_t len)
+{
+    char expected[BASE64_SIZE(1024) + 1];
+    char actual[BASE64_SIZE(1024) + 1];
+    size_t expected_len = _encode_with(_generic, in, len, expected);
+    size_t actual_len = _encode_with(impl, in, len, actual);
+    if (expected_len != BASE64_SIZE(len) || actual_len != expected_len ||
+        memcmp(expected, actual, expected_len) != 0) {
+        fprintf(stderr, "%s: mismatch for input of length %zu\n", impl->name,
+                len);
+        return 1;
+    }
+    return 0;
+}
+
+// input fed in chunks of varying sizes must give the same output
+static int _check_stream(const struct base64_enc_impl *impl,
+                         const uint8_t *in, size_t len)
+{
+    char expected[BASE64_SIZE(1024) + 1];
+    char actual[BASE64_SIZE(1024) + 1];
+    size_t expected_len = _encode_with(_generic, in, len, expected);
+
+    const struct base64_enc_impl *prev = base64_enc_impl;
+    base64_enc_impl = impl;
+    struct base64_state state = {0};
+    size_t actual_len = 0;
+    for (size_t pos = 0, chunk = 1; pos < len; pos += chunk, chunk += 7) {
+        if (chunk > len - pos) {
+            chunk = len - pos;
+        }
+        size_t n;
+        base64_stream_encode_plain(&state, (const char *) in + pos, chunk,
+                                   actual + actual_len, &n);
+        actual_len += n;
+    }
+    size_t n;
+    base64_stream_encode_final(&state, actual + actual_len, &n);
+    actual_len += n;
+    base64_enc_impl = prev;
+
+    if (actual_len != expected_len ||
+        memcmp(expected, actual, expected_len) != 0) {
+        fprintf(stderr, "%s: streamed mismatch for input of length %zu\n",
+                impl->name, len);
+        return 1;
+    }
+    return 0;
+}
+
+// fills buf with a deterministic pseudo-random sequence (xorshift32)
+static void _fill_random(uint8_t *buf, size_t len, uint32_t seed)
+{
+    uint32_t x = seed ? seed : 1;
+    for (size_t i = 0; i < len; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = (uint8_t) x;
+    }
+}
+
+// returns whether any output differed (reported on stderr); requires
+// base64_init()
+static int base64_parity(void)
+{
+    size_t num_impls;
+    const struct base64_enc_impl *impls = base64_enc_impls(&num_impls);
+    _generic = &impls[0];
+
+    // random data, then every byte value in every position of a block
+    static uint8_t in[1024];
+    int failed = 0;
+    for (uint32_t seed = 1; seed <= 4; seed++) {
+        _fill_random(in, sizeof in, seed);
+        for (size_t i = 0; i < num_impls; i++) {
+            if (!cpu_has(impls[i].required_features)) {
+                continue;
+            }
+            for (size_t len = 0; len <= sizeof in; len++) {
+                // at the end of the buffer, so ASAN catches over-reads
+                failed |= _check(&impls[i], in + sizeof in - len, len);
+            }
+            failed |= _check_stream(&impls[i], in, sizeof in);
+        }
+    }
+    for (size_t i = 0; i < sizeof in; i++) {
+        in[i] = (uint8_t) (i * 7 + i / 256);
+    }
+    for (size_t i = 0; i < num_impls; i++) {
+        if (cpu_has(impls[i].required_features)) {
+            failed |= _check(&impls[i], in, sizeof in);
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,19 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+// The base64 encoding loops against the generic one, under ctest
+
+#include "base64_parity.h"
+
+int main(void)
+{
+    cpu_features_init();
+    base64_init();
+    printf("selected implementation: %s\n", base64_enc_impl->name);
+    return base64_parity() ? 1 : 0;
+}
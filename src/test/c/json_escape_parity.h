@@ -0,0 +1,141 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+// Compares the JSON string escaping implementations the CPU supports against
+// the original byte-by-byte loop, for every length up to a few vector widths
+// of ASCII text with sparse and dense escapes and of random bytes. Shared by
+// json_escape_test and json_escape_bench.
+
+#include "cpu_features.h"
+#include "json.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// fills buf with a deterministic pseudo-random sequence (xorshift32)
+static void _fill_random(uint8_t *buf, size_t len, uint32_t seed)
+{
+    uint32_t x = seed ? seed : 1;
+    for (size_t i = 0; i < len; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = (uint8_t) x;
+    }
+}
+
+// the escaping loop json.h used before the table-driven/SIMD versions
+static size_t _legacy_size(const char *str, size_t str_len)
+{
+    size_t res = 0;
+    for (const char *c = str; c < str + str_len; c++) {
+        if (*c == '\\' || *c == '"') {
+            res += 2;
+        } else if (*c >= 0 && *c < 0x20) {
+            res += 6;
+        } else {
+            res += 1;
+        }
+    }
+    return res;
+}
+
+static void _legacy_escape(const char *str, size_t str_len, char *out)
+{
+    char *o = out;
+    for (const char *c = str; c < str + str_len; c++) {
+        if (*c == '\\' || *c == '"') {
+            o[0] = '\\';
+            o[1] = *c;
+            o += 2;
+        } else if (*c >= 0 && *c < 0x20) {
+            char s[3];
+            sprintf(s, "%02X", *c);
+            memcpy(o, "\\u00", 4);
+            o[4] = s[0];
+            o[5] = s[1];
+            o += 6;
+        } else {
+            *o = *c;
+            o += 1;
+        }
+    }
+}
+
+static char *_make_input(const char *kind, size_t len)
+{
+    char *buf = malloc(len);
+    if (!buf) {
+        abort();
+    }
+    _fill_random((uint8_t *) buf, len, (uint32_t) len);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t r = (uint8_t) buf[i];
+        if (strcmp(kind, "ascii") == 0) {
+            buf[i] = (char) ('a' + r % 26);
+        } else if (strcmp(kind, "ascii-sparse") == 0) {
+            // one quote or newline every ~128 bytes
+            buf[i] = r < 2 ? (r ? '"' : '\n') : (char) ('a' + r % 26);
+        } else if (strcmp(kind, "ascii-dense") == 0) {
+            buf[i] = r < 64 ? (char) (r % 32) : (r < 96 ? '\\' : 'x');
+        } // "binary": keep random bytes
+    }
+    return buf;
+}
+
+static int _check(const struct json_escape_impl *impl, const char *data,
+                  size_t len)
+{
+    size_t exp_len = _legacy_size(data, len);
+    char *exp = malloc(exp_len + 1);
+    char *act = malloc(exp_len + 1);
+    if (!exp || !act) {
+        abort();
+    }
+    _legacy_escape(data, len, exp);
+    int ret = 0;
+    size_t act_len = impl->escaped_size(data, len);
+    char *end = impl->escape(data, len, act);
+    if (act_len != exp_len || (size_t) (end - act) != exp_len ||
+        memcmp(exp, act, exp_len) != 0) {
+        fprintf(stderr, "%s: output mismatch for input of size %zu\n",
+                impl->name, len);
+        ret = 1;
+    }
+    free(exp);
+    free(act);
+    return ret;
+}
+
+static const char *const _kinds[] = {"ascii", "ascii-sparse", "ascii-dense",
+                                     "binary"};
+
+// returns whether any output differed (reported on stderr); requires
+// json_escape_init()
+static int json_escape_parity(void)
+{
+    size_t num_impls;
+    const struct json_escape_impl *impls = json_escape_impls(&num_impls);
+
+    int failed = 0;
+    for (size_t k = 0; k < sizeof(_kinds) / sizeof(_kinds[0]); k++) {
+        for (size_t len = 0; len <= 200; len++) {
+            char *data = _make_input(_kinds[k], len + 1);
+            for (size_t i = 0; i < num_impls; i++) {
+                if (cpu_has(impls[i].required_features)) {
+                    failed |= _check(&impls[i], data, len);
+                }
+            }
+            free(data);
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,20 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+// The JSON string escaping implementations against the original loop, under
+// ctest
+
+#include "json_escape_parity.h"
+
+int main(void)
+{
+    cpu_features_init();
+    json_escape_init();
+    printf("selected implementation: %s\n", json_escape_impl->name);
+    return json_escape_parity() ? 1 : 0;
+}
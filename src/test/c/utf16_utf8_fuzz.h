@@ -0,0 +1,252 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+// Checks every UTF-16 to UTF-8 transcoder the CPU supports against the
+// previous one code point at a time implementation (growing its output buffer
+// as needed): both the computed lengths and the output, on ASCII, Latin-1,
+// CJK and emoji text and text with unpaired surrogates of every length up to
+// 300 units, on pairs split at every position of a vector block and on
+// random units biased towards surrogates. Shared by utf16_utf8_test and
+// utf16_utf8_bench, which also uses the reference and the corpora.
+
+#include "cpu_features.h"
+#include "utf_transcode.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UTF16_LEAD(c) ((c) >= 0xD800 && (c) <= 0xDBFF)
+#define UTF16_TRAIL(c) ((c) >= 0xDC00 && (c) <= 0xDFFF)
+
+// the previous implementation, without JNI
+static uint8_t *_reference(const uint16_t *in, size_t len, size_t *out_len_p)
+{
+    size_t out_cap = len + 3;
+    size_t out_len = 0;
+    uint8_t *out = malloc(out_cap + 1);
+    if (!out) {
+        abort();
+    }
+
+    size_t i = 0;
+    while (i < len) {
+        if (out_cap - out_len < 4) {
+            out_cap *= 2;
+            out = realloc(out, out_cap + 1);
+            if (!out) {
+                abort();
+            }
+        }
+
+        uint32_t cp;
+        uint16_t c = in[i];
+        if (UTF16_TRAIL(c)) {
+            cp = UTF_REPL_CHAR;
+            i++;
+        } else if (!UTF16_LEAD(c)) {
+            cp = c;
+            i++;
+        } else if (i + 1 < len && UTF16_TRAIL(in[i + 1])) {
+            cp = 0x10000 + ((c - 0xD800U) * 0x400 + (in[i + 1] - 0xDC00U));
+            i += 2;
+        } else {
+            cp = UTF_REPL_CHAR;
+            i++;
+        }
+
+        uint8_t *buf = out + out_len;
+        if (cp < 0x80) {
+            buf[0] = (uint8_t) cp;
+            out_len += 1;
+        } else if (cp < 0x800) {
+            buf[0] = (uint8_t) (0xc0 | (cp >> 6));
+            buf[1] = 0x80 | (cp & 0x3f);
+            out_len += 2;
+        } else if (cp < 0x10000) {
+            buf[0] = (uint8_t) (0xe0 | (cp >> 12));
+            buf[1] = 0x80 | ((cp >> 6) & 0x3f);
+            buf[2] = 0x80 | (cp & 0x3f);
+            out_len += 3;
+        } else {
+            buf[0] = (uint8_t) (0xf0 | (cp >> 18));
+            buf[1] = 0x80 | ((cp >> 12) & 0x3f);
+            buf[2] = 0x80 | ((cp >> 6) & 0x3f);
+            buf[3] = 0x80 | (cp & 0x3f);
+            out_len += 4;
+        }
+    }
+    out[out_len] = '\0';
+    *out_len_p = out_len;
+    return out;
+}
+
+static uint8_t *_transcode(const struct utf_transcode_impl *impl,
+                           const uint16_t *in, size_t len, size_t *out_len_p)
+{
+    size_t out_len = impl->utf8_length(in, len);
+    uint8_t *out = malloc(out_len + 1);
+    if (!out) {
+        abort();
+    }
+    size_t written = impl->utf16_to_utf8(in, len, out, out_len);
+    out[out_len] = '\0';
+    *out_len_p = written == out_len ? out_len : (size_t) -1;
+    return out;
+}
+
+static const struct utf_transcode_impl *_impls;
+static size_t _num_impls;
+
+// checks every implementation the CPU supports
+static int _check(const char *corpus, const uint16_t *in, size_t len)
+{
+    size_t expected_len;
+    uint8_t *expected = _reference(in, len, &expected_len);
+    int failed = 0;
+    for (size_t i = 0; i < _num_impls; i++) {
+        if (!cpu_has(_impls[i].required_features)) {
+            continue;
+        }
+        size_t actual_len;
+        uint8_t *actual = _transcode(&_impls[i], in, len, &actual_len);
+        if (actual_len != expected_len ||
+            memcmp(expected, actual, expected_len) != 0) {
+            fprintf(stderr, "%s: %s: mismatch for input of length %zu\n",
+                    _impls[i].name, corpus, len);
+            failed = 1;
+        }
+        free(actual);
+    }
+    free(expected);
+    return failed;
+}
+
+enum corpus { ASCII, LATIN1, CJK, EMOJI, MIXED };
+
+static const char *const _corpus_names[] = {"ascii", "latin1", "cjk", "emoji",
+                                            "mixed"};
+
+// Latin-1 and CJK text is mostly non-ASCII letters separated by ASCII; emoji
+// are surrogate pairs. Mixed includes unpaired surrogates
+static void _fill(enum corpus corpus, uint16_t *buf, size_t len, uint32_t seed)
+{
+    uint32_t x = seed ? seed : 1;
+    for (size_t i = 0; i < len; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        uint16_t ascii = (uint16_t) (0x20 + x % 0x5F);
+        switch (corpus) {
+        case ASCII:
+            buf[i] = ascii;
+            break;
+        case LATIN1:
+            buf[i] = (x >> 8) % 8 == 0 ? (uint16_t) (0xC0 + (x >> 12) % 0x40)
+                                       : ascii;
+            break;
+        case CJK:
+            buf[i] = (x >> 8) % 8 == 0
+                             ? (uint16_t) ' '
+                             : (uint16_t) (0x4E00 + (x >> 12) % 0x5000);
+            break;
+        case EMOJI:
+            if ((x >> 8) % 4 != 0 && i + 1 < len) {
+                buf[i] = (uint16_t) (0xD83D);
+                buf[++i] = (uint16_t) (0xDE00 + (x >> 12) % 0x50);
+            } else {
+                buf[i] = ascii;
+            }
+            break;
+        case MIXED:
+            switch ((x >> 8) % 6) {
+            case 0:
+                buf[i] = ascii;
+                break;
+            case 1:
+                buf[i] = (uint16_t) (0x80 + (x >> 12) % 0x780);
+                break;
+            case 2:
+                buf[i] = (uint16_t) (0x800 + (x >> 12) % 0xD000);
+                break;
+            case 3: // lead, often unpaired
+                buf[i] = (uint16_t) (0xD800 + (x >> 12) % 0x400);
+                break;
+            case 4: // trail, often unpaired
+                buf[i] = (uint16_t) (0xDC00 + (x >> 12) % 0x400);
+                break;
+            default:
+                buf[i] = (uint16_t) (0xE000 + (x >> 12) % 0x2000);
+                break;
+            }
+            break;
+        }
+    }
+}
+
+static uint32_t _rand(uint32_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+// returns whether any output differed (reported on stderr); requires
+// utf_transcode_init()
+static int utf16_utf8_fuzz(int iterations)
+{
+    _impls = utf_transcode_impls(&_num_impls);
+
+    int failed = 0;
+    static uint16_t in[1024];
+    const size_t cap = sizeof in / sizeof in[0];
+    for (int c = ASCII; c <= MIXED; c++) {
+        for (uint32_t seed = 1; seed <= 8; seed++) {
+            _fill((enum corpus) c, in, cap, seed);
+            for (size_t len = 0; len <= 300; len++) {
+                // at the end of the buffer, so ASAN catches over-reads
+                failed |= _check(_corpus_names[c], in + cap - len, len);
+            }
+            failed |= _check(_corpus_names[c], in, cap);
+        }
+    }
+    // pairs split at every position of a vector block
+    for (size_t pos = 0; pos < 40; pos++) {
+        for (size_t i = 0; i < 40; i++) {
+            in[i] = 'a';
+        }
+        in[pos] = 0xD83D;
+        in[pos + 1] = 0xDE00;
+        failed |= _check("pair", in, 40);
+    }
+
+    // random units, half of them leads or trails, with a random ASCII prefix
+    // so that the surrogates land at every offset of the vector loops
+    uint32_t x = 0x9E3779B9;
+    for (int iter = 0; iter < iterations; iter++) {
+        size_t len = _rand(&x) % 97;
+        uint16_t *p = in + cap - len;
+        size_t prefix = len ? _rand(&x) % len : 0;
+        for (size_t i = 0; i < len; i++) {
+            uint32_t r = _rand(&x);
+            if (i < prefix) {
+                p[i] = (uint16_t) (0x20 + r % 0x5F);
+            } else if (r % 2) {
+                p[i] = (uint16_t) (0xD800 + (r >> 8) % 0x800);
+            } else {
+                p[i] = (uint16_t) (r >> 8);
+            }
+        }
+        failed |= _check("fuzz", p, len);
+    }
+    return failed;
+}
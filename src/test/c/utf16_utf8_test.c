@@ -0,0 +1,19 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+// A bounded run of the UTF-16 to UTF-8 parity fuzz, under ctest
+
+#include "utf16_utf8_fuzz.h"
+
+int main(void)
+{
+    cpu_features_init();
+    utf_transcode_init();
+    printf("selected implementation: %s\n", utf_transcode_impl->name);
+    return utf16_utf8_fuzz(20000) ? 1 : 0;
+}
@@ -0,0 +1,315 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+#pragma once
+
+// Checks every UTF-8 to UTF-16 decoder the CPU supports against the previous
+// one code point at a time implementation, on valid text of every length up
+// to 300 bytes and on random bytes and text with random corruptions,
+// truncations and non-shortest forms. Shared by utf8_utf16_test and
+// utf8_utf16_bench, which also uses the reference and the corpora.
+
+#include "cpu_features.h"
+#include "utf_transcode.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MB_FAILURE(pos, advance)                                               \
+    do {                                                                       \
+        *cursor = pos + (advance);                                             \
+        *status = false;                                                       \
+        return 0;                                                              \
+    } while (0)
+
+#define CHECK_LEN(pos, chars_need) ((str_len - (pos)) >= (chars_need))
+#define UTF8_LEAD(c) ((c) < 0x80 || ((c) >= 0xC2 && (c) <= 0xF4))
+#define UTF8_TRAIL(c) ((c) >= 0x80 && (c) <= 0xBF)
+
+// the previous implementation, without JNI
+static uint32_t _ref_next_codepoint(const uint8_t *str, size_t str_len,
+                                    size_t *cursor, bool *status)
+{
+    size_t pos = *cursor;
+    uint32_t codepoint;
+    uint8_t c;
+
+    *status = true;
+
+    c = str[pos];
+    if (c < 0x80) {
+        codepoint = c;
+        pos++;
+    } else if (c < 0xc2) {
+        MB_FAILURE(pos, 1);
+    } else if (c < 0xe0) {
+        if (!CHECK_LEN(pos, 2))
+            MB_FAILURE(pos, 1);
+
+        if (!UTF8_TRAIL(str[pos + 1])) {
+            MB_FAILURE(pos, UTF8_LEAD(str[pos + 1]) ? 1 : 2);
+        }
+        codepoint = ((c & 0x1fU) << 6) | (str[pos + 1] & 0x3f);
+        if (codepoint < 0x80) {
+            MB_FAILURE(pos, 2);
+        }
+        pos += 2;
+    } else if (c < 0xf0) {
+        size_t avail = str_len - pos;
+
+        if (avail < 3 || !UTF8_TRAIL(str[pos + 1]) ||
+            !UTF8_TRAIL(str[pos + 2])) {
+            if (avail < 2 || UTF8_LEAD(str[pos + 1]))
+                MB_FAILURE(pos, 1);
+            else if (avail < 3 || UTF8_LEAD(str[pos + 2]))
+                MB_FAILURE(pos, 2);
+            else
+                MB_FAILURE(pos, 3);
+        }
+
+        codepoint = ((c & 0x0fU) << 12) | ((str[pos + 1] & 0x3fU) << 6) |
+                    (str[pos + 2] & 0x3f);
+        if (codepoint < 0x800) {
+            MB_FAILURE(pos, 3);
+        } else if (codepoint >= 0xd800 && codepoint <= 0xdfff) {
+            MB_FAILURE(pos, 3);
+        }
+        pos += 3;
+    } else if (c < 0xf5) {
+        size_t avail = str_len - pos;
+
+        if (avail < 4 || !UTF8_TRAIL(str[pos + 1]) ||
+            !UTF8_TRAIL(str[pos + 2]) || !UTF8_TRAIL(str[pos + 3])) {
+            if (avail < 2 || UTF8_LEAD(str[pos + 1]))
+                MB_FAILURE(pos, 1);
+            else if (avail < 3 || UTF8_LEAD(str[pos + 2]))
+                MB_FAILURE(pos, 2);
+            else if (avail < 4 || UTF8_LEAD(str[pos + 3]))
+                MB_FAILURE(pos, 3);
+            else
+                MB_FAILURE(pos, 4);
+        }
+
+        codepoint = ((c & 0x07U) << 18) | ((str[pos + 1] & 0x3fU) << 12) |
+                    ((str[pos + 2] & 0x3fU) << 6) | (str[pos + 3] & 0x3f);
+        if (codepoint < 0x10000 || codepoint > 0x10FFFF) {
+            MB_FAILURE(pos, 4);
+        }
+        pos += 4;
+    } else {
+        MB_FAILURE(pos, 1);
+    }
+
+    *cursor = pos;
+    return codepoint;
+}
+
+static size_t _reference(const uint8_t *in, size_t len, uint16_t *out)
+{
+    size_t out_len = 0;
+    size_t cursor = 0;
+    while (cursor < len) {
+        bool status;
+        uint32_t cp = _ref_next_codepoint(in, len, &cursor, &status);
+        if (!status) {
+            cp = UTF_REPL_CHAR;
+        }
+        if (cp < 0x10000) {
+            out[out_len++] = (uint16_t) cp;
+        } else {
+            out[out_len++] = (uint16_t) (0xD800 | ((cp & 0xFFFF) >> 10));
+            out[out_len++] = (uint16_t) (0xDC00 | (cp & 0x3FF));
+        }
+    }
+    return out_len;
+}
+
+static uint32_t _rand(uint32_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+static const struct utf_transcode_impl *_impls;
+static size_t _num_impls;
+
+// checks every implementation the CPU supports
+static int _check(const char *corpus, const uint8_t *in, size_t len)
+{
+    uint16_t *expected = malloc((len + 1) * sizeof *expected);
+    uint16_t *actual = malloc((len + 1) * sizeof *actual);
+    if (!expected || !actual) {
+        abort();
+    }
+    size_t expected_len = _reference(in, len, expected);
+    int failed = 0;
+    for (size_t i = 0; i < _num_impls; i++) {
+        if (!cpu_has(_impls[i].required_features)) {
+            continue;
+        }
+        size_t actual_len = _impls[i].utf8_to_utf16(in, len, actual);
+        if (actual_len != expected_len ||
+            memcmp(expected, actual, expected_len * sizeof *actual) != 0) {
+            fprintf(stderr, "%s: %s: mismatch for input of length %zu\n",
+                    _impls[i].name, corpus, len);
+            failed = 1;
+        }
+    }
+    free(expected);
+    free(actual);
+    return failed;
+}
+
+enum corpus { ASCII, LATIN1, CJK, EMOJI, MIXED };
+
+static const char *const _corpus_names[] = {"ascii", "latin1", "cjk", "emoji",
+                                            "mixed"};
+
+static size_t _put_utf8(uint8_t *buf, uint32_t cp)
+{
+    if (cp < 0x80) {
+        buf[0] = (uint8_t) cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        buf[0] = (uint8_t) (0xc0 | (cp >> 6));
+        buf[1] = (uint8_t) (0x80 | (cp & 0x3f));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        buf[0] = (uint8_t) (0xe0 | (cp >> 12));
+        buf[1] = (uint8_t) (0x80 | ((cp >> 6) & 0x3f));
+        buf[2] = (uint8_t) (0x80 | (cp & 0x3f));
+        return 3;
+    }
+    buf[0] = (uint8_t) (0xf0 | (cp >> 18));
+    buf[1] = (uint8_t) (0x80 | ((cp >> 12) & 0x3f));
+    buf[2] = (uint8_t) (0x80 | ((cp >> 6) & 0x3f));
+    buf[3] = (uint8_t) (0x80 | (cp & 0x3f));
+    return 4;
+}
+
+// valid text filling up to len bytes; returns the bytes written. Latin-1 and
+// CJK text is mostly non-ASCII letters separated by ASCII
+static size_t _fill(enum corpus corpus, uint8_t *buf, size_t len,
+                    uint32_t seed)
+{
+    uint32_t x = seed ? seed : 1;
+    size_t n = 0;
+    while (n + 4 <= len) {
+        uint32_t r = _rand(&x);
+        uint32_t ascii = 0x20 + r % 0x5F;
+        uint32_t cp;
+        switch (corpus) {
+        case ASCII:
+            cp = ascii;
+            break;
+        case LATIN1:
+            cp = (r >> 8) % 4 == 0 ? ascii : 0xC0 + (r >> 12) % 0x40;
+            break;
+        case CJK:
+            cp = (r >> 8) % 8 == 0 ? ' ' : 0x4E00 + (r >> 12) % 0x5000;
+            break;
+        case EMOJI:
+            cp = (r >> 8) % 4 == 0 ? ascii : 0x1F600 + (r >> 12) % 0x50;
+            break;
+        case MIXED:
+        default:
+            switch ((r >> 8) % 4) {
+            case 0:
+                cp = ascii;
+                break;
+            case 1:
+                cp = 0x80 + (r >> 12) % 0x780;
+                break;
+            case 2:
+                cp = 0x800 + (r >> 12) % 0xD000;
+                if (cp >= 0xD800 && cp <= 0xDFFF) {
+                    cp = 0xFFFD;
+                }
+                break;
+            default:
+                cp = 0x10000 + (r >> 12) % 0x100000;
+                break;
+            }
+            break;
+        }
+        n += _put_utf8(buf + n, cp);
+    }
+    return n;
+}
+
+// bytes that are often mishandled: continuations, non-shortest form and
+// out of range leads, surrogates (ED A0-BF) and the ends of the ranges
+static const uint8_t _interesting[] = {0x00, 0x7F, 0x80, 0xBF, 0xC0, 0xC1,
+                                       0xC2, 0xDF, 0xE0, 0xED, 0xEF, 0xF0,
+                                       0xF4, 0xF5, 0xFF, 0xA0, 0x9F, 0x8F};
+
+static void _corrupt(uint8_t *buf, size_t len, uint32_t *x)
+{
+    if (!len) {
+        return;
+    }
+    size_t count = 1 + _rand(x) % 4;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t r = _rand(x);
+        buf[r % len] =
+                (r >> 16) % 2 ? (uint8_t) (r >> 8)
+                              : _interesting[(r >> 8) % sizeof _interesting];
+    }
+}
+
+// returns whether any output differed (reported on stderr); requires
+// utf_transcode_init()
+static int utf8_utf16_fuzz(int iterations)
+{
+    _impls = utf_transcode_impls(&_num_impls);
+
+    int failed = 0;
+    static uint8_t buf[1024];
+    const size_t cap = sizeof buf;
+
+    for (int c = ASCII; c <= MIXED; c++) {
+        for (uint32_t seed = 1; seed <= 8; seed++) {
+            size_t n = _fill((enum corpus) c, buf, cap, seed);
+            failed |= _check(_corpus_names[c], buf, n);
+            for (size_t len = 0; len <= 300; len++) {
+                // at the end of the buffer, so ASAN catches over-reads
+                memmove(buf + cap - len, buf, len);
+                failed |= _check(_corpus_names[c], buf + cap - len, len);
+                _fill((enum corpus) c, buf, cap, seed);
+            }
+        }
+    }
+
+    uint32_t x = 0x9E3779B9;
+    for (int iter = 0; iter < iterations; iter++) {
+        uint32_t r = _rand(&x);
+        size_t len = r % 97;
+        uint8_t *in = buf + cap - len;
+        if ((r >> 8) % 4 == 0) { // random bytes
+            for (size_t i = 0; i < len; i++) {
+                in[i] = (uint8_t) _rand(&x);
+            }
+        } else { // corrupted text
+            uint8_t text[100];
+            size_t n = _fill((enum corpus) ((r >> 12) % 5), text, sizeof text,
+                             _rand(&x));
+            len = len < n ? len : n;
+            in = buf + cap - len;
+            memcpy(in, text, len);
+            _corrupt(in, len, &x);
+        }
+        failed |= _check("fuzz", in, len);
+    }
+    return failed;
+}
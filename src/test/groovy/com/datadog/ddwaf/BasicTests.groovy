@@ -19,6 +19,7 @@ import static org.hamcrest.Matchers.containsInAnyOrder
 import static org.hamcrest.Matchers.hasItem
 import static org.hamcrest.Matchers.is
 import static org.hamcrest.Matchers.notNullValue
+import static org.hamcrest.Matchers.nullValue
 
 class BasicTests implements WafTrait {
 
@@ -90,6 +91,72 @@ class BasicTests implements WafTrait {
     assert metrics.totalRunTimeNs >= metrics.totalDdwafRunTimeNs
   }
 
+  @Test
+  void 'metrics can be shared between threads'() {
+    wafDiagnostics = builder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1)
+    handle = builder.buildWafHandleInstance()
+    final params = ['server.request.headers.no_cookies': ['user-agent': 'Arachni/v1']]
+
+    runInThreads(8) {
+      50.times {
+        WafContext ctx = new WafContext(handle)
+        try {
+          ctx.run(params, limits, metrics)
+        } finally {
+          ctx.close()
+        }
+      }
+    }
+
+    assert metrics.totalDdwafRunTimeNs > 0
+    assert metrics.totalRunTimeNs >= metrics.totalDdwafRunTimeNs
+    // each thread adds to its own stripe
+    int stripesUsed = (0..<WafMetrics.STRIPES).count {
+      metrics.nativeCounters.getLong(it * WafMetrics.STRIPE_SIZE +
+        WafMetrics.DDWAF_RUN_TIME_NS_OFFSET) != 0
+    }
+    assert stripesUsed > 1
+  }
+
+  @Test
+  void 'native counters are allocated on first use'() {
+    wafDiagnostics = builder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1)
+    handle = builder.buildWafHandleInstance()
+    context = new WafContext(handle)
+    final params = ['server.request.headers.no_cookies': ['user-agent': 'Arachni/v1']]
+
+    assert metrics.nativeCounters == null
+    assert metrics.totalDdwafRunTimeNs == 0
+
+    context.run(params, limits, metrics)
+
+    assert metrics.nativeCounters != null
+    assert metrics.totalDdwafRunTimeNs > 0
+  }
+
+  @Test
+  void 'results larger than the result buffer are decoded'() {
+    maxStringSize = 4096
+    wafDiagnostics = builder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1)
+    handle = builder.buildWafHandleInstance()
+    context = new WafContext(handle)
+    String userAgent = 'Arachni/v' + ('\u00e9\u4e2d' * 1500)
+    final params = ['server.request.headers.no_cookies': ['user-agent': userAgent]]
+
+    // run twice: the second run reuses the larger buffer
+    2.times {
+      ResultWithData res = context.run(params, limits, metrics)
+      assertThat res.result, is(Waf.Result.MATCH)
+      assertThat res.actions, is([:])
+
+      def json = slurper.parseText(res.data)
+      assert json[0].rule.id == 'arachni_rule'
+      String value = json[0].rule_matches[0]['parameters'][0].value
+      assert value.startsWith('Arachni/v\u00e9\u4e2d')
+      assert userAgent.startsWith(value)
+    }
+  }
+
   @Test
   void 'test blocking action'() {
     def ruleSet = ARACHNI_ATOM_BLOCK
@@ -108,6 +175,34 @@ class BasicTests implements WafTrait {
     assertThat res.actions.get('block_request').grpc_status_code, is(10L)
   }
 
+  @Test
+  void 'typed actions are shared between results of the same handle'() {
+    wafDiagnostics = builder.addOrUpdateConfig('test', ARACHNI_ATOM_BLOCK)
+    handle = builder.buildWafHandleInstance()
+    context = new WafContext(handle)
+    final params = ['server.request.headers.no_cookies': ['user-agent': 'Arachni/v1']]
+    ResultWithData res = context.run(params, limits, metrics)
+
+    assertThat res.typedActions.size(), is(1)
+    WafAction block = res.typedActions[0]
+    assertThat block.type, is(WafAction.Type.BLOCK_REQUEST)
+    assertThat block.name, is('block_request')
+    assertThat block.statusCode, is(403)
+    assertThat block.grpcStatusCode, is(10)
+    assertThat block.blockingType, is('auto')
+    assertThat block.location, is(nullValue())
+    assertThat block.parameters, is(res.actions.get('block_request'))
+
+    WafContext context2 = new WafContext(handle)
+    try {
+      ResultWithData res2 = context2.run(params, limits, metrics)
+      assert res2.typedActions.is(res.typedActions)
+      assert res2.actions.is(res.actions)
+    } finally {
+      context2.close()
+    }
+  }
+
   @Test
   void 'test built-in actions'() {
     def ruleSet = ARACHNI_ATOM_V2_1
@@ -130,6 +225,8 @@ class BasicTests implements WafTrait {
     // stack_trace action
     assertThat res.actions.keySet(), hasItem('generate_stack')
     assertThat res.actions.get('generate_stack').stack_id, is(notNullValue())
+    WafAction stack = res.typedActions.find { it.type == WafAction.Type.GENERATE_STACK }
+    assertThat stack.stackId, is(res.actions.get('generate_stack').stack_id)
 
     // extract_schema action
     assertThat res.actions.keySet(), hasItem('generate_schema')
@@ -37,6 +37,24 @@ class ByteBufferSerializerTests extends ByteBufferSerializerTestsBase {
     assertSerializeValue('\uD800\uDC00', '<STRING> \uD800\uDC00')
   }
 
+  @Test
+  void 'can convert long ASCII and mostly ASCII output'() {
+    // long enough overall for the Latin-1 path when converting back to a String
+    String ascii = 'abcdefghij' * 9
+    [ascii, ascii + '\u00E9', '\u00E9' + ascii].each { String last ->
+      lease = serializer.serialize([key: [ascii, last]], metrics)
+      String res = Waf.pwArgsBufferToString(lease.firstPWArgsByteBuffer)
+      def exp = p"""
+          <MAP>
+            key: <ARRAY>
+              <STRING> $ascii
+              <STRING> $last
+          """
+      assertThat res, is(exp)
+      lease.close()
+    }
+  }
+
   @Test
   void 'can serialize a dangling surrogate pair'() {
     assertSerializeValue('a\uD83C', '<STRING> a�')
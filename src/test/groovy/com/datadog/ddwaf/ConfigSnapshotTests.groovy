@@ -0,0 +1,75 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf
+
+import org.junit.Rule
+import org.junit.Test
+import org.junit.rules.TemporaryFolder
+
+import java.nio.file.Files
+import java.nio.file.Path
+
+import static groovy.test.GroovyAssert.shouldFail
+import static org.hamcrest.MatcherAssert.assertThat
+import static org.hamcrest.Matchers.is
+
+class ConfigSnapshotTests implements WafTrait {
+
+  // mapped files can't be deleted or replaced on Windows, so every file gets its own path and is
+  // only removed with the folder, once the test is over
+  @Rule
+  public TemporaryFolder tmp = new TemporaryFolder()
+
+  @Test
+  void 'a snapshot loads like the map it was written from'() {
+    Path file = tmp.root.toPath().resolve('ruleset.snapshot')
+    ConfigSnapshot.write(ARACHNI_ATOM_V2_1, file)
+    ConfigSnapshot snapshot = ConfigSnapshot.map(file)
+    wafDiagnostics = builder.addOrUpdateConfig('test', snapshot)
+    assertThat wafDiagnostics.numConfigOK, is(1)
+    assertThat wafDiagnostics.unchanged, is(false)
+
+    handle = builder.buildWafHandleInstance()
+    context = new WafContext(handle)
+    Waf.ResultWithData res = context.run(
+      ['server.request.headers.no_cookies': ['user-agent': 'Arachni/v1']], limits, metrics)
+    assertThat res.result, is(Waf.Result.MATCH)
+
+    // same digest as the converted map
+    assertThat builder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1).unchanged, is(true)
+  }
+
+  @Test
+  void 'a snapshot can be loaded by several builders'() {
+    Path file = tmp.root.toPath().resolve('ruleset.snapshot')
+    ConfigSnapshot.write(ARACHNI_ATOM_V2_1, file)
+    ConfigSnapshot snapshot = ConfigSnapshot.map(file)
+    assertThat builder.addOrUpdateConfig('test', snapshot).numConfigOK, is(1)
+    WafBuilder other = new WafBuilder()
+    try {
+      assertThat other.addOrUpdateConfig('test', snapshot).numConfigOK, is(1)
+    } finally {
+      other.close()
+    }
+  }
+
+  @Test
+  void 'other and truncated files are rejected'() {
+    Path other = tmp.newFile('other.snapshot').toPath()
+    other.text = 'not a snapshot'
+    shouldFail(IOException) { ConfigSnapshot.map(other) }
+
+    Path file = tmp.root.toPath().resolve('ruleset.snapshot')
+    ConfigSnapshot.write(ARACHNI_ATOM_V2_1, file)
+    byte[] bytes = Files.readAllBytes(file)
+    Path truncated = tmp.root.toPath().resolve('truncated.snapshot')
+    Files.write(truncated, Arrays.copyOf(bytes, bytes.length - 8))
+    shouldFail(IOException) { ConfigSnapshot.map(truncated) }
+  }
+}
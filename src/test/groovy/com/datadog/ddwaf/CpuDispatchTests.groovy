@@ -0,0 +1,43 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf
+
+import org.junit.Test
+
+import static org.hamcrest.MatcherAssert.assertThat
+import static org.hamcrest.Matchers.contains
+import static org.hamcrest.Matchers.is
+import static org.hamcrest.Matchers.isOneOf
+import static org.junit.Assume.assumeTrue
+
+class CpuDispatchTests implements JNITrait {
+
+  @Test
+  void 'reports a known cpu level'() {
+    assertThat Waf.cpuLevel,
+      isOneOf('generic', 'sse2', 'ssse3', 'sse4.2', 'avx2', 'avx512', 'neon')
+  }
+
+  @Test
+  void 'reports the implementation of each kernel'() {
+    Map<String, String> impls = Waf.kernelImplementations
+    assertThat impls.keySet(), contains('base64', 'json_escape', 'utf_transcode')
+    impls.values().each { assert it }
+  }
+
+  @Test
+  void 'the cpu level can be forced'() {
+    assumeTrue(System.getProperty('DD_APPSEC_WAF_CPU_LEVEL') == 'generic')
+
+    assertThat Waf.cpuLevel, is('generic')
+    Waf.kernelImplementations.values().each {
+      assertThat it, isOneOf('generic', 'scalar')
+    }
+  }
+}
@@ -52,5 +52,53 @@ class EncodingTests implements WafTrait {
 
     assertThat awd.data, containsString('\\u0000Arachni\\u0000')
   }
-}
 
+  @Test
+  void 'non-ASCII strings from the waf are decoded'() {
+    // longer than a vector block; Latin-1, CJK, emoji and ASCII followed by a single accent
+    def ids = [
+      'règle_détection_été_ça_à_où',
+      '检测规则_一二三四五六七八九十',
+      'rule_\uD83D\uDE00\uD83D\uDE01\uD83D\uDE02_emoji',
+      'x' * 40 + 'é'
+    ]
+
+    wafDiagnostics = builder.addOrUpdateConfig('test', [version: '2.1', rules: rulesWithIds(ids)])
+    assert wafDiagnostics.rules.loaded as Set == ids as Set
+  }
+
+  @Test
+  void 'long strings from the waf are decoded'() {
+    // longer than the 128 bytes widened on the stack: pure ASCII, and non-ASCII after an ASCII
+    // prefix, both past the vector loop and inside one of its blocks
+    def ids = [
+      'a' * 300,
+      'b' * 200 + 'é',
+      'c' * 130 + '检测',
+      'd' * 150 + '\uD83D\uDE00' + 'd' * 20,
+      'e' * 70 + 'ü' + 'e' * 100
+    ]
+
+    wafDiagnostics = builder.addOrUpdateConfig('test', [version: '2.1', rules: rulesWithIds(ids)])
+    assert wafDiagnostics.rules.loaded as Set == ids as Set
+  }
+
+  private static List<Map> rulesWithIds(List<String> ids) {
+    ids.collect { id ->
+      [
+        id: id,
+        name: id,
+        tags: [type: 'security_scanner'],
+        conditions: [
+          [
+            operator: 'match_regex',
+            parameters: [
+              inputs: [[address: 'server.request.headers.no_cookies', key_path: ['user-agent']]],
+              regex: 'Arachni'
+            ]
+          ]
+        ]
+      ]
+    }
+  }
+}
@@ -0,0 +1,93 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf
+
+import org.junit.Rule
+import org.junit.Test
+import org.junit.rules.TemporaryFolder
+
+import java.nio.file.Path
+
+import static org.hamcrest.MatcherAssert.assertThat
+import static org.hamcrest.Matchers.is
+
+class InputRecordingTests implements WafTrait {
+
+  // recordings stay mapped until collected and can't be deleted before then on Windows, so they
+  // are only removed with the folder, once the test is over
+  @Rule
+  public TemporaryFolder tmp = new TemporaryFolder()
+
+  @Test
+  void 'recorded inputs replay to the same results'() {
+    Path file = tmp.root.toPath().resolve('inputs.rec')
+    InputRecorder recorder = InputRecorder.open(file)
+    Waf.inputRecorder = recorder
+    try {
+      assertThat runRules('Arachni/v1').result, is(Waf.Result.MATCH)
+      context.runEphemeral([
+        'server.request.headers.no_cookies': ['user-agent': ['Mozilla', 42, true, null]]
+      ], limits, metrics)
+    } finally {
+      Waf.inputRecorder = null
+      recorder.close()
+    }
+    assertThat recorder.records, is(2L)
+    assertThat recorder.failures, is(0L)
+
+    InputRecording recording = InputRecording.map(file)
+    assertThat recording.size(), is(2)
+    assertThat recording.get(0).hasPersistentData(), is(true)
+    assertThat recording.get(1).hasEphemeralData(), is(true)
+    assertThat Waf.pwArgsBufferToString(recording.get(1).ephemeral), is(serialize(
+      ['server.request.headers.no_cookies': ['user-agent': ['Mozilla', 42, true, null]]]))
+
+    WafContext replayContext = new WafContext(handle)
+    try {
+      assertThat replayContext.run(recording.get(0), limits, metrics).result,
+        is(Waf.Result.MATCH)
+      assertThat replayContext.run(recording.get(1), limits, metrics).result,
+        is(Waf.Result.OK)
+    } finally {
+      replayContext.close()
+    }
+  }
+
+  @Test
+  void 'recordings are appended to'() {
+    Path file = tmp.root.toPath().resolve('inputs.rec')
+    2.times {
+      InputRecorder recorder = InputRecorder.open(file)
+      Waf.inputRecorder = recorder
+      try {
+        runRules('Arachni/v1')
+      } finally {
+        Waf.inputRecorder = null
+        recorder.close()
+      }
+    }
+    assertThat InputRecording.map(file).size(), is(2)
+  }
+
+  @Test(expected = IOException)
+  void 'other files are rejected'() {
+    Path file = tmp.root.toPath().resolve('inputs.rec')
+    file.text = 'not a recording'
+    InputRecording.map(file)
+  }
+
+  private String serialize(Map<String, Object> data) {
+    ByteBufferSerializer.ArenaLease lease = new ByteBufferSerializer(limits).serialize(data, null)
+    try {
+      Waf.pwArgsBufferToString(lease.firstPWArgsByteBuffer)
+    } finally {
+      lease.close()
+    }
+  }
+}
@@ -0,0 +1,80 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf
+
+import org.junit.Test
+
+import static org.hamcrest.MatcherAssert.assertThat
+import static org.hamcrest.Matchers.greaterThan
+import static org.hamcrest.Matchers.greaterThanOrEqualTo
+import static org.hamcrest.Matchers.is
+import static org.hamcrest.Matchers.lessThanOrEqualTo
+
+class LatencyHistogramTests implements WafTrait {
+
+  @Test
+  void 'buckets cover values with bounded relative error'() {
+    int prev = -1
+    [0L, 1L, 63L, 64L, 65L, 1000L, 123_456L, 10_000_000L, LatencyHistogram.MAX_TRACKABLE_NS].each {
+      int idx = LatencyHistogram.bucketIndex(it)
+      assertThat idx, greaterThan(prev)
+      long upper = LatencyHistogram.bucketUpperBound(idx)
+      assertThat upper, greaterThanOrEqualTo(it)
+      assertThat((double) (upper - it), lessThanOrEqualTo(it / 32.0d))
+      prev = idx
+    }
+    assertThat LatencyHistogram.bucketIndex(LatencyHistogram.MAX_TRACKABLE_NS),
+      is(LatencyHistogram.NUM_BUCKETS - 1)
+    assertThat LatencyHistogram.bucketIndex(Long.MAX_VALUE), is(LatencyHistogram.NUM_BUCKETS - 1)
+  }
+
+  @Test
+  void 'percentiles are merged from all threads'() {
+    LatencyHistogram histogram = new LatencyHistogram()
+    List<Thread> threads = (0..<4).collect { t ->
+      Thread.start {
+        (1..250).each { histogram.record(t * 250 + it) }
+      }
+    }
+    threads*.join()
+
+    LatencyHistogram.Snapshot snapshot = histogram.snapshot()
+    assertThat snapshot.count, is(1000L)
+    assertThat snapshot.sum, is(500_500L)
+    long p50 = snapshot.getValueAtPercentile(50)
+    assert p50 >= 500 && p50 <= 500 * 1.04
+    long p99 = snapshot.getValueAtPercentile(99)
+    assert p99 >= 990 && p99 <= 990 * 1.04
+    assert snapshot.max >= 1000 && snapshot.max <= 1000 * 1.04
+  }
+
+  @Test
+  void 'snapshotAndReset starts a new interval'() {
+    LatencyHistogram histogram = new LatencyHistogram()
+    histogram.record(10)
+    histogram.record(20)
+
+    assertThat histogram.snapshotAndReset().count, is(2L)
+    assertThat histogram.snapshot().count, is(0L)
+    assertThat histogram.snapshot().getValueAtPercentile(99), is(0L)
+  }
+
+  @Test
+  void 'runs are recorded per handle'() {
+    runRules('Arachni')
+    runRules('Arachni')
+
+    WafHandle.Latencies latencies = handle.latencies
+    assertThat latencies.totalRunTime.snapshot().count, is(1L)
+    assertThat latencies.serialization.snapshot().count, is(1L)
+    assertThat latencies.ddwafRunTime.snapshot().count, is(1L)
+    assertThat latencies.resultConversion.snapshot().count, is(1L)
+    assert latencies.totalRunTime.snapshot().max >= latencies.ddwafRunTime.snapshot().max / 1.04
+  }
+}
@@ -0,0 +1,130 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf
+
+import org.junit.Test
+
+import java.nio.charset.StandardCharsets
+import java.util.concurrent.TimeUnit
+
+import static org.hamcrest.MatcherAssert.assertThat
+import static org.hamcrest.Matchers.greaterThanOrEqualTo
+import static org.hamcrest.Matchers.is
+
+class NativeLoggingTests implements WafTrait {
+
+  // LOG_RING_SIZE in logging.c
+  private static final int RING_SIZE = 512
+
+  @Test
+  void 'native log records are drained by a daemon thread'() {
+    Thread drainer = Thread.allStackTraces.keySet().find {
+      it.name == NativeLogDrainer.THREAD_NAME
+    }
+
+    assert drainer != null
+    assertThat drainer.daemon, is(true)
+    assertThat drainer.alive, is(true)
+  }
+
+  @Test
+  void 'queued records reach the logger'() {
+    String message = "queued record ${System.nanoTime()}"
+    // slf4j-simple looks up System.err on every write
+    assert loggedWithin(10, TimeUnit.SECONDS, message) {
+      NativeLogDrainer.logRecords(message, 1)
+    }
+  }
+
+  @Test
+  void 'records are dropped and counted while the ring is full'() {
+    long droppedBefore = Waf.droppedNativeLogRecords
+    synchronized (NativeLogDrainer.PAUSE_LOCK) {
+      NativeLogDrainer.logRecords('filling the ring', RING_SIZE + 100)
+      // the ring may hold other records already, so at least 100 don't fit
+      assertThat Waf.droppedNativeLogRecords - droppedBefore, greaterThanOrEqualTo(100L)
+    }
+
+    // and logging resumes once there's room again
+    String message = "after the drops ${System.nanoTime()}"
+    assert loggedWithin(10, TimeUnit.SECONDS, message) {
+      NativeLogDrainer.logRecords(message, 1)
+    }
+  }
+
+  @Test
+  void 'logging from many threads does not fail'() {
+    runRules('Arachni')
+    runInThreads(8) {
+      100.times {
+        WafContext ctx = new WafContext(handle)
+        try {
+          ctx.run(['server.request.headers.no_cookies': ['user-agent': 'Arachni']],
+          limits, new WafMetrics())
+        } finally {
+          ctx.close()
+        }
+      }
+    }
+  }
+
+  // whether message was written to System.err before the timeout, once action ran
+  private static boolean loggedWithin(long timeout, TimeUnit unit, String message,
+                                      Closure<?> action) {
+    PrintStream origErr = System.err
+    ByteArrayOutputStream captured = new ByteArrayOutputStream()
+    System.setErr(new PrintStream(new TeeOutputStream(origErr, captured), true))
+    try {
+      action.call()
+      long deadline = System.nanoTime() + unit.toNanos(timeout)
+      while (System.nanoTime() < deadline) {
+        synchronized (captured) {
+          if (new String(captured.toByteArray(), StandardCharsets.UTF_8).contains(message)) {
+            return true
+          }
+        }
+        Thread.sleep(10)
+      }
+      return false
+    } finally {
+      System.setErr(origErr)
+    }
+  }
+
+  private static class TeeOutputStream extends OutputStream {
+    private final OutputStream first
+    private final OutputStream second
+
+    TeeOutputStream(OutputStream first, OutputStream second) {
+      this.first = first
+      this.second = second
+    }
+
+    @Override
+    void write(int b) {
+      first.write(b)
+      synchronized (second) {
+        second.write(b)
+      }
+    }
+
+    @Override
+    void write(byte[] b, int off, int len) {
+      first.write(b, off, len)
+      synchronized (second) {
+        second.write(b, off, len)
+      }
+    }
+
+    @Override
+    void flush() {
+      first.flush()
+    }
+  }
+}
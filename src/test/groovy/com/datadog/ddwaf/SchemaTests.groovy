@@ -164,6 +164,43 @@ class SchemaTests implements WafTrait {
     ]
   }
 
+  @Test
+  void 'identical schemas share the cached encoded string'() {
+    maxElements = 30
+    timeoutInUs = 20000000
+    runBudget = 20000000
+    wafDiagnostics = builder.addOrUpdateConfig('test', EXTRACT_SCHEMA)
+
+    def data = [
+      'waf.context.settings': [
+        'extract-schema': true
+      ],
+      'server.request.body': [
+        a: 'foo',
+        b: [1, 2, 3],
+        schema_cache_test: true
+      ]
+    ]
+    handle = builder.buildWafHandleInstance()
+
+    context = new WafContext(handle)
+    Waf.ResultWithData awd1 = context.run(data, limits, metrics)
+    context.close()
+    long hitsBefore = Waf.schemaCacheHits
+
+    context = new WafContext(handle)
+    Waf.ResultWithData awd2 = context.run(data, limits, metrics)
+
+    String schema1 = awd1.attributes['_dd.appsec.s.req.body']
+    String schema2 = awd2.attributes['_dd.appsec.s.req.body']
+    assert schema1.is(schema2)
+    assert Waf.schemaCacheHits > hitsBefore
+    def schema = new JsonSlurper().parseText(decodeGzipBase64(schema2))
+    assert deepSortLists(schema) == deepSortLists([
+      ['a': [8], 'b': [[[4]], ['len': 3]], 'schema_cache_test': [2]]
+    ])
+  }
+
   private static String decodeGzipBase64(String encodedData) {
     byte[] compressedData = Base64.decoder.decode(encodedData)
     ByteArrayInputStream bis = new ByteArrayInputStream(compressedData)
@@ -0,0 +1,79 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf
+
+import org.junit.Test
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.charset.StandardCharsets
+
+import static org.hamcrest.MatcherAssert.assertThat
+import static org.hamcrest.Matchers.is
+import static org.junit.Assume.assumeTrue
+
+class SlowRunCaptureTests implements WafTrait {
+
+  private static final int DDWAF_OBJ_STRING = 1 << 2
+  private static final int DDWAF_OBJ_MAP = 1 << 4
+
+  @Test
+  void 'dump is empty when nothing was captured'() {
+    Waf.drainSlowRunCaptures()
+
+    ByteBuffer dump = header(Waf.drainSlowRunCaptures())
+    assertThat dump.short as int, is(0)
+    assertThat dump.remaining(), is(0)
+  }
+
+  @Test
+  void 'captures the inputs of slow runs'() {
+    assumeTrue(System.getProperty('DD_APPSEC_WAF_SLOW_RUN_THRESHOLD_US') != null)
+    Waf.drainSlowRunCaptures()
+
+    runRules('Arachni/v1')
+
+    ByteBuffer dump = header(Waf.drainSlowRunCaptures())
+    assertThat dump.short as int, is(1)
+    int start = dump.position()
+    int len = dump.int
+    dump.long // wall clock time
+    long totalNs = dump.long
+    long ddwafNs = dump.long
+    assert totalNs >= ddwafNs
+    assertThat dump.get() & 0x0F, is(0x04) // persistent data only
+    assertThat string(dump).length(), is(36) // the handle's UUID
+
+    assertThat dump.get() as int, is(DDWAF_OBJ_MAP)
+    assertThat dump.int, is(1)
+    assertThat string(dump), is('server.request.headers.no_cookies')
+    assertThat dump.get() as int, is(DDWAF_OBJ_MAP)
+    assertThat dump.int, is(1)
+    assertThat string(dump), is('user-agent')
+    assertThat dump.get() as int, is(DDWAF_OBJ_STRING)
+    assertThat string(dump), is('Arachni/v1')
+    assertThat dump.position() - start, is(len)
+    assertThat dump.remaining(), is(0)
+  }
+
+  private static ByteBuffer header(byte[] bytes) {
+    ByteBuffer dump = ByteBuffer.wrap(bytes).order(ByteOrder.nativeOrder())
+    byte[] magic = new byte[4]
+    dump.get(magic)
+    assertThat new String(magic, StandardCharsets.US_ASCII), is('DDSC')
+    assertThat dump.short as int, is(1)
+    dump
+  }
+
+  private static String string(ByteBuffer buf) {
+    byte[] bytes = new byte[buf.int]
+    buf.get(bytes)
+    new String(bytes, StandardCharsets.UTF_8)
+  }
+}
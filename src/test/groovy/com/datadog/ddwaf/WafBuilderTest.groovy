@@ -11,15 +11,28 @@ package com.datadog.ddwaf
 import com.datadog.ddwaf.exception.InvalidObjectWafException
 import com.datadog.ddwaf.exception.InvalidRuleSetException
 import com.datadog.ddwaf.exception.UnclassifiedWafException
+import groovy.json.JsonOutput
 import groovy.transform.CompileStatic
+import org.junit.Rule
 import org.junit.Test
+import org.junit.rules.TemporaryFolder
 
 import java.nio.ByteBuffer
+import java.nio.charset.StandardCharsets
+import java.nio.file.Files
+import java.nio.file.Path
+import java.util.concurrent.CompletableFuture
+import java.util.concurrent.CountDownLatch
+import java.util.concurrent.ExecutionException
+import java.util.concurrent.TimeUnit
 
 import static groovy.test.GroovyAssert.shouldFail
 
 class WafBuilderTest implements WafTrait {
 
+  @Rule
+  public TemporaryFolder tmp = new TemporaryFolder()
+
   @CompileStatic
   static class BadMap<K, V> implements Map<K, V> {
     @Delegate
@@ -299,5 +312,310 @@ class WafBuilderTest implements WafTrait {
         limits, metrics)
     }
   }
-}
 
+  @Test
+  void 'async update builds a handle with a build report'() {
+    handle = builder.addOrUpdateConfigAsync('test', ARACHNI_ATOM_V2_1).get(10, TimeUnit.SECONDS)
+    assert handle.online
+
+    WafHandle.BuildReport report = handle.buildReport
+    assert report.appliedUpdates == 1
+    assert report.coalescedUpdates == 0
+    assert report.buildTimeNs > 0
+    assert report.conversionTimeNs > 0
+    assert report.diagnostics['test'].numConfigOK == 1
+  }
+
+  @Test
+  void 'updates queued during a build are coalesced'() {
+    CompletableFuture<WafHandle> first
+    CompletableFuture<WafHandle> superseded
+    CompletableFuture<WafHandle> latest
+    holdingBuildThread {
+      first = builder.addOrUpdateConfigAsync('first', ARACHNI_ATOM_V2_1)
+      superseded = builder.addOrUpdateConfigAsync('second', ARACHNI_ATOM_V1_0)
+      latest = builder.addOrUpdateConfigAsync('second', ARACHNI_ATOM_BLOCK)
+    }
+
+    handle = latest.get(10, TimeUnit.SECONDS)
+    assert superseded.get().is(handle)
+    assert first.get().is(handle)
+    assert handle.buildReport.appliedUpdates == 2
+    assert handle.buildReport.coalescedUpdates == 1
+  }
+
+  @Test
+  void 'an invalid async update fails alone'() {
+    CompletableFuture<WafHandle> invalid
+    CompletableFuture<WafHandle> valid
+    holdingBuildThread {
+      invalid = builder.addOrUpdateConfigAsync('invalid', [version: '2.1', rules: [[name: 'x']]])
+      valid = builder.addOrUpdateConfigAsync('valid', ARACHNI_ATOM_V2_1)
+    }
+
+    handle = valid.get(10, TimeUnit.SECONDS)
+    ExecutionException e = shouldFail(ExecutionException) {
+      invalid.get()
+    }
+    assert e.cause instanceof InvalidRuleSetException
+  }
+
+  @Test
+  void 'async removal of a missing configuration fails'() {
+    builder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1)
+    ExecutionException e = shouldFail(ExecutionException) {
+      builder.removeConfigAsync('missing').get(10, TimeUnit.SECONDS)
+    }
+    assert e.cause instanceof UnclassifiedWafException
+    handle = builder.buildWafHandleInstanceAsync().get(10, TimeUnit.SECONDS)
+    assert handle.buildReport.appliedUpdates == 0
+  }
+
+  @Test
+  void 'queued async updates fail when the builder is closed'() {
+    CompletableFuture<WafHandle> future
+    holdingBuildThread {
+      future = builder.addOrUpdateConfigAsync('test', ARACHNI_ATOM_V2_1)
+      builder.close()
+    }
+    ExecutionException e = shouldFail(ExecutionException) {
+      future.get(10, TimeUnit.SECONDS)
+    }
+    assert e.cause instanceof UnclassifiedWafException
+  }
+
+  @Test
+  void 'json configuration is equivalent to the map'() {
+    WafDiagnostics mapDiagnostics = builder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1)
+    builder.removeConfig('test')
+    byte[] json = JsonOutput.toJson(ARACHNI_ATOM_V2_1).getBytes(StandardCharsets.UTF_8)
+    wafDiagnostics = builder.addOrUpdateConfig('test', json)
+    assert wafDiagnostics.toString() == mapDiagnostics.toString()
+    assert wafDiagnostics.numConfigOK == mapDiagnostics.numConfigOK
+
+    handle = builder.buildWafHandleInstance()
+    context = new WafContext(handle)
+    Waf.ResultWithData res = context.run(
+      ['server.request.headers.no_cookies': ['user-agent': 'Arachni/v1']], limits, metrics)
+    assert res.result == Waf.Result.MATCH
+  }
+
+  @Test
+  void 'json configuration from buffers and files'() {
+    byte[] json = JsonOutput.toJson(ARACHNI_ATOM_V2_1).getBytes(StandardCharsets.UTF_8)
+    ByteBuffer direct = ByteBuffer.allocateDirect(json.length + 4)
+    direct.put('xx'.bytes).put(json).put('yy'.bytes).position(2).limit(2 + json.length)
+    assert builder.addOrUpdateConfig('direct', direct).numConfigOK == 1
+    assert direct.position() == 2
+
+    ByteBuffer readOnly = ByteBuffer.wrap(json).asReadOnlyBuffer()
+    assert builder.addOrUpdateConfig('read-only', readOnly).numConfigOK == 1
+
+    Path file = tmp.root.toPath().resolve('ruleset.json')
+    Files.write(file, json)
+    assert builder.addOrUpdateConfigFile('file', file).numConfigOK == 1
+    // the file was read, not mapped, so it can go right away, even on Windows
+    Files.delete(file)
+    handle = builder.buildWafHandleInstance()
+  }
+
+  @Test
+  void 'json escapes and numbers are decoded'() {
+    String json = '''
+      {"version": "2.1", "rules": [{
+        "id": "\\u00e9t\\u00e9", "name": "rule", "tags": {"type": "t", "category": "c"},
+        "conditions": [{"operator": "match_regex", "parameters": {
+          "inputs": [{"address": "arg"}], "regex": "\\\\d{3}\\ud83d\\ude00",
+          "options": {"min_length": 4}}}]}]}
+    '''
+    wafDiagnostics = builder.addOrUpdateConfig('test', json.getBytes(StandardCharsets.UTF_8))
+    assert wafDiagnostics.rules.loaded == ['\u00e9t\u00e9']
+
+    handle = builder.buildWafHandleInstance()
+    context = new WafContext(handle)
+    Waf.ResultWithData res = context.run([arg: '123\ud83d\ude00'], limits, metrics)
+    assert res.result == Waf.Result.MATCH
+  }
+
+  @Test
+  void 'malformed json configuration throws'() {
+    ['', '{"version": "2.1"', '{"version": 2.1,}', '[1 2]', '{} x'].each { String json ->
+      InvalidRuleSetException e = shouldFail(InvalidRuleSetException) {
+        builder.addOrUpdateConfig('test', json.getBytes(StandardCharsets.UTF_8))
+      }
+      assert json.isEmpty() || e.cause instanceof IllegalArgumentException
+    }
+    InvalidRuleSetException e = shouldFail(InvalidRuleSetException) {
+      builder.addOrUpdateConfig('test', ('[' * 21 + ']' * 21).getBytes(StandardCharsets.UTF_8))
+    }
+    assert e.cause.message.contains('Nested too deeply')
+  }
+
+  @Test
+  void 'identical configuration updates are skipped'() {
+    WafDiagnostics first = builder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1)
+    assert !first.unchanged
+    assert builder.modifiedSinceLastBuild
+    handle = builder.buildWafHandleInstance()
+    assert !builder.modifiedSinceLastBuild
+
+    String json = JsonOutput.toJson(ARACHNI_ATOM_V2_1)
+    wafDiagnostics = builder.addOrUpdateConfig('test', slurper.parseText(json) as Map<String, Object>)
+    assert wafDiagnostics.unchanged
+    assert wafDiagnostics.toString() == first.toString()
+    // the digest is of the converted config, whatever its source
+    assert builder.addOrUpdateConfig('test', json.getBytes(StandardCharsets.UTF_8)).unchanged
+    assert !builder.modifiedSinceLastBuild
+
+    assert !builder.addOrUpdateConfig('test', ARACHNI_ATOM_BLOCK).unchanged
+    assert builder.modifiedSinceLastBuild
+
+    builder.removeConfig('test')
+    assert !builder.addOrUpdateConfig('test', ARACHNI_ATOM_BLOCK).unchanged
+  }
+
+  @Test
+  void 'a configuration differing in a single character is not skipped'() {
+    String json = JsonOutput.toJson(ARACHNI_ATOM_V2_1)
+    assert json.contains('Arachni')
+    builder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1)
+
+    String other = json.replace('Arachni', 'Arachnj')
+    wafDiagnostics = builder.addOrUpdateConfig('test', other.getBytes(StandardCharsets.UTF_8))
+    assert !wafDiagnostics.unchanged
+    assert !builder.addOrUpdateConfig('test', json.getBytes(StandardCharsets.UTF_8)).unchanged
+  }
+
+  @Test
+  void 'an update that fails after being applied is not skipped later'() {
+    builder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1)
+    handle = builder.buildWafHandleInstance()
+    assert !builder.modifiedSinceLastBuild
+
+    // libddwaf takes the config, but its diagnostics can't be stored
+    shouldFail(RuntimeException) {
+      builder.runUpdate('test') { long[] digestRef, WafDiagnostics[] infoRef ->
+        WafBuilder.addOrUpdateConfigNative(
+          builder, 'test', ARACHNI_ATOM_BLOCK, digestRef, new WafDiagnostics[0])
+      }
+    }
+    assert builder.modifiedSinceLastBuild
+    assert !builder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1).unchanged
+  }
+
+  @Test
+  void 'invalid configurations are never skipped'() {
+    final invalidRule = [version: '2.1', rules: [[name: 'Invalid Rule']]]
+    2.times {
+      shouldFail(InvalidRuleSetException) {
+        builder.addOrUpdateConfig('invalid-rule', invalidRule)
+      }
+    }
+  }
+
+  @Test
+  void 'unchanged async updates are counted'() {
+    builder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1)
+    handle = builder.addOrUpdateConfigAsync('test', ARACHNI_ATOM_V2_1).get(10, TimeUnit.SECONDS)
+    assert handle.buildReport.unchangedUpdates == 1
+    assert handle.buildReport.diagnostics['test'].unchanged
+  }
+
+  @Test
+  void 'packed data config is equivalent to the map'() {
+    builder.addOrUpdateConfig('rules', [
+      version: '2.1',
+      rules: [
+        [
+          id: 'block_ips',
+          name: 'Block IPs',
+          tags: [type: 'ip_addresses', category: 'blocking'],
+          conditions: [
+            [
+              operator: 'ip_match',
+              parameters: [data: 'blocked_ips', inputs: [[address: 'http.client_ip']]]
+            ]
+          ]
+        ]
+      ]
+    ])
+    String[] ips = ['1.2.3.4', '10.0.0.0/8', '2001:db8::1']
+    wafDiagnostics = builder.addOrUpdateDataConfig(
+      'data', WafBuilder.DataSection.RULES_DATA, 'blocked_ips', 'ip_with_expiration', ips, null)
+    assert wafDiagnostics.rulesData.loaded == ['blocked_ips']
+
+    handle = builder.buildWafHandleInstance()
+    context = new WafContext(handle)
+    assert context.run(['http.client_ip': '10.1.2.3'], limits, metrics).result == Waf.Result.MATCH
+    assert context.run(['http.client_ip': '2001:db8::1'], limits, metrics).result == Waf.Result.MATCH
+    assert context.run(['http.client_ip': '1.2.3.5'], limits, metrics).result == Waf.Result.OK
+
+    def map = [
+      rules_data: [
+        [
+          id: 'blocked_ips',
+          type: 'ip_with_expiration',
+          data: ips.collect { [value: it, expiration: 0] }
+        ]
+      ]
+    ]
+    assert builder.addOrUpdateConfig('data', map).unchanged
+  }
+
+  @Test
+  void 'packed data values are UTF-8'() {
+    String[] values = ['paco', '', 'jos\u00e9', '\ud83d\ude00', 'x']
+    int[] ends = new int[values.length]
+    byte[] packed = WafBuilder.packValues(values, ends)
+    assert ends == [4, 4, 9, 13, 14] as int[]
+    assert new String(packed, 0, ends[4], StandardCharsets.UTF_8) == values.join('')
+
+    long[] expirations = [0, 0, 0, 0, 4102444800L]
+    wafDiagnostics = builder.addOrUpdateDataConfig('data', WafBuilder.DataSection.EXCLUSION_DATA,
+      'users', 'data_with_expiration', values, expirations)
+    assert wafDiagnostics.exclusionData.loaded == ['users']
+
+    // the non-ASCII values reached libddwaf as the same bytes the map converts to
+    def map = [
+      exclusion_data: [
+        [
+          id: 'users',
+          type: 'data_with_expiration',
+          data: (0..<values.length).collect { [value: values[it], expiration: expirations[it]] }
+        ]
+      ]
+    ]
+    assert builder.addOrUpdateConfig('data', map).unchanged
+  }
+
+  @Test
+  void 'invalid packed data is rejected'() {
+    String[] values = ['1.2.3.4']
+    shouldFail(IllegalArgumentException) {
+      builder.addOrUpdateDataConfig('data', WafBuilder.DataSection.RULES_DATA, 'ips',
+        'ip_with_expiration', ['1.2.3.4', null] as String[], null)
+    }
+    shouldFail(IllegalArgumentException) {
+      builder.addOrUpdateDataConfig('data', WafBuilder.DataSection.RULES_DATA, 'ips',
+        'ip_with_expiration', values, [0, 0] as long[])
+    }
+    shouldFail(IllegalArgumentException) {
+      builder.addOrUpdateDataConfig('data', WafBuilder.DataSection.RULES_DATA, 'ips',
+        'ip_with_expiration', values, [-1] as long[])
+    }
+    shouldFail(IllegalArgumentException) {
+      builder.addOrUpdateDataConfig('data', null, 'ips', 'ip_with_expiration', values, null)
+    }
+  }
+
+  // the build thread is single and shared, so the builds queued by body only start once it's done
+  private static void holdingBuildThread(Closure<?> body) {
+    CountDownLatch release = new CountDownLatch(1)
+    WafBuilder.BuildExecutor.INSTANCE.execute { release.await() }
+    try {
+      body.call()
+    } finally {
+      release.countDown()
+    }
+  }
+}
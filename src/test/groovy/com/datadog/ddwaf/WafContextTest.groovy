@@ -126,6 +126,53 @@ class WafContextTest implements WafTrait {
     }
   }
 
+  @Test
+  void 'run with very short timeout and timeoutAsResult returns TIMEOUT'() {
+    wafDiagnostics = builder.addOrUpdateConfig('test', ARACHNI_ATOM_V1_0)
+    handle = builder.buildWafHandleInstance()
+    context = new WafContext(handle)
+
+    def shortLimits = new Waf.Limits(5, 20, 100, 1, 1, true)
+
+    def result = context.run(['server.request.headers.no_cookies': ['user-agent': 'Arachni/v1']], shortLimits, metrics)
+    assert result.is(Waf.ResultWithData.TIMEOUT)
+    assert result.result == Waf.Result.TIMEOUT
+    assert result.actions.isEmpty()
+    assert result.data == null
+  }
+
+  @Test
+  void 'reduceBudget keeps timeoutAsResult'() {
+    def lims = new Waf.Limits(5, 20, 100, 1000, 0, true)
+    assert lims.reduceBudget(10).timeoutAsResult
+    assert !new Waf.Limits(5, 20, 100, 1000, 0).reduceBudget(10).timeoutAsResult
+  }
+
+  @Test
+  void 'ephemeral runs reuse a context-owned arena until close'() {
+    wafDiagnostics = builder.addOrUpdateConfig('test', ARACHNI_ATOM_V1_0)
+    handle = builder.buildWafHandleInstance()
+    context = new WafContext(handle)
+
+    assert context.@ephemeralLease == null
+    context.runEphemeral(['server.request.headers.no_cookies': ['user-agent': 'foo']], limits, metrics)
+    def lease = context.@ephemeralLease
+    assert lease != null
+
+    3.times {
+      def result = context.runEphemeral(
+        ['server.request.headers.no_cookies': ['user-agent': 'Arachni/v1']], limits, metrics)
+      assert result.result == Waf.Result.MATCH
+      assert context.@ephemeralLease.is(lease)
+      lease.arena.pwargsSegments.each { assert it.buffer.position() == 0 }
+      lease.arena.stringsSegments.each { assert it.buffer.position() == 0 }
+    }
+    assert !ByteBufferSerializer.ArenaPool.INSTANCE.arenas.any { it.is(lease.arena) }
+
+    context.close()
+    assert ByteBufferSerializer.ArenaPool.INSTANCE.arenas.any { it.is(lease.arena) }
+  }
+
   @Test
   void 'run updates metrics if provided'() {
     wafDiagnostics = builder.addOrUpdateConfig('test', ARACHNI_ATOM_V1_0)
@@ -159,4 +159,67 @@ class WafDiagnosticsTest implements WafTrait {
     assert diagnosticsString.contains('rulesetVersion=\'1.0\'')
     assert diagnosticsString.contains('rules=SectionInfo[loaded=[rule1]')
   }
+
+  @Test
+  void 'summary diagnostics count ids and build the lists on demand'() {
+    WafDiagnostics full = builder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1)
+
+    WafBuilder summaryBuilder = new WafBuilder(new WafConfig(summaryDiagnostics: true))
+    try {
+      WafDiagnostics summary = summaryBuilder.addOrUpdateConfig('test', ARACHNI_ATOM_V2_1)
+
+      assert !full.summary
+      assert summary.summary
+      assert summary.rulesetVersion == '1.2.6'
+      assert summary.numConfigOK == full.numConfigOK
+      assert summary.rules.numLoaded == 1
+      assert summary.rules.toString().contains('loaded=1 ids')
+      assert summary.detailsJson.contains('"arachni_rule"')
+
+      assert summary.rules.loaded == full.rules.loaded
+      assert summary.rules.failed.empty
+    } finally {
+      summaryBuilder.close()
+    }
+  }
+
+  @Test
+  void 'summary diagnostics keep the errors'() {
+    def ruleset = [
+      version: '2.1',
+      rules: [
+        [
+          id: 'valid_rule',
+          name: 'Valid rule',
+          tags: [type: 'arachni_detection', category: 'attack_attempt'],
+          conditions: [
+            [
+              operator: 'match_regex',
+              parameters: [inputs: [[address: 'server.request.headers.no_cookies']], regex: 'x']
+            ]
+          ]
+        ],
+        [
+          id: 'invalid_rule',
+          name: 'Invalid rule',
+          tags: [type: 'arachni_detection'],
+          conditions: [[operator: 'invalid_operator']]
+        ]
+      ]
+    ]
+
+    WafBuilder summaryBuilder = new WafBuilder(new WafConfig(summaryDiagnostics: true))
+    try {
+      WafDiagnostics full = builder.addOrUpdateConfig('test', ruleset)
+      WafDiagnostics summary = summaryBuilder.addOrUpdateConfig('test', ruleset)
+
+      assert summary.summary
+      assert summary.numConfigError == full.numConfigError
+      assert summary.allErrors == full.allErrors
+      assert summary.rules.numFailed == 1
+      assert summary.rules.failed == ['invalid_rule']
+    } finally {
+      summaryBuilder.close()
+    }
+  }
 }
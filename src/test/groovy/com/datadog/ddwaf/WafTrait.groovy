@@ -248,5 +248,22 @@ trait WafTrait extends JNITrait {
       ]
     ] as Map<String, Object>, limits, metrics)
   }
-}
 
+  // runs body on numThreads threads at once; fails with the first error thrown by any of them
+  void runInThreads(int numThreads, Closure<?> body) {
+    List<Throwable> errors = Collections.synchronizedList(new ArrayList<Throwable>())
+    List<Thread> threads = (1..numThreads).collect {
+      Thread.start {
+        try {
+          body.call()
+        } catch (Throwable t) {
+          errors << t
+        }
+      }
+    }
+    threads*.join()
+    if (!errors.empty) {
+      throw errors[0]
+    }
+  }
+}
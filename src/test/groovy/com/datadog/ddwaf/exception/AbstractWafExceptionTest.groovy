@@ -47,4 +47,36 @@ class AbstractWafExceptionTest {
       assert e.message == 'Unhandled WafErrorCode: BINDING_ERROR'
     }
   }
+
+  @Test
+  void testPreallocatedExceptionsAreSharedAndStackless() {
+    [-1, -2, -3].each {
+      def exc = AbstractWafException.preallocatedFromErrorCode(it)
+      assert exc.is(AbstractWafException.preallocatedFromErrorCode(it))
+      assert exc.class == AbstractWafException.createFromErrorCode(it).class
+      assert exc.code == it
+      assert exc.message == AbstractWafException.createFromErrorCode(it).message
+      assert exc.stackTrace.length == 0
+    }
+
+    def unclassified = AbstractWafException.preallocatedFromErrorCode(999)
+    assert unclassified instanceof UnclassifiedWafException
+    assert unclassified.code == 999
+  }
+
+  @Test
+  void testPreallocatedExceptionsIgnoreSuppressedAndCause() {
+    def exc = TimeoutWafException.PREALLOCATED
+    exc.addSuppressed(new RuntimeException())
+    assert exc.suppressed.length == 0
+    assert exc.stackTrace.length == 0
+    assert exc.message == 'Timeout'
+
+    try {
+      exc.initCause(new RuntimeException())
+      fail('Expected IllegalStateException to be thrown')
+    } catch (IllegalStateException e) {
+      assert exc.cause == null
+    }
+  }
 }
@@ -0,0 +1,58 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed
+ * under the Apache-2.0 License.
+ *
+ * This product includes software developed at Datadog
+ * (https://www.datadoghq.com/). Copyright 2026 Datadog, Inc.
+ */
+
+package com.datadog.ddwaf.logging
+
+import org.junit.Test
+
+import java.util.function.LongSupplier
+
+import static org.hamcrest.MatcherAssert.assertThat
+import static org.hamcrest.Matchers.is
+
+class LogRateLimiterTests {
+
+  long now = 1000
+  LogRateLimiter limiter = new LogRateLimiter(3, 100, { now } as LongSupplier)
+
+  @Test
+  void 'lets a burst through then suppresses'() {
+    3.times { assertThat limiter.tryAcquire(), is(0L) }
+    assertThat limiter.tryAcquire(), is(-1L)
+    assertThat limiter.tryAcquire(), is(-1L)
+  }
+
+  @Test
+  void 'reports the suppressed count once refilled'() {
+    3.times { limiter.tryAcquire() }
+    5.times { assertThat limiter.tryAcquire(), is(-1L) }
+
+    now += 100
+    assertThat limiter.tryAcquire(), is(5L)
+    assertThat limiter.tryAcquire(), is(-1L)
+    now += 99
+    assertThat limiter.tryAcquire(), is(-1L)
+    now += 1
+    assertThat limiter.tryAcquire(), is(2L)
+  }
+
+  @Test
+  void 'refills up to the burst size'() {
+    3.times { limiter.tryAcquire() }
+
+    now += 10_000
+    3.times { assertThat limiter.tryAcquire(), is(0L) }
+    assertThat limiter.tryAcquire(), is(-1L)
+  }
+
+  @Test
+  void 'suffix mentions the suppressed messages'() {
+    assertThat LogRateLimiter.suppressedSuffix(0), is('')
+    assertThat LogRateLimiter.suppressedSuffix(2), is(' (2 similar messages suppressed)')
+  }
+}